@@ -268,29 +268,25 @@ for i in range (int(opt.nb_frames)):
     for j in range(steps_per_frame):
         p.stepSimulation()
 
-    # Lets update the pose of the objects in visii 
+    # Lets update the pose of the objects in visii, all at once
+    transform_ids = []
+    positions = []
+    rotations = []
     for ids in ids_pybullet_and_visii_names:
 
         # get the pose of the objects
         pos, rot = p.getBasePositionAndOrientation(ids['pybullet_id'])
 
-        # get the visii entity for that object
+        # get the visii transform for that object
         obj_entity = visii.entity.get(ids['visii_id'])
-        obj_entity.get_transform().set_position(visii.vec3(
-                                                pos[0],
-                                                pos[1],
-                                                pos[2]
-                                                )
-                                            )
-
-        # visii quat expects w as the first argument
-        obj_entity.get_transform().set_rotation(visii.quat(
-                                                rot[3],
-                                                rot[0],
-                                                rot[1],
-                                                rot[2]
-                                                )   
-                                            )
+        transform_ids.append(obj_entity.get_transform().get_id())
+        positions.extend(pos)
+
+        # pybullet quaternions are (x, y, z, w), the order expected here
+        rotations.extend(rot)
+
+    visii.transform.set_positions_rotations(transform_ids, positions, rotations)
+
     print(f'rendering frame {str(i).zfill(5)}/{str(opt.nb_frames).zfill(5)}')
     visii.render_to_png(
         width=int(opt.width), 
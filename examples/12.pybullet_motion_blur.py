@@ -275,32 +275,36 @@ for i in range (int(opt.nb_frames)):
     for j in range(steps_per_frame):
         p.stepSimulation()
 
-    # Lets update the pose of the objects in visii 
+    # Lets update the pose of the objects in visii, all at once
+    transform_ids = []
+    positions = []
+    rotations = []
     for ids in ids_pybullet_and_visii_names:
 
         # get the pose of the objects
         pos, rot = p.getBasePositionAndOrientation(ids['pybullet_id'])
         _dpos, _drot = p.getBaseVelocity(ids['pybullet_id'])
 
-        # get the visii entity for that object. 
-        obj_entity = visii.entity.get(ids['visii_id'])
-        dpos = visii.vec3(_dpos[0],_dpos[1],_dpos[2])
-        new_pos = visii.vec3(pos[0],pos[1],pos[2])
-        obj_entity.get_transform().set_position(new_pos)
+        # get the visii transform for that object
+        obj_transform = visii.entity.get(ids['visii_id']).get_transform()
+        transform_ids.append(obj_transform.get_id())
+        positions.extend(pos)
+
+        # pybullet quaternions are (x, y, z, w), the order expected here
+        rotations.extend(rot)
 
         # Use linear velocity to blur the object in motion.
         # We use frames per second here to internally convert velocity in meters / second into meters / frame.
         # The "mix" parameter smooths out the motion blur temporally, reducing flickering from linear motion blur
-        obj_entity.get_transform().set_linear_velocity(dpos, frames_per_second, mix = .8)
+        dpos = visii.vec3(_dpos[0],_dpos[1],_dpos[2])
+        obj_transform.set_linear_velocity(dpos, frames_per_second, mix = .8)
 
-        # visii quat expects w as the first argument
-        new_rot = visii.quat(rot[3], rot[0], rot[1], rot[2])
-        drot = visii.vec3(_drot[0],_drot[1],_drot[2])
-        obj_entity.get_transform().set_rotation(new_rot)
-        
         # Use angular velocity to blur the object in motion. Same concepts as above, but for 
         # angular velocity instead of scalar.
-        obj_entity.get_transform().set_angular_velocity(visii.quat(1.0, drot), frames_per_second, mix = .8)
+        drot = visii.vec3(_drot[0],_drot[1],_drot[2])
+        obj_transform.set_angular_velocity(visii.quat(1.0, drot), frames_per_second, mix = .8)
+
+    visii.transform.set_positions_rotations(transform_ids, positions, rotations)
 
     print(f'rendering frame {str(i).zfill(5)}/{str(opt.nb_frames).zfill(5)}')
     visii.render_to_png(
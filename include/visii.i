@@ -88,9 +88,11 @@ else:
 
 
 /* STD Vectors */
+%include "std_string.i"
 %include "std_vector.i"
 namespace std {
   %template(FloatVector) vector<float>;
+  %template(StringVector) vector<string>;
   %template(UINT32Vector) vector<uint32_t>;
   %template(EntityVector) vector<Entity*>;
   %template(TransformVector) vector<Transform*>;
@@ -101,10 +103,14 @@ namespace std {
   %template(MaterialVector) vector<Material*>;
 }
 
-/* STD Maps */
-%include "std_map.i"
-namespace std {
-  %template(StringToUINT32Map) map<string, uint32_t>;
+/* Name to ID tables, returned to python as dictionaries */
+%typemap(out) const NameTable & {
+  $result = PyDict_New();
+  $1->forEach([&] (const std::string &name, uint32_t id) {
+    PyObject *value = PyLong_FromUnsignedLong(id);
+    PyDict_SetItemString($result, name.c_str(), value);
+    Py_DECREF(value);
+  });
 }
 
 /* -------- Ignores --------------*/
@@ -144,6 +150,20 @@ namespace std {
 %ignore Material::markDirty();
 %ignore Material::markClean();
 
+/* Component tables are paged, and not wrapped for python */
+%ignore Camera::getFront();
+%ignore Camera::getFrontStruct();
+%ignore Light::getFront();
+%ignore Light::getFrontStruct();
+%ignore Mesh::getFront();
+%ignore Mesh::getFrontStruct();
+%ignore Texture::getFront();
+%ignore Texture::getFrontStruct();
+
+/* References into mesh data, which are only safe to read while the renderer holds the edit mutex */
+%ignore Mesh::getVerticesRef();
+%ignore Mesh::getTriangleIndicesRef();
+
 /* -------- Renames --------------*/
 %rename("%(undercase)s",%$isfunction) "";
 %rename("%(undercase)s",%$isclass) "";
@@ -16,6 +16,7 @@
 class Camera : public StaticFactory
 {
 	friend class StaticFactory;
+	template<class, uint32_t, uint32_t> friend class PagedArray;
     friend class Entity;
 private:
   	/** Prevents multiple components from simultaneously being added and/or removed from the component list */
@@ -25,13 +26,16 @@ private:
 	static bool factoryInitialized;
 
 	/** The table of Camera components */
-	static Camera cameras[MAX_CAMERAS];
+	static PagedArray<Camera> cameras;
 
 	/** The table of Camera structs */
-	static CameraStruct cameraStructs[MAX_CAMERAS];
+	static PagedArray<CameraStruct> cameraStructs;
+
+	/* Grows the camera and camera struct tables to hold at least count cameras */
+	static void reserveTables(uint32_t count);
 
 	/* A lookup table of name to camera id */
-	static std::map<std::string, uint32_t> lookupTable;
+	static NameTable lookupTable;
 
   	/**
 	 * Instantiates a null Camera. Used to mark a row in the table as null. 
@@ -87,11 +91,11 @@ private:
 	*/
 	static Camera *get(std::string name);
 
-	/** @returns a pointer to the table of CameraStructs */
-	static CameraStruct *getFrontStruct();
+	/** @returns a reference to the table of CameraStructs */
+	static PagedArray<CameraStruct> &getFrontStruct();
 
 	/** @returns a pointer to the list of Camera components. */
-	static Camera *getFront();
+	static PagedArray<Camera> &getFront();
 
 	/** @returns the number of allocated cameras. */
 	static uint32_t getCount();
@@ -100,7 +104,7 @@ private:
 	std::string getName();
 
 	/** @returns A map whose key is a camera name and whose value is the ID for that camera */
-	static std::map<std::string, uint32_t> getNameToIdMap();
+	static const NameTable &getNameToIdMap();
 
 	/** @param name The name of the camera to remove */
 	static void remove(std::string name);
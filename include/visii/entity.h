@@ -26,6 +26,7 @@ class Mesh;
  */
 class Entity : public StaticFactory {
 	friend class StaticFactory;
+	template<class, uint32_t, uint32_t> friend class PagedArray;
 private:
 	/** If an entity isn't active, its callbacks aren't called */
 	bool active = true;
@@ -37,13 +38,16 @@ private:
 	static bool factoryInitialized;
 	
     /** The table of Entity components */
-	static Entity entities[MAX_ENTITIES];
+	static PagedArray<Entity> entities;
 
     /** The table of Entity structs */
-	static EntityStruct entityStructs[MAX_ENTITIES];
+	static PagedArray<EntityStruct> entityStructs;
+
+	/* Grows the entity and entity struct tables to hold at least count entities */
+	static void reserveTables(uint32_t count);
 
     /** A lookup table where, given the name of a component, returns the primary key of that component */
-	static std::map<std::string, uint32_t> lookupTable;
+	static NameTable lookupTable;
 
     /**
 	 * Instantiates a null Entity. Used to mark a row in the table as null. 
@@ -82,17 +86,37 @@ public:
 		Camera* camera = nullptr
 	);
 
+	/**
+	 * Constructs an Entity named after the given prefix. If an entity with that name already exists, 
+	 * a number making the name unique is appended to it.
+	 * 
+	 * @param prefix The name to give the entity, before any number is appended
+	 * @param transform (optional) A transform component places the entity into the scene
+	 * @param material (optional) A material component describes how an entity should look when rendered.
+	 * @param mesh (optional) A mesh component describes the geometry of the entity to be rendered. 
+	 * @param light (optional) A light component indicates that any connected geometry should act like a light source.
+	 * @param camera (optional) A camera component indicates that the current entity can be used to view into the scene.
+     * @returns a reference to an Entity
+	 */
+	static Entity* createUnique(std::string prefix, 
+		Transform* transform = nullptr, 
+		Material* material = nullptr,
+		Mesh* mesh = nullptr,
+		Light* light = nullptr,
+		Camera* camera = nullptr
+	);
+
 	/**
      * @param name The name of the entity to get
 	 * @returns an Entity who's name matches the given name 
 	 */
 	static Entity* get(std::string name);
 
-    /** @returns a pointer to the table of EntityStructs */
-	static EntityStruct* getFrontStruct();
+    /** @returns a reference to the table of EntityStructs */
+	static PagedArray<EntityStruct> &getFrontStruct();
 
-    /** @returns a pointer to the table of Entity components */
-	static Entity* getFront();
+    /** @returns a reference to the table of Entity components */
+	static PagedArray<Entity> &getFront();
 
     /** @returns the number of allocated entities */
 	static uint32_t getCount();
@@ -101,7 +125,7 @@ public:
 	std::string getName();
 
 	/** @returns A map whose key is an entity name and whose value is the ID for that entity */
-	static std::map<std::string, uint32_t> getNameToIdMap();
+	static const NameTable &getNameToIdMap();
 
     /** @param name The name of the Entity to remove */
 	static void remove(std::string name);
@@ -2,7 +2,6 @@
 #pragma once
 
 #include <stdint.h>
-#define MAX_ENTITIES 100000
 
 #ifndef ENTITY_VISIBILITY_FLAGS
 #define ENTITY_VISIBILITY_FLAGS
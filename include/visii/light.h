@@ -13,6 +13,7 @@ class Texture;
 */
 class Light : public StaticFactory {
     friend class StaticFactory;
+    template<class, uint32_t, uint32_t> friend class PagedArray;
     friend class Entity;
 public:
     /** 
@@ -42,17 +43,28 @@ public:
     */
     static Light* createFromRGB(std::string name, glm::vec3 color, float intensity);
 
+    /** 
+     * Like createFromRGB, but rather than failing when the prefix is already taken, appends a number 
+     * to it which makes the name unique. Useful when importing many lights, whose names may collide.
+     *
+     * @param prefix The name to use for this light, if not already taken.
+     * @param color An RGB color to emit. Values should range between 0 and 1. 
+     * @param intensity How powerful the light source is in emitting light 
+     * @returns a reference to a light component
+    */
+    static Light* createUnique(std::string prefix, glm::vec3 color, float intensity);
+
     /** 
      * @param name The name of the light to get
      * @returns a Light who's name matches the given name 
     */
     static Light* get(std::string name);
 
-    /** @returns a pointer to the table of LightStructs required for rendering */
-    static LightStruct* getFrontStruct();
+    /** @returns a reference to the table of LightStructs required for rendering */
+    static PagedArray<LightStruct> &getFrontStruct();
 
-    /** @returns a pointer to the table of light components */
-    static Light* getFront();
+    /** @returns a reference to the table of light components */
+    static PagedArray<Light> &getFront();
 
     /** @returns the number of allocated lights */
     static uint32_t getCount();
@@ -61,7 +73,7 @@ public:
 	std::string getName();
 
     /** @returns A map whose key is a light name and whose value is the ID for that light */
-	static std::map<std::string, uint32_t> getNameToIdMap();
+	static const NameTable &getNameToIdMap();
 
     /** @param name The name of the Light to remove */
     static void remove(std::string name);
@@ -152,12 +164,15 @@ private:
     /* Flag indicating that static resources were created */
     static bool factoryInitialized;
 
-    /* A list of light components, allocated statically */
-    static Light lights[MAX_LIGHTS];
-    static LightStruct lightStructs[MAX_LIGHTS];
+    /* A list of light components, grown as components are created */
+    static PagedArray<Light> lights;
+    static PagedArray<LightStruct> lightStructs;
+
+    /* Grows the light and light struct tables to hold at least count lights */
+    static void reserveTables(uint32_t count);
 
     /* A lookup table of name to light id */
-    static std::map<std::string, uint32_t> lookupTable;
+    static NameTable lookupTable;
 
     /* Indicates that one of the components has been edited */
     static bool anyDirty;
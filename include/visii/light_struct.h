@@ -1,7 +1,6 @@
 /* File shared by both host and device */
 #pragma once
 
-#define MAX_LIGHTS 100
 #include <stdint.h>
 #include <glm/glm.hpp>
 using namespace glm;
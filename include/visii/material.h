@@ -36,6 +36,7 @@ class Texture;
 class Material : public StaticFactory
 {
   friend class StaticFactory;
+  template<class, uint32_t, uint32_t> friend class PagedArray;
   friend class Entity;
   public:
     /**
@@ -82,6 +83,15 @@ class Material : public StaticFactory
       float clearcoat = 0.f,
       float clearcoat_roughness = .03f);
 
+    /**
+     * Constructs a material with default properties, named after the given prefix. If a material with 
+     * that name already exists, a number making the name unique is appended to it.
+     * 
+     * @param prefix The name to give the material, before any number is appended
+     * @returns a reference to a material component
+    */
+    static Material* createUnique(std::string prefix);
+
     /**
      * Gets a material by name 
      * 
@@ -90,11 +100,11 @@ class Material : public StaticFactory
     */
     static Material* get(std::string name);
 
-    /** @returns a pointer to the table of MaterialStructs */
-    static MaterialStruct* getFrontStruct();
+    /** @returns a reference to the table of MaterialStructs */
+    static PagedArray<MaterialStruct> &getFrontStruct();
 
-    /** @returns a pointer to the table of Material components */
-    static Material* getFront();
+    /** @returns a reference to the table of Material components */
+    static PagedArray<Material> &getFront();
 
     /** @returns the number of allocated materials */
 	  static uint32_t getCount();
@@ -103,7 +113,7 @@ class Material : public StaticFactory
 	  std::string getName();
 
     /** @returns A map whose key is a material name and whose value is the ID for that material */
-	  static std::map<std::string, uint32_t> getNameToIdMap();
+	  static const NameTable &getNameToIdMap();
 
     /** @param name The name of the material to remove */
     static void remove(std::string name);
@@ -639,12 +649,15 @@ class Material : public StaticFactory
     /* TODO */
     static bool factoryInitialized;
 
-    /*  A list of the material components, allocated statically */
-    static Material materials[MAX_MATERIALS];
-    static MaterialStruct materialStructs[MAX_MATERIALS];
+    /*  A list of the material components, grown as components are created */
+    static PagedArray<Material> materials;
+    static PagedArray<MaterialStruct> materialStructs;
+
+    /* Grows the material and material struct tables to hold at least count materials */
+    static void reserveTables(uint32_t count);
 
     /* A lookup table of name to material id */
-    static std::map<std::string, uint32_t> lookupTable;
+    static NameTable lookupTable;
     
     /* Indicates that one of the components has been edited */
     static bool anyDirty;
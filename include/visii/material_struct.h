@@ -1,7 +1,6 @@
 /* File shared by both host and device */
 #pragma once
 
-#define MAX_MATERIALS 100000
 #include <stdint.h>
 #include <glm/glm.hpp>
 using namespace glm;
@@ -26,6 +26,7 @@ class Vertex;
 class Mesh : public StaticFactory
 {
 	friend class StaticFactory;
+	template<class, uint32_t, uint32_t> friend class PagedArray;
 	friend class Entity;
 	public:
 		/** 
@@ -572,11 +573,20 @@ class Mesh : public StaticFactory
 		 * 
 		 * @param name The name (used as a primary key) for this mesh component
 		 * @param path A path to the OBJ file.
+		 * @param optimize If True, triangles and vertices are reordered for better memory locality during rendering. 
+		 * (see optimize_for_locality)
 		*/
-		static Mesh* createFromObj(std::string name, std::string path);
+		static Mesh* createFromObj(std::string name, std::string path, bool optimize = true);
 
-		// /* Creates a mesh component from an ASCII STL file */
-		// static Mesh* createFromStl(std::string name, std::string stlPath);
+		/** 
+		 * Creates a mesh component from a binary STL file. The file is memory mapped and read directly, 
+		 * coincident vertices are welded together, and smooth vertex normals are generated.
+		 * 
+		 * @param name The name (used as a primary key) for this mesh component
+		 * @param path A path to the binary STL file.
+		 * @returns a reference to the mesh component
+		*/
+		static Mesh* createFromStl(std::string name, std::string path);
 
 		// /* Creates a mesh component from a GLB file (material properties are ignored) */
 		// static Mesh* createFromGlb(std::string name, std::string glbPath);
@@ -596,6 +606,8 @@ class Mesh : public StaticFactory
 		 * @param colors A list of per-vertex colors. If indices aren't supplied, this must be a multiple of 3.
 		 * @param texcoords A list of 2D per-vertex texture coordinates. If indices aren't supplied, this must be a multiple of 3.
 		 * @param indices A list of integer indices connecting vertex positions in a counterclockwise ordering to form triangles. If supplied, indices must be a multiple of 3.
+		 * @param optimize If True, triangles and vertices are reordered for better memory locality during rendering. 
+		 * Note that this changes the order of the supplied per vertex data and indices. (see optimize_for_locality)
 		 * @returns a reference to the mesh component
 		*/
 		static Mesh* createFromData(
@@ -604,7 +616,25 @@ class Mesh : public StaticFactory
 			std::vector<glm::vec4> normals = std::vector<glm::vec4>(), 
 			std::vector<glm::vec4> colors = std::vector<glm::vec4>(), 
 			std::vector<glm::vec2> texcoords = std::vector<glm::vec2>(), 
-			std::vector<uint32_t> indices = std::vector<uint32_t>());
+			std::vector<uint32_t> indices = std::vector<uint32_t>(),
+			bool optimize = false);
+
+		/**
+		 * Like createFromData, but rather than failing when the prefix is already taken, appends a number 
+		 * to it which makes the name unique. Useful when importing many meshes, whose names may collide.
+		 * 
+		 * @param prefix The name to use for this mesh component, if not already taken.
+		 * See createFromData for the remaining parameters.
+		 * @returns a reference to the mesh component
+		*/
+		static Mesh* createUnique(
+			std::string prefix,
+			std::vector<glm::vec4> positions, 
+			std::vector<glm::vec4> normals = std::vector<glm::vec4>(), 
+			std::vector<glm::vec4> colors = std::vector<glm::vec4>(), 
+			std::vector<glm::vec2> texcoords = std::vector<glm::vec2>(), 
+			std::vector<uint32_t> indices = std::vector<uint32_t>(),
+			bool optimize = false);
 
 		/**
 		 * @param name The name of the Mesh to get
@@ -612,11 +642,11 @@ class Mesh : public StaticFactory
 		 */
         static Mesh* get(std::string name);
 
-        /** @returns a pointer to the table of MeshStructs required for rendering */
-        static MeshStruct* getFrontStruct();
+        /** @returns a reference to the table of MeshStructs required for rendering */
+        static PagedArray<MeshStruct> &getFrontStruct();
 
-        /** @returns a pointer to the table of mesh components */
-        static Mesh* getFront();
+        /** @returns a reference to the table of mesh components */
+        static PagedArray<Mesh> &getFront();
 
         /** @returns the number of allocated meshes */
         static uint32_t getCount();
@@ -625,7 +655,7 @@ class Mesh : public StaticFactory
 		std::string getName();
 		
 		/** @returns A map whose key is a mesh name and whose value is the ID for that mesh */
-		static std::map<std::string, uint32_t> getNameToIdMap();
+		static const NameTable &getNameToIdMap();
 
 		/** @param name The name of the Mesh to remove */
         static void remove(std::string name);
@@ -757,6 +787,30 @@ class Mesh : public StaticFactory
 		*/
 		void generateSmoothNormals();
 
+		/**
+		 * Reorders triangles to improve post-transform vertex cache reuse, then reorders vertices 
+		 * into the order they are first referenced, so that vertex fetches during rendering are 
+		 * mostly coherent. The resulting geometry is unchanged.
+		*/
+		void optimizeForLocality();
+
+		/**
+		 * Simulates a FIFO vertex cache over the triangle indices.
+		 * 
+		 * @param cacheSize The number of vertices held by the simulated cache.
+		 * @returns the average cache miss ratio (ACMR), the number of vertices transformed per triangle. 
+		 * Values range from 3.0 (no reuse) down to about 0.5 for large regular meshes.
+		*/
+		float getAverageCacheMissRatio(uint32_t cacheSize = 16);
+
+		/**
+		 * Simulates a small cache of 64 byte lines over the vertex position buffer.
+		 * 
+		 * @returns the ratio of bytes fetched over the bytes of all referenced vertices. 
+		 * A value of 1.0 means every vertex was fetched exactly once.
+		*/
+		float getVertexFetchRatio();
+
 		// /* If mesh editing is enabled, replaces the vertex color at the given index with a new vertex color */
 		// void edit_vertex_color(uint32_t index, glm::vec4 new_color);
 
@@ -788,6 +842,12 @@ class Mesh : public StaticFactory
 		/** For internal use. Returns the mutex used to lock entities for processing by the renderer. */
 		static std::shared_ptr<std::mutex> getEditMutex();
 
+		/** For internal use. Returns the per vertex positions without copying them. Only valid while the edit mutex is held. */
+		const std::vector<glm::vec4> &getVerticesRef();
+
+		/** For internal use. Returns the triangle indices without copying them. Only valid while the edit mutex is held. */
+		const std::vector<uint32_t> &getTriangleIndicesRef();
+
 	private:
 		/** Creates an uninitialized mesh. Useful for preallocation. */
 		Mesh();
@@ -801,12 +861,15 @@ class Mesh : public StaticFactory
 		/* TODO */
 		static bool factoryInitialized;
 		
-		/** A list of the mesh components, allocated statically */
-		static Mesh meshes[MAX_MESHES];
-		static MeshStruct meshStructs[MAX_MESHES];
+		/** A list of the mesh components, grown as components are created */
+		static PagedArray<Mesh> meshes;
+		static PagedArray<MeshStruct> meshStructs;
+
+		/* Grows the mesh and mesh struct tables to hold at least count meshes */
+		static void reserveTables(uint32_t count);
 
 		/** A lookup table of name to mesh id */
-		static std::map<std::string, uint32_t> lookupTable;
+		static NameTable lookupTable;
 
 		// /* Lists of per vertex data. These might not match GPU memory if editing is disabled. */
 		std::vector<glm::vec4> positions;
@@ -878,10 +941,10 @@ class Mesh : public StaticFactory
 		// void createTriangleIndexBuffer(bool allow_edits, bool submit_immediately);
 
 		// /* Loads in an OBJ mesh and copies per vertex data to the GPU */
-		void loadObj(std::string objPath);
+		void loadObj(std::string objPath, bool optimize);
 
-		// /* Loads in an STL mesh and copies per vertex data to the GPU */
-		// void load_stl(std::string stlPath);
+		/* Loads in a binary STL mesh, welding coincident vertices together */
+		void loadStl(std::string stlPath);
 
 		// /* Loads in a GLB mesh and copies per vertex data to the GPU */
 		// void load_glb(std::string glbPath);
@@ -895,7 +958,8 @@ class Mesh : public StaticFactory
 			std::vector<glm::vec4> &normals, 
 			std::vector<glm::vec4> &colors, 
 			std::vector<glm::vec2> &texcoords,
-			std::vector<uint32_t> indices
+			std::vector<uint32_t> indices,
+			bool optimize
 		);
 		
 		/** Creates a procedural mesh from the given mesh generator, and copies per vertex to the GPU */
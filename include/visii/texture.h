@@ -12,6 +12,7 @@
 class Texture : public StaticFactory
 {
 	friend class StaticFactory;
+	template<class, uint32_t, uint32_t> friend class PagedArray;
   public:
 	
 	/** 
@@ -38,17 +39,26 @@ class Texture : public StaticFactory
 	*/
 	static Texture *createFromData(std::string name, uint32_t width, uint32_t height, std::vector<float> data);
 
+	/** 
+	 * Like createFromData, but rather than failing when the prefix is already taken, appends a number 
+	 * to it which makes the name unique. Useful when importing many textures, whose names may collide.
+	 * @param prefix The name to use for this texture, if not already taken.
+	 * See createFromData for the remaining parameters.
+     * @returns a Texture allocated by the renderer. 
+	*/
+	static Texture *createUnique(std::string prefix, uint32_t width, uint32_t height, std::vector<float> data);
+
     /**
      * @param name The name of the Texture to get
 	 * @returns a Texture who's name matches the given name 
 	 */
 	static Texture *get(std::string name);
 
-    /** @returns a pointer to the table of TextureStructs */
-	static TextureStruct *getFrontStruct();
+    /** @returns a reference to the table of TextureStructs */
+	static PagedArray<TextureStruct> &getFrontStruct();
 
-	/** @returns a pointer to the table of Texture components */
-	static Texture *getFront();
+	/** @returns a reference to the table of Texture components */
+	static PagedArray<Texture> &getFront();
 
 	/** @returns the number of allocated textures */
 	static uint32_t getCount();
@@ -57,7 +67,7 @@ class Texture : public StaticFactory
 	std::string getName();
 
 	/** @returns A map whose key is a texture name and whose value is the ID for that texture */
-	static std::map<std::string, uint32_t> getNameToIdMap();
+	static const NameTable &getNameToIdMap();
 
 	/** @param name The name of the Texture to remove */
 	static void remove(std::string name);
@@ -120,12 +130,15 @@ class Texture : public StaticFactory
 	/* TODO */
 	static bool factoryInitialized;
 	
-    /** A list of the camera components, allocated statically */
-	static Texture textures[MAX_TEXTURES];
-	static TextureStruct textureStructs[MAX_TEXTURES];
+    /** A list of the camera components, grown as components are created */
+	static PagedArray<Texture> textures;
+	static PagedArray<TextureStruct> textureStructs;
+
+	/* Grows the texture and texture struct tables to hold at least count textures */
+	static void reserveTables(uint32_t count);
 	
 	/** A lookup table of name to camera id */
-	static std::map<std::string, uint32_t> lookupTable;
+	static NameTable lookupTable;
 
     /** Indicates that one of the components has been edited */
     static bool anyDirty;
@@ -1,8 +1,6 @@
 /* File shared by both host and device */
 #pragma once
 
-#define MAX_TEXTURES 32768
-
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #define GLM_DEPTH_ZERO_TO_ONE
 #define GLM_FORCE_RADIANS
@@ -17,8 +17,10 @@
 #include <glm/gtx/matrix_decompose.hpp>
 #include <map>
 #include <mutex>
+#include <atomic>
 
 #include <visii/utilities/static_factory.h>
+#include <visii/utilities/trs_interpolation.h>
 #include <visii/transform_struct.h>
 
 using namespace glm;
@@ -31,13 +33,17 @@ using namespace std;
 class Transform : public StaticFactory
 {
     friend class StaticFactory;
+    template<class, uint32_t, uint32_t> friend class PagedArray;
     friend class Entity;
   private:
-    /* Scene graph information */
+    /* Scene graph information. Children form a doubly linked list through their sibling links, 
+    so that a transform can be attached or detached in constant time. */
     int32_t parent = -1;
-	  std::set<int32_t> children;
+    int32_t firstChild = -1;
+    int32_t prevSibling = -1;
+    int32_t nextSibling = -1;
 
-    /* Local <=> Parent */
+    /* Local <=> Parent. These are the source of truth, every matrix is derived from them on demand. */
     vec3 scale = vec3(1.0);
     vec3 position = vec3(0.0);
     quat rotation = quat(1.0f, 0.0f, 0.0f, 0.0f);
@@ -46,83 +52,94 @@ class Transform : public StaticFactory
     quat angularVelocity = quat(1.f,0.f,0.f,0.f);
     vec3 scalarVelocity = vec3(0.0);
 
-    vec3 right = vec3(1.0, 0.0, 0.0);
-    vec3 up = vec3(0.0, 1.0, 0.0);
-    vec3 forward = vec3(0.0, 0.0, 1.0);
-
-    mat4 localToParentTransform = mat4(1);
-    mat4 localToParentRotation = mat4(1);
-    mat4 localToParentTranslation = mat4(1);
-    mat4 localToParentScale = mat4(1);
-
-    mat4 parentToLocalTransform = mat4(1);
-    mat4 parentToLocalRotation = mat4(1);
-    mat4 parentToLocalTranslation = mat4(1);
-    mat4 parentToLocalScale = mat4(1);
-
-    mat4 localToParentMatrix = mat4(1);
-    mat4 parentToLocalMatrix = mat4(1);
-
-    mat4 nextLocalToParentTranslation = mat4(1);
-    mat4 nextLocalToParentRotation = mat4(1);
-    mat4 nextLocalToParentScale = mat4(1);
-
-    mat4 nextParentToLocalTranslation = mat4(1);
-    mat4 nextParentToLocalRotation = mat4(1);
-    mat4 nextParentToLocalScale = mat4(1);
-
-    mat4 nextLocalToParentMatrix = mat4(1);
-    mat4 nextParentToLocalMatrix = mat4(1);
-
-    /* Local <=> World */
-    mat4 localToWorldMatrix = mat4(1);
-    mat4 worldToLocalMatrix = mat4(1);
-    mat4 nextLocalToWorldMatrix = mat4(1);
-    mat4 nextWorldToLocalMatrix = mat4(1);
-
-    // from local to world decomposition. 
-    // May only approximate the localToWorldMatrix
-    glm::vec3 worldScale;
-    glm::quat worldRotation;
-    glm::vec3 worldTranslation;
-    glm::vec3 worldSkew;
-    glm::vec4 worldPerspective;
-    
-    // float interpolation = 1.0;
+    /* An optional additional transform, applied after the translation. Only allocated when set through setTransform. */
+    std::unique_ptr<mat4> localToParentTransform;
+
+    /* Optional keys describing motion over the frame, used in place of the velocities. Empty unless set through setMotionKeys. */
+    std::vector<TRSKey> motionKeys;
+
+    /* Indicates this transform was edited since the last call to updateComponents, and so the world 
+    matrices cached in its TransformStruct (and those of its descendants) may be out of date */
+    bool worldDirty = false;
 
     /* TODO */
 	static std::shared_ptr<std::mutex> editMutex;
     static bool factoryInitialized;
 
-    static Transform transforms[MAX_TRANSFORMS];
-    static TransformStruct transformStructs[MAX_TRANSFORMS];
-    static std::map<std::string, uint32_t> lookupTable;
-    
-    /* Updates cached rotation values */
-    void updateRotation();
-
-    /* Updates cached position values */
-    void updatePosition();
-
-    /* Updates cached scale values */
-    void updateScale();
-
-    /* Updates cached final local to parent matrix values */
-    void updateMatrix();
-
-    /* Updates cached final local to world matrix values */
+    static PagedArray<Transform> transforms;
+    static PagedArray<TransformStruct> transformStructs;
+
+    /* Grows the transform tables, including the next frame matrices below, to hold at least count transforms */
+    static void reserveTables(uint32_t count);
+
+    /* Local to world matrices at the end of the frame, accounting for velocities. Only needed on the host 
+    for building instance motion, so these are kept apart from the TransformStructs uploaded to the device. */
+    static PagedArray<glm::mat4> nextLocalToWorldMatrices;
+    static NameTable lookupTable;
+
+    /* Transforms edited since the last call to updateComponents. Only touched while holding the edit mutex, 
+    since the renderer consumes this list from its own thread. */
+    static std::vector<int32_t> dirtyTransforms;
+
+    /* Set while dirtyTransforms is non empty, so that queries can skip the walk up the hierarchy without the mutex */
+    static std::atomic<bool> anyWorldDirty;
+
+    /* Returns the optional additional transform, or identity if none was set */
+    glm::mat4 getLocalToParentTransform();
+
+    /* Returns the inverse of the optional additional transform, or identity if none was set */
+    glm::mat4 getParentToLocalTransform();
+
+    /* Removes this transform from its parent's list of children, making it a root */
+    void unlinkFromParent();
+
+    /* Adds this transform to the front of the given transform's list of children. 
+    Assumes this transform is currently a root. */
+    void linkToParent(int32_t newParent);
+
+    /* Visits the ids of a subtree depth first, each parent before its children. No stack is 
+    needed, as the walk back up the tree follows parent links. */
+    class SubtreeIterator {
+      public:
+        SubtreeIterator(int32_t root, int32_t current) : root(root), current(current) {}
+        int32_t operator*() const { return current; }
+        bool operator!=(const SubtreeIterator &other) const { return current != other.current; }
+        SubtreeIterator &operator++();
+      private:
+        int32_t root;
+        int32_t current;
+    };
+
+    /* The range of transforms within the subtree below (and including) root */
+    struct Subtree {
+        int32_t root;
+        SubtreeIterator begin() const { return SubtreeIterator(root, root); }
+        SubtreeIterator end() const { return SubtreeIterator(root, -1); }
+    };
+
+    /* @returns a range for iterating over the subtree below (and including) root, depth first */
+    static Subtree getSubtree(int32_t root);
+
+    /* Flags the cached world matrices of this transform and all of its descendants as out of date. 
+    These are recomputed together by updateComponents. */
+    void markWorldDirty();
+
+    /* Like markWorldDirty, for callers which already hold the edit mutex */
+    void markWorldDirtyLocked();
+
+    /* Recomputes the cached world matrices in this transform's TransformStruct, along with its next 
+    local to world matrix, assuming the parent's cached world matrices are up to date */
     void updateWorldMatrix();
 
-    /* updates all childrens cached final local to world matrix values */
-    void updateChildren();
+    /* Computes the world matrices without relying on, or modifying, any out of date cached world 
+    matrices. Used to answer queries between an edit and the next call to updateComponents. */
+    void computeWorldMatrices(glm::mat4 &worldToLocal, glm::mat4 &localToWorld, glm::mat4 &nextLocalToWorld);
+
+    /* @returns True if this transform or any of its ancestors were edited since the last call to updateComponents */
+    bool isWorldStale();
 
-    /* updates the struct for this transform which can be uploaded to the GPU. */
-    void updateStruct();
-    
-    /* traverses from the current transform up through its ancestors, 
-    computing a final world to local matrix */
-    glm::mat4 computeWorldToLocalMatrix();
-    glm::mat4 computeNextWorldToLocalMatrix();
+    /* Decomposes the local to world matrix into a (possibly approximate) scale, rotation and translation */
+    void decomposeWorldMatrix(glm::vec3 &scale, glm::quat &rotation, glm::vec3 &translation);
 
     Transform();
     Transform(std::string name, uint32_t id);
@@ -149,17 +166,33 @@ class Transform : public StaticFactory
       vec3 position = vec3(0.f) 
     );
 
+    /**
+     * Constructs a transform named after the given prefix. If a transform with that name already exists, 
+     * a number making the name unique is appended to it.
+     * 
+     * @param prefix The name to give the transform, before any number is appended
+     * @param scale The initial scale of the transform, applied first. 
+     * @param rotation The initial scale of the transform, applied after scale.
+     * @param position The initial position of the transform, applied after rotation.
+     * @returns a reference to a transform component
+    */
+    static Transform* createUnique(std::string prefix, 
+      vec3 scale = vec3(1.0f), 
+      quat rotation = quat(1.0f, 0.0f, 0.0f, 0.0f),
+      vec3 position = vec3(0.f) 
+    );
+
     /** 
      * @param name The name of the transform to get
      * @returns a transform who's name matches the given name 
      */
     static Transform* get(std::string name);
 
-    /** @returns a pointer to the table of TransformStructs required for rendering*/
-    static TransformStruct* getFrontStruct();
+    /** @returns a reference to the table of TransformStructs required for rendering*/
+    static PagedArray<TransformStruct> &getFrontStruct();
 
-    /** @returns a pointer to the table of transform components */
-    static Transform* getFront();
+    /** @returns a reference to the table of transform components */
+    static PagedArray<Transform> &getFront();
 
     /** @returns the number of allocated transforms */
 	  static uint32_t getCount();
@@ -168,7 +201,7 @@ class Transform : public StaticFactory
 	  std::string getName();
 
     /** @returns A map whose key is a transform name and whose value is the ID for that transform */
-	  static std::map<std::string, uint32_t> getNameToIdMap();
+	  static const NameTable &getNameToIdMap();
 
     /** @param name The name of the transform to remove */
     static void remove(std::string name);
@@ -391,6 +424,23 @@ class Transform : public StaticFactory
     // */
     // void setPosition(float x, float y, float z);
 
+    /**
+     * Sets the positions and rotations of many transforms at once, for example to copy the state of
+     * a physics simulation into the scene. Equivalent to calling setPosition and setRotation on each
+     * transform, but the edits are applied together in a single (multithreaded) pass, and the renderer
+     * sees either all of them or none of them.
+     *
+     * @param ids The ids of the transforms to edit. An id may not appear more than once.
+     * @param positions Three floats per id, the new (x, y, z) position of each transform. May be empty to leave positions unchanged.
+     * @param rotations Four floats per id, the new rotation of each transform as an (x, y, z, w) quaternion,
+     * the order used by most physics engines. May be empty to leave rotations unchanged.
+     */
+    static void setPositionsRotations(
+      const std::vector<uint32_t> &ids,
+      const std::vector<float> &positions,
+      const std::vector<float> &rotations = std::vector<float>()
+    );
+
     // /**
     //  * Adds to the current the position vector describing where this transform should be translated to 
     //  * when placed in its parent space. 
@@ -548,7 +598,7 @@ class Transform : public StaticFactory
 
     /** 
      * Set the parent of this transform, whose transformation will be applied after the current
-     * transform. 
+     * transform. Throws if the parent is this transform or one of its descendants.
      * 
      * @param parent The transform component to constrain the current transform to. Any existing parent constraint is replaced.
     */
@@ -559,7 +609,7 @@ class Transform : public StaticFactory
 
     /** 
      * Add a child to this transform, whose transformation will be applied before the current
-     * transform. 
+     * transform. Throws if the child is this transform or one of its ancestors.
      * 
      * @param child The child transform component to constrain to the current transform. Any existing parent constraint is replaced.
     */
@@ -567,6 +617,7 @@ class Transform : public StaticFactory
 
     /** 
      * Removes a child transform previously added to the current transform. 
+     * Does nothing if the given transform is not a child of this transform.
      * 
      * @param child The constrained child transform component to un-constrain from the current transform. Any existing parent constraint is replaced.
     */
@@ -590,6 +641,43 @@ class Transform : public StaticFactory
      */
 	  glm::mat4 getNextLocalToWorldMatrix();
 
+    /**
+     * Sets keys describing how this transform moves over the course of a frame, for motion blur. Keys are
+     * spaced evenly over the frame, and interpolated linearly, with rotations slerped along the shortest arc.
+     * While set, keys take the place of the linear, angular and scalar velocities for motion blur. The 
+     * position, rotation and scale of the transform are left unchanged.
+     *
+     * @param positions Three floats per key, the (x, y, z) position at each key. May be empty to hold the current position.
+     * @param rotations Four floats per key, the rotation at each key as an (x, y, z, w) quaternion. May be empty to hold the current rotation.
+     * @param scales Three floats per key, the (x, y, z) scale at each key. May be empty to hold the current scale.
+     * Every array that is not empty must describe the same number of keys, between 2 and MAX_MOTION_KEYS (8).
+     */
+    void setMotionKeys(
+      const std::vector<float> &positions, 
+      const std::vector<float> &rotations = std::vector<float>(), 
+      const std::vector<float> &scales = std::vector<float>()
+    );
+
+    /** Removes any keys set through setMotionKeys, so that motion blur is driven by velocities again. */
+    void clearMotionKeys();
+
+    /** @returns the number of keys set through setMotionKeys, or 0 if none are set */
+    uint32_t getNumMotionKeys();
+
+    /**
+     * @param time The time within the frame to sample, from 0 (the start of the frame) to 1 (the end of the frame)
+     * @returns the matrix transforming this object from its local space to its parent's space at the given time, 
+     * following either the motion keys or the velocities of this transform.
+     */
+    glm::mat4 getLocalToParentMatrixAtTime(float time);
+
+    /**
+     * @param time The time within the frame to sample, from 0 (the start of the frame) to 1 (the end of the frame)
+     * @returns the matrix transforming this object from its local space to world space at the given time,
+     * following the motion keys or velocities of this transform and all of its parents.
+     */
+    glm::mat4 getLocalToWorldMatrixAtTime(float time);
+
     /** 
      * @returns a (possibly approximate) scale scaling the current transform from 
        * local space to world space, taking all parent transforms into account 
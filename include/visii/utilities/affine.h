@@ -0,0 +1,137 @@
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#if (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))) && !defined(__CUDACC__)
+#define VISII_AFFINE_SSE
+#include <emmintrin.h>
+#endif
+
+/*
+ * Helpers for affine transforms, ie 4x4 matrices whose bottom row is (0, 0, 0, 1).
+ * Matrices are kept as regular column major glm::mats, so they can be used interchangeably with glm,
+ * but these helpers skip the work glm would spend on the constant bottom row, and use closed form
+ * inverses. The SSE and scalar paths perform the same operations in the same order, and agree with
+ * the equivalent glm expressions to within rounding.
+*/
+
+/** @returns True if the bottom row of m is (0, 0, 0, 1) */
+inline bool isAffine(const glm::mat4 &m)
+{
+    return (m[0][3] == 0.f) && (m[1][3] == 0.f) && (m[2][3] == 0.f) && (m[3][3] == 1.f);
+}
+
+/** @returns a * b, where b is affine. a may be any matrix. */
+inline glm::mat4 affineMultiply(const glm::mat4 &a, const glm::mat4 &b)
+{
+    glm::mat4 result;
+#ifdef VISII_AFFINE_SSE
+    __m128 a0 = _mm_loadu_ps(&a[0][0]);
+    __m128 a1 = _mm_loadu_ps(&a[1][0]);
+    __m128 a2 = _mm_loadu_ps(&a[2][0]);
+    for (int j = 0; j < 4; ++j) {
+        __m128 column = _mm_add_ps(_mm_add_ps(
+            _mm_mul_ps(a0, _mm_set1_ps(b[j][0])),
+            _mm_mul_ps(a1, _mm_set1_ps(b[j][1]))),
+            _mm_mul_ps(a2, _mm_set1_ps(b[j][2])));
+        if (j == 3) column = _mm_add_ps(column, _mm_loadu_ps(&a[3][0]));
+        _mm_storeu_ps(&result[j][0], column);
+    }
+#else
+    for (int j = 0; j < 3; ++j) {
+        result[j] = a[0] * b[j][0] + a[1] * b[j][1] + a[2] * b[j][2];
+    }
+    result[3] = a[0] * b[3][0] + a[1] * b[3][1] + a[2] * b[3][2] + a[3];
+#endif
+    return result;
+}
+
+/** @returns translate(translation) * toMat4(rotation) * scale(scale), without any matrix multiplies */
+inline glm::mat4 affineFromTRS(const glm::vec3 &translation, const glm::quat &rotation, const glm::vec3 &scale)
+{
+    glm::mat3 r = glm::mat3_cast(rotation);
+    return glm::mat4(
+        glm::vec4(r[0] * scale.x, 0.f),
+        glm::vec4(r[1] * scale.y, 0.f),
+        glm::vec4(r[2] * scale.z, 0.f),
+        glm::vec4(translation, 1.f));
+}
+
+/**
+ * @returns the inverse of affineFromTRS(translation, rotation, scale), ie
+ * scale(1 / scale) * transpose(toMat4(rotation)) * translate(-translation)
+*/
+inline glm::mat4 affineFromInverseTRS(const glm::vec3 &translation, const glm::quat &rotation, const glm::vec3 &scale)
+{
+    glm::mat3 r = glm::mat3_cast(rotation);
+    glm::vec3 invScale = 1.f / scale;
+    glm::mat4 result(
+        glm::vec4(r[0][0] * invScale.x, r[1][0] * invScale.y, r[2][0] * invScale.z, 0.f),
+        glm::vec4(r[0][1] * invScale.x, r[1][1] * invScale.y, r[2][1] * invScale.z, 0.f),
+        glm::vec4(r[0][2] * invScale.x, r[1][2] * invScale.y, r[2][2] * invScale.z, 0.f),
+        glm::vec4(0.f, 0.f, 0.f, 1.f));
+    result[3] = glm::vec4(-(glm::vec3(result[0]) * translation.x + glm::vec3(result[1]) * translation.y + glm::vec3(result[2]) * translation.z), 1.f);
+    return result;
+}
+
+/** @returns the inverse of the affine matrix m, computed from the cofactors of its upper 3x3 */
+inline glm::mat4 affineInverse(const glm::mat4 &m)
+{
+    glm::vec3 c0(m[0]), c1(m[1]), c2(m[2]);
+    glm::vec3 r0 = glm::cross(c1, c2);
+    glm::vec3 r1 = glm::cross(c2, c0);
+    glm::vec3 r2 = glm::cross(c0, c1);
+    float invDet = 1.f / glm::dot(c0, r0);
+    r0 *= invDet; r1 *= invDet; r2 *= invDet;
+
+    /* r0, r1 and r2 are the rows of the inverse */
+    glm::mat4 result(
+        glm::vec4(r0.x, r1.x, r2.x, 0.f),
+        glm::vec4(r0.y, r1.y, r2.y, 0.f),
+        glm::vec4(r0.z, r1.z, r2.z, 0.f),
+        glm::vec4(0.f, 0.f, 0.f, 1.f));
+    glm::vec3 t(m[3]);
+    result[3] = glm::vec4(-(glm::vec3(result[0]) * t.x + glm::vec3(result[1]) * t.y + glm::vec3(result[2]) * t.z), 1.f);
+    return result;
+}
+
+/*
+ * The batched transforms below have no SSE path. Broadcasting each coordinate and storing three of the four lanes
+ * costs more than it saves, and the compiler already pipelines the scalar loops well (see tests/benchmark_affine.cpp).
+*/
+
+/** Computes m * vec4(points[i], 1) for count points. points and result may be the same array. */
+inline void affineTransformPoints(const glm::mat4 &m, const glm::vec3 *points, glm::vec3 *result, size_t count)
+{
+    glm::vec3 m0(m[0]), m1(m[1]), m2(m[2]), m3(m[3]);
+    for (size_t i = 0; i < count; ++i) {
+        glm::vec3 p = points[i];
+        result[i] = m0 * p.x + m1 * p.y + m2 * p.z + m3;
+    }
+}
+
+/** Computes m * vec4(directions[i], 0) for count directions. directions and result may be the same array. */
+inline void affineTransformDirections(const glm::mat4 &m, const glm::vec3 *directions, glm::vec3 *result, size_t count)
+{
+    glm::vec3 m0(m[0]), m1(m[1]), m2(m[2]);
+    for (size_t i = 0; i < count; ++i) {
+        glm::vec3 d = directions[i];
+        result[i] = m0 * d.x + m1 * d.y + m2 * d.z;
+    }
+}
+
+/**
+ * Packs the top three rows of count affine matrices into 12 floats each, one column after the other.
+ * This is the layout of OWL's owl4x3f instance transforms.
+*/
+inline void affinePack3x4(const glm::mat4 *matrices, float *result, size_t count)
+{
+    for (size_t i = 0; i < count; ++i) {
+        for (int j = 0; j < 4; ++j) {
+            std::memcpy(&result[i * 12 + j * 3], &matrices[i][j][0], 3 * sizeof(float));
+        }
+    }
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <string>
+#include <stdexcept>
+#include <cstdint>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+/* A read-only memory mapping of an entire file. The mapping is released when this object goes out of scope. */
+class MappedFile {
+public:
+    MappedFile(std::string path) {
+#ifdef _WIN32
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        if (file == INVALID_HANDLE_VALUE)
+            throw std::runtime_error(std::string("Error: unable to open " + path));
+        LARGE_INTEGER fileSize;
+        GetFileSizeEx(file, &fileSize);
+        length = size_t(fileSize.QuadPart);
+        if (length == 0) return;
+        mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mapping == NULL) {
+            CloseHandle(file);
+            throw std::runtime_error(std::string("Error: unable to map " + path));
+        }
+        bytes = (const uint8_t*) MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+#else
+        fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            throw std::runtime_error(std::string("Error: unable to open " + path));
+        struct stat st;
+        fstat(fd, &st);
+        length = size_t(st.st_size);
+        if (length == 0) return;
+        void* ptr = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (ptr == MAP_FAILED) {
+            close(fd);
+            throw std::runtime_error(std::string("Error: unable to map " + path));
+        }
+        bytes = (const uint8_t*) ptr;
+        madvise(ptr, length, MADV_SEQUENTIAL);
+#endif
+    }
+
+    ~MappedFile() {
+#ifdef _WIN32
+        if (bytes) UnmapViewOfFile(bytes);
+        if (mapping) CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+#else
+        if (bytes) munmap((void*)bytes, length);
+        if (fd >= 0) close(fd);
+#endif
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    /** @returns a pointer to the first byte of the file */
+    const uint8_t* data() const { return bytes; }
+
+    /** @returns the size of the file in bytes */
+    size_t size() const { return length; }
+
+private:
+    const uint8_t* bytes = nullptr;
+    size_t length = 0;
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = NULL;
+#else
+    int fd = -1;
+#endif
+};
@@ -0,0 +1,175 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+/*
+ * Maps component names to ids, for the StaticFactory lookup tables.
+ * Each name is interned once, into a pool of strings owned by the table. The table itself is an
+ * open addressing hash table with linear probing, whose slots only hold a hash, an index into that
+ * pool and an id, so probing rarely touches the strings themselves. Removals shift later entries
+ * of a cluster back rather than leaving tombstones, so lookups stay fast under churn.
+*/
+class NameTable {
+    public:
+
+    /* Returns true and sets id if name is in the table */
+    bool find(const std::string &name, uint32_t &id) const
+    {
+        if (count == 0) return false;
+        uint32_t hash = hashName(name);
+        for (size_t slot = hash & mask();; slot = (slot + 1) & mask()) {
+            const Slot &entry = slots[slot];
+            if (entry.name == EMPTY) return false;
+            if ((entry.hash == hash) && (names[entry.name] == name)) {
+                id = entry.id;
+                return true;
+            }
+        }
+    }
+
+    /* Returns true if name is in the table */
+    bool contains(const std::string &name) const
+    {
+        uint32_t id;
+        return find(name, id);
+    }
+
+    /* Maps name to id, replacing any previous id for that name */
+    void insert(const std::string &name, uint32_t id)
+    {
+        if ((count + 1) * 4 > slots.size() * 3) grow();
+        uint32_t hash = hashName(name);
+        size_t slot = hash & mask();
+        for (; slots[slot].name != EMPTY; slot = (slot + 1) & mask()) {
+            Slot &entry = slots[slot];
+            if ((entry.hash == hash) && (names[entry.name] == name)) {
+                entry.id = id;
+                return;
+            }
+        }
+
+        uint32_t nameIndex;
+        if (!freeNames.empty()) {
+            nameIndex = freeNames.back();
+            freeNames.pop_back();
+            names[nameIndex] = name;
+        } else {
+            nameIndex = uint32_t(names.size());
+            names.push_back(name);
+        }
+        slots[slot] = Slot{hash, nameIndex, id};
+        count++;
+    }
+
+    /* Removes name from the table. Returns false if it was not in the table. */
+    bool erase(const std::string &name)
+    {
+        if (count == 0) return false;
+        uint32_t hash = hashName(name);
+        size_t slot = hash & mask();
+        for (;; slot = (slot + 1) & mask()) {
+            const Slot &entry = slots[slot];
+            if (entry.name == EMPTY) return false;
+            if ((entry.hash == hash) && (names[entry.name] == name)) break;
+        }
+
+        names[slots[slot].name] = std::string();
+        freeNames.push_back(slots[slot].name);
+        count--;
+
+        /* Moves later entries of the cluster into the hole when that keeps them reachable */
+        size_t hole = slot;
+        for (size_t next = (hole + 1) & mask(); slots[next].name != EMPTY; next = (next + 1) & mask()) {
+            size_t home = slots[next].hash & mask();
+            if (((next - home) & mask()) >= ((next - hole) & mask())) {
+                slots[hole] = slots[next];
+                hole = next;
+            }
+        }
+        slots[hole].name = EMPTY;
+        return true;
+    }
+
+    /*
+     * Returns prefix if it is not in the table, and otherwise prefix followed by a number (counting up
+     * from 1) that is not in the table. The last number handed out for each prefix is remembered, so
+     * that creating many items from the same prefix does not probe every earlier name.
+    */
+    std::string makeUnique(const std::string &prefix)
+    {
+        if (!contains(prefix)) return prefix;
+        uint32_t &suffix = suffixHints[prefix];
+        while (true) {
+            std::string name = prefix + std::to_string(++suffix);
+            if (!contains(name)) return name;
+        }
+    }
+
+    /* Calls function(name, id) for every entry, in no particular order */
+    template<class F>
+    void forEach(F function) const
+    {
+        for (const Slot &entry : slots) {
+            if (entry.name != EMPTY) function(names[entry.name], entry.id);
+        }
+    }
+
+    /* Returns the number of names in the table */
+    size_t size() const { return count; }
+
+    /* Removes every name from the table, and releases its memory */
+    void clear()
+    {
+        slots = std::vector<Slot>();
+        names = std::vector<std::string>();
+        freeNames = std::vector<uint32_t>();
+        suffixHints.clear();
+        count = 0;
+    }
+
+    private:
+
+    static constexpr uint32_t EMPTY = UINT32_MAX;
+
+    struct Slot {
+        uint32_t hash;
+        uint32_t name = EMPTY;
+        uint32_t id;
+    };
+
+    /* 64 bit FNV-1a, folded down to 32 bits */
+    static uint32_t hashName(const std::string &name)
+    {
+        uint64_t hash = 14695981039346656037ull;
+        for (unsigned char c : name) {
+            hash ^= c;
+            hash *= 1099511628211ull;
+        }
+        return uint32_t(hash ^ (hash >> 32));
+    }
+
+    size_t mask() const { return slots.size() - 1; }
+
+    /* Doubles the number of slots, reinserting every entry */
+    void grow()
+    {
+        std::vector<Slot> old;
+        old.swap(slots);
+        slots.resize(old.empty() ? 16 : old.size() * 2);
+        for (const Slot &entry : old) {
+            if (entry.name == EMPTY) continue;
+            size_t slot = entry.hash & mask();
+            while (slots[slot].name != EMPTY) slot = (slot + 1) & mask();
+            slots[slot] = entry;
+        }
+    }
+
+    std::vector<Slot> slots;
+    std::vector<std::string> names;
+    std::vector<uint32_t> freeNames;
+    std::unordered_map<std::string, uint32_t> suffixHints;
+    size_t count = 0;
+};
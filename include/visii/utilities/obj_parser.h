@@ -0,0 +1,64 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <tiny_obj_loader.h>
+
+/**
+ * A drop in replacement for tinyobj::LoadObj (with triangulation enabled), intended for large files.
+ *
+ * The OBJ file is memory mapped and split into chunks at line boundaries. A quick first pass counts
+ * the vertex statements in each chunk, so that every chunk knows where its vertex data lands in the
+ * final arrays. A second pass then parses all chunks on all cores, writing vertex data in place.
+ * Finally, faces and state changes (usemtl, g, o, s, mtllib) are merged in file order,
+ * reproducing the shapes and materials that tinyobj would produce.
+ *
+ * Polygons with more than three vertices are fan triangulated, which matches tinyobj for convex polygons.
+ * Materials are read through tinyobj::MaterialFileReader.
+ *
+ * @param attrib Receives the vertex positions, normals, texture coordinates and colors
+ * @param shapes Receives the triangulated shapes
+ * @param materials Receives any materials loaded from referenced mtl files
+ * @param err Receives any warnings or errors
+ * @param filename The path of the OBJ file to load
+ * @param mtl_basedir The directory to search for referenced mtl files
+ * @returns True if the file was parsed successfully, and False otherwise
+*/
+bool loadObjParallel(
+    tinyobj::attrib_t *attrib,
+    std::vector<tinyobj::shape_t> *shapes,
+    std::vector<tinyobj::material_t> *materials,
+    std::string *err,
+    const std::string &filename,
+    const std::string &mtl_basedir = "");
+
+/**
+ * A streaming variant of loadObjParallel, which bounds peak memory when importing very large files.
+ *
+ * The vertex pool is loaded in full, since faces may reference vertices anywhere in the file. Faces are
+ * then parsed a batch of chunks at a time, and shapes are handed to the callback as soon as they are complete.
+ * Shapes too large for the budget are handed off in several pieces which share the same name.
+ * Once the callback returns, the shape's memory is released.
+ *
+ * @param attrib Receives the vertex positions, normals, texture coordinates and colors
+ * @param materials Receives any materials loaded from referenced mtl files. These are loaded as mtllib
+ * statements are encountered, so are available to the callback for any shape which references them.
+ * @param err Receives any warnings or errors
+ * @param filename The path of the OBJ file to load
+ * @param mtl_basedir The directory to search for referenced mtl files
+ * @param memory_budget The approximate peak memory in bytes for the vertex pool, parsed faces, and the consumer's buffers
+ * @param consumer_bytes_per_triangle The memory the callback requires per triangle, used to size the shapes handed off
+ * @param callback Called with each shape, or piece of a shape, in file order
+ * @returns True if the file was parsed successfully, and False otherwise (including when the vertex pool alone exceeds the budget)
+*/
+bool loadObjStreaming(
+    tinyobj::attrib_t *attrib,
+    std::vector<tinyobj::material_t> *materials,
+    std::string *err,
+    const std::string &filename,
+    const std::string &mtl_basedir,
+    uint64_t memory_budget,
+    uint64_t consumer_bytes_per_triangle,
+    const std::function<void(tinyobj::shape_t &shape)> &callback);
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <algorithm>
+#include <atomic>
+
+/*
+ * A growable table of items, for the StaticFactory component and struct tables.
+ * Items are stored in fixed size pages, allocated as the table grows, so memory use follows the
+ * number of items actually created. Pages never move once allocated, so pointers to items stay
+ * valid as the table grows, and items in existing pages can be read while another thread grows
+ * the table. The page directory is allocated up front for the same reason, and so bounds the
+ * number of items the table can hold.
+*/
+template<class T, uint32_t PAGE_SIZE = 1024, uint32_t MAX_PAGES = 16384>
+class PagedArray {
+    public:
+
+    PagedArray() : pages(new std::unique_ptr<T[]>[MAX_PAGES]) {}
+
+    T &operator[](size_t index) { return pages[index / PAGE_SIZE][index % PAGE_SIZE]; }
+    const T &operator[](size_t index) const { return pages[index / PAGE_SIZE][index % PAGE_SIZE]; }
+
+    /* Returns the number of items the table currently holds, which is always a whole number of pages */
+    uint32_t size() const { return numPages.load(std::memory_order_acquire) * PAGE_SIZE; }
+
+    /* Returns the largest number of items the table can grow to hold */
+    static constexpr uint32_t maxSize() { return PAGE_SIZE * MAX_PAGES; }
+
+    /* Grows the table to hold at least count default constructed items. Never shrinks the table. */
+    void reserve(uint32_t count)
+    {
+        if (count > maxSize())
+            throw std::runtime_error(std::string("Error: cannot hold more than " + std::to_string(maxSize()) + " items"));
+        /* Only the thread holding the factory mutex grows the table, but readers may not hold it, so
+           publish each page only once it is allocated */
+        uint32_t n = numPages.load(std::memory_order_relaxed);
+        while (n * PAGE_SIZE < count) {
+            pages[n].reset(new T[PAGE_SIZE]());
+            numPages.store(++n, std::memory_order_release);
+        }
+    }
+
+    /* Copies the first count items into dest, which must have room for count items. Stops at the
+       items the table currently holds. */
+    void copyTo(T *dest, uint32_t count) const
+    {
+        count = std::min(count, numPages.load(std::memory_order_acquire) * PAGE_SIZE);
+        for (uint32_t first = 0; first < count; first += PAGE_SIZE) {
+            const T *page = pages[first / PAGE_SIZE].get();
+            std::copy(page, page + std::min(PAGE_SIZE, count - first), dest + first);
+        }
+    }
+
+    private:
+
+    std::unique_ptr<std::unique_ptr<T[]>[]> pages;
+    std::atomic<uint32_t> numPages{0};
+};
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <exception>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+
+/** @returns the number of worker threads to use for host side parallel loops */
+inline uint32_t getNumWorkerThreads() {
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+/** 
+ * Splits the range [0, count) into one contiguous chunk per worker thread, and calls
+ * func(begin, end, threadIdx) on each chunk. The calling thread processes the first chunk.
+ * Any exception thrown by a worker is rethrown on the calling thread.
+ * Ranges smaller than minChunk run serially on the calling thread.
+*/
+template<class Func>
+inline void parallelFor(uint64_t count, Func func, uint64_t minChunk = 1024) {
+    if (count == 0) return;
+    uint32_t numThreads = uint32_t(std::min<uint64_t>(getNumWorkerThreads(), (count + minChunk - 1) / minChunk));
+    if (numThreads <= 1) { func(uint64_t(0), count, uint32_t(0)); return; }
+
+    std::exception_ptr error = nullptr;
+    std::mutex errorMutex;
+    auto run = [&] (uint32_t t) {
+        uint64_t begin = (count * t) / numThreads;
+        uint64_t end = (count * (t + 1)) / numThreads;
+        try { func(begin, end, t); }
+        catch (...) { std::lock_guard<std::mutex> lock(errorMutex); if (!error) error = std::current_exception(); }
+    };
+
+    std::vector<std::thread> workers;
+    for (uint32_t t = 1; t < numThreads; ++t) workers.emplace_back(run, t);
+    run(0);
+    for (auto &w : workers) w.join();
+    if (error) std::rethrow_exception(error);
+}
+
+/**
+ * Calls func(index, threadIdx) for every index in [0, count), for items whose cost varies a lot.
+ * Each worker thread starts out owning an equal share of the range, and takes items from the front of
+ * its share. A worker whose share runs out steals the back half of the largest share left, so that all
+ * threads stay busy until the last items. The calling thread acts as the first worker.
+ * Any exception thrown by a worker is rethrown on the calling thread, and stops further items from starting.
+*/
+template<class Func>
+inline void parallelForStealing(uint32_t count, Func func) {
+    if (count == 0) return;
+    uint32_t numThreads = std::min(getNumWorkerThreads(), count);
+    if (numThreads <= 1) { for (uint32_t i = 0; i < count; ++i) func(i, uint32_t(0)); return; }
+
+    /* Each share is a [begin, end) range packed into one word, so owners and thieves both update it with one compare and swap */
+    auto pack = [] (uint32_t begin, uint32_t end) { return (uint64_t(end) << 32) | uint64_t(begin); };
+    std::vector<std::atomic<uint64_t>> shares(numThreads);
+    for (uint32_t t = 0; t < numThreads; ++t) {
+        shares[t].store(pack(uint32_t((uint64_t(count) * t) / numThreads), uint32_t((uint64_t(count) * (t + 1)) / numThreads)));
+    }
+
+    std::exception_ptr error = nullptr;
+    std::mutex errorMutex;
+    std::atomic<bool> failed(false);
+    auto run = [&] (uint32_t t) {
+        while (!failed.load(std::memory_order_relaxed)) {
+            uint64_t share = shares[t].load();
+            uint32_t begin = uint32_t(share), end = uint32_t(share >> 32);
+            if (begin < end) {
+                if (!shares[t].compare_exchange_weak(share, pack(begin + 1, end))) continue;
+                try { func(begin, t); }
+                catch (...) { std::lock_guard<std::mutex> lock(errorMutex); if (!error) error = std::current_exception(); failed = true; }
+                continue;
+            }
+
+            uint32_t victim = t, most = 0;
+            for (uint32_t v = 0; v < numThreads; ++v) {
+                uint64_t other = shares[v].load();
+                uint32_t size = uint32_t(other >> 32) - std::min(uint32_t(other), uint32_t(other >> 32));
+                if (size > most) { most = size; victim = v; }
+            }
+            if (most == 0) break;
+
+            /* Nobody else writes to an empty share, so ours can be replaced without a compare and swap */
+            uint64_t other = shares[victim].load();
+            uint32_t otherBegin = uint32_t(other), otherEnd = uint32_t(other >> 32);
+            if (otherBegin >= otherEnd) continue;
+            uint32_t middle = otherBegin + (otherEnd - otherBegin) / 2;
+            if (!shares[victim].compare_exchange_weak(other, pack(otherBegin, middle))) continue;
+            shares[t].store(pack(middle, otherEnd));
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (uint32_t t = 1; t < numThreads; ++t) workers.emplace_back(run, t);
+    run(0);
+    for (auto &w : workers) w.join();
+    if (error) std::rethrow_exception(error);
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+/*
+ * Tracks which slots of a component table are in use, for the StaticFactory.
+ * Slots are kept in a bitmap, with a second bitmap flagging which 64 slot words are full, so
+ * finding the first free slot only looks at one summary word per 4096 slots, followed by a
+ * single find first zero. The bitmaps grow with the number of slots in use, up to capacity.
+ * Slots are always handed out lowest first, matching a linear scan of the table, so ids of
+ * existing components never move.
+*/
+class SlotAllocator {
+    public:
+
+    SlotAllocator(uint32_t capacity) : capacity(capacity) {}
+
+    /* Marks the lowest free slot as used and returns it, or returns -1 if every slot is used */
+    int32_t acquire()
+    {
+        for (size_t f = 0; f < full.size(); ++f) {
+            if (full[f] == ~0ull) continue;
+            size_t w = f * 64 + firstZero(full[f]);
+            if (w >= used.size()) break;
+            uint32_t slot = uint32_t(w * 64 + firstZero(used[w]));
+            if (slot >= capacity) return -1;
+            setUsed(slot);
+            return int32_t(slot);
+        }
+
+        /* Every tracked slot is used, so start tracking another word of slots */
+        if (used.size() * 64 >= capacity) return -1;
+        used.push_back(0ull);
+        if (full.size() * 64 < used.size()) full.push_back(0ull);
+        uint32_t slot = uint32_t((used.size() - 1) * 64);
+        setUsed(slot);
+        return int32_t(slot);
+    }
+
+    /* Marks a slot as free, so that it can be handed out again */
+    void release(uint32_t slot)
+    {
+        if (slot / 64 >= used.size()) return;
+        used[slot / 64] &= ~(1ull << (slot % 64));
+        full[slot / 4096] &= ~(1ull << ((slot / 64) % 64));
+    }
+
+    /* Returns true if the slot is currently used */
+    bool isUsed(uint32_t slot) const
+    {
+        return (slot / 64 < used.size()) && ((used[slot / 64] >> (slot % 64)) & 1ull);
+    }
+
+    private:
+
+    void setUsed(uint32_t slot)
+    {
+        uint64_t &word = used[slot / 64];
+        word |= 1ull << (slot % 64);
+        if (word == ~0ull) full[slot / 4096] |= 1ull << ((slot / 64) % 64);
+    }
+
+    /* Index of the lowest zero bit. Assumes at least one bit is zero. */
+    static uint32_t firstZero(uint64_t bits)
+    {
+        uint64_t zeros = ~bits;
+        #if defined(_MSC_VER)
+        unsigned long index;
+        _BitScanForward64(&index, zeros);
+        return uint32_t(index);
+        #else
+        return uint32_t(__builtin_ctzll(zeros));
+        #endif
+    }
+
+    uint32_t capacity;
+    std::vector<uint64_t> used;
+    std::vector<uint64_t> full;
+};
@@ -42,6 +42,10 @@
 #include <thread>
 #include <future>
 
+#include <visii/utilities/name_table.h>
+#include <visii/utilities/slot_allocator.h>
+#include <visii/utilities/paged_array.h>
+
 class StaticFactory {
     public:
 
@@ -55,42 +59,69 @@ class StaticFactory {
     virtual int32_t getId() { return id; };
     
     /* Returns whether or not a key exists in the lookup table. */
-    static bool doesItemExist(std::map<std::string, uint32_t> &lookupTable, std::string name)
+    static bool doesItemExist(NameTable &lookupTable, const std::string &name)
+    {
+        return lookupTable.contains(name);
+    }
+
+    /* Returns the allocator tracking which slots hold an initialized item of type T. Each type has a single table of items. */
+    template<class T>
+    static SlotAllocator &getSlotAllocator() 
     {
-        auto it = lookupTable.find(name);
-        return (it != lookupTable.end());
+        static SlotAllocator allocator(PagedArray<T>::maxSize());
+        return allocator;
     }
 
-    /* Returns the first index where an item of type T is uninitialized. */
+    /* Reserves and returns the first index where an item of type T is uninitialized, or -1 if the table is full. */
     template<class T>
-    static int32_t findAvailableID(T *items, uint32_t max_items) 
+    static int32_t findAvailableID(PagedArray<T> &items) 
     {
-        for (uint32_t i = 0; i < max_items; ++i)
-            if (items[i].initialized == false)
-                return (int32_t)i;
-        return -1;
+        return getSlotAllocator<T>().acquire();
     }
     
     /* Reserves a location in items and adds an entry in the lookup table */
     template<class T>
-    static T* create(std::shared_ptr<std::mutex> factory_mutex, std::string name, std::string type, std::map<std::string, uint32_t> &lookupTable, T* items, uint32_t maxItems, std::function<void(T*)> function = nullptr) 
+    static T* create(std::shared_ptr<std::mutex> factory_mutex, std::string name, std::string type, NameTable &lookupTable, PagedArray<T> &items, std::function<void(T*)> function = nullptr) 
     {
         auto mutex = factory_mutex.get();
         std::lock_guard<std::mutex> lock(*mutex);
         if (doesItemExist(lookupTable, name))
             throw std::runtime_error(std::string("Error: " + type + " \"" + name + "\" already exists."));
 
-        int32_t id = findAvailableID(items, maxItems);
+        return createLocked(name, type, lookupTable, items, function);
+    }
+
+    /* 
+     * Like create, but rather than failing when prefix is taken, appends a number that makes the 
+     * name unique. The name is picked and reserved while holding the factory mutex, so 
+     * concurrent calls never collide.
+    */
+    template<class T>
+    static T* createUnique(std::shared_ptr<std::mutex> factory_mutex, std::string prefix, std::string type, NameTable &lookupTable, PagedArray<T> &items, std::function<void(T*)> function = nullptr) 
+    {
+        auto mutex = factory_mutex.get();
+        std::lock_guard<std::mutex> lock(*mutex);
+        return createLocked(lookupTable.makeUnique(prefix), type, lookupTable, items, function);
+    }
+
+    /* Reserves a location in items for an unused name. Assumes the factory mutex is held. */
+    template<class T>
+    static T* createLocked(const std::string &name, const std::string &type, NameTable &lookupTable, PagedArray<T> &items, std::function<void(T*)> function) 
+    {
+        int32_t id = findAvailableID(items);
 
         if (id < 0) 
             throw std::runtime_error(std::string("Error: max " + type + " limit reached."));
 
+        // Tables grow a page at a time, as components are created
+        if (uint32_t(id) >= items.size()) T::reserveTables(uint32_t(id) + 1);
+
         // TODO: make this only output if verbose
         #if SF_VERBOSE
         std::cout << "Adding " << type << " \"" << name << "\"" << std::endl;
         #endif
         items[id] = T(name, id);
-        lookupTable[name] = id;
+        lookupTable.insert(name, id);
 
         // callback for creation before releasing mutex
         if (function != nullptr) function(&items[id]);
@@ -100,12 +131,12 @@ class StaticFactory {
 
     /* Retrieves an element with a lookup table indirection */
     template<class T>
-    static T* get(std::shared_ptr<std::mutex> factory_mutex, std::string name, std::string type, std::map<std::string, uint32_t> &lookupTable, T* items, uint32_t maxItems) 
+    static T* get(std::shared_ptr<std::mutex> factory_mutex, std::string name, std::string type, NameTable &lookupTable, PagedArray<T> &items) 
     {
         auto mutex = factory_mutex.get();
         std::lock_guard<std::mutex> lock(*mutex);
-        if (doesItemExist(lookupTable, name)) {
-            uint32_t id = lookupTable[name];
+        uint32_t id;
+        if (lookupTable.find(name, id)) {
             if (!items[id].initialized) return nullptr;
             return &items[id];
         }
@@ -117,14 +148,14 @@ class StaticFactory {
 
     /* Retrieves an element by ID directly */
     template<class T>
-    static T* get(std::shared_ptr<std::mutex> factory_mutex, uint32_t id, std::string type, std::map<std::string, uint32_t> &lookupTable, T* items, uint32_t maxItems) 
+    static T* get(std::shared_ptr<std::mutex> factory_mutex, uint32_t id, std::string type, NameTable &lookupTable, PagedArray<T> &items) 
     {
         auto mutex = factory_mutex.get();
         std::lock_guard<std::mutex> lock(*mutex);
-        if (id >= maxItems) 
+        if (id >= PagedArray<T>::maxSize()) 
             throw std::runtime_error(std::string("Error: id greater than max " + type));
 
-        else if (!items[id].initialized) return nullptr;
+        else if ((id >= items.size()) || !items[id].initialized) return nullptr;
             //throw std::runtime_error(std::string("Error: " + type + " with id " + std::to_string(id) + " does not exist"));
          
         return &items[id];
@@ -132,42 +163,47 @@ class StaticFactory {
 
     /* Removes an element with a lookup table indirection, removing from both items and the lookup table */
     template<class T>
-    static void remove(std::shared_ptr<std::mutex> factory_mutex, std::string name, std::string type, std::map<std::string, uint32_t> &lookupTable, T* items, uint32_t maxItems)
+    static void remove(std::shared_ptr<std::mutex> factory_mutex, std::string name, std::string type, NameTable &lookupTable, PagedArray<T> &items)
     {
         auto mutex = factory_mutex.get();
         std::lock_guard<std::mutex> lock(*mutex);
-        if (!doesItemExist(lookupTable, name))
+        uint32_t id;
+        if (!lookupTable.find(name, id))
             throw std::runtime_error(std::string("Error: " + type + " \"" + name + "\" does not exist."));
 
-        items[lookupTable[name]] = T();
+        items[id] = T();
+        getSlotAllocator<T>().release(id);
         lookupTable.erase(name);
     }
 
     /* If it exists, removes an element with a lookup table indirection, removing from both items and the lookup table */
     template<class T>
-    static void removeIfExists(std::shared_ptr<std::mutex> factory_mutex, std::string name, std::string type, std::map<std::string, uint32_t> &lookupTable, T* items, uint32_t maxItems)
+    static void removeIfExists(std::shared_ptr<std::mutex> factory_mutex, std::string name, std::string type, NameTable &lookupTable, PagedArray<T> &items)
     {
         auto mutex = factory_mutex.get();
         std::lock_guard<std::mutex> lock(*mutex);
-        if (!doesItemExist(lookupTable, name)) return;
-        items[lookupTable[name]] = T();
+        uint32_t id;
+        if (!lookupTable.find(name, id)) return;
+        items[id] = T();
+        getSlotAllocator<T>().release(id);
         lookupTable.erase(name);
     }
 
     /* Removes an element by ID directly, removing from both items and the lookup table */
     template<class T>
-    static void remove(std::shared_ptr<std::mutex> factory_mutex, uint32_t id, std::string type, std::map<std::string, uint32_t> &lookupTable, T* items, uint32_t maxItems)
+    static void remove(std::shared_ptr<std::mutex> factory_mutex, uint32_t id, std::string type, NameTable &lookupTable, PagedArray<T> &items)
     {
         auto mutex = factory_mutex.get();
         std::lock_guard<std::mutex> lock(*mutex);
-        if (id >= maxItems)
+        if (id >= PagedArray<T>::maxSize())
             throw std::runtime_error(std::string("Error: id greater than max " + type));
 
-        if (!items[id].initialized)
+        if ((id >= items.size()) || !items[id].initialized)
             throw std::runtime_error(std::string("Error: " + type + " with id " + std::to_string(id) + " does not exist"));
 
         lookupTable.erase(items[id].name);
         items[id] = T();
+        getSlotAllocator<T>().release(id);
     }
 
     protected:
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <algorithm>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+/** A translation, rotation and scale, sampled at one point in time */
+struct TRSKey {
+    glm::vec3 translation = glm::vec3(0.f);
+    glm::quat rotation = glm::quat(1.f, 0.f, 0.f, 0.f);
+    glm::vec3 scale = glm::vec3(1.f);
+};
+
+/**
+ * Interpolates between two keys. Translation and scale are interpolated linearly, and rotation
+ * is slerped along the shortest arc, so that a spinning key sequence sweeps out an arc rather than a chord.
+ *
+ * @param t The interpolation parameter, where 0 returns a and 1 returns b
+*/
+inline TRSKey interpolateTRS(const TRSKey &a, const TRSKey &b, float t)
+{
+    TRSKey result;
+    result.translation = glm::mix(a.translation, b.translation, t);
+    result.rotation = glm::normalize(glm::slerp(a.rotation, b.rotation, t));
+    result.scale = glm::mix(a.scale, b.scale, t);
+    return result;
+}
+
+/**
+ * Samples a sequence of keys spaced evenly over the interval [0, 1].
+ *
+ * @param keys The keys to sample, the first at time 0 and the last at time 1
+ * @param count The number of keys. Returns an identity key if zero.
+ * @param time The time to sample at, clamped to [0, 1]
+*/
+inline TRSKey sampleTRSKeys(const TRSKey *keys, size_t count, float time)
+{
+    if (count == 0) return TRSKey();
+    if ((count == 1) || !(time > 0.f)) return keys[0];
+    if (time >= 1.f) return keys[count - 1];
+    float x = time * float(count - 1);
+    size_t i = std::min(size_t(x), count - 2);
+    return interpolateTRS(keys[i], keys[i + 1], x - float(i));
+}
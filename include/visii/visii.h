@@ -18,8 +18,13 @@ void initializeInteractive(bool window_on_top = false);
   * Initializes various backend systems required to render scene data.
   * 
   * This call avoids using any OpenGL resources, to enable 
+  * 
+  * @param backend Either "optix", to path trace on the GPU, or "cpu", to path trace on the host's CPU 
+  * cores on machines without an OptiX capable GPU. Both backends render the same scene descriptions 
+  * through render, render_data, and the file saving variants of those. The CPU backend has no denoiser.
+  * Libraries configured with -DVISII_BUILD_OPTIX=OFF need neither CUDA nor OptiX, and only have the "cpu" backend.
 */
-void initializeHeadless();
+void initializeHeadless(std::string backend = "optix");
 
 /**
   * Cleans up any allocated resources, closes windows and shuts down any running backend systems.
@@ -85,6 +90,15 @@ void setDirectLightingClamp(float clamp);
  */ 
 void setMaxBounceDepth(uint32_t depth);
 
+/** 
+ * Sets how long each launch of the path tracer should take when rendering an image. Several samples per pixel are 
+ * traced in each launch, as many as fit in this time, which cuts down on the per launch overhead for scenes that 
+ * are quick to trace. Lower values keep the window more responsive while rendering.
+ * 
+ * @param seconds The time to aim for in each launch. 0 traces one sample per pixel in each launch. Defaults to 0.1.
+ */ 
+void setLaunchTimeBudget(float seconds);
+
 /**
   * If using interactive mode, resizes the window to the specified dimensions.
   * 
@@ -145,6 +159,26 @@ void renderToPNG(uint32_t width, uint32_t height, uint32_t samples_per_pixel, st
 */
 std::vector<float> renderData(uint32_t width, uint32_t height, uint32_t start_frame, uint32_t frame_count, uint32_t bounce, std::string options);
 
+/** 
+ * Renders out metadata for the surfaces directly visible to the camera, returning the resulting framebuffers back to the user directly.
+ * Only camera rays are traced, and nothing is shaded, so this is much faster than renderData. Several kinds of metadata can be 
+ * requested at once, and are all read from the same camera rays. renderData uses this for "depth", "position", "normal" and 
+ * "entity_id" at bounce 0, with identical results.
+ * On the CPU backend, a 1920x1080 frame still takes most of a second per core, about 2 million camera rays at a few hundred 
+ * nanoseconds each, so interactive rates need either several cores or the OptiX backend.
+ * 
+ * @param width The width of the image to render
+ * @param height The height of the image to render
+ * @param start_frame The start seed to feed into the random number generator
+ * @param frame_count Metadata is not accumulated, so only the camera rays of frame frame_count - 1 are traced, giving the same result
+ * as renderData with the same start_frame and frame_count.
+ * @param options The data to return, in order. Possible values are "depth" for the distance from the camera to the visible surface,
+ * "position" for the world space position of the visible surface, "normal" for its world space normal, and "entity_id" for the ID
+ * of its entity. Pixels where nothing is visible are set to FLT_MAX.
+ * @returns One RGBA framebuffer of width * height pixels per option, concatenated in the order of the options.
+*/
+std::vector<float> renderPrimaryData(uint32_t width, uint32_t height, uint32_t start_frame, uint32_t frame_count, std::vector<std::string> options);
+
 /**
  * Imports an OBJ containing scene data. 
  * First, any materials described by the mtl file are used to generate Material components.
@@ -160,8 +194,34 @@ std::vector<float> renderData(uint32_t width, uint32_t height, uint32_t start_fr
  * @param position A change in position to apply to all entities generated by this function
  * @param position A change in scale to apply to all entities generated by this function
  * @param position A change in rotation to apply to all entities generated by this function
+ * @param memory_budget_mb If non-zero, the OBJ is imported in a streaming mode which keeps the memory used while importing 
+ * under roughly this many megabytes, not counting the generated meshes themselves. Shapes are converted to meshes one at a time 
+ * as they are parsed, and shapes too large for the budget are split across several entities. 
+ * The vertex data of the OBJ is always loaded in full, so the budget must be larger than that.
 */
 std::vector<Entity*> importOBJ(std::string name_prefix, std::string file_path, std::string mtl_base_dir, 
         glm::vec3 position = glm::vec3(0.0f), 
         glm::vec3 scale = glm::vec3(1.0f),
-        glm::quat rotation = glm::angleAxis(0.0f, glm::vec3(1.0f, 0.0f, 0.0f)));
\ No newline at end of file
+        glm::quat rotation = glm::angleAxis(0.0f, glm::vec3(1.0f, 0.0f, 0.0f)),
+        uint32_t memory_budget_mb = 0);
+
+/**
+ * Imports a glTF 2.0 scene, either as a .gltf file with external or embedded resources, or as a binary .glb file. 
+ * Vertex data is read directly out of the binary buffers, and all referenced images are decoded in parallel.
+ * First, any materials are used to generate Material components using the metallic/roughness workflow.
+ * Next, each triangle primitive is converted into a Mesh component, shared by all nodes which reference it.
+ * Then, the node hierarchy of the default scene is mirrored by a hierarchy of Transform components,
+ * and an entity is created for each primitive of each node to attach a transform, mesh, and material component together.
+ * Finally, all root nodes are parented to a root transform which holds any specified position, scale, and/or rotation.
+ * 
+ * @param name_prefix A string used to uniquely prefix any generated component names by.
+ * @param file_path The path for the glTF or GLB file to load
+ * @param position A change in position to apply to all entities generated by this function
+ * @param scale A change in scale to apply to all entities generated by this function
+ * @param rotation A change in rotation to apply to all entities generated by this function
+ * @returns a list of the entities created
+*/
+std::vector<Entity*> importGLTF(std::string name_prefix, std::string file_path, 
+        glm::vec3 position = glm::vec3(0.0f), 
+        glm::vec3 scale = glm::vec3(1.0f),
+        glm::quat rotation = glm::angleAxis(0.0f, glm::vec3(1.0f, 0.0f, 0.0f)));
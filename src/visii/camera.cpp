@@ -1,9 +1,9 @@
 #include <visii/camera.h>
 #include <glm/gtx/matrix_transform_2d.hpp>
 
-Camera Camera::cameras[MAX_CAMERAS];
-CameraStruct Camera::cameraStructs[MAX_CAMERAS];
-std::map<std::string, uint32_t> Camera::lookupTable;
+PagedArray<Camera> Camera::cameras;
+PagedArray<CameraStruct> Camera::cameraStructs;
+NameTable Camera::lookupTable;
 std::shared_ptr<std::mutex> Camera::editMutex;
 bool Camera::factoryInitialized = false;
 bool Camera::anyDirty = true;
@@ -73,7 +73,7 @@ void Camera::markDirty() {
 
 void Camera::updateComponents()
 {
-    for (int i = 0; i < MAX_CAMERAS; ++i) {
+    for (uint32_t i = 0; i < cameras.size(); ++i) {
 		if (cameras[i].isDirty()) {
             cameras[i].markClean();
         }
@@ -165,7 +165,8 @@ void Camera::clearAll()
 {
 	if (!isFactoryInitialized()) return;
 
-	for (auto &camera : cameras) {
+	for (uint32_t i = 0; i < cameras.size(); ++i) {
+		auto &camera = cameras[i];
 		if (camera.initialized) {
 			Camera::remove(camera.name);
 		}
@@ -175,24 +176,24 @@ void Camera::clearAll()
 /* Static Factory Implementations */
 Camera* Camera::createPerspectiveFromFOV(std::string name, float fieldOfView, float aspect)
 {
-	auto camera = StaticFactory::create(editMutex, name, "Camera", lookupTable, cameras, MAX_CAMERAS);
+	auto camera = StaticFactory::create(editMutex, name, "Camera", lookupTable, cameras);
 	try {
         camera->usePerspectiveFromFOV(fieldOfView, aspect);
         return camera;
 	} catch (...) {
-		StaticFactory::removeIfExists(editMutex, name, "Camera", lookupTable, cameras, MAX_CAMERAS);
+		StaticFactory::removeIfExists(editMutex, name, "Camera", lookupTable, cameras);
 		throw;
 	}
 }
 
 Camera* Camera::createPerspectiveFromFocalLength(std::string name, float focalLength, float sensorWidth, float sensorHeight)
 {
-	auto camera = StaticFactory::create(editMutex, name, "Camera", lookupTable, cameras, MAX_CAMERAS);
+	auto camera = StaticFactory::create(editMutex, name, "Camera", lookupTable, cameras);
 	try {
         camera->usePerspectiveFromFocalLength(focalLength, sensorWidth, sensorHeight);
         return camera;
 	} catch (...) {
-		StaticFactory::removeIfExists(editMutex, name, "Camera", lookupTable, cameras, MAX_CAMERAS);
+		StaticFactory::removeIfExists(editMutex, name, "Camera", lookupTable, cameras);
 		throw;
 	}
 }
@@ -203,24 +204,30 @@ std::shared_ptr<std::mutex> Camera::getEditMutex()
 }
 
 Camera* Camera::get(std::string name) {
-	return StaticFactory::get(editMutex, name, "Camera", lookupTable, cameras, MAX_CAMERAS);
+	return StaticFactory::get(editMutex, name, "Camera", lookupTable, cameras);
 }
 
 void Camera::remove(std::string name) {
-	StaticFactory::remove(editMutex, name, "Camera", lookupTable, cameras, MAX_CAMERAS);
+	StaticFactory::remove(editMutex, name, "Camera", lookupTable, cameras);
 	anyDirty = true;
 }
 
-CameraStruct* Camera::getFrontStruct() {
+PagedArray<CameraStruct> &Camera::getFrontStruct() {
 	return cameraStructs;
 }
 
-Camera* Camera::getFront() {
+PagedArray<Camera> &Camera::getFront() {
 	return cameras;
 }
 
 uint32_t Camera::getCount() {
-	return MAX_CAMERAS;
+	return cameras.size();
+}
+
+void Camera::reserveTables(uint32_t count)
+{
+	cameras.reserve(count);
+	cameraStructs.reserve(count);
 }
 
 std::string Camera::getName()
@@ -228,7 +235,7 @@ std::string Camera::getName()
     return name;
 }
 
-std::map<std::string, uint32_t> Camera::getNameToIdMap()
+const NameTable &Camera::getNameToIdMap()
 {
 	return lookupTable;
 }
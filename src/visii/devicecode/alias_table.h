@@ -0,0 +1,15 @@
+/* File shared by both host and device */
+#pragma once
+
+#include <stdint.h>
+
+/*
+ * One slot of a Walker alias table over n items. A slot is picked uniformly, and then gives
+ * its own item with probability threshold, or otherwise its alias. pdf is the overall
+ * probability of picking this slot's own item, so that it can be looked up after sampling.
+*/
+struct AliasTableEntry {
+    float threshold = 1.f;
+    uint32_t alias = 0;
+    float pdf = 0.f;
+};
@@ -1,7 +1,9 @@
 #pragma once
 
+#ifdef __CUDACC__
 #include <math_constants.h>
 #include <optix.h>
+#endif
 #include "float3.h"
 #include "types.h"
 
@@ -164,6 +166,7 @@ __device__ void pack_ptr(void *ptr, uint32_t &hi, uint32_t &lo) {
 	lo = val & 0x00000000ffffffff;
 }
 
+#ifdef __CUDACC__
 template<typename T>
 __device__ T& get_payload() {
 	return *reinterpret_cast<T*>(unpack_ptr(optixGetPayload_0(), optixGetPayload_1()));
@@ -173,3 +176,4 @@ template<typename T>
 __device__ const T& get_shader_params() {
 	return *reinterpret_cast<const T*>(optixGetSbtDataPointer());
 }
+#endif
@@ -142,7 +142,7 @@ __device__ float3 sample_gtr_1_h(const float3 &n, const float3 &v_x, const float
 	float alpha_sqr = alpha * alpha;
 	float cos_theta_h_sqr = (1.f - pow(alpha_sqr, 1.f - s.y)) / (1.f - alpha_sqr);
 	float cos_theta_h = sqrt(cos_theta_h_sqr);
-	float sin_theta_h = 1.f - cos_theta_h_sqr;
+	float sin_theta_h = sqrt(max(0.f, 1.f - cos_theta_h_sqr));
 	float3 hemi_dir = normalize(spherical_dir(sin_theta_h, cos_theta_h, phi_h));
 	return hemi_dir.x * v_x + hemi_dir.y * v_y + hemi_dir.z * n;
 }
@@ -151,7 +151,7 @@ __device__ float3 sample_gtr_2_h(const float3 &n, const float3 &v_x, const float
 	float phi_h = 2.f * M_PI * s.x;
 	float cos_theta_h_sqr = (1.f - s.y) / (1.f + (alpha * alpha - 1.f) * s.y);
 	float cos_theta_h = sqrt(cos_theta_h_sqr);
-	float sin_theta_h = 1.f - cos_theta_h_sqr;
+	float sin_theta_h = sqrt(max(0.f, 1.f - cos_theta_h_sqr));
 	float3 hemi_dir = normalize(spherical_dir(sin_theta_h, cos_theta_h, phi_h));
 	return hemi_dir.x * v_x + hemi_dir.y * v_y + hemi_dir.z * n;
 }
@@ -330,17 +330,18 @@ __device__ float3 disney_multiscatter(const DisneyMaterial &mat, const float3 &n
 	float3 w_h = normalize(w_i + w_o);
 	float v_dot_n = abs(dot(normalize(w_o), normalize(n)));
 	float l_dot_n = abs(dot(normalize(w_i), normalize(n)));
-	float alpha = max(mat.roughness*mat.roughness, MIN_ALPHA);
+	// The lookup tables are parameterized by roughness, not by alpha = roughness^2
+	float roughness = sqrt(max(mat.roughness*mat.roughness, MIN_ALPHA));
 
     //E(μ) is in fact the sum of the red and green channels in our environment BRDF
     // vec2 sampleE_o = texture2D(BRDFlut, vec2(NdotV, alpha)).xy;
     // E_o = sampleE_o.x + sampleE_o.y;
-	float E_o = tex2D<float>(GGX_E_LOOKUP, v_dot_n, alpha);
+	float E_o = tex2D<float>(GGX_E_LOOKUP, v_dot_n, roughness);
     float oneMinusE_o = 1.0 - E_o;
-    float E_i = tex2D<float>(GGX_E_LOOKUP, l_dot_n, alpha);
+    float E_i = tex2D<float>(GGX_E_LOOKUP, l_dot_n, roughness);
     float oneMinusE_i = 1.0 - E_i;
 
-    float Eavg = tex2D<float>(GGX_E_AVG_LOOKUP, alpha, .5);
+    float Eavg = tex2D<float>(GGX_E_AVG_LOOKUP, roughness, .5);
 	// float Eavg = AverageEnergy(alpha);
     float oneMinusEavg = 1.0 - Eavg;
 	
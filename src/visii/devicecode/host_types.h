@@ -0,0 +1,74 @@
+#pragma once
+
+/*
+ * Host definitions of the CUDA qualifiers, vector types and intrinsics used by the device code, so
+ * that the BSDF, light sampling and random number headers also compile into the CPU renderer.
+ * Only meant for host translation units which do not include the CUDA headers themselves.
+*/
+
+#include <cmath>
+#include <cfloat>
+#include <cstdint>
+#include <limits>
+#include <hostcode/host_texture.h>
+
+#ifndef __device__
+#define __device__
+#endif
+
+#ifndef CUDART_NAN_F
+#define CUDART_NAN_F std::numeric_limits<float>::quiet_NaN()
+#endif
+
+struct alignas(8) float2 { float x, y; };
+struct float3 { float x, y, z; };
+struct alignas(16) float4 { float x, y, z, w; };
+struct int3 { int x, y, z; };
+struct alignas(8) uint2 { unsigned int x, y; };
+
+inline float2 make_float2(float x, float y) { return float2{x, y}; }
+inline float3 make_float3(float x, float y, float z) { return float3{x, y, z}; }
+inline float4 make_float4(float x, float y, float z, float w) { return float4{x, y, z, w}; }
+inline int3 make_int3(int x, int y, int z) { return int3{x, y, z}; }
+inline uint2 make_uint2(unsigned int x, unsigned int y) { return uint2{x, y}; }
+
+/* The device code calls these unqualified, and expects the float overloads */
+using std::abs;
+using std::fabs;
+using std::sqrt;
+using std::pow;
+using std::exp;
+using std::log;
+using std::sin;
+using std::cos;
+using std::asin;
+using std::acos;
+using std::atan2;
+using std::floor;
+using std::ldexp;
+using std::isnan;
+using std::isinf;
+
+inline float min(float a, float b) { return (b < a) ? b : a; }
+inline float max(float a, float b) { return (a < b) ? b : a; }
+inline int min(int a, int b) { return (b < a) ? b : a; }
+inline int max(int a, int b) { return (a < b) ? b : a; }
+inline uint32_t min(uint32_t a, uint32_t b) { return (b < a) ? b : a; }
+inline uint32_t max(uint32_t a, uint32_t b) { return (a < b) ? b : a; }
+inline float saturate(float x) { return min(max(x, 0.f), 1.f); }
+
+/* Texture objects become pointers to host textures, read through the same tex2D calls */
+typedef const HostTexture *cudaTextureObject_t;
+
+template<class T> T tex2D(cudaTextureObject_t texture, float x, float y);
+
+template<> inline float tex2D<float>(cudaTextureObject_t texture, float x, float y)
+{
+    return texture->sample(x, y).x;
+}
+
+template<> inline float4 tex2D<float4>(cudaTextureObject_t texture, float x, float y)
+{
+    glm::vec4 texel = texture->sample(x, y);
+    return make_float4(texel.x, texel.y, texel.z, texel.w);
+}
@@ -15,9 +15,14 @@
 #include <visii/light_struct.h>
 #include <visii/texture_struct.h>
 
+#include "render_data_flags.h"
+#include "alias_table.h"
+#include "light_bvh.h"
+
 struct LaunchParams {
     glm::ivec2 frameSize;
     uint64_t frameID = 0;
+    uint32_t samplesPerLaunch = 1; // samples per pixel traced by each launch, starting at frame frameID
     glm::vec4 *frameBuffer;
     glm::vec4 *albedoBuffer;
     glm::vec4 *normalBuffer;
@@ -37,16 +42,29 @@ struct LaunchParams {
     LightStruct     *lights = nullptr;
     TextureStruct   *textures = nullptr;
     uint32_t        *lightEntities = nullptr;
+    LightBVHNode    *lightBVH = nullptr; // picks a light entity for each shading point
     uint32_t        *instanceToEntityMap = nullptr;
     uint32_t         numLightEntities = 0;
 
+    // Number of slots in each component table. Tables grow as components are created.
+    uint32_t numEntities = 0;
+    uint32_t numTransforms = 0;
+    uint32_t numMaterials = 0;
+    uint32_t numCameras = 0;
+    uint32_t numMeshes = 0;
+    uint32_t numLights = 0;
+    uint32_t numTextures = 0;
+
     owl::device::Buffer vertexLists;
     owl::device::Buffer normalLists;
     owl::device::Buffer texCoordLists;
     owl::device::Buffer indexLists;
+    owl::device::Buffer triangleSamplingTables; // per mesh, only for the meshes of light entities
 
     int32_t environmentMapID = -1;
     glm::quat environmentMapRotation = glm::quat(1,0,0,0);
+    AliasTableEntry *environmentSamplingTable = nullptr; // picks dome light directions by texel luminance
+    glm::ivec2 environmentSamplingTableSize = glm::ivec2(0); // the dome light texture's size, or 0 when not sampled
     cudaTextureObject_t *textureObjects = nullptr;
 
     cudaTextureObject_t GGX_E_AVG_LOOKUP;
@@ -55,14 +73,9 @@ struct LaunchParams {
     // Used to extract metadata from the renderer.
     uint32_t renderDataMode = 0;
     uint32_t renderDataBounce = 0;
-};
 
-enum RenderDataFlags : uint32_t { 
-  NONE = 0, 
-  DEPTH = 1, 
-  POSITION = 2,
-  NORMAL = 3,
-  ENTITY_ID = 4,
-  DENOISE_NORMAL = 5,
-  DENOISE_ALBEDO = 6,
-};
\ No newline at end of file
+    // With motion keys, the frame is split into several segments, each with its own TLAS. 
+    // world always holds the first segment.
+    uint32_t numMotionSegments = 1;
+    OptixTraversableHandle motionSegments[MAX_MOTION_KEYS - 1];
+};
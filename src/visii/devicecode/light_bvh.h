@@ -0,0 +1,30 @@
+/* File shared by both host and device */
+#pragma once
+
+#include <stdint.h>
+#include <glm/glm.hpp>
+
+/*
+ * Bounds on where a group of lights is and where it shines. Emitter normals lie within cosThetaO of axis, and each
+ * emits out to cosThetaE past its normal. Two sided lights also shine along the negated normals.
+ * A power of zero marks bounds which contain no light.
+*/
+struct LightBounds {
+    glm::vec3 boundsMin = glm::vec3(0.f);
+    float power = 0.f;
+    glm::vec3 boundsMax = glm::vec3(0.f);
+    float cosThetaO = 1.f;
+    glm::vec3 axis = glm::vec3(0.f, 0.f, 1.f);
+    float cosThetaE = 0.f;
+    uint32_t twoSided = 0;
+};
+
+/*
+ * A node of the light BVH, stored depth first. An interior node's first child follows it, and index is its second
+ * child. A leaf holds a single light, and index is that light's position in lightEntities.
+*/
+struct LightBVHNode {
+    LightBounds bounds;
+    uint32_t index = 0;
+    uint32_t isLeaf = 0;
+};
@@ -1,6 +1,8 @@
 #pragma once
 
 #include "cuda_utils.h"
+#include "alias_table.h"
+#include "light_bvh.h"
 
 // Quad-shaped light source
 struct QuadLight {
@@ -365,3 +367,155 @@ void sampleTriangle(const vec3 &pos, const vec3 &n,
 	float aCosThere = max(0.0, fabs(dot(-dir,n)));
 	pdf = PdfAtoW( pdfA, d2, aCosThere );
 }
+
+/* Picks an item from a Walker alias table of the given size in O(1), returning the probability it had of being picked */
+inline __device__
+uint32_t sampleAliasTable(const AliasTableEntry *table, uint32_t size, float rand, float &pdf)
+{
+	float scaled = rand * float(size);
+	uint32_t slot = min(uint32_t(scaled), size - 1);
+	uint32_t item = ((scaled - float(slot)) < table[slot].threshold) ? slot : table[slot].alias;
+	pdf = table[item].pdf;
+	return item;
+}
+
+/*
+ * The dome light texture is a latitude-longitude map. missColor reads it at toSpherical(x, -z, y) of the rotated
+ * direction, so u goes once around the z axis, and v goes from the -z pole at 0 to the +z pole at 1.
+*/
+inline __device__
+vec2 environmentDirectionToUV(const vec3 &dir)
+{
+	vec3 d = normalize(dir);
+	float u = atan2(d.y, d.x) / (2.f * M_PI) + .5f;
+	float v = asin(glm::clamp(d.z, -1.f, 1.f)) / M_PI + .5f;
+	return vec2(u, v);
+}
+
+inline __device__
+vec3 environmentUVToDirection(const vec2 &uv)
+{
+	float theta = M_PI * (1.f - uv.y);
+	float phi = 2.f * M_PI * (uv.x - .5f);
+	return vec3(sin(theta) * cos(phi), sin(theta) * sin(phi), cos(theta));
+}
+
+/*
+ * Picks a texel of the dome light from a table laid out by buildEnvironmentSamplingTable, first its row and then its
+ * column, and a uniformly distributed point within it. Returns that point's texture coordinate, along with the
+ * density of the direction through it per unit solid angle.
+*/
+inline __device__
+vec2 sampleEnvironment(const AliasTableEntry *table, const ivec2 &size, float rand1, float rand2, float rand3, float rand4, float &pdf)
+{
+	float rowPdf, columnPdf;
+	uint32_t row = sampleAliasTable(table, uint32_t(size.y), rand1, rowPdf);
+	uint32_t column = sampleAliasTable(table + size.y + row * size.x, uint32_t(size.x), rand2, columnPdf);
+	vec2 uv = vec2((float(column) + rand3) / float(size.x), (float(row) + rand4) / float(size.y));
+
+	// Texels cover less of the sphere towards the poles
+	float sinTheta = sin(M_PI * uv.y);
+	pdf = (sinTheta > 0.f) ? rowPdf * columnPdf * float(size.x) * float(size.y) / (2.f * M_PI * M_PI * sinTheta) : 0.f;
+	return uv;
+}
+
+/* The density per unit solid angle with which sampleEnvironment picks the direction through a texture coordinate */
+inline __device__
+float environmentPdf(const AliasTableEntry *table, const ivec2 &size, const vec2 &uv)
+{
+	uint32_t column = min(uint32_t(max(uv.x, 0.f) * float(size.x)), uint32_t(size.x - 1));
+	uint32_t row = min(uint32_t(max(uv.y, 0.f) * float(size.y)), uint32_t(size.y - 1));
+	float sinTheta = sin(M_PI * uv.y);
+	if (sinTheta <= 0.f) return 0.f;
+	return table[row].pdf * table[size.y + row * size.x + column].pdf * float(size.x) * float(size.y) / (2.f * M_PI * M_PI * sinTheta);
+}
+
+/* cos(max(0, a - b)), from the sines and cosines of a and b */
+inline __device__
+float cosSubClamped(float sinA, float cosA, float sinB, float cosB)
+{
+	if (cosA > cosB) return 1.f;
+	return cosA * cosB + sinA * sinB;
+}
+
+/* sin(max(0, a - b)), from the sines and cosines of a and b */
+inline __device__
+float sinSubClamped(float sinA, float cosA, float sinB, float cosB)
+{
+	if (cosA > cosB) return 0.f;
+	return sinA * cosB - cosA * sinB;
+}
+
+/*
+ * How much light a group of lights could send to a point with normal n, used to pick between the children of a
+ * light BVH node. It's the group's power over the squared distance to it, times bounds on the cosines at the
+ * emitters and at the point which hold for any light within the group. A zero normal skips the cosine at the point.
+*/
+inline __device__
+float lightBoundsImportance(const LightBounds &b, const vec3 &p, const vec3 &n)
+{
+	if (b.power <= 0.f) return 0.f;
+	vec3 center = (b.boundsMin + b.boundsMax) * .5f;
+	vec3 diagonal = b.boundsMax - b.boundsMin;
+	float d2 = dot(p - center, p - center);
+	d2 = max(d2, length(diagonal) * .5f);
+	vec3 w_i = (d2 > 0.f) ? normalize(p - center) : vec3(0.f, 0.f, 1.f);
+
+	// The angle between the axis and the point, less the spread of normals, less the angle the bounds subtend
+	float cosThetaW = dot(b.axis, w_i);
+	if (b.twoSided) cosThetaW = fabs(cosThetaW);
+	float sinThetaW = sqrt(max(0.f, 1.f - cosThetaW * cosThetaW));
+	float radius2 = dot(diagonal, diagonal) * .25f;
+	float distance2 = dot(p - center, p - center);
+	float cosThetaB = (distance2 < radius2) ? -1.f : sqrt(max(0.f, 1.f - radius2 / distance2));
+	float sinThetaB = sqrt(max(0.f, 1.f - cosThetaB * cosThetaB));
+	float sinThetaO = sqrt(max(0.f, 1.f - b.cosThetaO * b.cosThetaO));
+	float cosThetaX = cosSubClamped(sinThetaW, cosThetaW, sinThetaO, b.cosThetaO);
+	float sinThetaX = sinSubClamped(sinThetaW, cosThetaW, sinThetaO, b.cosThetaO);
+	float cosThetaP = cosSubClamped(sinThetaX, cosThetaX, sinThetaB, cosThetaB);
+	if (cosThetaP <= b.cosThetaE) return 0.f;
+
+	float importance = b.power * cosThetaP / d2;
+	if ((n.x != 0.f) || (n.y != 0.f) || (n.z != 0.f)) {
+		float cosThetaI = fabs(dot(w_i, n));
+		float sinThetaI = sqrt(max(0.f, 1.f - cosThetaI * cosThetaI));
+		importance *= cosSubClamped(sinThetaI, cosThetaI, sinThetaB, cosThetaB);
+	}
+	return max(importance, 0.f);
+}
+
+/*
+ * Picks a light for a point with normal n by walking down the light BVH, choosing each child in proportion to its
+ * importance. Returns the light's position in lightEntities, along with the probability it had of being picked,
+ * which is zero if no light can reach the point.
+*/
+inline __device__
+uint32_t sampleLightBVH(const LightBVHNode *nodes, uint32_t numLights, const vec3 &p, const vec3 &n, float rand, float &pdf)
+{
+	pdf = 0.f;
+	if ((numLights == 0) || (lightBoundsImportance(nodes[0].bounds, p, n) <= 0.f)) return 0;
+
+	float prob = 1.f;
+	uint32_t node = 0;
+	while (!nodes[node].isLeaf) {
+		uint32_t first = node + 1;
+		uint32_t second = nodes[node].index;
+		float importance0 = lightBoundsImportance(nodes[first].bounds, p, n);
+		float importance1 = lightBoundsImportance(nodes[second].bounds, p, n);
+		if ((importance0 + importance1) <= 0.f) return 0;
+
+		// Reuse the random number, rescaled to the range of the child that was picked
+		float p0 = importance0 / (importance0 + importance1);
+		if (rand < p0) {
+			node = first;
+			rand = min(rand / p0, 0.99999994f);
+			prob *= p0;
+		} else {
+			node = second;
+			rand = min((rand - p0) / (1.f - p0), 0.99999994f);
+			prob *= 1.f - p0;
+		}
+	}
+	pdf = prob;
+	return nodes[node].index;
+}
@@ -47,6 +47,27 @@ float3 missColor(const owl::Ray &ray)
     return c;
 }
 
+/* The density per unit solid angle with which the dome light is sampled along a direction, or 0 if it isn't sampled */
+inline __device__
+float domeLightPdf(const float3 &direction)
+{
+    if (optixLaunchParams.environmentSamplingTableSize.x == 0) return 0.f;
+    vec3 rayDir = optixLaunchParams.environmentMapRotation * make_vec3(normalize(direction));
+    return environmentPdf(optixLaunchParams.environmentSamplingTable, optixLaunchParams.environmentSamplingTableSize, environmentDirectionToUV(rayDir));
+}
+
+/* Returns the TLAS covering the ray's time, and remaps the ray's time to lie within that TLAS's segment of the frame */
+inline __device__
+OptixTraversableHandle sceneAtRayTime(owl::Ray &ray)
+{
+    uint32_t numSegments = optixLaunchParams.numMotionSegments;
+    if (numSegments <= 1) return optixLaunchParams.world;
+    float t = ray.time * float(numSegments);
+    uint32_t segment = min(uint32_t(t), numSegments - 1);
+    ray.time = t - float(segment);
+    return optixLaunchParams.motionSegments[segment];
+}
+
 OPTIX_MISS_PROGRAM(miss)()
 {
 }
@@ -66,8 +87,8 @@ bool loadCamera(EntityStruct &cameraEntity, CameraStruct &camera, TransformStruc
 {
     cameraEntity = optixLaunchParams.cameraEntity;
     if (!cameraEntity.initialized) return false;
-    if ((cameraEntity.transform_id < 0) || (cameraEntity.transform_id >= MAX_TRANSFORMS)) return false;
-    if ((cameraEntity.camera_id < 0) || (cameraEntity.camera_id >= MAX_CAMERAS)) return false;
+    if ((cameraEntity.transform_id < 0) || (cameraEntity.transform_id >= optixLaunchParams.numTransforms)) return false;
+    if ((cameraEntity.camera_id < 0) || (cameraEntity.camera_id >= optixLaunchParams.numCameras)) return false;
     camera = optixLaunchParams.cameras[cameraEntity.camera_id];
     transform = optixLaunchParams.transforms[cameraEntity.transform_id];
     return true;
@@ -75,7 +96,7 @@ bool loadCamera(EntityStruct &cameraEntity, CameraStruct &camera, TransformStruc
 
 inline __device__ 
 vec4 sampleTexture(int32_t textureId, vec2 texCoord, vec4 defaultValue) {
-    if (textureId < 0 || textureId >= MAX_TEXTURES) return defaultValue;
+    if (textureId < 0 || textureId >= optixLaunchParams.numTextures) return defaultValue;
     cudaTextureObject_t tex = optixLaunchParams.textureObjects[textureId];
     if (!tex) return defaultValue;
     return make_vec4(tex2D<float4>(tex, texCoord.x, texCoord.y));
@@ -261,16 +282,20 @@ OPTIX_RAYGEN_PROGRAM(rayGen)()
     float3 accum_illum = make_float3(0.f);
     float3 primaryAlbedo = make_float3(0.f);
     float3 primaryNormal = make_float3(0.f);
+    vec4 sumAlbedo = vec4(0.f);
+    vec4 sumNormal = vec4(0.f);
     
     float3 renderData = make_float3(0.f);
     initializeRenderData(renderData);
     
-    // For potentially several samples per pixel... 
-    // Update: for machine learning applications, it's important there be only 1SPP.
-    // Metadata like depth or IDs dont work with multiple SPP.
-    #define SPP 1
-    for (uint32_t rid = 0; rid < SPP; ++rid) 
+    // Several samples per pixel can be traced per launch, each with the random numbers of the frame it stands for.
+    // Metadata like depth or IDs dont work with multiple SPP, so render data modes trace one.
+    uint32_t numSamples = (optixLaunchParams.renderDataMode == RenderDataFlags::NONE) ? max(optixLaunchParams.samplesPerLaunch, 1u) : 1u;
+    for (uint32_t rid = 0; rid < numSamples; ++rid) 
     {
+        rng = get_rng(optixLaunchParams.frameID + rid);
+        primaryAlbedo = make_float3(0.f);
+        primaryNormal = make_float3(0.f);
 
         // Trace an initial ray through the scene
         owl::Ray ray = generateRay(camera, camera_transform, pixelID, optixLaunchParams.frameSize, rng);
@@ -285,7 +310,7 @@ OPTIX_RAYGEN_PROGRAM(rayGen)()
         RayPayload payload;
         payload.tHit = -1.f;
         ray.time = lcg_randomf(rng);
-        owl::traceRay(  /*accel to trace against*/ optixLaunchParams.world,
+        owl::traceRay(  /*accel to trace against*/ sceneAtRayTime(ray),
                         /*the ray to trace*/ ray,
                         /*prd*/ payload);
 
@@ -308,7 +333,7 @@ OPTIX_RAYGEN_PROGRAM(rayGen)()
                 ray.origin = ray.origin + ray.direction * (payload.tHit + EPSILON);
                 payload.tHit = -1.f;
                 ray.time = lcg_randomf(rng);
-                owl::traceRay( optixLaunchParams.world, ray, payload);
+                owl::traceRay( sceneAtRayTime(ray), ray, payload);
                 visibilitySkips++;
                 if (visibilitySkips > 10) break; // avoid locking up.
 
@@ -324,7 +349,7 @@ OPTIX_RAYGEN_PROGRAM(rayGen)()
 
             TransformStruct entityTransform = optixLaunchParams.transforms[entity.transform_id];
             MaterialStruct entityMaterial; LightStruct entityLight;
-            if (entity.material_id >= 0 && entity.material_id < MAX_MATERIALS) {
+            if (entity.material_id >= 0 && entity.material_id < optixLaunchParams.numMaterials) {
                 entityMaterial = optixLaunchParams.materials[entity.material_id];
             }
             
@@ -398,7 +423,7 @@ OPTIX_RAYGEN_PROGRAM(rayGen)()
 
             // If the entity we hit is a light, terminate the path.
             // First hits are colored by the light. All other light hits are handled by NEE/MIS 
-            if (entity.light_id >= 0 && entity.light_id < MAX_LIGHTS) {
+            if (entity.light_id >= 0 && entity.light_id < optixLaunchParams.numLights) {
                 if (bounce == 0) 
                 {
                     entityLight = optixLaunchParams.lights[entity.light_id];
@@ -417,6 +442,7 @@ OPTIX_RAYGEN_PROGRAM(rayGen)()
             // float3 lightEmission = make_float3(0.f);
             float3 irradiance = make_float3(0.f);
             float light_pdf = 0.f;
+            float light_selection_pdf = 1.f;
 
             EntityStruct light_entity;
             MaterialStruct light_material;
@@ -436,22 +462,24 @@ OPTIX_RAYGEN_PROGRAM(rayGen)()
                 // bool entering = dot(w_o, v_z) < 0.f;
                 // if (entering) break;
 
-                
-                uint32_t random_id = uint32_t(min(lcg_randomf(rng) * numLights, float(numLights - 1)));
-                random_id = min(random_id, numLights - 1);
+
+                // Lights which are brighter, larger, closer and facing this point are picked more often
+                uint32_t random_id = sampleLightBVH(optixLaunchParams.lightBVH, numLights, vec3(hit_p.x, hit_p.y, hit_p.z),
+                    vec3(n_l.x, n_l.y, n_l.z), lcg_randomf(rng), light_selection_pdf);
+                if (light_selection_pdf <= 0.f) break;
                 sampledLightID = optixLaunchParams.lightEntities[random_id];
                 light_entity = optixLaunchParams.entities[sampledLightID];
                 
                 // shouldn't happen, but just in case...
-                if ((light_entity.light_id < 0) || (light_entity.light_id > MAX_LIGHTS)) break;
-                if ((light_entity.transform_id < 0) || (light_entity.transform_id > MAX_TRANSFORMS)) break;
+                if ((light_entity.light_id < 0) || (light_entity.light_id >= optixLaunchParams.numLights)) break;
+                if ((light_entity.transform_id < 0) || (light_entity.transform_id >= optixLaunchParams.numTransforms)) break;
             
                 light_light = optixLaunchParams.lights[light_entity.light_id];
                 TransformStruct transform = optixLaunchParams.transforms[light_entity.transform_id];
                 MeshStruct mesh;
                 
                 bool is_area_light = false;
-                if ((light_entity.mesh_id >= 0) && (light_entity.mesh_id < MAX_MESHES)) {
+                if ((light_entity.mesh_id >= 0) && (light_entity.mesh_id < optixLaunchParams.numMeshes)) {
                     mesh = optixLaunchParams.meshes[light_entity.mesh_id];
                     is_area_light = true;
                 };
@@ -462,7 +490,11 @@ OPTIX_RAYGEN_PROGRAM(rayGen)()
             
                 if (!is_area_light) break;
 
-                uint32_t random_tri_id = uint32_t(min(lcg_randomf(rng) * mesh.numTris, float(mesh.numTris - 1)));
+                owl::device::Buffer *triangleSamplingTables = (owl::device::Buffer *)optixLaunchParams.triangleSamplingTables.data;
+                AliasTableEntry *triangleSamplingTable = (AliasTableEntry*) triangleSamplingTables[light_entity.mesh_id].data;
+                if (!triangleSamplingTable) break;
+                float tri_pdf;
+                uint32_t random_tri_id = sampleAliasTable(triangleSamplingTable, mesh.numTris, lcg_randomf(rng), tri_pdf);
                 owl::device::Buffer *indexLists = (owl::device::Buffer *)optixLaunchParams.indexLists.data;
                 ivec3 *indices = (ivec3*) indexLists[light_entity.mesh_id].data;
                 ivec3 triIndex = indices[random_tri_id];   
@@ -487,11 +519,14 @@ OPTIX_RAYGEN_PROGRAM(rayGen)()
                     vec3 normal = glm::vec3(n_l.x, n_l.y, n_l.z);
                     float dotNWi = fabs(dot(dir, normal)); // for now, making all lights double sided.
                     light_pdf = abs(light_pdf);
+                    // Triangles too small or too far away to be worth sampling are skipped. Otherwise, the density
+                    // covers the whole light, since triangles are picked in proportion to their area.
+                    light_pdf = (light_pdf > EPSILON) ? light_pdf * tri_pdf : 0.f;
                     
                     float4 default_light_emission = make_float4(light_light.r, light_light.g, light_light.b, 0.f);
                     float3 lightEmission = make_float3(sampleTexture(light_light.color_texture_id, uv, make_vec4(default_light_emission))) * light_light.intensity;
         
-                    if ((light_pdf > EPSILON) && (dotNWi > EPSILON)) {
+                    if ((light_pdf > 0.f) && (dotNWi > EPSILON)) {
                         float3 light_dir = make_float3(dir.x, dir.y, dir.z);
                         light_dir = normalize(light_dir);
                         float bsdf_pdf = disney_pdf(mat, n_l, w_o, light_dir, v_x, v_y);
@@ -504,14 +539,14 @@ OPTIX_RAYGEN_PROGRAM(rayGen)()
                             ray.direction = light_dir;
                             payload.tHit = -1.f;
                             ray.time = lcg_randomf(rng);
-                            owl::traceRay( optixLaunchParams.world, ray, payload, occlusion_flags);
+                            owl::traceRay( sceneAtRayTime(ray), ray, payload, occlusion_flags);
                             if (payload.instanceID == -1) continue;
                             int entityID = optixLaunchParams.instanceToEntityMap[payload.instanceID];
                             bool visible = ((entityID == sampledLightID) || (entityID == -1));
                             if (visible) {
                                 float w = power_heuristic(1.f, light_pdf, 1.f, bsdf_pdf);
                                 float3 bsdf = disney_brdf(mat, n_l, w_o, light_dir, v_x, v_y, optixLaunchParams.GGX_E_LOOKUP, optixLaunchParams.GGX_E_AVG_LOOKUP);
-                                float3 Li = lightEmission * w / light_pdf;
+                                float3 Li = lightEmission * w / (light_pdf * light_selection_pdf);
                                 irradiance = (bsdf * Li * fabs(dotNWi));
                             }
                         }
@@ -519,12 +554,43 @@ OPTIX_RAYGEN_PROGRAM(rayGen)()
                 }
             } while (false);
 
+            // Then sample the dome light, in proportion to the brightness of its texture
+            if ((optixLaunchParams.environmentSamplingTableSize.x > 0) && (optixLaunchParams.domeLightIntensity > 0.f)) {
+                float dome_pdf;
+                vec2 uv = sampleEnvironment(optixLaunchParams.environmentSamplingTable, optixLaunchParams.environmentSamplingTableSize,
+                    lcg_randomf(rng), lcg_randomf(rng), lcg_randomf(rng), lcg_randomf(rng), dome_pdf);
+                vec3 dir = glm::inverse(optixLaunchParams.environmentMapRotation) * environmentUVToDirection(uv);
+                float3 light_dir = normalize(make_float3(dir.x, dir.y, dir.z));
+                float dotNWi = fabs(dot(light_dir, n_l));
+                float bsdf_pdf = (dome_pdf > 0.f) ? disney_pdf(mat, n_l, w_o, light_dir, v_x, v_y) : 0.f;
+                if ((bsdf_pdf > EPSILON) && (dotNWi > EPSILON)) {
+                    RayPayload payload;
+                    owl::Ray ray;
+                    ray.tmin = EPSILON * 10.f;
+                    ray.tmax = 1e20f;
+                    ray.origin = hit_p;
+                    ray.direction = light_dir;
+                    payload.tHit = -1.f;
+                    ray.time = lcg_randomf(rng);
+                    owl::traceRay(sceneAtRayTime(ray), ray, payload, OPTIX_RAY_FLAG_DISABLE_ANYHIT);
+                    if (payload.instanceID == -1) {
+                        float w = power_heuristic(1.f, dome_pdf, 1.f, bsdf_pdf);
+                        // disney_brdf already includes the cosine term
+                        float3 bsdf = disney_brdf(mat, n_l, w_o, light_dir, v_x, v_y, optixLaunchParams.GGX_E_LOOKUP, optixLaunchParams.GGX_E_AVG_LOOKUP);
+                        float3 Li = missColor(ray) * optixLaunchParams.domeLightIntensity * w / dome_pdf;
+                        irradiance = irradiance + (bsdf * Li);
+                    }
+                }
+            }
+
             // next, sample a light source by importance sampling the BDRF
             float3 w_i;
             float bsdf_pdf;
             bool sampledSpecular;
             float3 bsdf = sample_disney_brdf(mat, v_z, w_o, v_x, v_y, rng, w_i, bsdf_pdf, sampledSpecular, optixLaunchParams.GGX_E_LOOKUP, optixLaunchParams.GGX_E_AVG_LOOKUP);
             if (bsdf_pdf < EPSILON || all_zero(bsdf)) {
+                // The path ends here, but keep the light sampled above
+                illum = illum + path_throughput * irradiance;
                 break;
             }
 
@@ -537,9 +603,9 @@ OPTIX_RAYGEN_PROGRAM(rayGen)()
             ray.tmin = EPSILON * 100.f;
             payload.tHit = -1.f;
             ray.time = lcg_randomf(rng);
-            owl::traceRay(optixLaunchParams.world, ray, payload);
+            owl::traceRay(sceneAtRayTime(ray), ray, payload);
 
-            if (light_pdf > EPSILON) 
+            if (light_pdf > 0.f) 
             {
                 // if by sampling the brdf we also hit the light source...
                 if (payload.instanceID == -1) continue;
@@ -568,7 +634,7 @@ OPTIX_RAYGEN_PROGRAM(rayGen)()
                     float dotNWi = fabs(dot(-v_gz, ray.direction)); // for now, making all lights double sided.
                     if (dotNWi > 0.f){
                         float w = power_heuristic(1.f, bsdf_pdf, 1.f, light_pdf);
-                        float3 Li = lightEmission * w / bsdf_pdf;
+                        float3 Li = lightEmission * w / (bsdf_pdf * light_selection_pdf);
                         irradiance = irradiance + (bsdf * Li * fabs(dotNWi)); // missing r^2 falloff?
                     }
                 }
@@ -580,7 +646,10 @@ OPTIX_RAYGEN_PROGRAM(rayGen)()
 
             // If ray misses, interpret normal as "miss color" assigned by miss program and move on to the next sample
             if (payload.tHit <= 0.f) {
-                illum = illum + path_throughput * missColor(ray) * optixLaunchParams.domeLightIntensity;
+                // Weighted against the chance of sampling the same direction from the dome light
+                float dome_pdf = domeLightPdf(ray.direction);
+                float w = (dome_pdf > 0.f) ? power_heuristic(1.f, bsdf_pdf, 1.f, dome_pdf) : 1.f;
+                illum = illum + path_throughput * missColor(ray) * optixLaunchParams.domeLightIntensity * w;
             }
             
             if (bounce == 0) {
@@ -621,13 +690,17 @@ OPTIX_RAYGEN_PROGRAM(rayGen)()
 
         // accumulate the illumination from this sample into what will be an average illumination from all samples in this pixel
         accum_illum = accum_illum + illum;
+        sumAlbedo = sumAlbedo + vec4(primaryAlbedo.x, primaryAlbedo.y, primaryAlbedo.z, 1.f);
+        vec4 sampleNormal = normalize(camera.proj * camera_transform.worldToLocal * vec4(primaryNormal.x, primaryNormal.y, primaryNormal.z, 0.f));
+        sampleNormal.a = 1.f;
+        sumNormal = sumNormal + sampleNormal;
     }
-    accum_illum = accum_illum / float(SPP);
-
 
-    /* Write to AOVs, progressively refining results */
+    /* Write to AOVs, progressively refining results. The samples of this launch follow frameID earlier ones. */
+    float prevSamples = float(optixLaunchParams.frameID);
+    float totalSamples = prevSamples + float(numSamples);
     float4 &prev_color = (float4&) optixLaunchParams.accumPtr[fbOfs];
-    float4 accum_color = make_float4((accum_illum + float(optixLaunchParams.frameID) * make_float3(prev_color)) / float(optixLaunchParams.frameID + 1), 1.0f);
+    float4 accum_color = make_float4((accum_illum + prevSamples * make_float3(prev_color)) / totalSamples, 1.0f);
     optixLaunchParams.accumPtr[fbOfs] = vec4(
         accum_color.x, 
         accum_color.y, 
@@ -656,11 +729,8 @@ OPTIX_RAYGEN_PROGRAM(rayGen)()
     vec4 oldNormal = optixLaunchParams.normalBuffer[fbOfs];
     if (any(isnan(oldAlbedo))) oldAlbedo = vec4(1.f);
     if (any(isnan(oldNormal))) oldNormal = vec4(1.f);
-    vec4 newAlbedo = vec4(primaryAlbedo.x, primaryAlbedo.y, primaryAlbedo.z, 1.f);
-    vec4 newNormal = normalize(camera.proj * camera_transform.worldToLocal * vec4(primaryNormal.x, primaryNormal.y, primaryNormal.z, 0.f));
-    newNormal.a = 1.f;
-    vec4 accumAlbedo = (newAlbedo + float(optixLaunchParams.frameID) * oldAlbedo) / float(optixLaunchParams.frameID + 1);
-    vec4 accumNormal = (newNormal + float(optixLaunchParams.frameID) * oldNormal) / float(optixLaunchParams.frameID + 1);
+    vec4 accumAlbedo = (sumAlbedo + prevSamples * oldAlbedo) / totalSamples;
+    vec4 accumNormal = (sumNormal + prevSamples * oldNormal) / totalSamples;
     optixLaunchParams.albedoBuffer[fbOfs] = accumAlbedo;
     optixLaunchParams.normalBuffer[fbOfs] = accumNormal;
 
@@ -674,3 +744,106 @@ OPTIX_RAYGEN_PROGRAM(rayGen)()
         optixLaunchParams.frameBuffer[fbOfs] = vec4( renderData.x, renderData.y, renderData.z, 1.0f);
     }
 }
+
+/*
+ * Traces only the camera ray of each pixel, for metadata which is read at the first visible hit.
+ * The camera ray, its random numbers, and the hit's normal are computed the same way as in rayGen,
+ * so the results match renderData at bounce 0, without loading materials or shading.
+ * Writes vec4(position, depth) to the frame buffer and vec4(normal, entity id) to the normal buffer.
+*/
+OPTIX_RAYGEN_PROGRAM(primaryRayGen)()
+{
+    auto pixelID = ivec2(owl::getLaunchIndex()[0], owl::getLaunchIndex()[1]);
+    auto fbOfs = pixelID.x+optixLaunchParams.frameSize.x* ((optixLaunchParams.frameSize.y - 1) -  pixelID.y);
+    LCGRand rng = get_rng(optixLaunchParams.frameID);
+
+    // Nothing is visible without a camera
+    optixLaunchParams.frameBuffer[fbOfs] = vec4(FLT_MAX);
+    optixLaunchParams.normalBuffer[fbOfs] = vec4(FLT_MAX);
+
+    EntityStruct    camera_entity;
+    TransformStruct camera_transform;
+    CameraStruct    camera;
+    if (!loadCamera(camera_entity, camera, camera_transform)) return;
+
+    owl::Ray ray = generateRay(camera, camera_transform, pixelID, optixLaunchParams.frameSize, rng);
+    RayPayload payload;
+    payload.tHit = -1.f;
+    ray.time = lcg_randomf(rng);
+    owl::traceRay(sceneAtRayTime(ray), ray, payload);
+
+    int entityID = -1;
+    EntityStruct entity;
+    for (int visibilitySkips = 0; payload.tHit > 0.f; ++visibilitySkips) {
+        entityID = optixLaunchParams.instanceToEntityMap[payload.instanceID];
+        entity = optixLaunchParams.entities[entityID];
+        if ((entity.visibilityFlags & ENTITY_VISIBILITY_CAMERA_RAYS) != 0) break;
+
+        // Skip forward if the hit object is invisible to the camera
+        if (visibilitySkips == 10) return; // avoid locking up.
+        ray.origin = ray.origin + ray.direction * (payload.tHit + EPSILON);
+        payload.tHit = -1.f;
+        ray.time = lcg_randomf(rng);
+        owl::traceRay(sceneAtRayTime(ray), ray, payload);
+    }
+    if (payload.tHit <= 0.f) return;
+
+    MaterialStruct entityMaterial;
+    if (entity.material_id >= 0 && entity.material_id < optixLaunchParams.numMaterials) {
+        entityMaterial = optixLaunchParams.materials[entity.material_id];
+    }
+
+    const float3 w_o = -ray.direction;
+    float3 p, v_x, v_y, v_z, v_gz, p_e1, p_e2; float2 uv, uv_e1, uv_e2; int3 indices;
+    loadMeshTriIndices(entity.mesh_id, payload.primitiveID, indices);
+    loadMeshVertexData(entity.mesh_id, indices, payload.barycentrics, p, v_gz, p_e1, p_e2);
+    loadMeshUVData(entity.mesh_id, indices, payload.barycentrics, uv, uv_e1, uv_e2);
+    loadMeshNormalData(entity.mesh_id, indices, payload.barycentrics, uv, v_z);
+
+    glm::mat4 xfm;
+    xfm = glm::column(xfm, 0, vec4(payload.localToWorld[0], payload.localToWorld[4],  payload.localToWorld[8], 0.0f));
+    xfm = glm::column(xfm, 1, vec4(payload.localToWorld[1], payload.localToWorld[5],  payload.localToWorld[9], 0.0f));
+    xfm = glm::column(xfm, 2, vec4(payload.localToWorld[2], payload.localToWorld[6],  payload.localToWorld[10], 0.0f));
+    xfm = glm::column(xfm, 3, vec4(payload.localToWorld[3], payload.localToWorld[7],  payload.localToWorld[11], 1.0f));
+    glm::mat3 nxfm = transpose(glm::inverse(glm::mat3(xfm)));
+
+    float f = 1.0f / (uv_e1.x * uv_e2.y - uv_e2.x * uv_e1.y);
+    vec3 tangent;
+    tangent.x = f * (uv_e2.y * p_e1.x - uv_e1.y * p_e2.x);
+    tangent.y = f * (uv_e2.y * p_e1.y - uv_e1.y * p_e2.y);
+    tangent.z = f * (uv_e2.y * p_e1.z - uv_e1.y * p_e2.z);
+    tangent = normalize(tangent);
+    v_z = normalize(v_z);
+
+    p = make_float3(xfm * make_vec4(p, 1.0f));
+    v_gz = make_float3(normalize(nxfm * make_vec3(v_gz)));
+    v_z = make_float3(normalize(nxfm * make_vec3(v_z)));
+    v_x = make_float3(normalize(nxfm * tangent));
+    v_y = cross(v_z, v_x);
+    v_x = cross(v_y, v_z);
+
+    if (
+        all(lessThan(abs(make_vec3(v_x)), vec3(EPSILON))) || 
+        all(lessThan(abs(make_vec3(v_y)), vec3(EPSILON))) ||
+        any(isnan(make_vec3(v_x))) || 
+        any(isnan(make_vec3(v_y)))
+    ) {
+        ortho_basis(v_x, v_y, v_z);
+    }
+
+    glm::mat3 tbn;
+    tbn = glm::column(tbn, 0, make_vec3(v_x) );
+    tbn = glm::column(tbn, 1, make_vec3(v_y) );
+    tbn = glm::column(tbn, 2, make_vec3(v_z) );
+
+    float3 dN = make_float3(sampleTexture(entityMaterial.normal_map_texture_id, make_vec2(uv), vec4(0.5f, .5f, 1.f, 0.f)));
+    dN = (dN * make_float3(2.0f)) - make_float3(1.f);
+    v_z = make_float3(normalize(tbn * normalize(make_vec3(dN))) );
+
+    if (entityMaterial.transmission == 0.f) {
+        v_z = faceNormalForward(w_o, v_gz, v_z);
+    }
+
+    optixLaunchParams.frameBuffer[fbOfs] = vec4(p.x, p.y, p.z, payload.tHit);
+    optixLaunchParams.normalBuffer[fbOfs] = vec4(v_z.x, v_z.y, v_z.z, float(entityID));
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <stdint.h>
+
+/* Which metadata renderData extracts in place of the shaded image */
+enum RenderDataFlags : uint32_t { 
+  NONE = 0, 
+  DEPTH = 1, 
+  POSITION = 2,
+  NORMAL = 3,
+  ENTITY_ID = 4,
+  DENOISE_NORMAL = 5,
+  DENOISE_ALBEDO = 6,
+};
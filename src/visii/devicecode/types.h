@@ -1,5 +1,9 @@
 #pragma once
 
+#ifndef __CUDACC__
+#include "host_types.h"
+#endif
+
 #ifndef M_PI
 #define M_PI 3.14159265358979323846f
 #endif
@@ -18,8 +22,12 @@
 #define NUM_RAY_TYPES 2
 // #define MAX_PATH_DEPTH 50
 
+#ifndef FLT_MIN
 #define FLT_MIN 1.175494e-38
+#endif
+#ifndef FLT_MAX
 #define FLT_MAX 3.402823e+38
+#endif
 // #ifdef __CUDA_ARCH__
 // typedef unsigned long long uint64_t;
 // typedef unsigned int uint32_t;
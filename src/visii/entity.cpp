@@ -5,9 +5,9 @@
 #include <visii/material.h>
 #include <visii/mesh.h>
 
-Entity Entity::entities[MAX_ENTITIES];
-EntityStruct Entity::entityStructs[MAX_ENTITIES];
-std::map<std::string, uint32_t> Entity::lookupTable;
+PagedArray<Entity> Entity::entities;
+PagedArray<EntityStruct> Entity::entityStructs;
+NameTable Entity::lookupTable;
 std::shared_ptr<std::mutex> Entity::editMutex;
 bool Entity::factoryInitialized = false;
 bool Entity::anyDirty = true;
@@ -63,7 +63,7 @@ void Entity::setTransform(Transform* transform)
 void Entity::clearTransform()
 {
 	auto &entity = getStruct();
-	auto transforms = Transform::getFront();
+	auto &transforms = Transform::getFront();
 	if (entity.transform_id != -1) transforms[entity.transform_id].entities.erase(id);
 	entity.transform_id = -1;
 	markDirty();
@@ -72,8 +72,8 @@ void Entity::clearTransform()
 Transform* Entity::getTransform()
 {
 	auto &entity = getStruct();
-	if ((entity.transform_id < 0) || (entity.transform_id >= MAX_TRANSFORMS)) return nullptr;
-	auto transforms = Transform::getFront(); 
+	if ((entity.transform_id < 0) || (uint32_t(entity.transform_id) >= Transform::getCount())) return nullptr;
+	auto &transforms = Transform::getFront(); 
 	if (!transforms[entity.transform_id].isInitialized()) return nullptr;
 	return &transforms[entity.transform_id];
 }
@@ -91,7 +91,7 @@ void Entity::setCamera(Camera *camera)
 void Entity::clearCamera()
 {
 	auto &entity = getStruct();
-	auto cameras = Camera::getFront();
+	auto &cameras = Camera::getFront();
 	if (entity.camera_id != -1) cameras[entity.camera_id].entities.erase(id);
 	entity.camera_id = -1;
 	markDirty();
@@ -100,8 +100,8 @@ void Entity::clearCamera()
 Camera* Entity::getCamera()
 {
 	auto &entity = getStruct();
-	if ((entity.camera_id < 0) || (entity.camera_id >= MAX_CAMERAS)) return nullptr;
-	auto cameras = Camera::getFront(); 
+	if ((entity.camera_id < 0) || (uint32_t(entity.camera_id) >= Camera::getCount())) return nullptr;
+	auto &cameras = Camera::getFront(); 
 	if (!cameras[entity.camera_id].isInitialized()) return nullptr;
 	return &cameras[entity.camera_id];
 }
@@ -119,7 +119,7 @@ void Entity::setMaterial(Material *material)
 void Entity::clearMaterial()
 {
 	auto &entity = getStruct();
-	auto materials = Material::getFront();
+	auto &materials = Material::getFront();
 	if (entity.material_id != -1) materials[entity.material_id].entities.erase(id);
 	entity.material_id = -1;
 	markDirty();
@@ -128,7 +128,7 @@ void Entity::clearMaterial()
 Material* Entity::getMaterial()
 {
 	auto &entity = getStruct();
-	if ((entity.material_id < 0) || (entity.material_id >= MAX_MATERIALS)) return nullptr;
+	if ((entity.material_id < 0) || (uint32_t(entity.material_id) >= Material::getCount())) return nullptr;
 	auto &material = Material::getFront()[entity.material_id];
 	if (!material.isInitialized()) return nullptr;
 	return &material;
@@ -147,7 +147,7 @@ void Entity::setLight(Light* light)
 void Entity::clearLight()
 {
 	auto &entity = getStruct();
-	auto lights = Light::getFront();
+	auto &lights = Light::getFront();
 	if (entity.light_id != -1) lights[entity.light_id].entities.erase(id);
 	entity.light_id = -1;
 	markDirty();
@@ -156,7 +156,7 @@ void Entity::clearLight()
 Light* Entity::getLight()
 {
 	auto &entity = getStruct();
-	if ((entity.light_id < 0) || (entity.light_id >= MAX_LIGHTS)) return nullptr;
+	if ((entity.light_id < 0) || (uint32_t(entity.light_id) >= Light::getCount())) return nullptr;
 	auto &light = Light::getFront()[entity.light_id];
 	if (!light.isInitialized()) return nullptr;
 	return &light;
@@ -175,7 +175,7 @@ void Entity::setMesh(Mesh* mesh)
 void Entity::clearMesh()
 {
 	auto &entity = getStruct();
-	auto meshes = Mesh::getFront();
+	auto &meshes = Mesh::getFront();
 	if (entity.mesh_id != -1) meshes[entity.mesh_id].entities.erase(id);
 	entity.mesh_id = -1;
 	markDirty();
@@ -184,7 +184,7 @@ void Entity::clearMesh()
 Mesh* Entity::getMesh()
 {
 	auto &entity = getStruct();
-	if ((entity.mesh_id < 0) || (entity.mesh_id >= MAX_MESHES))  return nullptr;
+	if ((entity.mesh_id < 0) || (uint32_t(entity.mesh_id) >= Mesh::getCount()))  return nullptr;
 	auto &mesh = Mesh::getFront()[entity.mesh_id];
 	if (!mesh.isInitialized()) return nullptr;
 	return &mesh;
@@ -242,7 +242,8 @@ void Entity::updateComponents()
 void Entity::clearAll()
 {
 	if (!isFactoryInitialized()) return;
-	for (auto &entity : entities) {
+	for (uint32_t i = 0; i < entities.size(); ++i) {
+		auto &entity = entities[i];
 		if (entity.initialized) {
 			Entity::remove(entity.name);
 		}
@@ -259,7 +260,7 @@ Entity* Entity::create(
 	Camera* camera
     )
 {
-	auto entity =  StaticFactory::create(editMutex, name, "Entity", lookupTable, entities, MAX_ENTITIES);
+	auto entity =  StaticFactory::create(editMutex, name, "Entity", lookupTable, entities);
 	try {
 		entity->setVisibility(true);
 		if (transform) entity->setTransform(transform);
@@ -269,7 +270,31 @@ Entity* Entity::create(
 		if (light) entity->setLight(light);
 		return entity;
 	} catch (...) {
-		StaticFactory::removeIfExists(editMutex, name, "Entity", lookupTable, entities, MAX_ENTITIES);
+		StaticFactory::removeIfExists(editMutex, name, "Entity", lookupTable, entities);
+		throw;
+	}
+}
+
+Entity* Entity::createUnique(
+	std::string prefix, 
+	Transform* transform, 
+	Material* material, 
+	Mesh* mesh, 
+	Light* light, 
+	Camera* camera
+    )
+{
+	auto entity =  StaticFactory::createUnique(editMutex, prefix, "Entity", lookupTable, entities);
+	try {
+		entity->setVisibility(true);
+		if (transform) entity->setTransform(transform);
+		if (material) entity->setMaterial(material);
+		if (camera) entity->setCamera(camera);
+		if (mesh) entity->setMesh(mesh);
+		if (light) entity->setLight(light);
+		return entity;
+	} catch (...) {
+		StaticFactory::removeIfExists(editMutex, entity->getName(), "Entity", lookupTable, entities);
 		throw;
 	}
 }
@@ -280,7 +305,7 @@ std::shared_ptr<std::mutex> Entity::getEditMutex()
 }
 
 Entity* Entity::get(std::string name) {
-	return StaticFactory::get(editMutex, name, "Entity", lookupTable, entities, MAX_ENTITIES);
+	return StaticFactory::get(editMutex, name, "Entity", lookupTable, entities);
 }
 
 void Entity::remove(std::string name) {
@@ -290,20 +315,26 @@ void Entity::remove(std::string name) {
 	entity->clearMaterial();
 	entity->clearMesh();
 	entity->clearTransform();
-	StaticFactory::remove(editMutex, name, "Entity", lookupTable, entities, MAX_ENTITIES);
+	StaticFactory::remove(editMutex, name, "Entity", lookupTable, entities);
 	anyDirty = true;
 }
 
-EntityStruct* Entity::getFrontStruct() {
+PagedArray<EntityStruct> &Entity::getFrontStruct() {
 	return entityStructs;
 }
 
-Entity* Entity::getFront() {
+PagedArray<Entity> &Entity::getFront() {
 	return entities;
 }
 
 uint32_t Entity::getCount() {
-	return MAX_ENTITIES;
+	return entities.size();
+}
+
+void Entity::reserveTables(uint32_t count)
+{
+	entities.reserve(count);
+	entityStructs.reserve(count);
 }
 
 std::string Entity::getName()
@@ -311,7 +342,7 @@ std::string Entity::getName()
     return name;
 }
 
-std::map<std::string, uint32_t> Entity::getNameToIdMap()
+const NameTable &Entity::getNameToIdMap()
 {
 	return lookupTable;
 }
\ No newline at end of file
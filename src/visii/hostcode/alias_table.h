@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+#include <glm/glm.hpp>
+
+#include <devicecode/alias_table.h>
+#include <visii/utilities/parallel.h>
+
+/*
+ * Builds a Walker alias table which picks item i with probability weights[i] / sum(weights), using Vose's
+ * method in O(n). Negative and non finite weights count as zero. If every weight is zero, items are picked uniformly.
+*/
+inline std::vector<AliasTableEntry> buildAliasTable(const std::vector<float> &weights)
+{
+    uint32_t count = uint32_t(weights.size());
+    std::vector<AliasTableEntry> table(count);
+    if (count == 0) return table;
+
+    double total = 0.0;
+    for (float w : weights) if (std::isfinite(w) && (w > 0.f)) total += w;
+
+    // Scaled so that the average is one. Items above one donate their excess to the slots of items below one.
+    std::vector<double> scaled(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        double w = (std::isfinite(weights[i]) && (weights[i] > 0.f)) ? double(weights[i]) : 0.0;
+        double p = (total > 0.0) ? (w / total) : (1.0 / count);
+        table[i].pdf = float(p);
+        scaled[i] = p * count;
+    }
+
+    std::vector<uint32_t> small, large;
+    for (uint32_t i = 0; i < count; ++i) {
+        if (scaled[i] < 1.0) small.push_back(i);
+        else large.push_back(i);
+    }
+    while (!small.empty() && !large.empty()) {
+        uint32_t s = small.back(); small.pop_back();
+        uint32_t l = large.back();
+        table[s].threshold = float(scaled[s]);
+        table[s].alias = l;
+        scaled[l] -= 1.0 - scaled[s];
+        if (scaled[l] < 1.0) { large.pop_back(); small.push_back(l); }
+    }
+
+    // Whatever is left is one up to rounding error
+    for (uint32_t i : large) { table[i].threshold = 1.f; table[i].alias = i; }
+    for (uint32_t i : small) { table[i].threshold = 1.f; table[i].alias = i; }
+    return table;
+}
+
+/*
+ * Builds an alias table which picks the triangles of a mesh in proportion to their object space area, with one
+ * entry per triangle. Areas are computed in parallel. Triangles with out of range indices get no area.
+*/
+inline std::vector<AliasTableEntry> buildTriangleAreaTable(const std::vector<glm::vec4> &vertices, const std::vector<uint32_t> &indices)
+{
+    std::vector<float> areas(indices.size() / 3, 0.f);
+    parallelFor(areas.size(), [&] (uint64_t begin, uint64_t end, uint32_t) {
+        for (uint64_t t = begin; t < end; ++t) {
+            uint32_t i0 = indices[t * 3 + 0], i1 = indices[t * 3 + 1], i2 = indices[t * 3 + 2];
+            if ((i0 >= vertices.size()) || (i1 >= vertices.size()) || (i2 >= vertices.size())) continue;
+            glm::vec3 v0 = glm::vec3(vertices[i0]), v1 = glm::vec3(vertices[i1]), v2 = glm::vec3(vertices[i2]);
+            areas[t] = .5f * glm::length(glm::cross(v1 - v0, v2 - v0));
+        }
+    }, 4096);
+    return buildAliasTable(areas);
+}
+
+/*
+ * Builds the table sampleEnvironment picks dome light directions from, for a latitude-longitude texture of the given
+ * size. Texels are weighted by their luminance, times the sine of their polar angle, since rows towards the poles
+ * cover less of the sphere. The first height entries pick a row, and are followed by one table per row which picks
+ * a column. Rows are built in parallel. The table is empty if no texel has any weight.
+*/
+inline std::vector<AliasTableEntry> buildEnvironmentSamplingTable(const std::vector<glm::vec4> &texels, uint32_t width, uint32_t height)
+{
+    if ((width == 0) || (height == 0) || (texels.size() < size_t(width) * height)) return {};
+
+    std::vector<AliasTableEntry> table(height + size_t(width) * height);
+    std::vector<float> rowWeights(height, 0.f);
+    parallelFor(height, [&] (uint64_t begin, uint64_t end, uint32_t) {
+        std::vector<float> weights(width);
+        for (uint64_t row = begin; row < end; ++row) {
+            float sinTheta = std::sin(3.14159265358979323846f * (float(row) + .5f) / float(height));
+            double rowWeight = 0.0;
+            for (uint32_t column = 0; column < width; ++column) {
+                const glm::vec4 &texel = texels[row * width + column];
+                weights[column] = (.2126f * texel.r + .7152f * texel.g + .0722f * texel.b) * sinTheta;
+                if (std::isfinite(weights[column]) && (weights[column] > 0.f)) rowWeight += weights[column];
+            }
+            rowWeights[row] = float(rowWeight);
+            std::vector<AliasTableEntry> rowTable = buildAliasTable(weights);
+            std::copy(rowTable.begin(), rowTable.end(), table.begin() + height + row * width);
+        }
+    }, 16);
+
+    double total = 0.0;
+    for (float w : rowWeights) total += w;
+    if (!(total > 0.0)) return {};
+    std::vector<AliasTableEntry> rowTable = buildAliasTable(rowWeights);
+    std::copy(rowTable.begin(), rowTable.end(), table.begin());
+    return table;
+}
@@ -0,0 +1,613 @@
+#pragma once
+
+#include <cstdint>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <glm/glm.hpp>
+#include <visii/utilities/parallel.h>
+#include <hostcode/simd.h>
+
+/* An axis aligned bounding box. Starts out empty. */
+struct AABB {
+    glm::vec3 lo = glm::vec3(FLT_MAX);
+    glm::vec3 hi = glm::vec3(-FLT_MAX);
+
+    void extend(const glm::vec3 &p) { lo = glm::min(lo, p); hi = glm::max(hi, p); }
+    void extend(const AABB &b) { lo = glm::min(lo, b.lo); hi = glm::max(hi, b.hi); }
+    glm::vec3 center() const { return (lo + hi) * .5f; }
+    bool empty() const { return (lo.x > hi.x) || (lo.y > hi.y) || (lo.z > hi.z); }
+
+    float area() const
+    {
+        if (empty()) return 0.f;
+        glm::vec3 d = hi - lo;
+        return 2.f * (d.x * d.y + d.y * d.z + d.z * d.x);
+    }
+
+    /* Slab test, returning the parametric distance to the box through tNear */
+    bool intersect(const glm::vec3 &origin, const glm::vec3 &invDir, float tmin, float tmax, float &tNear) const
+    {
+        glm::vec3 t0 = (lo - origin) * invDir;
+        glm::vec3 t1 = (hi - origin) * invDir;
+        glm::vec3 tsmall = glm::min(t0, t1);
+        glm::vec3 tbig = glm::max(t0, t1);
+        tNear = std::max(std::max(tsmall.x, tsmall.y), std::max(tsmall.z, tmin));
+        float tFar = std::min(std::min(tbig.x, tbig.y), std::min(tbig.z, tmax));
+        return tNear <= tFar;
+    }
+};
+
+/*
+ * A node with up to four children, sized and aligned to fill exactly one cache line.
+ * Child bounds are stored as 8 bit steps along a grid which spans the node, with a power of two
+ * spacing per axis. They are rounded outwards, so a child's box always contains everything below it.
+ * A child is either another node, or a leaf of count primitives starting at child in the index list.
+*/
+struct alignas(64) BVHNode4 {
+    float origin[3];
+    int8_t exponent[3]; // the grid spacing along each axis is 2^exponent
+    uint8_t numChildren;
+    uint8_t lo[3][4];
+    uint8_t hi[3][4];
+    uint32_t child[4];
+    uint8_t count[4];   // 0 for nodes, the number of primitives for leaves
+    uint32_t padding;
+};
+static_assert(sizeof(BVHNode4) == 64, "BVHNode4 should fill one cache line");
+
+/* Before C++17, std::allocator only aligns to alignof(std::max_align_t), which is less than a cache line */
+template<class T>
+struct CacheLineAllocator {
+    using value_type = T;
+
+    CacheLineAllocator() = default;
+    template<class U> CacheLineAllocator(const CacheLineAllocator<U> &) {}
+
+    T *allocate(size_t count)
+    {
+        // The pointer returned by operator new is kept just below the aligned block
+        char *raw = static_cast<char*>(::operator new(count * sizeof(T) + 64 + sizeof(void*)));
+        uintptr_t aligned = (reinterpret_cast<uintptr_t>(raw) + sizeof(void*) + 63) & ~uintptr_t(63);
+        reinterpret_cast<void**>(aligned)[-1] = raw;
+        return reinterpret_cast<T*>(aligned);
+    }
+
+    void deallocate(T *p, size_t) { ::operator delete(reinterpret_cast<void**>(p)[-1]); }
+
+    template<class U> bool operator==(const CacheLineAllocator<U> &) const { return true; }
+    template<class U> bool operator!=(const CacheLineAllocator<U> &) const { return false; }
+};
+
+/* SIMD_WIDTH rays traced together. Lanes without a ray have tmax below tmin, so they never hit anything. */
+struct alignas(64) RayPacket {
+    float origin[3][SIMD_WIDTH];
+    float direction[3][SIMD_WIDTH];
+    float invDirection[3][SIMD_WIDTH];
+    float tmin[SIMD_WIDTH];
+    float tmax[SIMD_WIDTH];
+
+    void set(uint32_t lane, const glm::vec3 &o, const glm::vec3 &d, float rayTmin, float rayTmax)
+    {
+        for (int a = 0; a < 3; ++a) {
+            origin[a][lane] = o[a];
+            direction[a][lane] = d[a];
+            invDirection[a][lane] = 1.f / ((std::fabs(d[a]) > 1e-20f) ? d[a] : std::copysign(1e-20f, d[a]));
+        }
+        tmin[lane] = rayTmin;
+        tmax[lane] = rayTmax;
+    }
+
+    /* Written out rather than through set, since packets clear their unused lanes at every instance they enter */
+    void clear(uint32_t lane)
+    {
+        for (int a = 0; a < 3; ++a) {
+            origin[a][lane] = 0.f;
+            direction[a][lane] = 1.f;
+            invDirection[a][lane] = 1.f;
+        }
+        tmin[lane] = 0.f;
+        tmax[lane] = -1.f;
+    }
+
+    vbool active() const { return vfloat::load(tmin) <= vfloat::load(tmax); }
+};
+
+/*
+ * A bounding volume hierarchy over a list of primitive bounds. The CPU renderer keeps one per mesh
+ * over its triangles, and one over the instances of the scene.
+ *
+ * Nodes are split with a binned surface area heuristic. Nodes with many primitives are binned across
+ * threads, and the smaller subtrees below them are then built concurrently, one per thread.
+ * The binary tree is finally collapsed into four wide, quantized nodes for traversal.
+*/
+class BVH {
+    public:
+
+    static constexpr uint32_t NUM_BINS = 16;
+    static constexpr uint32_t MAX_LEAF_SIZE = 8;
+    static constexpr uint32_t MAX_SAH_DEPTH = 64;
+    static constexpr uint32_t PARALLEL_THRESHOLD = 4096;
+
+    /* Below MAX_SAH_DEPTH nodes are split at the median, which takes at most 32 more levels */
+    static constexpr uint32_t MAX_DEPTH = MAX_SAH_DEPTH + 32;
+
+    void build(const std::vector<AABB> &primitives)
+    {
+        nodes.clear();
+        nodeBounds.clear();
+        sahCost = 0.f;
+        indices.resize(primitives.size());
+        for (uint32_t i = 0; i < indices.size(); ++i) indices[i] = i;
+        if (primitives.empty()) return;
+
+        std::vector<glm::vec3> centroids(primitives.size());
+        parallelFor(primitives.size(), [&] (uint64_t begin, uint64_t end, uint32_t) {
+            for (uint64_t i = begin; i < end; ++i) centroids[i] = primitives[i].center();
+        }, PARALLEL_THRESHOLD);
+
+        // Split the top of the tree one node at a time, handing off nodes that are small enough as subtrees
+        std::vector<BuildNode> binary(1);
+        binary[0].count = uint32_t(primitives.size());
+        std::vector<BuildTask> subtrees;
+        splitNodes(primitives, centroids, binary, 0, 0, &subtrees);
+
+        std::vector<std::vector<BuildNode>> subtreeNodes(subtrees.size());
+        parallelForStealing(uint32_t(subtrees.size()), [&] (uint32_t s, uint32_t) {
+            subtreeNodes[s].push_back(binary[subtrees[s].node]);
+            splitNodes(primitives, centroids, subtreeNodes[s], 0, subtrees[s].depth, nullptr);
+        });
+
+        // Each subtree's root replaces its placeholder, and the rest of its nodes go at the end
+        for (uint32_t s = 0; s < subtrees.size(); ++s) {
+            const std::vector<BuildNode> &local = subtreeNodes[s];
+            uint32_t base = uint32_t(binary.size()) - 1;
+            auto relocate = [base] (BuildNode node) { if (node.count == 0) node.offset += base; return node; };
+            binary[subtrees[s].node] = relocate(local[0]);
+            for (size_t i = 1; i < local.size(); ++i) binary.push_back(relocate(local[i]));
+        }
+
+        collapse(binary);
+    }
+
+    /*
+     * Updates the bounds of every node for primitives which moved, keeping the tree as it is.
+     * Much faster than a rebuild, but the tree gets worse the further primitives move from where they were built.
+    */
+    void refit(const std::vector<AABB> &primitives)
+    {
+        if (primitives.size() != indices.size()) { build(primitives); return; }
+
+        // Children are always stored after their parents
+        for (size_t n = nodes.size(); n-- > 0;) {
+            BVHNode4 &node = nodes[n];
+            AABB childBounds[4];
+            AABB bounds;
+            for (uint32_t i = 0; i < node.numChildren; ++i) {
+                if (node.count[i] > 0) {
+                    for (uint32_t p = 0; p < node.count[i]; ++p) childBounds[i].extend(primitives[indices[node.child[i] + p]]);
+                }
+                else childBounds[i] = nodeBounds[node.child[i]];
+                bounds.extend(childBounds[i]);
+            }
+            nodeBounds[n] = bounds;
+            quantize(node, bounds, childBounds);
+        }
+        updateCost();
+    }
+
+    bool empty() const { return nodes.empty(); }
+
+    const AABB &bounds() const { return nodeBounds[0]; }
+
+    /* The surface area heuristic cost of traversing the nodes, relative to the root. Grows as refits loosen the tree. */
+    float cost() const { return sahCost; }
+
+    /*
+     * Calls intersect(primitive, tmax) for every primitive in the leaves the ray enters before tmax, nearest
+     * children first. intersect lowers tmax whenever it finds a closer hit, which culls the nodes behind it.
+    */
+    template<class Intersect>
+    void traverse(const glm::vec3 &origin, const glm::vec3 &direction, float tmin, float &tmax, Intersect intersect) const
+    {
+        if (nodes.empty()) return;
+        glm::vec3 invDir;
+        bool negative[3];
+        for (int a = 0; a < 3; ++a) {
+            invDir[a] = 1.f / ((std::fabs(direction[a]) > 1e-20f) ? direction[a] : std::copysign(1e-20f, direction[a]));
+            negative[a] = invDir[a] < 0.f;
+        }
+
+        struct Entry { uint32_t child; uint32_t count; float tNear; };
+        Entry stack[3 * MAX_DEPTH + 1];
+        uint32_t stackSize = 0;
+        stack[stackSize++] = {0, 0, tmin};
+        while (stackSize > 0) {
+            Entry entry = stack[--stackSize];
+            if (entry.tNear > tmax) continue;
+            if (entry.count > 0) {
+                for (uint32_t p = 0; p < entry.count; ++p) intersect(indices[entry.child + p], tmax);
+                continue;
+            }
+
+            // Grid steps are converted to distances along the ray once per axis, rather than once per child
+            const BVHNode4 &node = nodes[entry.child];
+            float stepT[3], originT[3];
+            for (int a = 0; a < 3; ++a) {
+                stepT[a] = exponentScale(node.exponent[a]) * invDir[a];
+                originT[a] = (node.origin[a] - origin[a]) * invDir[a];
+            }
+            Entry hits[4];
+            uint32_t numHits = 0;
+            for (uint32_t i = 0; i < node.numChildren; ++i) {
+                // Entering and leaving planes are picked by the ray's direction, so empty children never pass
+                float tNear = tmin, tFar = tmax;
+                for (int a = 0; a < 3; ++a) {
+                    float t0 = originT[a] + float(negative[a] ? node.hi[a][i] : node.lo[a][i]) * stepT[a];
+                    float t1 = originT[a] + float(negative[a] ? node.lo[a][i] : node.hi[a][i]) * stepT[a];
+                    tNear = std::max(tNear, t0);
+                    tFar = std::min(tFar, t1);
+                }
+                if (tNear > tFar) continue;
+
+                // Keep hits sorted far to near, so the nearest child is popped first
+                uint32_t h = numHits++;
+                while ((h > 0) && (hits[h - 1].tNear < tNear)) { hits[h] = hits[h - 1]; --h; }
+                hits[h] = {node.child[i], node.count[i], tNear};
+            }
+            for (uint32_t h = 0; h < numHits; ++h) stack[stackSize++] = hits[h];
+        }
+    }
+
+    /*
+     * Traverses a packet of rays together, testing every lane against a node's children at once. Calls
+     * intersect(primitive, lanes) for each primitive in the leaves entered by any of the lanes in the mask,
+     * which lowers packet.tmax for the lanes it hits. Lanes are split up by the octant of their direction,
+     * so packets of rays pointing the same way traverse the tree only once.
+    */
+    template<class Intersect>
+    void traversePacket(RayPacket &packet, Intersect intersect) const
+    {
+        if (nodes.empty()) return;
+        uint32_t negative[3];
+        for (int a = 0; a < 3; ++a) negative[a] = (vfloat::load(packet.invDirection[a]) < vfloat(0.f)).bits();
+
+        uint32_t remaining = packet.active().bits();
+        while (remaining) {
+            uint32_t lane = vfloat::lowestLane(remaining);
+            uint32_t lanes = remaining;
+            bool octant[3];
+            for (int a = 0; a < 3; ++a) {
+                octant[a] = (negative[a] >> lane) & 1u;
+                lanes &= octant[a] ? negative[a] : ~negative[a];
+            }
+            remaining &= ~lanes;
+            traverseOctant(packet, lanes, octant, intersect);
+        }
+    }
+
+    std::vector<BVHNode4, CacheLineAllocator<BVHNode4>> nodes;
+    std::vector<uint32_t> indices;
+
+    private:
+
+    /* Binary nodes, used while building. An inner node's children are at offset and offset + 1. */
+    struct BuildNode {
+        AABB bounds;
+        uint32_t offset = 0;
+        uint32_t count = 0;
+    };
+
+    struct BuildTask {
+        uint32_t node;
+        uint32_t depth;
+    };
+
+    struct Bins {
+        AABB bounds[NUM_BINS];
+        uint32_t counts[NUM_BINS] = {};
+    };
+
+    /* Exact bounds of each node, which refitting merges upwards */
+    std::vector<AABB> nodeBounds;
+    float sahCost = 0.f;
+
+    void updateCost()
+    {
+        sahCost = 0.f;
+        float rootArea = nodeBounds.empty() ? 0.f : nodeBounds[0].area();
+        if (rootArea <= 0.f) return;
+        for (auto &b : nodeBounds) sahCost += b.area();
+        sahCost /= rootArea;
+    }
+
+    /* Packet traversal for lanes whose directions share the signs in negative */
+    template<class Intersect>
+    void traverseOctant(RayPacket &packet, uint32_t lanes, const bool negative[3], Intersect intersect) const
+    {
+        vfloat origin[3], invDir[3];
+        for (int a = 0; a < 3; ++a) {
+            origin[a] = vfloat::load(packet.origin[a]);
+            invDir[a] = vfloat::load(packet.invDirection[a]);
+        }
+        const vfloat tmin = vfloat::load(packet.tmin);
+
+        // Each entry keeps the lanes which entered it, and the nearest distance any of them did so at
+        struct Entry { uint32_t child; uint32_t count; uint32_t lanes; float tNear; };
+        Entry stack[3 * MAX_DEPTH + 1];
+        uint32_t stackSize = 0;
+        stack[stackSize++] = {0, 0, lanes, -FLT_MAX};
+        while (stackSize > 0) {
+            Entry entry = stack[--stackSize];
+            vbool entryLanes = vbool::fromBits(entry.lanes);
+            vfloat tmax = vfloat::load(packet.tmax);
+            if (entry.tNear > tmax.reduceMax(entryLanes)) continue;
+            if (entry.count > 0) {
+                for (uint32_t p = 0; p < entry.count; ++p) intersect(indices[entry.child + p], entryLanes);
+                continue;
+            }
+
+            const BVHNode4 &node = nodes[entry.child];
+            vfloat stepT[3], originT[3];
+            for (int a = 0; a < 3; ++a) {
+                stepT[a] = vfloat(exponentScale(node.exponent[a])) * invDir[a];
+                originT[a] = (vfloat(node.origin[a]) - origin[a]) * invDir[a];
+            }
+            Entry hits[4];
+            uint32_t numHits = 0;
+            for (uint32_t i = 0; i < node.numChildren; ++i) {
+                vfloat tNear = tmin, tFar = tmax;
+                for (int a = 0; a < 3; ++a) {
+                    float nearStep = float(negative[a] ? node.hi[a][i] : node.lo[a][i]);
+                    float farStep = float(negative[a] ? node.lo[a][i] : node.hi[a][i]);
+                    tNear = max(tNear, originT[a] + vfloat(nearStep) * stepT[a]);
+                    tFar = min(tFar, originT[a] + vfloat(farStep) * stepT[a]);
+                }
+                vbool hit = (tNear <= tFar) & entryLanes;
+                if (!hit.any()) continue;
+
+                float nearest = tNear.reduceMin(hit);
+                uint32_t h = numHits++;
+                while ((h > 0) && (hits[h - 1].tNear < nearest)) { hits[h] = hits[h - 1]; --h; }
+                hits[h] = {node.child[i], node.count[i], hit.bits(), nearest};
+            }
+            for (uint32_t h = 0; h < numHits; ++h) stack[stackSize++] = hits[h];
+        }
+    }
+
+    static float exponentScale(int8_t exponent)
+    {
+        uint32_t bits = uint32_t(int32_t(exponent) + 127) << 23;
+        float scale;
+        std::memcpy(&scale, &bits, sizeof(float));
+        return scale;
+    }
+
+    /*
+     * Splits nodes depth first, starting from rootID. When subtrees is given, nodes with no more than
+     * PARALLEL_THRESHOLD primitives are left unsplit and recorded there instead.
+    */
+    void splitNodes(const std::vector<AABB> &primitives, const std::vector<glm::vec3> &centroids, std::vector<BuildNode> &binary,
+        uint32_t rootID, uint32_t rootDepth, std::vector<BuildTask> *subtrees)
+    {
+        std::vector<BuildTask> stack = {{rootID, rootDepth}};
+        while (!stack.empty()) {
+            BuildTask task = stack.back();
+            stack.pop_back();
+            uint32_t first = binary[task.node].offset, count = binary[task.node].count;
+            if (subtrees && (count <= PARALLEL_THRESHOLD)) { subtrees->push_back(task); continue; }
+
+            AABB bounds, centroidBounds;
+            computeBounds(primitives, centroids, first, count, bounds, centroidBounds);
+            binary[task.node].bounds = bounds;
+
+            uint32_t middle;
+            if ((count <= 2) || !split(primitives, centroids, first, count, bounds, centroidBounds, task.depth >= MAX_SAH_DEPTH, middle)) continue;
+
+            uint32_t left = uint32_t(binary.size());
+            binary.push_back(BuildNode());
+            binary.push_back(BuildNode());
+            binary[left].offset = first;
+            binary[left].count = middle - first;
+            binary[left + 1].offset = middle;
+            binary[left + 1].count = first + count - middle;
+            binary[task.node].offset = left;
+            binary[task.node].count = 0;
+            stack.push_back({left + 1, task.depth + 1});
+            stack.push_back({left, task.depth + 1});
+        }
+    }
+
+    void computeBounds(const std::vector<AABB> &primitives, const std::vector<glm::vec3> &centroids,
+        uint32_t first, uint32_t count, AABB &bounds, AABB &centroidBounds) const
+    {
+        if (count <= PARALLEL_THRESHOLD) {
+            for (uint32_t i = first; i < first + count; ++i) {
+                bounds.extend(primitives[indices[i]]);
+                centroidBounds.extend(centroids[indices[i]]);
+            }
+            return;
+        }
+        std::vector<std::pair<AABB, AABB>> partial(getNumWorkerThreads());
+        parallelFor(count, [&] (uint64_t begin, uint64_t end, uint32_t t) {
+            for (uint64_t i = first + begin; i < first + end; ++i) {
+                partial[t].first.extend(primitives[indices[i]]);
+                partial[t].second.extend(centroids[indices[i]]);
+            }
+        }, PARALLEL_THRESHOLD);
+        for (auto &p : partial) { bounds.extend(p.first); centroidBounds.extend(p.second); }
+    }
+
+    /*
+     * Partitions a node's primitives along the cheapest binned split. Returns false if a leaf is cheaper.
+     * Deep in the tree nodes are split at the median instead, which bounds the depth of the hierarchy.
+    */
+    bool split(const std::vector<AABB> &primitives, const std::vector<glm::vec3> &centroids, uint32_t first, uint32_t count,
+        const AABB &bounds, const AABB &centroidBounds, bool median, uint32_t &middle)
+    {
+        glm::vec3 extent = centroidBounds.hi - centroidBounds.lo;
+        int axis = (extent.x > extent.y) ? ((extent.x > extent.z) ? 0 : 2) : ((extent.y > extent.z) ? 1 : 2);
+        uint32_t *begin = indices.data() + first, *end = begin + count;
+
+        /* Every centroid is in the same place, so any split is as good as another */
+        if (extent[axis] <= 0.f) {
+            if (count <= MAX_LEAF_SIZE) return false;
+            middle = first + count / 2;
+            return true;
+        }
+
+        float scale = float(NUM_BINS) / extent[axis];
+        float lo = centroidBounds.lo[axis];
+        auto binOf = [&] (uint32_t primitive) {
+            return std::min(uint32_t(std::max((centroids[primitive][axis] - lo) * scale, 0.f)), NUM_BINS - 1);
+        };
+
+        Bins bins;
+        if (count <= PARALLEL_THRESHOLD) {
+            for (uint32_t *i = begin; i != end; ++i) {
+                uint32_t bin = binOf(*i);
+                bins.bounds[bin].extend(primitives[*i]);
+                bins.counts[bin]++;
+            }
+        } else {
+            std::vector<Bins> partial(getNumWorkerThreads());
+            parallelFor(count, [&] (uint64_t b, uint64_t e, uint32_t t) {
+                for (uint64_t i = b; i < e; ++i) {
+                    uint32_t bin = binOf(begin[i]);
+                    partial[t].bounds[bin].extend(primitives[begin[i]]);
+                    partial[t].counts[bin]++;
+                }
+            }, PARALLEL_THRESHOLD);
+            for (auto &p : partial) {
+                for (uint32_t b = 0; b < NUM_BINS; ++b) { bins.bounds[b].extend(p.bounds[b]); bins.counts[b] += p.counts[b]; }
+            }
+        }
+
+        /* Sweep from the right to get the cost of everything right of each split, then from the left */
+        float rightCost[NUM_BINS];
+        AABB accum;
+        uint32_t accumCount = 0;
+        for (uint32_t b = NUM_BINS - 1; b > 0; --b) {
+            accum.extend(bins.bounds[b]);
+            accumCount += bins.counts[b];
+            rightCost[b] = accum.area() * float(accumCount);
+        }
+
+        float bestCost = FLT_MAX;
+        uint32_t bestSplit = 0;
+        accum = AABB();
+        accumCount = 0;
+        for (uint32_t b = 1; b < NUM_BINS; ++b) {
+            accum.extend(bins.bounds[b - 1]);
+            accumCount += bins.counts[b - 1];
+            float cost = accum.area() * float(accumCount) + rightCost[b];
+            if ((accumCount > 0) && (accumCount < count) && (cost < bestCost)) {
+                bestCost = cost;
+                bestSplit = b;
+            }
+        }
+
+        /* Traversing a node costs about as much as one primitive test */
+        float leafCost = bounds.area() * float(count);
+        float splitCost = bounds.area() + bestCost;
+        if (median || (bestSplit == 0) || ((splitCost >= leafCost) && (count <= MAX_LEAF_SIZE))) {
+            if (median && (count <= 2)) return false;
+            if (count <= MAX_LEAF_SIZE) return false;
+            middle = first + count / 2;
+            std::nth_element(begin, begin + count / 2, end, [&] (uint32_t a, uint32_t b) {
+                return centroids[a][axis] < centroids[b][axis];
+            });
+            return true;
+        }
+
+        uint32_t *mid = std::partition(begin, end, [&] (uint32_t primitive) { return binOf(primitive) < bestSplit; });
+        middle = first + uint32_t(mid - begin);
+        return true;
+    }
+
+    /* Turns the binary tree into four wide nodes, by repeatedly opening the child with the largest surface area */
+    void collapse(const std::vector<BuildNode> &binary)
+    {
+        nodes.clear();
+        nodeBounds.clear();
+        nodes.reserve(binary.size() / 2 + 1);
+        nodeBounds.reserve(binary.size() / 2 + 1);
+        nodes.emplace_back();
+        nodeBounds.push_back(binary[0].bounds);
+
+        std::vector<std::pair<uint32_t, uint32_t>> stack = {{0, 0}};
+        while (!stack.empty()) {
+            uint32_t binaryID = stack.back().first, nodeID = stack.back().second;
+            stack.pop_back();
+
+            uint32_t children[4];
+            uint32_t numChildren = 0;
+            if (binary[binaryID].count > 0) children[numChildren++] = binaryID;
+            else {
+                children[numChildren++] = binary[binaryID].offset;
+                children[numChildren++] = binary[binaryID].offset + 1;
+            }
+            while (numChildren < 4) {
+                int largest = -1;
+                float largestArea = -1.f;
+                for (uint32_t i = 0; i < numChildren; ++i) {
+                    if (binary[children[i]].count > 0) continue;
+                    float area = binary[children[i]].bounds.area();
+                    if (area > largestArea) { largestArea = area; largest = int(i); }
+                }
+                if (largest < 0) break;
+                uint32_t opened = children[largest];
+                children[largest] = binary[opened].offset;
+                children[numChildren++] = binary[opened].offset + 1;
+            }
+
+            BVHNode4 node = {};
+            AABB childBounds[4];
+            node.numChildren = uint8_t(numChildren);
+            for (uint32_t i = 0; i < numChildren; ++i) {
+                const BuildNode &child = binary[children[i]];
+                childBounds[i] = child.bounds;
+                if (child.count > 0) {
+                    node.child[i] = child.offset;
+                    node.count[i] = uint8_t(child.count);
+                    continue;
+                }
+                node.child[i] = uint32_t(nodes.size());
+                nodes.emplace_back();
+                nodeBounds.push_back(child.bounds);
+                stack.push_back({children[i], node.child[i]});
+            }
+            quantize(node, nodeBounds[nodeID], childBounds);
+            nodes[nodeID] = node;
+        }
+        updateCost();
+    }
+
+    /* Fits a node's grid to its bounds, then rounds each child's bounds outwards onto that grid */
+    static void quantize(BVHNode4 &node, const AABB &bounds, const AABB *childBounds)
+    {
+        for (int a = 0; a < 3; ++a) {
+            float origin = bounds.empty() ? 0.f : bounds.lo[a];
+            float extent = bounds.empty() ? 0.f : bounds.hi[a] - bounds.lo[a];
+            int exponent = -126;
+            if (extent > 0.f) exponent = std::min(std::max(int(std::ceil(std::log2(extent / 255.f))), -126), 127);
+            while ((exponent < 127) && !bounds.empty() && (origin + 255.f * exponentScale(int8_t(exponent)) < bounds.hi[a])) ++exponent;
+            float scale = exponentScale(int8_t(exponent));
+            node.origin[a] = origin;
+            node.exponent[a] = int8_t(exponent);
+
+            for (uint32_t i = 0; i < node.numChildren; ++i) {
+                if (childBounds[i].empty()) { node.lo[a][i] = 255; node.hi[a][i] = 0; continue; }
+                int lo = std::min(std::max(int(std::floor((childBounds[i].lo[a] - origin) / scale)), 0), 255);
+                int hi = std::min(std::max(int(std::ceil((childBounds[i].hi[a] - origin) / scale)), 0), 255);
+                while ((lo > 0) && (origin + float(lo) * scale > childBounds[i].lo[a])) --lo;
+                while ((hi < 255) && (origin + float(hi) * scale < childBounds[i].hi[a])) ++hi;
+                node.lo[a][i] = uint8_t(lo);
+                node.hi[a][i] = uint8_t(hi);
+            }
+        }
+    }
+};
@@ -0,0 +1,1265 @@
+#include <hostcode/cpu_renderer.h>
+
+#include <algorithm>
+#include <stdexcept>
+#include <glm/gtc/matrix_access.hpp>
+
+// Compiled for the host, these pick up the CUDA stand-ins in devicecode/host_types.h
+#include <devicecode/disney_bsdf.h>
+#include <devicecode/lights.h>
+#include <devicecode/render_data_flags.h>
+
+#include <visii/utilities/ggx_lookup_tables.h>
+#include <visii/utilities/parallel.h>
+
+/* Pixels are traced in square tiles, which worker threads steal from each other */
+static const uint32_t TILE_SIZE = 16;
+
+/* How much worse a refitted top level BVH may get before it is rebuilt */
+static const float TLAS_REBUILD_COST_RATIO = 2.f;
+
+struct HostRay {
+    float3 origin;
+    float3 direction;
+    float tmin = 0.f;
+    float tmax = 1e20f;
+    float time = 0.f;
+};
+
+struct RayPayload {
+    int instanceID = -1;
+    int primitiveID = -1;
+    float2 barycentrics;
+    float tHit = -1.f;
+    glm::mat4 localToWorld;
+};
+
+static vec2 toSpherical(vec3 dir) {
+    dir = normalize(dir);
+    float u = atan(dir.z, dir.x) / (2.0f * 3.1415926535897932384626433832795f) + .5f;
+    float v = asin(dir.y) / 3.1415926535897932384626433832795f + .5f;
+    return vec2(u, (1.0f - v));
+}
+
+static float3 faceNormalForward(const float3 &w_o, const float3 &gn, const float3 &n)
+{
+    float3 new_n = n;
+    if (dot(w_o, new_n) < 0.f) {
+        // prevents differences from geometric and shading normal from creating black artifacts
+        new_n = reflect(-new_n, gn);
+    }
+    if (dot(w_o, new_n) < 0.f) {
+        new_n = -new_n;
+    }
+    return new_n;
+}
+
+/*
+ * The programs of devicecode/path_tracer.cu, reading from the CPU renderer in place of the launch parameters.
+ * Keep the two in sync, so that both backends converge to the same image.
+*/
+struct CPUTracer {
+    CPURenderer &R;
+    const HostLaunchParams &LP;
+
+    // Every path of a frame starts from the same camera, so it is read once rather than once per pixel
+    bool hasCamera;
+    EntityStruct cameraEntity;
+    CameraStruct camera;
+    TransformStruct cameraTransform;
+
+    CPUTracer(CPURenderer &renderer, const HostLaunchParams &launchParams) : R(renderer), LP(launchParams)
+    {
+        hasCamera = loadCamera(cameraEntity, camera, cameraTransform);
+    }
+
+    cudaTextureObject_t textureObject(int32_t textureId) const
+    {
+        if ((textureId < 0) || (textureId >= int32_t(R.textureObjects.size()))) return nullptr;
+        const HostTexture &texture = R.textureObjects[textureId];
+        return texture.texels.empty() ? nullptr : &texture;
+    }
+
+    float3 missColor(const HostRay &ray) const
+    {
+        vec3 rayDir = LP.environmentMapRotation * make_vec3(normalize(ray.direction));
+        if (LP.environmentMapID != -1)
+        {
+            vec2 tc = toSpherical(vec3(rayDir.x, -rayDir.z, rayDir.y));
+            cudaTextureObject_t tex = textureObject(LP.environmentMapID);
+            if (!tex) return make_float3(1.f, 0.f, 1.f);
+
+            float4 texColor = tex2D<float4>(tex, tc.x,tc.y);
+            return make_float3(texColor);
+        }
+
+        float t = 0.5f*(rayDir.z + 1.0f);
+        float3 c = (1.0f - t) * make_float3(pow(vec3(1.0f), vec3(2.2f))) + t * make_float3( pow(vec3(0.5f, 0.7f, 1.0f), vec3(2.2f)) );
+        return c;
+    }
+
+    float domeLightPdf(const float3 &direction) const
+    {
+        if (R.environmentSamplingTableSize.x == 0) return 0.f;
+        vec3 rayDir = LP.environmentMapRotation * make_vec3(normalize(direction));
+        return environmentPdf(R.environmentSamplingTable.data(), R.environmentSamplingTableSize, environmentDirectionToUV(rayDir));
+    }
+
+    /* Finds the closest hit along the ray. Like the closest hit program, the payload is left untouched on a miss. */
+    void traceRay(const HostRay &ray, RayPayload &payload) const
+    {
+        if (R.tlas.empty()) return;
+        float tmax = ray.tmax;
+        R.tlas.traverse(make_vec3(ray.origin), make_vec3(ray.direction), ray.tmin, tmax, [&] (uint32_t instanceID, float &tmax) {
+            intersectInstance(instanceID, ray, tmax, payload);
+        });
+    }
+
+    void intersectInstance(uint32_t instanceID, const HostRay &ray, float &tmax, RayPayload &payload) const
+    {
+        const CPURenderer::InstanceData &instance = R.instances[instanceID];
+        const CPURenderer::MeshData &mesh = R.meshData[instance.instance.meshID];
+        const std::vector<glm::mat4> &keys = instance.instance.keys;
+
+        // Matrices are interpolated linearly between the two keys around the ray's time, as OptiX does
+        glm::mat4 localToWorld = keys[0];
+        glm::mat4 worldToLocal = instance.worldToLocal;
+        if (keys.size() > 1) {
+            uint32_t numSegments = uint32_t(keys.size()) - 1;
+            float t = ray.time * float(numSegments);
+            uint32_t segment = std::min(uint32_t(std::max(t, 0.f)), numSegments - 1);
+            float alpha = t - float(segment);
+            localToWorld = keys[segment] * (1.f - alpha) + keys[segment + 1] * alpha;
+            worldToLocal = glm::inverse(localToWorld);
+        }
+
+        vec3 localOrigin = vec3(worldToLocal * vec4(make_vec3(ray.origin), 1.f));
+        vec3 localDirection = vec3(worldToLocal * vec4(make_vec3(ray.direction), 0.f));
+        mesh.blas.traverse(localOrigin, localDirection, ray.tmin, tmax, [&] (uint32_t primitiveID, float &tmax) {
+            const vec3 A = vec3(mesh.vertices[mesh.indices[primitiveID * 3 + 0]]);
+            const vec3 B = vec3(mesh.vertices[mesh.indices[primitiveID * 3 + 1]]);
+            const vec3 C = vec3(mesh.vertices[mesh.indices[primitiveID * 3 + 2]]);
+
+            // Moller-Trumbore, with u and v weighting B and C like OptiX's triangle barycentrics
+            vec3 e1 = B - A, e2 = C - A;
+            vec3 p = glm::cross(localDirection, e2);
+            float det = glm::dot(e1, p);
+            if (det == 0.f) return;
+            float invDet = 1.f / det;
+            vec3 s = localOrigin - A;
+            float u = glm::dot(s, p) * invDet;
+            if ((u < 0.f) || (u > 1.f)) return;
+            vec3 q = glm::cross(s, e1);
+            float v = glm::dot(localDirection, q) * invDet;
+            if ((v < 0.f) || (u + v > 1.f)) return;
+            float t = glm::dot(e2, q) * invDet;
+            if ((t <= ray.tmin) || (t >= tmax)) return;
+
+            tmax = t;
+            payload.instanceID = int(instanceID);
+            payload.primitiveID = int(primitiveID);
+            payload.barycentrics = make_float2(u, v);
+            payload.tHit = t;
+            payload.localToWorld = localToWorld;
+        });
+    }
+
+    /*
+     * traceRay for up to SIMD_WIDTH rays at once. Static instances are intersected by the whole packet,
+     * moving ones one ray at a time, since every ray sees them at a different time.
+    */
+    void tracePacket(const HostRay *rays, RayPayload *payloads, uint32_t count) const
+    {
+        if (R.tlas.empty()) return;
+        RayPacket packet;
+        for (uint32_t lane = 0; lane < SIMD_WIDTH; ++lane) {
+            if (lane < count) packet.set(lane, make_vec3(rays[lane].origin), make_vec3(rays[lane].direction), rays[lane].tmin, rays[lane].tmax);
+            else packet.clear(lane);
+        }
+
+        R.tlas.traversePacket(packet, [&] (uint32_t instanceID, vbool lanes) {
+            const CPURenderer::InstanceData &instance = R.instances[instanceID];
+            if (instance.instance.keys.size() > 1) {
+                for (uint32_t bits = lanes.bits(); bits; bits &= bits - 1) {
+                    uint32_t lane = vfloat::lowestLane(bits);
+                    intersectInstance(instanceID, rays[lane], packet.tmax[lane], payloads[lane]);
+                }
+                return;
+            }
+
+            // Same transform as intersectInstance, so packets find exactly the hits single rays do
+            RayPacket local;
+            for (uint32_t lane = 0; lane < SIMD_WIDTH; ++lane) {
+                if (!(lanes.bits() & (1u << lane))) { local.clear(lane); continue; }
+                vec3 localOrigin = vec3(instance.worldToLocal * vec4(make_vec3(rays[lane].origin), 1.f));
+                vec3 localDirection = vec3(instance.worldToLocal * vec4(make_vec3(rays[lane].direction), 0.f));
+                local.set(lane, localOrigin, localDirection, rays[lane].tmin, packet.tmax[lane]);
+            }
+
+            const CPURenderer::MeshData &mesh = R.meshData[instance.instance.meshID];
+            mesh.blas.traversePacket(local, [&] (uint32_t primitiveID, vbool lanes) {
+                intersectTrianglePacket(local, lanes, mesh, instanceID, primitiveID, payloads);
+            });
+            for (uint32_t bits = lanes.bits(); bits; bits &= bits - 1) {
+                uint32_t lane = vfloat::lowestLane(bits);
+                packet.tmax[lane] = local.tmax[lane];
+            }
+        });
+    }
+
+    /* The triangle test of intersectInstance, one lane per ray */
+    void intersectTrianglePacket(RayPacket &packet, vbool lanes, const CPURenderer::MeshData &mesh,
+        uint32_t instanceID, uint32_t primitiveID, RayPayload *payloads) const
+    {
+        const vec3 A = vec3(mesh.vertices[mesh.indices[primitiveID * 3 + 0]]);
+        const vec3 B = vec3(mesh.vertices[mesh.indices[primitiveID * 3 + 1]]);
+        const vec3 C = vec3(mesh.vertices[mesh.indices[primitiveID * 3 + 2]]);
+        const vec3 e1 = B - A, e2 = C - A;
+
+        vfloat d[3], s[3];
+        for (int a = 0; a < 3; ++a) {
+            d[a] = vfloat::load(packet.direction[a]);
+            s[a] = vfloat::load(packet.origin[a]) - vfloat(A[a]);
+        }
+        vfloat tmin = vfloat::load(packet.tmin), tmax = vfloat::load(packet.tmax);
+
+        vfloat p[3] = {
+            d[1] * vfloat(e2.z) - vfloat(e2.y) * d[2],
+            d[2] * vfloat(e2.x) - vfloat(e2.z) * d[0],
+            d[0] * vfloat(e2.y) - vfloat(e2.x) * d[1] };
+        vfloat det = vfloat(e1.x) * p[0] + vfloat(e1.y) * p[1] + vfloat(e1.z) * p[2];
+        vfloat invDet = vfloat(1.f) / det;
+        vfloat u = (s[0] * p[0] + s[1] * p[1] + s[2] * p[2]) * invDet;
+        vfloat q[3] = {
+            s[1] * vfloat(e1.z) - vfloat(e1.y) * s[2],
+            s[2] * vfloat(e1.x) - vfloat(e1.z) * s[0],
+            s[0] * vfloat(e1.y) - vfloat(e1.x) * s[1] };
+        vfloat v = (d[0] * q[0] + d[1] * q[1] + d[2] * q[2]) * invDet;
+        vfloat t = (vfloat(e2.x) * q[0] + vfloat(e2.y) * q[1] + vfloat(e2.z) * q[2]) * invDet;
+
+        // Written as the misses of the single ray test, so that NaNs are treated the same way
+        vbool miss = (det == vfloat(0.f)) | (u < vfloat(0.f)) | (u > vfloat(1.f)) | (v < vfloat(0.f)) |
+            ((u + v) > vfloat(1.f)) | (t <= tmin) | (t >= tmax);
+        vbool hit = andNot(miss, lanes);
+        if (!hit.any()) return;
+
+        alignas(64) float tLanes[SIMD_WIDTH], uLanes[SIMD_WIDTH], vLanes[SIMD_WIDTH];
+        t.store(tLanes);
+        u.store(uLanes);
+        v.store(vLanes);
+        const glm::mat4 &localToWorld = R.instances[instanceID].instance.keys[0];
+        for (uint32_t bits = hit.bits(); bits; bits &= bits - 1) {
+            uint32_t lane = vfloat::lowestLane(bits);
+            packet.tmax[lane] = tLanes[lane];
+            RayPayload &payload = payloads[lane];
+            payload.instanceID = int(instanceID);
+            payload.primitiveID = int(primitiveID);
+            payload.barycentrics = make_float2(uLanes[lane], vLanes[lane]);
+            payload.tHit = tLanes[lane];
+            payload.localToWorld = localToWorld;
+        }
+    }
+
+    /*
+     * traceRay for a batch of rays. Rays are sorted by the octant of their direction before being
+     * split into packets, so that rays in a packet enter boxes through the same planes.
+    */
+    void traceStream(const HostRay *rays, RayPayload *payloads, uint32_t count) const
+    {
+        auto octantOf = [&] (const HostRay &ray) {
+            return uint32_t(ray.direction.x < 0.f) | (uint32_t(ray.direction.y < 0.f) << 1) | (uint32_t(ray.direction.z < 0.f) << 2);
+        };
+        uint32_t offsets[9] = {};
+        for (uint32_t i = 0; i < count; ++i) offsets[octantOf(rays[i]) + 1]++;
+        for (uint32_t o = 0; o < 8; ++o) offsets[o + 1] += offsets[o];
+        std::vector<uint32_t> order(count);
+        for (uint32_t i = 0; i < count; ++i) order[offsets[octantOf(rays[i])]++] = i;
+
+        HostRay packetRays[SIMD_WIDTH];
+        RayPayload packetPayloads[SIMD_WIDTH];
+        for (uint32_t first = 0; first < count; first += SIMD_WIDTH) {
+            uint32_t packetSize = std::min(SIMD_WIDTH, count - first);
+            for (uint32_t lane = 0; lane < packetSize; ++lane) {
+                packetRays[lane] = rays[order[first + lane]];
+                packetPayloads[lane] = payloads[order[first + lane]];
+            }
+            tracePacket(packetRays, packetPayloads, packetSize);
+            for (uint32_t lane = 0; lane < packetSize; ++lane) payloads[order[first + lane]] = packetPayloads[lane];
+        }
+    }
+
+    bool loadCamera(EntityStruct &cameraEntity, CameraStruct &camera, TransformStruct &transform) const
+    {
+        cameraEntity = LP.cameraEntity;
+        if (!cameraEntity.initialized) return false;
+        if ((cameraEntity.transform_id < 0) || (cameraEntity.transform_id >= int32_t(R.transforms.size()))) return false;
+        if ((cameraEntity.camera_id < 0) || (cameraEntity.camera_id >= int32_t(R.cameras.size()))) return false;
+        camera = R.cameras[cameraEntity.camera_id];
+        transform = R.transforms[cameraEntity.transform_id];
+        return true;
+    }
+
+    vec4 sampleTexture(int32_t textureId, vec2 texCoord, vec4 defaultValue) const
+    {
+        cudaTextureObject_t tex = textureObject(textureId);
+        if (!tex) return defaultValue;
+        return make_vec4(tex2D<float4>(tex, texCoord.x, texCoord.y));
+    }
+
+    void loadMeshTriIndices(int meshID, int primitiveID, int3 &triIndices) const
+    {
+        const std::vector<uint32_t> &indices = R.meshData[meshID].indices;
+        triIndices = make_int3(int(indices[primitiveID * 3 + 0]), int(indices[primitiveID * 3 + 1]), int(indices[primitiveID * 3 + 2]));
+    }
+
+    void loadMeshVertexData(int meshID, int3 indices, float2 barycentrics, float3 &position, float3 &geometricNormal, float3 &edge1, float3 &edge2) const
+    {
+        const std::vector<vec4> &vertices = R.meshData[meshID].vertices;
+        const float3 A = make_float3(vertices[indices.x]);
+        const float3 B = make_float3(vertices[indices.y]);
+        const float3 C = make_float3(vertices[indices.z]);
+        edge1 = B - A;
+        edge2 = C - A;
+        position = A * (1.f - (barycentrics.x + barycentrics.y)) + B * barycentrics.x + C * barycentrics.y;
+        geometricNormal = normalize(cross(B-A,C-A));
+    }
+
+    void loadMeshUVData(int meshID, int3 indices, float2 barycentrics, float2 &uv, float2 &edge1, float2 &edge2) const
+    {
+        const std::vector<vec2> &texCoords = R.meshData[meshID].texCoords;
+        const float2 A = make_float2(texCoords[indices.x]);
+        const float2 B = make_float2(texCoords[indices.y]);
+        const float2 C = make_float2(texCoords[indices.z]);
+        edge1 = B - A;
+        edge2 = C - A;
+        uv = A * (1.f - (barycentrics.x + barycentrics.y)) + B * barycentrics.x + C * barycentrics.y;
+    }
+
+    void loadMeshNormalData(int meshID, int3 indices, float2 barycentrics, float2 uv, float3 &normal) const
+    {
+        const std::vector<vec4> &normals = R.meshData[meshID].normals;
+        const float3 A = make_float3(normals[indices.x]);
+        const float3 B = make_float3(normals[indices.y]);
+        const float3 C = make_float3(normals[indices.z]);
+        normal = A * (1.f - (barycentrics.x + barycentrics.y)) + B * barycentrics.x + C * barycentrics.y;
+    }
+
+    void loadDisneyMaterial(const MaterialStruct &p, vec2 uv, DisneyMaterial &mat, float roughnessMinimum) const
+    {
+        mat.base_color = make_float3(sampleTexture(p.base_color_texture_id, uv, vec4(p.base_color.r, p.base_color.g, p.base_color.b, 1.f)));
+        mat.metallic = sampleTexture(p.metallic_texture_id, uv, vec4(p.metallic))[p.metallic_texture_channel];
+        mat.specular = sampleTexture(p.specular_texture_id, uv, vec4(p.specular))[p.specular_texture_channel];
+        mat.roughness = max(max(sampleTexture(p.roughness_texture_id, uv, vec4(p.roughness))[p.roughness_texture_channel], MIN_ROUGHNESS), roughnessMinimum);
+        mat.specular_tint = sampleTexture(p.specular_tint_texture_id, uv, vec4(p.specular_tint))[p.specular_tint_texture_channel];
+        mat.anisotropy = sampleTexture(p.anisotropic_texture_id, uv, vec4(p.anisotropic))[p.anisotropic_texture_channel];
+        mat.sheen = sampleTexture(p.sheen_texture_id, uv, vec4(p.sheen))[p.sheen_texture_channel];
+        mat.sheen_tint = sampleTexture(p.sheen_tint_texture_id, uv, vec4(p.sheen_tint))[p.sheen_tint_texture_channel];
+        mat.clearcoat = sampleTexture(p.clearcoat_texture_id, uv, vec4(p.clearcoat))[p.clearcoat_texture_channel];
+        float clearcoat_roughness = max(sampleTexture(p.clearcoat_roughness_texture_id, uv, vec4(p.clearcoat_roughness))[p.clearcoat_roughness_texture_channel], roughnessMinimum);
+        mat.clearcoat_gloss = 1.0 - clearcoat_roughness * clearcoat_roughness;
+        mat.ior = sampleTexture(p.ior_texture_id, uv, vec4(p.ior))[p.ior_texture_channel];
+        mat.specular_transmission = sampleTexture(p.transmission_texture_id, uv, vec4(p.transmission))[p.transmission_texture_channel];
+        mat.flatness = sampleTexture(p.subsurface_texture_id, uv, vec4(p.subsurface))[p.subsurface_texture_channel];
+        mat.transmission_roughness = max(max(sampleTexture(p.transmission_roughness_texture_id, uv, vec4(p.transmission_roughness))[p.transmission_roughness_texture_channel], MIN_ROUGHNESS), roughnessMinimum);
+    }
+
+    HostRay generateRay(const CameraStruct &camera, const TransformStruct &transform, ivec2 pixelID, ivec2 frameSize, LCGRand &rng) const
+    {
+        /* Generate camera rays */
+        mat4 projinv = camera.projinv;
+        mat4 viewinv = transform.localToWorld;
+        vec2 aa = vec2(lcg_randomf(rng),lcg_randomf(rng)) - vec2(.5f,.5f);
+        vec2 inUV = (vec2(pixelID.x, pixelID.y) + aa) / vec2(frameSize);
+        vec3 right = normalize(vec3(glm::column(viewinv, 0)));
+        vec3 up = normalize(vec3(glm::column(viewinv, 1)));
+        vec3 origin = vec3(glm::column(viewinv, 3));
+
+        float cameraLensRadius = camera.apertureDiameter;
+
+        vec3 p(0.f);
+        if (cameraLensRadius > 0.0) {
+            do {
+                p = 2.0f*vec3(lcg_randomf(rng),lcg_randomf(rng),0.f) - vec3(1.f,1.f,0.f);
+            } while (dot(p,p) >= 1.0f);
+        }
+
+        vec3 rd = cameraLensRadius * p;
+        vec3 lens_offset = (right * rd.x) / float(frameSize.x) + (up * rd.y) / float(frameSize.y);
+
+        origin = origin + lens_offset;
+        vec2 dir = inUV * 2.f - 1.f; dir.y *= -1.f;
+        vec4 t = (projinv * vec4(dir.x, dir.y, -1.f, 1.f));
+        vec3 target = vec3(t) / float(t.w);
+        vec3 direction = normalize(vec3(viewinv * vec4(target, 0.f))) * camera.focalDistance;
+        direction = normalize(direction - lens_offset);
+
+        HostRay ray;
+        ray.tmin = .001f;
+        ray.tmax = 1e20f;
+        ray.origin = make_float3(origin);
+        ray.direction = make_float3(direction);
+        return ray;
+    }
+
+    void saveRenderData(float3 &renderData, int bounce, float depth, float3 w_p, float3 w_n, int entity_id) const
+    {
+        if (LP.renderDataMode == RenderDataFlags::NONE) return;
+        if (uint32_t(bounce) != LP.renderDataBounce) return;
+
+        if (LP.renderDataMode == RenderDataFlags::DEPTH) {
+            renderData = make_float3(depth);
+        }
+        else if (LP.renderDataMode == RenderDataFlags::POSITION) {
+            renderData = w_p;
+        }
+        else if (LP.renderDataMode == RenderDataFlags::NORMAL) {
+            renderData = w_n;
+        }
+        else if (LP.renderDataMode == RenderDataFlags::ENTITY_ID) {
+            renderData = make_float3(float(entity_id));
+        }
+    }
+
+    /*
+     * A path between the rays it traces. The shading of rayGen in path_tracer.cu is split at each of them, so that the
+     * paths of a tile can trace their camera rays, then their shadow rays, then their bounce rays, and so on, each as
+     * one stream.
+    */
+    struct PathState {
+        enum Stage {
+            SKIP,           // ray continues past a hit which is invisible to camera rays
+            BOUNCE,         // the shadow rays and ray, the next bounce, are traced before continuing
+            LAST_SHADOWS,   // the path ends once its shadow rays are traced
+            DONE
+        };
+
+        ivec2 pixelID;
+        LCGRand rng;
+        HostRay ray;
+        RayPayload payload;
+        Stage stage = DONE;
+
+        int bounce = 0;
+        int visibilitySkips = 0;
+        float3 primaryAlbedo = make_float3(0.f);
+        float3 primaryNormal = make_float3(0.f);
+        float3 renderData = make_float3(FLT_MAX); // every render data mode starts out as "nothing was hit"
+        float3 directIllum = make_float3(0.f);
+        float3 illum = make_float3(0.f);
+        float3 path_throughput = make_float3(1.f);
+
+        // What the last hit sampled, for weighting a bounce ray which hits the sampled light as well
+        float3 irradiance;
+        float3 bsdf;
+        float bsdf_pdf;
+        float light_pdf;
+        float light_selection_pdf;
+        int sampledLightID;
+        int lightMeshID;
+        LightStruct light_light;
+
+        // Shadow rays towards the sampled light and the dome light, with what each adds if unoccluded. The BSDF is only
+        // evaluated for the rays which get through, as when they were traced on the spot.
+        bool traceLightShadow = false;
+        bool traceDomeShadow = false;
+        HostRay lightShadowRay;
+        HostRay domeShadowRay;
+        float3 lightShadowLi;
+        float lightShadowCos;
+        float domeShadowWeight;
+        float domeShadowPdf;
+        DisneyMaterial mat;
+        float3 n_l, w_o, v_x, v_y;
+    };
+
+    /*
+     * Generates the camera ray of a pixel into a newly constructed state. Returns false, after writing noise, if there
+     * is no camera to trace from.
+    */
+    bool beginPath(ivec2 pixelID, PathState &state) const
+    {
+        auto fbOfs = pixelID.x+LP.frameSize.x* ((LP.frameSize.y - 1) -  pixelID.y);
+        LCGRand rng = get_rng(int(LP.frameID), make_uint2(pixelID.x, pixelID.y), make_uint2(LP.frameSize.x, LP.frameSize.y));
+
+        // If no camera is in use, just display some random noise...
+        if (!hasCamera) {
+            R.frameBuffer[fbOfs] = vec4(lcg_randomf(rng), lcg_randomf(rng), lcg_randomf(rng), 1.f);
+            return false;
+        }
+
+        // Trace an initial ray through the scene
+        state.pixelID = pixelID;
+        state.ray = generateRay(camera, cameraTransform, pixelID, LP.frameSize, rng);
+        state.ray.time = lcg_randomf(rng);
+        state.rng = rng;
+        state.payload.tHit = -1.f;
+        return true;
+    }
+
+    /*
+     * Shades the paths of a tile, whose camera rays were traced into their payloads, and writes their pixels. Paths
+     * advance together one traced ray at a time, so that their shadow rays and bounce rays are traced as streams.
+    */
+    void tracePaths(PathState *states, uint32_t count)
+    {
+        for (uint32_t i = 0; i < count; ++i) {
+            PathState &state = states[i];
+            // If ray misses
+            if (state.payload.tHit <= 0.f) {
+                state.illum = missColor(state.ray) * LP.domeLightIntensity;
+                state.primaryNormal = make_float3(0.f, 0.f, 1.f);
+                state.primaryAlbedo = state.illum;
+                state.directIllum = state.illum;
+                state.stage = PathState::DONE;
+            }
+            // If we hit something, shade each hit point on a path using NEE with MIS
+            else shadeHit(state);
+        }
+
+        std::vector<HostRay> rays(count * 2);
+        std::vector<RayPayload> payloads(count * 2);
+        std::vector<uint32_t> owners(count * 2);
+        while (true) {
+            // Shadow rays of every path, towards both the sampled light and the dome light
+            uint32_t numShadowRays = 0;
+            for (uint32_t i = 0; i < count; ++i) {
+                PathState &state = states[i];
+                if ((state.stage != PathState::BOUNCE) && (state.stage != PathState::LAST_SHADOWS)) continue;
+                if (state.traceLightShadow) {
+                    rays[numShadowRays] = state.lightShadowRay;
+                    payloads[numShadowRays] = RayPayload();
+                    owners[numShadowRays++] = i * 2;
+                }
+                if (state.traceDomeShadow) {
+                    rays[numShadowRays] = state.domeShadowRay;
+                    payloads[numShadowRays] = RayPayload();
+                    owners[numShadowRays++] = i * 2 + 1;
+                }
+            }
+            traceStream(rays.data(), payloads.data(), numShadowRays);
+            // The sampled light counts before the dome light, as when each shadow ray was traced in turn
+            for (uint32_t r = 0; r < numShadowRays; ++r) {
+                PathState &state = states[owners[r] / 2];
+                if (owners[r] % 2 == 0) {
+                    if (payloads[r].instanceID == -1) continue;
+                    int entityID = int(R.instances[payloads[r].instanceID].instance.entityID);
+                    bool visible = ((entityID == state.sampledLightID) || (entityID == -1));
+                    if (visible) {
+                        float3 bsdf = disney_brdf(state.mat, state.n_l, state.w_o, state.lightShadowRay.direction, state.v_x, state.v_y, &R.GGX_E_LOOKUP, &R.GGX_E_AVG_LOOKUP);
+                        state.irradiance = state.irradiance + (bsdf * state.lightShadowLi * state.lightShadowCos);
+                    }
+                }
+                else if (payloads[r].instanceID == -1) {
+                    // disney_brdf already includes the cosine term
+                    const HostRay &ray = state.domeShadowRay;
+                    float3 bsdf = disney_brdf(state.mat, state.n_l, state.w_o, ray.direction, state.v_x, state.v_y, &R.GGX_E_LOOKUP, &R.GGX_E_AVG_LOOKUP);
+                    float3 Li = missColor(ray) * LP.domeLightIntensity * state.domeShadowWeight / state.domeShadowPdf;
+                    state.irradiance = state.irradiance + (bsdf * Li);
+                }
+            }
+
+            // Then the rays continuing each path
+            uint32_t numRays = 0;
+            for (uint32_t i = 0; i < count; ++i) {
+                PathState &state = states[i];
+                state.traceLightShadow = state.traceDomeShadow = false;
+                if (state.stage == PathState::LAST_SHADOWS) {
+                    // The path ends here, but keep the light sampled above
+                    state.illum = state.illum + state.path_throughput * state.irradiance;
+                    state.stage = PathState::DONE;
+                }
+                if ((state.stage != PathState::SKIP) && (state.stage != PathState::BOUNCE)) continue;
+                rays[numRays] = state.ray;
+                payloads[numRays] = state.payload;
+                owners[numRays++] = i;
+            }
+            if (numRays == 0) break;
+            traceStream(rays.data(), payloads.data(), numRays);
+            for (uint32_t r = 0; r < numRays; ++r) {
+                PathState &state = states[owners[r]];
+                state.payload = payloads[r];
+                if (state.stage == PathState::SKIP) continueAfterSkip(state);
+                else continueAfterBounce(state);
+            }
+        }
+
+        for (uint32_t i = 0; i < count; ++i) finishPath(states[i]);
+    }
+
+    /* Shades the hit in the path's payload, leaving the rays to trace next in the path */
+    void shadeHit(PathState &state)
+    {
+        LCGRand &rng = state.rng;
+        HostRay &ray = state.ray;
+        RayPayload &payload = state.payload;
+        int bounce = state.bounce;
+        float roughnessMinimum = 0.f;
+        DisneyMaterial mat;
+
+        // Load common position, vectors, and material data used for shading...
+        const int entityID = int(R.instances[payload.instanceID].instance.entityID);
+        EntityStruct entity = R.entities[entityID];
+
+        // Skip forward if the hit object is invisible for this ray type
+        if ((bounce == 0) && ((entity.visibilityFlags & ENTITY_VISIBILITY_CAMERA_RAYS) == 0)) {
+            ray.origin = ray.origin + ray.direction * (payload.tHit + EPSILON);
+            payload.tHit = -1.f;
+            ray.time = lcg_randomf(rng);
+            state.visibilitySkips++;
+            state.stage = (state.visibilitySkips > 10) ? PathState::DONE : PathState::SKIP; // avoid locking up.
+            return;
+        }
+
+        MaterialStruct entityMaterial; LightStruct entityLight;
+        if (entity.material_id >= 0 && entity.material_id < int32_t(R.materials.size())) {
+            entityMaterial = R.materials[entity.material_id];
+        }
+
+        const float3 w_o = -ray.direction;
+        float3 hit_p = ray.origin + payload.tHit * ray.direction;
+        float3 p, v_x, v_y, v_z, v_gz, p_e1, p_e2; float2 uv, uv_e1, uv_e2; int3 indices;
+        bool shouldNormalFaceForward = (entityMaterial.transmission == 0.f);
+
+        loadMeshTriIndices(entity.mesh_id, payload.primitiveID, indices);
+        loadMeshVertexData(entity.mesh_id, indices, payload.barycentrics, p, v_gz, p_e1, p_e2);
+        loadMeshUVData(entity.mesh_id, indices, payload.barycentrics, uv, uv_e1, uv_e2);
+        loadMeshNormalData(entity.mesh_id, indices, payload.barycentrics, uv, v_z);
+        loadDisneyMaterial(entityMaterial, make_vec2(uv), mat, roughnessMinimum);
+
+        glm::mat4 xfm = payload.localToWorld;
+        glm::mat3 nxfm = transpose(glm::inverse(glm::mat3(xfm)));
+
+        // If the material has a normal map, load it.
+        float f = 1.0f / (uv_e1.x * uv_e2.y - uv_e2.x * uv_e1.y);
+        vec3 tangent;
+        tangent.x = f * (uv_e2.y * p_e1.x - uv_e1.y * p_e2.x);
+        tangent.y = f * (uv_e2.y * p_e1.y - uv_e1.y * p_e2.y);
+        tangent.z = f * (uv_e2.y * p_e1.z - uv_e1.y * p_e2.z);
+        tangent = normalize(tangent);
+        v_z = normalize(v_z);
+
+        // Transform data into world space
+        p = make_float3(xfm * make_vec4(p, 1.0f));
+        hit_p = p;
+        v_gz = make_float3(normalize(nxfm * make_vec3(v_gz)));
+        v_z = make_float3(normalize(nxfm * make_vec3(v_z)));
+        v_x = make_float3(normalize(nxfm * tangent));
+        v_y = cross(v_z, v_x);
+        v_x = cross(v_y, v_z);
+
+        if (
+            all(lessThan(abs(make_vec3(v_x)), vec3(EPSILON))) ||
+            all(lessThan(abs(make_vec3(v_y)), vec3(EPSILON))) ||
+            any(isnan(make_vec3(v_x))) ||
+            any(isnan(make_vec3(v_y)))
+        ) {
+            ortho_basis(v_x, v_y, v_z);
+        }
+
+        glm::mat3 tbn;
+        tbn = glm::column(tbn, 0, make_vec3(v_x) );
+        tbn = glm::column(tbn, 1, make_vec3(v_y) );
+        tbn = glm::column(tbn, 2, make_vec3(v_z) );
+
+        float3 dN = make_float3(sampleTexture(entityMaterial.normal_map_texture_id, make_vec2(uv), vec4(0.5f, .5f, 1.f, 0.f)));
+        dN = (dN * make_float3(2.0f)) - make_float3(1.f);
+
+        v_z = make_float3(normalize(tbn * normalize(make_vec3(dN))) );
+
+        if (shouldNormalFaceForward) {
+            v_z = faceNormalForward(w_o, v_gz, v_z);
+        }
+
+        // For segmentations, metadata extraction for applications like denoising or ML training
+        saveRenderData(state.renderData, bounce, payload.tHit, hit_p, v_z, entityID);
+
+        // If this is the first hit, keep track of primary albedo and normal for denoising.
+        if (bounce == 0) {
+            state.primaryNormal = v_z;
+            state.primaryAlbedo = mat.base_color;
+        }
+
+        // If the entity we hit is a light, terminate the path.
+        // First hits are colored by the light. All other light hits are handled by NEE/MIS
+        if (entity.light_id >= 0 && entity.light_id < int32_t(R.lights.size())) {
+            if (bounce == 0)
+            {
+                entityLight = R.lights[entity.light_id];
+                float3 light_emission;
+                if (entityLight.color_texture_id == -1) light_emission = make_float3(entityLight.r, entityLight.g, entityLight.b) * entityLight.intensity;
+                else light_emission = make_float3(sampleTexture(entityLight.color_texture_id, make_vec2(uv), vec4(entityLight.r, entityLight.g, entityLight.b, 1.f)));
+                state.illum = light_emission;
+                state.directIllum = state.illum;
+            }
+            state.stage = PathState::DONE;
+            return;
+        }
+
+        // Sample a light source
+        int sampledLightID = -1;
+        int numLights = int(R.lightEntities.size());
+        float light_pdf = 0.f;
+        float light_selection_pdf = 1.f;
+        state.irradiance = make_float3(0.f);
+
+        EntityStruct light_entity;
+        LightStruct light_light;
+
+        float3 n_l = v_z;
+
+        // first, sample the light source by importance sampling the light
+        do {
+            if (numLights == 0) break;
+
+            // Lights which are brighter, larger, closer and facing this point are picked more often
+            uint32_t random_id = sampleLightBVH(R.lightBVH.nodes.data(), uint32_t(numLights), make_vec3(hit_p), make_vec3(n_l),
+                lcg_randomf(rng), light_selection_pdf);
+            if (light_selection_pdf <= 0.f) break;
+            sampledLightID = int(R.lightEntities[random_id]);
+            light_entity = R.entities[sampledLightID];
+
+            // shouldn't happen, but just in case...
+            if ((light_entity.light_id < 0) || (light_entity.light_id >= int32_t(R.lights.size()))) break;
+            if ((light_entity.transform_id < 0) || (light_entity.transform_id >= int32_t(R.transforms.size()))) break;
+
+            light_light = R.lights[light_entity.light_id];
+            TransformStruct transform = R.transforms[light_entity.transform_id];
+            MeshStruct mesh;
+
+            bool is_area_light = false;
+            if ((light_entity.mesh_id >= 0) && (light_entity.mesh_id < int32_t(R.meshes.size()))
+                && (light_entity.mesh_id < int32_t(R.meshData.size())) && !R.meshData[light_entity.mesh_id].indices.empty()) {
+                mesh = R.meshes[light_entity.mesh_id];
+                is_area_light = true;
+            };
+
+            if (!is_area_light) break;
+
+            const CPURenderer::MeshData &lightMesh = R.meshData[light_entity.mesh_id];
+            uint32_t numTris = uint32_t(lightMesh.indices.size() / 3);
+            if (lightMesh.triangleSamplingTable.size() != numTris) break;
+            float tri_pdf;
+            uint32_t random_tri_id = sampleAliasTable(lightMesh.triangleSamplingTable.data(), numTris, lcg_randomf(rng), tri_pdf);
+            ivec3 triIndex = ivec3(lightMesh.indices[random_tri_id * 3 + 0], lightMesh.indices[random_tri_id * 3 + 1], lightMesh.indices[random_tri_id * 3 + 2]);
+
+            // Sample the light to compute an incident light ray to this point
+            {
+                vec3 dir;
+                vec2 uv;
+                vec3 pos = vec3(hit_p.x, hit_p.y, hit_p.z);
+                vec3 v1 = vec3(transform.localToWorld * lightMesh.vertices[triIndex.x]);
+                vec3 v2 = vec3(transform.localToWorld * lightMesh.vertices[triIndex.y]);
+                vec3 v3 = vec3(transform.localToWorld * lightMesh.vertices[triIndex.z]);
+                vec2 uv1 = lightMesh.texCoords[triIndex.x];
+                vec2 uv2 = lightMesh.texCoords[triIndex.y];
+                vec2 uv3 = lightMesh.texCoords[triIndex.z];
+                vec3 N = normalize(cross( normalize(v2 - v1), normalize(v3 - v1)));
+                sampleTriangle(pos, N, v1, v2, v3, uv1, uv2, uv3, lcg_randomf(rng), lcg_randomf(rng), dir, light_pdf, uv);
+                vec3 normal = glm::vec3(n_l.x, n_l.y, n_l.z);
+                float dotNWi = fabs(dot(dir, normal)); // for now, making all lights double sided.
+                light_pdf = abs(light_pdf);
+                // Triangles too small or too far away to be worth sampling are skipped. Otherwise, the density
+                // covers the whole light, since triangles are picked in proportion to their area.
+                light_pdf = (light_pdf > EPSILON) ? light_pdf * tri_pdf : 0.f;
+
+                float4 default_light_emission = make_float4(light_light.r, light_light.g, light_light.b, 0.f);
+                float3 lightEmission = make_float3(sampleTexture(light_light.color_texture_id, uv, make_vec4(default_light_emission))) * light_light.intensity;
+
+                if ((light_pdf > 0.f) && (dotNWi > EPSILON)) {
+                    float3 light_dir = make_float3(dir.x, dir.y, dir.z);
+                    light_dir = normalize(light_dir);
+                    float bsdf_pdf = disney_pdf(mat, n_l, w_o, light_dir, v_x, v_y);
+                    if (bsdf_pdf > EPSILON) {
+                        HostRay &ray = state.lightShadowRay;
+                        ray.tmin = EPSILON * 10.f;
+                        ray.tmax = 1e20f;
+                        ray.origin = hit_p;
+                        ray.direction = light_dir;
+                        ray.time = lcg_randomf(rng);
+                        float w = power_heuristic(1.f, light_pdf, 1.f, bsdf_pdf);
+                        state.lightShadowLi = lightEmission * w / (light_pdf * light_selection_pdf);
+                        state.lightShadowCos = fabs(dotNWi);
+                        state.traceLightShadow = true;
+                    }
+                }
+            }
+        } while (false);
+        state.light_pdf = light_pdf;
+        state.light_selection_pdf = light_selection_pdf;
+        state.sampledLightID = sampledLightID;
+        state.lightMeshID = light_entity.mesh_id;
+        state.light_light = light_light;
+
+        // Then sample the dome light, in proportion to the brightness of its texture
+        if ((R.environmentSamplingTableSize.x > 0) && (LP.domeLightIntensity > 0.f)) {
+            float dome_pdf;
+            vec2 uv = sampleEnvironment(R.environmentSamplingTable.data(), R.environmentSamplingTableSize,
+                lcg_randomf(rng), lcg_randomf(rng), lcg_randomf(rng), lcg_randomf(rng), dome_pdf);
+            vec3 dir = glm::inverse(LP.environmentMapRotation) * environmentUVToDirection(uv);
+            float3 light_dir = normalize(make_float3(dir.x, dir.y, dir.z));
+            float dotNWi = fabs(dot(light_dir, n_l));
+            float bsdf_pdf = (dome_pdf > 0.f) ? disney_pdf(mat, n_l, w_o, light_dir, v_x, v_y) : 0.f;
+            if ((bsdf_pdf > EPSILON) && (dotNWi > EPSILON)) {
+                HostRay &ray = state.domeShadowRay;
+                ray.tmin = EPSILON * 10.f;
+                ray.tmax = 1e20f;
+                ray.origin = hit_p;
+                ray.direction = light_dir;
+                ray.time = lcg_randomf(rng);
+                state.domeShadowWeight = power_heuristic(1.f, dome_pdf, 1.f, bsdf_pdf);
+                state.domeShadowPdf = dome_pdf;
+                state.traceDomeShadow = true;
+            }
+        }
+        if (state.traceLightShadow || state.traceDomeShadow) {
+            state.mat = mat;
+            state.n_l = n_l;
+            state.w_o = w_o;
+            state.v_x = v_x;
+            state.v_y = v_y;
+        }
+
+        // next, sample a light source by importance sampling the BDRF
+        float3 w_i;
+        float bsdf_pdf;
+        bool sampledSpecular;
+        float3 bsdf = sample_disney_brdf(mat, v_z, w_o, v_x, v_y, rng, w_i, bsdf_pdf, sampledSpecular, &R.GGX_E_LOOKUP, &R.GGX_E_AVG_LOOKUP);
+        if (bsdf_pdf < EPSILON || all_zero(bsdf)) {
+            state.stage = PathState::LAST_SHADOWS;
+            return;
+        }
+
+        // trace the next ray along that sampled BRDF direction
+        ray.origin = hit_p;
+        ray.direction = w_i;
+        ray.tmin = EPSILON * 100.f;
+        payload.tHit = -1.f;
+        ray.time = lcg_randomf(rng);
+
+        state.bsdf = bsdf;
+        state.bsdf_pdf = bsdf_pdf;
+        state.stage = PathState::BOUNCE;
+    }
+
+    /* Shades the next hit of the path, if it has bounces left */
+    void continuePath(PathState &state)
+    {
+        if (uint32_t(state.bounce) < LP.maxBounceDepth) shadeHit(state);
+        else state.stage = PathState::DONE;
+    }
+
+    void continueAfterSkip(PathState &state)
+    {
+        // If ray misses
+        if (state.payload.tHit <= 0.f) {
+            state.illum = missColor(state.ray) * LP.domeLightIntensity;
+            state.primaryNormal = make_float3(0.f, 0.f, 1.f);
+            state.primaryAlbedo = state.illum;
+            state.directIllum = state.illum;
+        }
+        continuePath(state);
+    }
+
+    /* Adds what the bounce ray found to the path, once the hit it left from has had its shadow rays traced */
+    void continueAfterBounce(PathState &state)
+    {
+        HostRay &ray = state.ray;
+        RayPayload &payload = state.payload;
+        float3 &irradiance = state.irradiance;
+
+        if (state.light_pdf > 0.f)
+        {
+            // if by sampling the brdf we also hit the light source...
+            if (payload.instanceID == -1) { continuePath(state); return; }
+            int entityID = int(R.instances[payload.instanceID].instance.entityID);
+            bool visible = (entityID == state.sampledLightID);
+            if (visible) {
+                const LightStruct &light_light = state.light_light;
+                int3 indices; float3 p, p_e1, p_e2; float3 v_gz; float2 uv, uv_e1, uv_e2;
+                loadMeshTriIndices(state.lightMeshID, payload.primitiveID, indices);
+                loadMeshVertexData(state.lightMeshID, indices, payload.barycentrics, p, v_gz, p_e1, p_e2);
+                loadMeshUVData(state.lightMeshID, indices, payload.barycentrics, uv, uv_e1, uv_e2);
+
+                // Transform data into world space
+                glm::mat4 xfm = payload.localToWorld;
+                glm::mat3 nxfm = transpose(glm::inverse(glm::mat3(xfm)));
+                p = make_float3(xfm * make_vec4(p, 1.0f));
+                v_gz = make_float3(normalize(nxfm * normalize(make_vec3(v_gz))));
+
+                float4 default_light_emission = make_float4(light_light.r, light_light.g, light_light.b, 0.f);
+                float3 lightEmission = make_float3(sampleTexture(light_light.color_texture_id, make_vec2(uv), make_vec4(default_light_emission))) * light_light.intensity;
+
+                float dotNWi = fabs(dot(-v_gz, ray.direction)); // for now, making all lights double sided.
+                if (dotNWi > 0.f){
+                    float w = power_heuristic(1.f, state.bsdf_pdf, 1.f, state.light_pdf);
+                    float3 Li = lightEmission * w / (state.bsdf_pdf * state.light_selection_pdf);
+                    irradiance = irradiance + (state.bsdf * Li * fabs(dotNWi));
+                }
+            }
+        }
+
+        // accumulate any radiance (ie path_throughput * irradiance), and update the path throughput using the sampled BRDF
+        state.illum = state.illum + state.path_throughput * irradiance;
+        state.path_throughput = state.path_throughput * state.bsdf / state.bsdf_pdf;
+        float3 &path_throughput = state.path_throughput;
+
+        // If ray misses, interpret normal as "miss color" assigned by miss program and move on to the next sample
+        if (payload.tHit <= 0.f) {
+            // Weighted against the chance of sampling the same direction from the dome light
+            float dome_pdf = domeLightPdf(ray.direction);
+            float w = (dome_pdf > 0.f) ? power_heuristic(1.f, state.bsdf_pdf, 1.f, dome_pdf) : 1.f;
+            state.illum = state.illum + path_throughput * missColor(ray) * LP.domeLightIntensity * w;
+        }
+
+        if (state.bounce == 0) {
+            state.directIllum = state.illum;
+        }
+
+        if ((payload.tHit <= 0.0f) || (path_throughput.x < EPSILON && path_throughput.y < EPSILON && path_throughput.z < EPSILON)) {
+            state.stage = PathState::DONE;
+            return;
+        }
+
+        // if the bounce count is less than the max bounce count, potentially add on radiance from the next hit location.
+        ++state.bounce;
+        continuePath(state);
+    }
+
+    /* Writes the pixel of a finished path */
+    void finishPath(PathState &state)
+    {
+        ivec2 pixelID = state.pixelID;
+        auto fbOfs = pixelID.x+LP.frameSize.x* ((LP.frameSize.y - 1) -  pixelID.y);
+        float3 renderData = state.renderData;
+        float3 primaryAlbedo = state.primaryAlbedo;
+        float3 primaryNormal = state.primaryNormal;
+
+        // clamp out any extreme fireflies
+        glm::vec3 gillum = vec3(state.illum.x, state.illum.y, state.illum.z);
+        glm::vec3 dillum = vec3(state.directIllum.x, state.directIllum.y, state.directIllum.z);
+        glm::vec3 iillum = gillum - dillum;
+
+        if (LP.indirectClamp > 0.f)
+            iillum = clamp(iillum, vec3(0.f), vec3(LP.indirectClamp));
+        if (LP.directClamp > 0.f)
+            dillum = clamp(dillum, vec3(0.f), vec3(LP.directClamp));
+
+        gillum = dillum + iillum;
+
+        // just in case we get inf's or nans, remove them.
+        if (glm::any(glm::isnan(gillum))) gillum = vec3(0.f);
+        if (glm::any(glm::isinf(gillum))) gillum = vec3(0.f);
+        float3 accum_illum = make_float3(gillum.r, gillum.g, gillum.b);
+
+        /* Write to AOVs, progressively refining results */
+        vec4 prev_color = R.accumBuffer[fbOfs];
+        float4 accum_color = make_float4((accum_illum + float(LP.frameID) * make_float3(prev_color)) / float(LP.frameID + 1), 1.0f);
+        R.accumBuffer[fbOfs] = make_vec4(accum_color);
+        R.frameBuffer[fbOfs] = vec4(accum_color.x, accum_color.y, accum_color.z, 1.0f);
+
+        vec4 oldAlbedo = R.albedoBuffer[fbOfs];
+        vec4 oldNormal = R.normalBuffer[fbOfs];
+        if (any(isnan(oldAlbedo))) oldAlbedo = vec4(1.f);
+        if (any(isnan(oldNormal))) oldNormal = vec4(1.f);
+        vec4 newAlbedo = vec4(primaryAlbedo.x, primaryAlbedo.y, primaryAlbedo.z, 1.f);
+        vec4 newNormal = normalize(camera.proj * cameraTransform.worldToLocal * vec4(primaryNormal.x, primaryNormal.y, primaryNormal.z, 0.f));
+        newNormal.a = 1.f;
+        vec4 accumAlbedo = (newAlbedo + float(LP.frameID) * oldAlbedo) / float(LP.frameID + 1);
+        vec4 accumNormal = (newNormal + float(LP.frameID) * oldNormal) / float(LP.frameID + 1);
+        R.albedoBuffer[fbOfs] = accumAlbedo;
+        R.normalBuffer[fbOfs] = accumNormal;
+
+        // Override framebuffer output if user requested to render metadata
+        if (LP.renderDataMode != RenderDataFlags::NONE) {
+            accumNormal = abs(accumNormal + vec4(1.f));
+            if (LP.renderDataMode == RenderDataFlags::DENOISE_NORMAL)
+                renderData = make_float3(accumNormal.x, accumNormal.y, accumNormal.z);
+            if (LP.renderDataMode == RenderDataFlags::DENOISE_ALBEDO)
+                renderData = make_float3(accumAlbedo.x, accumAlbedo.y, accumAlbedo.z);
+            R.frameBuffer[fbOfs] = vec4( renderData.x, renderData.y, renderData.z, 1.0f);
+        }
+    }
+
+    /*
+     * Reads the metadata at the first visible hit of the camera ray, without shading, as primaryRayGen does.
+     * Writes vec4(position, depth) to the frame buffer and vec4(normal, entity id) to the normal buffer.
+    */
+    void finishPrimary(PathState &state, RayPayload &payload)
+    {
+        ivec2 pixelID = state.pixelID;
+        auto fbOfs = pixelID.x+LP.frameSize.x* ((LP.frameSize.y - 1) -  pixelID.y);
+        LCGRand &rng = state.rng;
+        HostRay &ray = state.ray;
+        R.frameBuffer[fbOfs] = vec4(FLT_MAX);
+        R.normalBuffer[fbOfs] = vec4(FLT_MAX);
+
+        int entityID = -1;
+        EntityStruct entity;
+        for (int visibilitySkips = 0; payload.tHit > 0.f; ++visibilitySkips) {
+            entityID = int(R.instances[payload.instanceID].instance.entityID);
+            entity = R.entities[entityID];
+            if ((entity.visibilityFlags & ENTITY_VISIBILITY_CAMERA_RAYS) != 0) break;
+
+            // Skip forward if the hit object is invisible to the camera
+            if (visibilitySkips == 10) return; // avoid locking up.
+            ray.origin = ray.origin + ray.direction * (payload.tHit + EPSILON);
+            payload.tHit = -1.f;
+            ray.time = lcg_randomf(rng);
+            traceRay(ray, payload);
+        }
+        if (payload.tHit <= 0.f) return;
+
+        MaterialStruct entityMaterial;
+        if (entity.material_id >= 0 && entity.material_id < int32_t(R.materials.size())) {
+            entityMaterial = R.materials[entity.material_id];
+        }
+
+        const float3 w_o = -ray.direction;
+        float3 p, v_x, v_y, v_z, v_gz, p_e1, p_e2; float2 uv, uv_e1, uv_e2; int3 indices;
+        loadMeshTriIndices(entity.mesh_id, payload.primitiveID, indices);
+        loadMeshVertexData(entity.mesh_id, indices, payload.barycentrics, p, v_gz, p_e1, p_e2);
+        loadMeshUVData(entity.mesh_id, indices, payload.barycentrics, uv, uv_e1, uv_e2);
+        loadMeshNormalData(entity.mesh_id, indices, payload.barycentrics, uv, v_z);
+
+        glm::mat4 xfm = payload.localToWorld;
+        glm::mat3 nxfm = transpose(glm::inverse(glm::mat3(xfm)));
+
+        float f = 1.0f / (uv_e1.x * uv_e2.y - uv_e2.x * uv_e1.y);
+        vec3 tangent;
+        tangent.x = f * (uv_e2.y * p_e1.x - uv_e1.y * p_e2.x);
+        tangent.y = f * (uv_e2.y * p_e1.y - uv_e1.y * p_e2.y);
+        tangent.z = f * (uv_e2.y * p_e1.z - uv_e1.y * p_e2.z);
+        tangent = normalize(tangent);
+        v_z = normalize(v_z);
+
+        p = make_float3(xfm * make_vec4(p, 1.0f));
+        v_gz = make_float3(normalize(nxfm * make_vec3(v_gz)));
+        v_z = make_float3(normalize(nxfm * make_vec3(v_z)));
+        v_x = make_float3(normalize(nxfm * tangent));
+        v_y = cross(v_z, v_x);
+        v_x = cross(v_y, v_z);
+
+        if (
+            all(lessThan(abs(make_vec3(v_x)), vec3(EPSILON))) ||
+            all(lessThan(abs(make_vec3(v_y)), vec3(EPSILON))) ||
+            any(isnan(make_vec3(v_x))) ||
+            any(isnan(make_vec3(v_y)))
+        ) {
+            ortho_basis(v_x, v_y, v_z);
+        }
+
+        glm::mat3 tbn;
+        tbn = glm::column(tbn, 0, make_vec3(v_x) );
+        tbn = glm::column(tbn, 1, make_vec3(v_y) );
+        tbn = glm::column(tbn, 2, make_vec3(v_z) );
+
+        float3 dN = make_float3(sampleTexture(entityMaterial.normal_map_texture_id, make_vec2(uv), vec4(0.5f, .5f, 1.f, 0.f)));
+        dN = (dN * make_float3(2.0f)) - make_float3(1.f);
+        v_z = make_float3(normalize(tbn * normalize(make_vec3(dN))) );
+
+        if (entityMaterial.transmission == 0.f) {
+            v_z = faceNormalForward(w_o, v_gz, v_z);
+        }
+
+        R.frameBuffer[fbOfs] = vec4(p.x, p.y, p.z, payload.tHit);
+        R.normalBuffer[fbOfs] = vec4(v_z.x, v_z.y, v_z.z, float(entityID));
+    }
+};
+
+CPURenderer::CPURenderer()
+{
+    // Same lookup tables the GPU renderer binds as textures for multiple scattering
+    GGX_E_AVG_LOOKUP.width = uint32_t(GGX_E_avg_size);
+    GGX_E_AVG_LOOKUP.height = 1;
+    GGX_E_AVG_LOOKUP.channels = 1;
+    GGX_E_AVG_LOOKUP.texels.assign(GGX_E_avg, GGX_E_avg + GGX_E_avg_size);
+
+    GGX_E_LOOKUP.width = uint32_t(GGX_E_size[0]);
+    GGX_E_LOOKUP.height = uint32_t(GGX_E_size[1]);
+    GGX_E_LOOKUP.channels = 1;
+    GGX_E_LOOKUP.texels.assign(&GGX_E[0][0], &GGX_E[0][0] + GGX_E_size[0] * GGX_E_size[1]);
+}
+
+void CPURenderer::setMesh(uint32_t meshID, std::vector<glm::vec4> vertices, std::vector<glm::vec4> normals,
+    std::vector<glm::vec2> texCoords, std::vector<uint32_t> indices)
+{
+    if (meshID >= meshData.size()) meshData.resize(meshID + 1);
+    MeshData &mesh = meshData[meshID];
+    mesh.vertices = std::move(vertices);
+    mesh.normals = std::move(normals);
+    mesh.texCoords = std::move(texCoords);
+    mesh.indices = std::move(indices);
+    mesh.triangleSamplingTable.clear();
+
+    std::vector<AABB> triangleBounds(mesh.indices.size() / 3);
+    for (size_t i = 0; i < triangleBounds.size(); ++i) {
+        for (uint32_t c = 0; c < 3; ++c) triangleBounds[i].extend(glm::vec3(mesh.vertices[mesh.indices[i * 3 + c]]));
+    }
+    mesh.blas.build(triangleBounds);
+    tlasDirty = true;
+}
+
+void CPURenderer::buildTriangleSamplingTable(uint32_t meshID)
+{
+    if (!hasMesh(meshID)) return;
+    MeshData &mesh = meshData[meshID];
+    if (mesh.triangleSamplingTable.size() == mesh.indices.size() / 3) return;
+    mesh.triangleSamplingTable = buildTriangleAreaTable(mesh.vertices, mesh.indices);
+}
+
+void CPURenderer::clearMesh(uint32_t meshID)
+{
+    if (meshID >= meshData.size()) return;
+    meshData[meshID] = MeshData();
+    tlasDirty = true;
+}
+
+void CPURenderer::setTexture(uint32_t textureID, uint32_t width, uint32_t height, const std::vector<glm::vec4> &texels)
+{
+    if (texels.size() != size_t(width) * height) throw std::runtime_error("Error: texel count does not match the texture dimensions");
+    if (textureID >= textureObjects.size()) textureObjects.resize(textureID + 1);
+    HostTexture &texture = textureObjects[textureID];
+    texture.width = width;
+    texture.height = height;
+    texture.channels = 4;
+    texture.texels.assign((const float*)texels.data(), (const float*)texels.data() + texels.size() * 4);
+}
+
+void CPURenderer::clearTexture(uint32_t textureID)
+{
+    if (textureID >= textureObjects.size()) return;
+    textureObjects[textureID] = HostTexture();
+}
+
+void CPURenderer::setInstances(std::vector<Instance> newInstances)
+{
+    // When only transforms changed, the top level BVH keeps its tree and just refits its bounds
+    bool sameInstances = (newInstances.size() == instances.size());
+    for (size_t i = 0; sameInstances && (i < newInstances.size()); ++i) {
+        sameInstances = (newInstances[i].entityID == instances[i].instance.entityID) && (newInstances[i].meshID == instances[i].instance.meshID);
+    }
+
+    instances.clear();
+    instances.reserve(newInstances.size());
+    for (auto &instance : newInstances) {
+        if ((instance.meshID >= meshData.size()) || instance.keys.empty())
+            throw std::runtime_error("Error: CPU renderer instance refers to a missing mesh, or has no transform keys");
+
+        // Static instances keep a single key, and skip inverting a matrix per ray
+        bool moving = false;
+        for (auto &key : instance.keys) moving |= (key != instance.keys[0]);
+        if (!moving) instance.keys.resize(1);
+
+        InstanceData data;
+        data.worldToLocal = glm::inverse(instance.keys[0]);
+        data.instance = std::move(instance);
+        instances.push_back(std::move(data));
+    }
+    if (sameInstances) tlasRefit = true;
+    else tlasDirty = true;
+}
+
+void CPURenderer::updateTLAS()
+{
+    std::vector<AABB> instanceBounds(instances.size());
+    for (size_t i = 0; i < instances.size(); ++i) {
+        const BVH &blas = meshData[instances[i].instance.meshID].blas;
+        if (blas.empty()) continue;
+
+        // Matrices are interpolated linearly between keys, so the boxes at each key bound the whole motion
+        const AABB &local = blas.bounds();
+        for (auto &key : instances[i].instance.keys) {
+            for (uint32_t corner = 0; corner < 8; ++corner) {
+                glm::vec3 p((corner & 1) ? local.hi.x : local.lo.x, (corner & 2) ? local.hi.y : local.lo.y, (corner & 4) ? local.hi.z : local.lo.z);
+                instanceBounds[i].extend(glm::vec3(key * glm::vec4(p, 1.f)));
+            }
+        }
+    }
+
+    // Refitting loosens the tree as instances move around, so rebuild once it costs much more to traverse than a fresh one
+    if (!tlasDirty) {
+        tlas.refit(instanceBounds);
+        tlasDirty = tlas.cost() > TLAS_REBUILD_COST_RATIO * tlasBuildCost;
+    }
+    if (tlasDirty) {
+        tlas.build(instanceBounds);
+        tlasBuildCost = tlas.cost();
+    }
+    tlasDirty = false;
+    tlasRefit = false;
+}
+
+void CPURenderer::resize(uint32_t width, uint32_t height)
+{
+    size_t count = size_t(width) * size_t(height);
+    frameBuffer.assign(count, glm::vec4(0.f));
+    albedoBuffer.assign(count, glm::vec4(0.f));
+    normalBuffer.assign(count, glm::vec4(0.f));
+    accumBuffer.assign(count, glm::vec4(0.f));
+}
+
+/* Generates each tile's camera rays, traces them together in packets, and hands the tile's paths to finish */
+template <typename Finish>
+static void traceCameraTiles(CPUTracer &tracer, glm::ivec2 frameSize, const Finish &finish)
+{
+    uint32_t tilesX = (uint32_t(frameSize.x) + TILE_SIZE - 1) / TILE_SIZE;
+    uint32_t tilesY = (uint32_t(frameSize.y) + TILE_SIZE - 1) / TILE_SIZE;
+    parallelForStealing(tilesX * tilesY, [&] (uint32_t tile, uint32_t) {
+        // Camera rays are coherent, so a tile's worth are traced together in packets before shading each path
+        std::vector<CPUTracer::PathState> states(TILE_SIZE * TILE_SIZE);
+        HostRay rays[TILE_SIZE * TILE_SIZE];
+        RayPayload payloads[TILE_SIZE * TILE_SIZE];
+        uint32_t numPaths = 0;
+        int x0 = int((tile % tilesX) * TILE_SIZE), y0 = int((tile / tilesX) * TILE_SIZE);
+        for (int y = y0; y < std::min(y0 + int(TILE_SIZE), frameSize.y); ++y) {
+            for (int x = x0; x < std::min(x0 + int(TILE_SIZE), frameSize.x); ++x) {
+                if (!tracer.beginPath(ivec2(x, y), states[numPaths])) continue;
+                rays[numPaths] = states[numPaths].ray;
+                payloads[numPaths] = states[numPaths].payload;
+                numPaths++;
+            }
+        }
+        tracer.traceStream(rays, payloads, numPaths);
+        for (uint32_t i = 0; i < numPaths; ++i) states[i].payload = payloads[i];
+        finish(states.data(), numPaths);
+    });
+}
+
+void CPURenderer::render(const HostLaunchParams &launchParams)
+{
+    glm::ivec2 frameSize = launchParams.frameSize;
+    if (frameBuffer.size() != size_t(frameSize.x) * size_t(frameSize.y))
+        throw std::runtime_error("Error: CPU renderer frame buffer does not match the frame size");
+    if (tlasDirty || tlasRefit) updateTLAS();
+
+    // Each sample of a launch is traced as its own frame, like the samples within a GPU launch
+    uint32_t numSamples = (launchParams.renderDataMode == RenderDataFlags::NONE) ? std::max(launchParams.samplesPerLaunch, 1u) : 1u;
+    HostLaunchParams frameParams = launchParams;
+    for (uint32_t sample = 0; sample < numSamples; ++sample) {
+        frameParams.frameID = launchParams.frameID + sample;
+        CPUTracer tracer(*this, frameParams);
+        traceCameraTiles(tracer, frameSize, [&] (CPUTracer::PathState *states, uint32_t count) {
+            tracer.tracePaths(states, count);
+        });
+    }
+}
+
+void CPURenderer::renderPrimary(const HostLaunchParams &launchParams)
+{
+    glm::ivec2 frameSize = launchParams.frameSize;
+    if (frameBuffer.size() != size_t(frameSize.x) * size_t(frameSize.y))
+        throw std::runtime_error("Error: CPU renderer frame buffer does not match the frame size");
+    if (tlasDirty || tlasRefit) updateTLAS();
+
+    // Nothing is visible without a camera
+    CPUTracer tracer(*this, launchParams);
+    if (!tracer.hasCamera) {
+        std::fill(frameBuffer.begin(), frameBuffer.end(), glm::vec4(FLT_MAX));
+        std::fill(normalBuffer.begin(), normalBuffer.end(), glm::vec4(FLT_MAX));
+        return;
+    }
+
+    traceCameraTiles(tracer, frameSize, [&] (CPUTracer::PathState *states, uint32_t count) {
+        for (uint32_t i = 0; i < count; ++i) tracer.finishPrimary(states[i], states[i].payload);
+    });
+}
@@ -0,0 +1,140 @@
+#pragma once
+
+/*
+ * A path tracer which runs on the CPU, for machines without an OptiX capable GPU.
+ * It reads the same component structs the GPU renderer uploads, and produces the same
+ * buffers as the rayGen program in devicecode/path_tracer.cu.
+ * This header is kept free of CUDA and OptiX types so that it can be included next to them.
+*/
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <visii/entity_struct.h>
+#include <visii/transform_struct.h>
+#include <visii/material_struct.h>
+#include <visii/camera_struct.h>
+#include <visii/mesh_struct.h>
+#include <visii/light_struct.h>
+#include <visii/texture_struct.h>
+
+#include <hostcode/bvh.h>
+#include <hostcode/host_texture.h>
+#include <hostcode/alias_table.h>
+#include <hostcode/light_bvh.h>
+
+/* The per frame subset of LaunchParams read by the CPU renderer */
+struct HostLaunchParams {
+    glm::ivec2 frameSize = glm::ivec2(0);
+    uint64_t frameID = 0;
+    uint32_t samplesPerLaunch = 1;
+    float domeLightIntensity = 1.f;
+    float directClamp = 100.f;
+    float indirectClamp = 100.f;
+    uint32_t maxBounceDepth = 10;
+    EntityStruct cameraEntity;
+    int32_t environmentMapID = -1;
+    glm::quat environmentMapRotation = glm::quat(1,0,0,0);
+    uint32_t renderDataMode = 0;
+    uint32_t renderDataBounce = 0;
+};
+
+class CPURenderer {
+    public:
+
+    /* An entity placed in the scene. Keys are spread evenly over the frame, like the motion segments of the GPU renderer. */
+    struct Instance {
+        uint32_t entityID;
+        uint32_t meshID;
+        std::vector<glm::mat4> keys;
+    };
+
+    CPURenderer();
+
+    /* Copies a mesh's geometry and builds its bottom level BVH */
+    void setMesh(uint32_t meshID, std::vector<glm::vec4> vertices, std::vector<glm::vec4> normals,
+        std::vector<glm::vec2> texCoords, std::vector<uint32_t> indices);
+    void clearMesh(uint32_t meshID);
+
+    /* Builds the table light sampling picks a mesh's triangles from, in proportion to their area, unless it is already built */
+    void buildTriangleSamplingTable(uint32_t meshID);
+    bool hasMesh(uint32_t meshID) const { return (meshID < meshData.size()) && !meshData[meshID].blas.empty(); }
+
+    void setTexture(uint32_t textureID, uint32_t width, uint32_t height, const std::vector<glm::vec4> &texels);
+    void clearTexture(uint32_t textureID);
+
+    /*
+     * Replaces the instances in the scene. The top level BVH is updated on the next render, by refitting it
+     * if the same entities are instanced with the same meshes as before, and by rebuilding it otherwise.
+    */
+    void setInstances(std::vector<Instance> instances);
+
+    void resize(uint32_t width, uint32_t height);
+
+    /*
+     * Traces launchParams.samplesPerLaunch samples per pixel, each as its own frame with its own frame id, and
+     * accumulates them into the frame buffers. Render data modes trace a single sample.
+    */
+    void render(const HostLaunchParams &launchParams);
+
+    /*
+     * Traces only the camera ray of each pixel, skipping shading. Writes vec4(position, depth) to the frame buffer
+     * and vec4(normal, entity id) to the normal buffer, or FLT_MAX where nothing visible was hit.
+    */
+    void renderPrimary(const HostLaunchParams &launchParams);
+
+    /* Component tables, copied from the component factories */
+    std::vector<EntityStruct>    entities;
+    std::vector<TransformStruct> transforms;
+    std::vector<MaterialStruct>  materials;
+    std::vector<CameraStruct>    cameras;
+    std::vector<MeshStruct>      meshes;
+    std::vector<LightStruct>     lights;
+    std::vector<TextureStruct>   textures;
+    std::vector<uint32_t>        lightEntities;
+    LightBVH                     lightBVH; // over lightEntities, rebuilt when they change and refit otherwise
+    LightBoundsCache             lightBounds; // what lightBVH's bounds were computed from, kept to only update what changed
+
+    /* Picks dome light directions, laid out by buildEnvironmentSamplingTable. Empty when the dome light isn't sampled. */
+    std::vector<AliasTableEntry> environmentSamplingTable;
+    glm::ivec2 environmentSamplingTableSize = glm::ivec2(0);
+    int32_t environmentSamplingTextureID = -1;
+
+    std::vector<glm::vec4> frameBuffer;
+    std::vector<glm::vec4> albedoBuffer;
+    std::vector<glm::vec4> normalBuffer;
+    std::vector<glm::vec4> accumBuffer;
+
+    private:
+
+    struct MeshData {
+        std::vector<glm::vec4> vertices;
+        std::vector<glm::vec4> normals;
+        std::vector<glm::vec2> texCoords;
+        std::vector<uint32_t> indices;
+        std::vector<AliasTableEntry> triangleSamplingTable; // only built for meshes of light entities
+        BVH blas;
+    };
+
+    struct InstanceData {
+        Instance instance;
+        glm::mat4 worldToLocal; // only used by instances with a single key
+    };
+
+    friend struct CPUTracer;
+
+    void updateTLAS();
+
+    std::vector<MeshData> meshData;
+    std::vector<HostTexture> textureObjects;
+    std::vector<InstanceData> instances;
+    BVH tlas;
+    bool tlasDirty = true;
+    bool tlasRefit = false;
+    float tlasBuildCost = 0.f;
+
+    HostTexture GGX_E_LOOKUP;
+    HostTexture GGX_E_AVG_LOOKUP;
+};
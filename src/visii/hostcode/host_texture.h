@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <glm/glm.hpp>
+
+/*
+ * A texture held in host memory, for the CPU renderer.
+ * Sampling follows the texture objects the GPU renderer creates: normalized coordinates,
+ * bilinear filtering between texel centers, and either wrapped or clamped addressing.
+ * Missing channels read as 0, except alpha which reads as 1.
+*/
+struct HostTexture {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t channels = 4;
+    bool wrap = true;
+    std::vector<float> texels;
+
+    glm::vec4 sample(float u, float v) const
+    {
+        if ((width == 0) || (height == 0)) return glm::vec4(0.f);
+        if (!std::isfinite(u) || !std::isfinite(v)) return glm::vec4(0.f);
+        float x = u * float(width) - .5f;
+        float y = v * float(height) - .5f;
+        float x0 = std::floor(x);
+        float y0 = std::floor(y);
+        float ax = x - x0;
+        float ay = y - y0;
+        int64_t ix = int64_t(x0);
+        int64_t iy = int64_t(y0);
+        glm::vec4 top = fetch(ix, iy) * (1.f - ax) + fetch(ix + 1, iy) * ax;
+        glm::vec4 bottom = fetch(ix, iy + 1) * (1.f - ax) + fetch(ix + 1, iy + 1) * ax;
+        return top * (1.f - ay) + bottom * ay;
+    }
+
+    glm::vec4 fetch(int64_t x, int64_t y) const
+    {
+        if (wrap) {
+            x %= int64_t(width); if (x < 0) x += width;
+            y %= int64_t(height); if (y < 0) y += height;
+        } else {
+            x = std::min(std::max(x, int64_t(0)), int64_t(width) - 1);
+            y = std::min(std::max(y, int64_t(0)), int64_t(height) - 1);
+        }
+        const float *texel = &texels[(size_t(y) * width + size_t(x)) * channels];
+        glm::vec4 result(0.f, 0.f, 0.f, 1.f);
+        for (uint32_t c = 0; c < std::min(channels, 4u); ++c) result[c] = texel[c];
+        return result;
+    }
+};
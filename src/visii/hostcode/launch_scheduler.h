@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+
+#define MAX_SAMPLES_PER_LAUNCH 1024
+
+/*
+ * Chooses how many samples per pixel to trace in each launch of a progressive render, so that each launch takes
+ * about budget seconds. Fewer, larger launches spend less time on launch overhead and device syncs, while the budget
+ * keeps each one short enough for the window to stay responsive and the GPU watchdog to stay quiet.
+ * The first launch traces one sample to measure the cost of a sample. From then on, the batch size follows a running
+ * average of the measured cost, and at most doubles from one launch to the next in case a launch ran fast by chance.
+*/
+class LaunchScheduler {
+public:
+    LaunchScheduler(double budget, uint32_t maxSamplesPerLaunch)
+        : budget(budget), maxSamplesPerLaunch(std::max(maxSamplesPerLaunch, 1u)) {}
+
+    /* The number of samples to trace in the next launch, with remaining samples still to go. A budget of 0 traces one. */
+    uint32_t next(uint32_t remaining) const
+    {
+        if (remaining == 0) return 0;
+        uint32_t samples = 1;
+        if ((budget > 0.0) && measured) {
+            double fit = (secondsPerSample > 0.0) ? std::floor(budget / secondsPerSample) : double(maxSamplesPerLaunch);
+            double grown = 2.0 * double(lastSamples);
+            samples = uint32_t(std::max(1.0, std::min(std::min(fit, grown), double(maxSamplesPerLaunch))));
+        }
+        return std::min(samples, remaining);
+    }
+
+    /* Records how long a launch of the given number of samples took */
+    void record(uint32_t samples, double seconds)
+    {
+        if ((samples == 0) || !(seconds >= 0.0)) return;
+        double perSample = seconds / double(samples);
+        secondsPerSample = measured ? (.5 * secondsPerSample + .5 * perSample) : perSample;
+        measured = true;
+        lastSamples = samples;
+    }
+
+private:
+    double budget;
+    uint32_t maxSamplesPerLaunch;
+    bool measured = false;
+    double secondsPerSample = 0.0;
+    uint32_t lastSamples = 1;
+};
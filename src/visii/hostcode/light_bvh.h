@@ -0,0 +1,309 @@
+#pragma once
+
+#include <cstdint>
+#include <cfloat>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <glm/glm.hpp>
+
+#include <devicecode/light_bvh.h>
+
+/*
+ * Widens the cone of directions within acos(cosTheta) of axis to also cover the cone around w, returning the
+ * smallest cone around both. The whole sphere is a cosTheta of -1.
+*/
+inline void unionDirectionCone(glm::vec3 &axis, float &cosTheta, const glm::vec3 &w, float cosThetaW)
+{
+    const float pi = 3.14159265358979323846f;
+    float thetaA = std::acos(glm::clamp(cosTheta, -1.f, 1.f));
+    float thetaB = std::acos(glm::clamp(cosThetaW, -1.f, 1.f));
+    float thetaD = std::acos(glm::clamp(glm::dot(axis, w), -1.f, 1.f));
+    if (std::min(thetaD + thetaB, pi) <= thetaA) return;
+    if (std::min(thetaD + thetaA, pi) <= thetaB) { axis = w; cosTheta = cosThetaW; return; }
+
+    // The new cone's edges touch the far edges of both cones, so its axis turns from axis towards w
+    float thetaO = (thetaA + thetaD + thetaB) * .5f;
+    glm::vec3 k = glm::cross(axis, w);
+    if ((thetaO >= pi) || (glm::dot(k, k) == 0.f)) { cosTheta = -1.f; return; }
+    k = glm::normalize(k);
+    float thetaR = thetaO - thetaA;
+    axis = glm::normalize(axis * std::cos(thetaR) + glm::cross(k, axis) * std::sin(thetaR));
+    cosTheta = std::cos(thetaO);
+}
+
+/* Bounds on both a and b. Bounds without power are empty, and are left out. */
+inline LightBounds unionLightBounds(const LightBounds &a, const LightBounds &b)
+{
+    if (!(a.power > 0.f)) return b;
+    if (!(b.power > 0.f)) return a;
+    LightBounds u = a;
+    u.boundsMin = glm::min(a.boundsMin, b.boundsMin);
+    u.boundsMax = glm::max(a.boundsMax, b.boundsMax);
+    u.power = a.power + b.power;
+    unionDirectionCone(u.axis, u.cosThetaO, b.axis, b.cosThetaO);
+    u.cosThetaE = std::min(a.cosThetaE, b.cosThetaE);
+    u.twoSided = a.twoSided | b.twoSided;
+    return u;
+}
+
+/*
+ * Bounds of a triangle mesh light in its own space, which only change when the mesh does. Lights are double sided,
+ * so each triangle's normal is flipped towards the cone's axis before the cone is grown to cover it.
+*/
+struct MeshLightBounds {
+    glm::vec3 boundsMin = glm::vec3(FLT_MAX);
+    glm::vec3 boundsMax = glm::vec3(-FLT_MAX);
+    glm::vec3 axis = glm::vec3(0.f, 0.f, 1.f);
+    float cosThetaO = 1.f;
+    float area = 0.f;
+};
+
+inline MeshLightBounds computeObjectLightBounds(const std::vector<glm::vec4> &vertices, const std::vector<uint32_t> &indices)
+{
+    MeshLightBounds b;
+    double area = 0.0;
+    bool haveNormal = false;
+    for (size_t t = 0; t + 2 < indices.size(); t += 3) {
+        glm::vec3 v1 = glm::vec3(vertices[indices[t + 0]]);
+        glm::vec3 v2 = glm::vec3(vertices[indices[t + 1]]);
+        glm::vec3 v3 = glm::vec3(vertices[indices[t + 2]]);
+        b.boundsMin = glm::min(b.boundsMin, glm::min(v1, glm::min(v2, v3)));
+        b.boundsMax = glm::max(b.boundsMax, glm::max(v1, glm::max(v2, v3)));
+
+        glm::vec3 c = glm::cross(v2 - v1, v3 - v1);
+        float length = glm::length(c);
+        area += .5 * length;
+        if (!(length > 0.f)) continue;
+        glm::vec3 n = c / length;
+        if (!haveNormal) { b.axis = n; b.cosThetaO = 1.f; haveNormal = true; continue; }
+        if (glm::dot(n, b.axis) < 0.f) n = -n;
+        if (glm::dot(n, b.axis) < b.cosThetaO) unionDirectionCone(b.axis, b.cosThetaO, n, 1.f);
+    }
+    b.area = haveNormal ? float(area) : 0.f;
+    return b;
+}
+
+/*
+ * Places a mesh light's object space bounds in the world, with a power of radiance times its area. The box is the
+ * bounds of the transformed box. Normals move by the cofactor of the linear part, C, which maps each triangle's
+ * cross product to its world space one. A normal within thetaO of the axis a is cos(thetaO) a + sin(thetaO) p
+ * for some unit p at right angles to a. Once mapped, its part along C a is at least cos(thetaO) |C a| less
+ * sin(thetaO) times the most C p can have along C a, and the rest is at most sin(thetaO) times C's largest
+ * singular value, which bounds the cone's new angle. The bound is exact for flat meshes, rotations and uniform
+ * scales. The area is exact for those too, and only an estimate for curved meshes under other transforms, which
+ * just steers which lights get picked.
+*/
+inline LightBounds transformMeshLightBounds(const MeshLightBounds &m, const glm::mat4 &localToWorld, float radiance)
+{
+    if (!(m.area > 0.f) || !std::isfinite(radiance) || !(radiance > 0.f)) return LightBounds();
+    glm::mat3 a = glm::mat3(localToWorld);
+    glm::mat3 c = glm::mat3(glm::cross(a[1], a[2]), glm::cross(a[2], a[0]), glm::cross(a[0], a[1]));
+
+    LightBounds b;
+    b.twoSided = 1;
+    b.cosThetaE = 0.f;
+    glm::vec3 center = a * ((m.boundsMin + m.boundsMax) * .5f) + glm::vec3(localToWorld[3]);
+    glm::vec3 extent = glm::mat3(glm::abs(a[0]), glm::abs(a[1]), glm::abs(a[2])) * ((m.boundsMax - m.boundsMin) * .5f);
+    b.boundsMin = center - extent;
+    b.boundsMax = center + extent;
+
+    glm::vec3 axis = c * m.axis;
+    float axisLength = glm::length(axis);
+    if (!(axisLength > 0.f)) return LightBounds();
+    b.axis = axis / axisLength;
+    float area;
+    if (m.cosThetaO >= 1.f) {
+        b.cosThetaO = 1.f;
+        area = m.area * axisLength;
+    } else {
+        // The largest singular value of c is at most the square root of the largest row sum of |c^T c|
+        glm::mat3 ctc = glm::transpose(c) * c;
+        float rowSum = 0.f;
+        for (int i = 0; i < 3; ++i) rowSum = std::max(rowSum, std::fabs(ctc[0][i]) + std::fabs(ctc[1][i]) + std::fabs(ctc[2][i]));
+        float sigmaMax = std::sqrt(rowSum);
+        glm::vec3 q = glm::transpose(c) * b.axis;
+        float sideways = glm::length(q - glm::dot(q, m.axis) * m.axis);
+
+        float sinThetaO = std::sqrt(std::max(0.f, 1.f - m.cosThetaO * m.cosThetaO));
+        float along = m.cosThetaO * axisLength - sinThetaO * sideways;
+        float across = sinThetaO * sigmaMax;
+        b.cosThetaO = ((m.cosThetaO > 0.f) && (along > 0.f)) ? along / std::sqrt(along * along + across * across) : -1.f;
+        area = m.area * std::pow(std::fabs(glm::determinant(a)), 2.f / 3.f);
+    }
+
+    b.power = radiance * area;
+    if (!(b.power > 0.f) || !std::isfinite(b.power)) return LightBounds();
+    return b;
+}
+
+/* Bounds of a triangle mesh light once placed in the world. Its power is radiance times its area. */
+inline LightBounds computeMeshLightBounds(const std::vector<glm::vec4> &vertices, const std::vector<uint32_t> &indices,
+    const glm::mat4 &localToWorld, float radiance)
+{
+    return transformMeshLightBounds(computeObjectLightBounds(vertices, indices), localToWorld, radiance);
+}
+
+/*
+ * What each light's bounds were last computed from, so that an update only recomputes the lights whose entity,
+ * mesh, transform or light changed. Object space bounds are kept per mesh, and dropped when the mesh is edited.
+*/
+struct LightBoundsCache {
+    struct Source {
+        uint32_t entityID = UINT32_MAX;
+        int32_t meshID = -1;
+        uint32_t meshVersion = 0;
+        glm::mat4 localToWorld = glm::mat4(1.f);
+        float radiance = 0.f;
+
+        bool operator==(const Source &o) const
+        {
+            return (entityID == o.entityID) && (meshID == o.meshID) && (meshVersion == o.meshVersion)
+                && (localToWorld == o.localToWorld) && (radiance == o.radiance);
+        }
+    };
+
+    struct MeshEntry {
+        MeshLightBounds bounds;
+        uint32_t version = 1;
+        bool computed = false;
+    };
+
+    std::vector<MeshEntry> meshes; // by mesh id
+    std::vector<Source> sources; // one per light, in the order of the light entities
+    std::vector<LightBounds> lights; // the bounds computed from each source
+
+    /* Called when a mesh is edited, so that lights using it are recomputed */
+    void invalidateMesh(uint32_t meshID)
+    {
+        if (meshID >= meshes.size()) return;
+        meshes[meshID].version++;
+        meshes[meshID].computed = false;
+    }
+};
+
+/*
+ * A bounding volume hierarchy over lights, which next event estimation walks down to pick a light which is likely to
+ * matter at the point being shaded. It has one leaf per light, including lights without power, so that the tree can
+ * be refit as lights move as long as the set of lights stays the same. Built top down, splitting on the surface area
+ * and orientation heuristic over twelve buckets per axis.
+*/
+class LightBVH {
+public:
+    std::vector<LightBVHNode> nodes;
+
+    void build(const std::vector<LightBounds> &lights)
+    {
+        nodes.clear();
+        numLights = uint32_t(lights.size());
+        if (lights.empty()) return;
+        nodes.reserve(lights.size() * 2 - 1);
+        std::vector<uint32_t> order(lights.size());
+        for (uint32_t i = 0; i < order.size(); ++i) order[i] = i;
+        buildRecursive(lights, order, 0, uint32_t(order.size()));
+    }
+
+    /* Updates the bounds of every node bottom up, keeping the tree. Returns false if the number of lights changed. */
+    bool refit(const std::vector<LightBounds> &lights)
+    {
+        if (lights.size() != numLights) return false;
+        // Children always come after their parents
+        for (size_t i = nodes.size(); i-- > 0;) {
+            LightBVHNode &node = nodes[i];
+            if (node.isLeaf) node.bounds = lights[node.index];
+            else node.bounds = unionLightBounds(nodes[i + 1].bounds, nodes[node.index].bounds);
+        }
+        return true;
+    }
+
+    uint32_t getNumLights() const { return numLights; }
+
+private:
+    uint32_t numLights = 0;
+
+    static float cost(const LightBounds &b, const glm::vec3 &diagonal, int axis)
+    {
+        const float pi = 3.14159265358979323846f;
+        if (!(b.power > 0.f)) return 0.f;
+        float thetaO = std::acos(glm::clamp(b.cosThetaO, -1.f, 1.f));
+        float thetaE = std::acos(glm::clamp(b.cosThetaE, -1.f, 1.f));
+        float thetaW = std::min(thetaO + thetaE, pi);
+        float sinThetaO = std::sqrt(std::max(0.f, 1.f - b.cosThetaO * b.cosThetaO));
+        float orientation = 2.f * pi * (1.f - b.cosThetaO) + pi / 2.f *
+            (2.f * thetaW * sinThetaO - std::cos(thetaO - 2.f * thetaW) - 2.f * thetaO * sinThetaO + b.cosThetaO);
+        glm::vec3 d = b.boundsMax - b.boundsMin;
+        float area = 2.f * (d.x * d.y + d.y * d.z + d.z * d.x);
+        // Long thin splits are penalized, relative to the node's longest axis
+        float maxExtent = std::max(diagonal.x, std::max(diagonal.y, diagonal.z));
+        float aspect = (diagonal[axis] > 0.f) ? maxExtent / diagonal[axis] : 1.f;
+        return b.power * orientation * aspect * area;
+    }
+
+    uint32_t buildRecursive(const std::vector<LightBounds> &lights, std::vector<uint32_t> &order, uint32_t begin, uint32_t end)
+    {
+        uint32_t index = uint32_t(nodes.size());
+        nodes.emplace_back();
+        if (end - begin == 1) {
+            nodes[index].isLeaf = 1;
+            nodes[index].index = order[begin];
+            nodes[index].bounds = lights[order[begin]];
+            return index;
+        }
+
+        LightBounds bounds;
+        glm::vec3 centroidMin = glm::vec3(FLT_MAX), centroidMax = glm::vec3(-FLT_MAX);
+        for (uint32_t i = begin; i < end; ++i) {
+            const LightBounds &b = lights[order[i]];
+            bounds = unionLightBounds(bounds, b);
+            if (!(b.power > 0.f)) continue;
+            glm::vec3 c = (b.boundsMin + b.boundsMax) * .5f;
+            centroidMin = glm::min(centroidMin, c);
+            centroidMax = glm::max(centroidMax, c);
+        }
+        glm::vec3 diagonal = bounds.boundsMax - bounds.boundsMin;
+
+        const int numBuckets = 12;
+        float bestCost = FLT_MAX;
+        int bestAxis = -1, bestBucket = -1;
+        auto bucketOf = [&] (const LightBounds &b, int axis) {
+            float c = (b.boundsMin[axis] + b.boundsMax[axis]) * .5f;
+            int bucket = int(float(numBuckets) * (c - centroidMin[axis]) / (centroidMax[axis] - centroidMin[axis]));
+            return glm::clamp(bucket, 0, numBuckets - 1);
+        };
+        for (int axis = 0; axis < 3; ++axis) {
+            if (!(centroidMax[axis] > centroidMin[axis])) continue;
+            LightBounds buckets[numBuckets];
+            for (uint32_t i = begin; i < end; ++i) {
+                int bucket = bucketOf(lights[order[i]], axis);
+                buckets[bucket] = unionLightBounds(buckets[bucket], lights[order[i]]);
+            }
+            // Sweep from the right to find the cost of each split
+            LightBounds right;
+            float rightCosts[numBuckets - 1];
+            for (int split = numBuckets - 1; split > 0; --split) {
+                right = unionLightBounds(right, buckets[split]);
+                rightCosts[split - 1] = cost(right, diagonal, axis);
+            }
+            LightBounds left;
+            for (int split = 0; split < numBuckets - 1; ++split) {
+                left = unionLightBounds(left, buckets[split]);
+                float c = cost(left, diagonal, axis) + rightCosts[split];
+                if (c < bestCost) { bestCost = c; bestAxis = axis; bestBucket = split; }
+            }
+        }
+
+        uint32_t mid = (begin + end) / 2;
+        if (bestAxis != -1) {
+            mid = uint32_t(std::partition(order.begin() + begin, order.begin() + end, [&] (uint32_t light) {
+                return bucketOf(lights[light], bestAxis) <= bestBucket;
+            }) - order.begin());
+            if ((mid == begin) || (mid == end)) mid = (begin + end) / 2;
+        }
+
+        buildRecursive(lights, order, begin, mid);
+        uint32_t second = buildRecursive(lights, order, mid, end);
+        nodes[index].index = second;
+        nodes[index].bounds = unionLightBounds(nodes[index + 1].bounds, nodes[second].bounds);
+        return index;
+    }
+};
@@ -0,0 +1,194 @@
+#pragma once
+
+/*
+ * Thin wrappers over vector registers, for tracing packets of rays on the CPU.
+ * The width follows the instruction set the CPU renderer is compiled for (see VISII_CPU_SIMD in the
+ * top level CMakeLists.txt): 16 lanes with AVX-512, 8 with AVX2 and 4 with SSE. Other architectures
+ * get a plain four wide fallback.
+*/
+
+#include <cstdint>
+#include <cfloat>
+#include <algorithm>
+
+#if defined(__AVX512F__)
+#define VISII_SIMD_AVX512
+#include <immintrin.h>
+#elif defined(__AVX2__)
+#define VISII_SIMD_AVX2
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#define VISII_SIMD_SSE
+#include <emmintrin.h>
+#endif
+
+#if defined(VISII_SIMD_AVX512)
+static constexpr uint32_t SIMD_WIDTH = 16;
+#elif defined(VISII_SIMD_AVX2)
+static constexpr uint32_t SIMD_WIDTH = 8;
+#else
+static constexpr uint32_t SIMD_WIDTH = 4;
+#endif
+
+/* A mask of lanes. bits() has bit i set for lane i. */
+struct vbool {
+#if defined(VISII_SIMD_AVX512)
+    __mmask16 m;
+    vbool(__mmask16 m) : m(m) {}
+    static vbool fromBits(uint32_t bits) { return vbool(__mmask16(bits)); }
+    uint32_t bits() const { return uint32_t(m); }
+    friend vbool operator&(vbool a, vbool b) { return vbool(__mmask16(a.m & b.m)); }
+    friend vbool operator|(vbool a, vbool b) { return vbool(__mmask16(a.m | b.m)); }
+    friend vbool andNot(vbool a, vbool b) { return vbool(__mmask16(~a.m & b.m)); }
+#elif defined(VISII_SIMD_AVX2)
+    __m256 m;
+    vbool(__m256 m) : m(m) {}
+    static vbool fromBits(uint32_t bits)
+    {
+        const __m256i lanes = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+        __m256i set = _mm256_and_si256(_mm256_set1_epi32(int(bits)), lanes);
+        return vbool(_mm256_castsi256_ps(_mm256_cmpeq_epi32(set, lanes)));
+    }
+    uint32_t bits() const { return uint32_t(_mm256_movemask_ps(m)); }
+    friend vbool operator&(vbool a, vbool b) { return vbool(_mm256_and_ps(a.m, b.m)); }
+    friend vbool operator|(vbool a, vbool b) { return vbool(_mm256_or_ps(a.m, b.m)); }
+    friend vbool andNot(vbool a, vbool b) { return vbool(_mm256_andnot_ps(a.m, b.m)); }
+#elif defined(VISII_SIMD_SSE)
+    __m128 m;
+    vbool(__m128 m) : m(m) {}
+    static vbool fromBits(uint32_t bits)
+    {
+        const __m128i lanes = _mm_setr_epi32(1, 2, 4, 8);
+        __m128i set = _mm_and_si128(_mm_set1_epi32(int(bits)), lanes);
+        return vbool(_mm_castsi128_ps(_mm_cmpeq_epi32(set, lanes)));
+    }
+    uint32_t bits() const { return uint32_t(_mm_movemask_ps(m)); }
+    friend vbool operator&(vbool a, vbool b) { return vbool(_mm_and_ps(a.m, b.m)); }
+    friend vbool operator|(vbool a, vbool b) { return vbool(_mm_or_ps(a.m, b.m)); }
+    friend vbool andNot(vbool a, vbool b) { return vbool(_mm_andnot_ps(a.m, b.m)); }
+#else
+    uint32_t m;
+    vbool(uint32_t m) : m(m) {}
+    static vbool fromBits(uint32_t bits) { return vbool(bits & ((1u << SIMD_WIDTH) - 1)); }
+    uint32_t bits() const { return m; }
+    friend vbool operator&(vbool a, vbool b) { return vbool(a.m & b.m); }
+    friend vbool operator|(vbool a, vbool b) { return vbool(a.m | b.m); }
+    friend vbool andNot(vbool a, vbool b) { return vbool(~a.m & b.m & ((1u << SIMD_WIDTH) - 1)); }
+#endif
+
+    bool any() const { return bits() != 0; }
+};
+
+/* SIMD_WIDTH floats. Loads and stores expect arrays aligned to 64 bytes. */
+struct vfloat {
+#if defined(VISII_SIMD_AVX512)
+    __m512 v;
+    vfloat() = default;
+    vfloat(__m512 v) : v(v) {}
+    vfloat(float f) : v(_mm512_set1_ps(f)) {}
+    static vfloat load(const float *p) { return vfloat(_mm512_load_ps(p)); }
+    void store(float *p) const { _mm512_store_ps(p, v); }
+    friend vfloat operator+(vfloat a, vfloat b) { return vfloat(_mm512_add_ps(a.v, b.v)); }
+    friend vfloat operator-(vfloat a, vfloat b) { return vfloat(_mm512_sub_ps(a.v, b.v)); }
+    friend vfloat operator*(vfloat a, vfloat b) { return vfloat(_mm512_mul_ps(a.v, b.v)); }
+    friend vfloat operator/(vfloat a, vfloat b) { return vfloat(_mm512_div_ps(a.v, b.v)); }
+    friend vfloat min(vfloat a, vfloat b) { return vfloat(_mm512_min_ps(a.v, b.v)); }
+    friend vfloat max(vfloat a, vfloat b) { return vfloat(_mm512_max_ps(a.v, b.v)); }
+    friend vbool operator<(vfloat a, vfloat b) { return vbool(_mm512_cmp_ps_mask(a.v, b.v, _CMP_LT_OQ)); }
+    friend vbool operator<=(vfloat a, vfloat b) { return vbool(_mm512_cmp_ps_mask(a.v, b.v, _CMP_LE_OQ)); }
+    friend vbool operator>(vfloat a, vfloat b) { return vbool(_mm512_cmp_ps_mask(a.v, b.v, _CMP_GT_OQ)); }
+    friend vbool operator>=(vfloat a, vfloat b) { return vbool(_mm512_cmp_ps_mask(a.v, b.v, _CMP_GE_OQ)); }
+    friend vbool operator==(vfloat a, vfloat b) { return vbool(_mm512_cmp_ps_mask(a.v, b.v, _CMP_EQ_OQ)); }
+    friend vfloat select(vbool m, vfloat a, vfloat b) { return vfloat(_mm512_mask_blend_ps(m.m, b.v, a.v)); }
+#elif defined(VISII_SIMD_AVX2)
+    __m256 v;
+    vfloat() = default;
+    vfloat(__m256 v) : v(v) {}
+    vfloat(float f) : v(_mm256_set1_ps(f)) {}
+    static vfloat load(const float *p) { return vfloat(_mm256_load_ps(p)); }
+    void store(float *p) const { _mm256_store_ps(p, v); }
+    friend vfloat operator+(vfloat a, vfloat b) { return vfloat(_mm256_add_ps(a.v, b.v)); }
+    friend vfloat operator-(vfloat a, vfloat b) { return vfloat(_mm256_sub_ps(a.v, b.v)); }
+    friend vfloat operator*(vfloat a, vfloat b) { return vfloat(_mm256_mul_ps(a.v, b.v)); }
+    friend vfloat operator/(vfloat a, vfloat b) { return vfloat(_mm256_div_ps(a.v, b.v)); }
+    friend vfloat min(vfloat a, vfloat b) { return vfloat(_mm256_min_ps(a.v, b.v)); }
+    friend vfloat max(vfloat a, vfloat b) { return vfloat(_mm256_max_ps(a.v, b.v)); }
+    friend vbool operator<(vfloat a, vfloat b) { return vbool(_mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ)); }
+    friend vbool operator<=(vfloat a, vfloat b) { return vbool(_mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ)); }
+    friend vbool operator>(vfloat a, vfloat b) { return vbool(_mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ)); }
+    friend vbool operator>=(vfloat a, vfloat b) { return vbool(_mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ)); }
+    friend vbool operator==(vfloat a, vfloat b) { return vbool(_mm256_cmp_ps(a.v, b.v, _CMP_EQ_OQ)); }
+    friend vfloat select(vbool m, vfloat a, vfloat b) { return vfloat(_mm256_blendv_ps(b.v, a.v, m.m)); }
+#elif defined(VISII_SIMD_SSE)
+    __m128 v;
+    vfloat() = default;
+    vfloat(__m128 v) : v(v) {}
+    vfloat(float f) : v(_mm_set1_ps(f)) {}
+    static vfloat load(const float *p) { return vfloat(_mm_load_ps(p)); }
+    void store(float *p) const { _mm_store_ps(p, v); }
+    friend vfloat operator+(vfloat a, vfloat b) { return vfloat(_mm_add_ps(a.v, b.v)); }
+    friend vfloat operator-(vfloat a, vfloat b) { return vfloat(_mm_sub_ps(a.v, b.v)); }
+    friend vfloat operator*(vfloat a, vfloat b) { return vfloat(_mm_mul_ps(a.v, b.v)); }
+    friend vfloat operator/(vfloat a, vfloat b) { return vfloat(_mm_div_ps(a.v, b.v)); }
+    friend vfloat min(vfloat a, vfloat b) { return vfloat(_mm_min_ps(a.v, b.v)); }
+    friend vfloat max(vfloat a, vfloat b) { return vfloat(_mm_max_ps(a.v, b.v)); }
+    friend vbool operator<(vfloat a, vfloat b) { return vbool(_mm_cmplt_ps(a.v, b.v)); }
+    friend vbool operator<=(vfloat a, vfloat b) { return vbool(_mm_cmple_ps(a.v, b.v)); }
+    friend vbool operator>(vfloat a, vfloat b) { return vbool(_mm_cmpgt_ps(a.v, b.v)); }
+    friend vbool operator>=(vfloat a, vfloat b) { return vbool(_mm_cmpge_ps(a.v, b.v)); }
+    friend vbool operator==(vfloat a, vfloat b) { return vbool(_mm_cmpeq_ps(a.v, b.v)); }
+    friend vfloat select(vbool m, vfloat a, vfloat b) { return vfloat(_mm_or_ps(_mm_and_ps(m.m, a.v), _mm_andnot_ps(m.m, b.v))); }
+#else
+    float v[SIMD_WIDTH];
+    vfloat() = default;
+    vfloat(float f) { for (uint32_t i = 0; i < SIMD_WIDTH; ++i) v[i] = f; }
+    static vfloat load(const float *p) { vfloat r(0.f); for (uint32_t i = 0; i < SIMD_WIDTH; ++i) r.v[i] = p[i]; return r; }
+    void store(float *p) const { for (uint32_t i = 0; i < SIMD_WIDTH; ++i) p[i] = v[i]; }
+    template<class F> static vfloat map(vfloat a, vfloat b, F f) { for (uint32_t i = 0; i < SIMD_WIDTH; ++i) a.v[i] = f(a.v[i], b.v[i]); return a; }
+    template<class F> static vbool test(vfloat a, vfloat b, F f) { uint32_t m = 0; for (uint32_t i = 0; i < SIMD_WIDTH; ++i) m |= uint32_t(f(a.v[i], b.v[i])) << i; return vbool(m); }
+    friend vfloat operator+(vfloat a, vfloat b) { return map(a, b, [] (float x, float y) { return x + y; }); }
+    friend vfloat operator-(vfloat a, vfloat b) { return map(a, b, [] (float x, float y) { return x - y; }); }
+    friend vfloat operator*(vfloat a, vfloat b) { return map(a, b, [] (float x, float y) { return x * y; }); }
+    friend vfloat operator/(vfloat a, vfloat b) { return map(a, b, [] (float x, float y) { return x / y; }); }
+    friend vfloat min(vfloat a, vfloat b) { return map(a, b, [] (float x, float y) { return (y < x) ? y : x; }); }
+    friend vfloat max(vfloat a, vfloat b) { return map(a, b, [] (float x, float y) { return (y > x) ? y : x; }); }
+    friend vbool operator<(vfloat a, vfloat b) { return test(a, b, [] (float x, float y) { return x < y; }); }
+    friend vbool operator<=(vfloat a, vfloat b) { return test(a, b, [] (float x, float y) { return x <= y; }); }
+    friend vbool operator>(vfloat a, vfloat b) { return test(a, b, [] (float x, float y) { return x > y; }); }
+    friend vbool operator>=(vfloat a, vfloat b) { return test(a, b, [] (float x, float y) { return x >= y; }); }
+    friend vbool operator==(vfloat a, vfloat b) { return test(a, b, [] (float x, float y) { return x == y; }); }
+    friend vfloat select(vbool m, vfloat a, vfloat b) { for (uint32_t i = 0; i < SIMD_WIDTH; ++i) if (!(m.m & (1u << i))) a.v[i] = b.v[i]; return a; }
+#endif
+
+    /* The smallest and largest lane, out of those in the mask */
+    float reduceMin(vbool mask) const { return horizontalMin(select(mask, *this, vfloat(FLT_MAX))); }
+    float reduceMax(vbool mask) const { return -horizontalMin(select(mask, vfloat(0.f) - *this, vfloat(FLT_MAX))); }
+
+    static float horizontalMin(vfloat a)
+    {
+#if defined(VISII_SIMD_AVX512)
+        __m256 m = _mm256_min_ps(_mm512_castps512_ps256(a.v), _mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(a.v), 1)));
+        __m128 x = _mm_min_ps(_mm256_castps256_ps128(m), _mm256_extractf128_ps(m, 1));
+#elif defined(VISII_SIMD_AVX2)
+        __m128 x = _mm_min_ps(_mm256_castps256_ps128(a.v), _mm256_extractf128_ps(a.v, 1));
+#elif defined(VISII_SIMD_SSE)
+        __m128 x = a.v;
+#endif
+#if defined(VISII_SIMD_AVX512) || defined(VISII_SIMD_AVX2) || defined(VISII_SIMD_SSE)
+        x = _mm_min_ps(x, _mm_shuffle_ps(x, x, _MM_SHUFFLE(1, 0, 3, 2)));
+        x = _mm_min_ps(x, _mm_shuffle_ps(x, x, _MM_SHUFFLE(2, 3, 0, 1)));
+        return _mm_cvtss_f32(x);
+#else
+        float result = a.v[0];
+        for (uint32_t i = 1; i < SIMD_WIDTH; ++i) result = std::min(result, a.v[i]);
+        return result;
+#endif
+    }
+
+    static uint32_t lowestLane(uint32_t bits)
+    {
+        uint32_t lane = 0;
+        while (!(bits & 1u)) { bits >>= 1; ++lane; }
+        return lane;
+    }
+};
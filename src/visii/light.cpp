@@ -1,9 +1,9 @@
 #include <visii/light.h>
 #include <visii/texture.h>
 
-Light Light::lights[MAX_LIGHTS];
-LightStruct Light::lightStructs[MAX_LIGHTS];
-std::map<std::string, uint32_t> Light::lookupTable;
+PagedArray<Light> Light::lights;
+PagedArray<LightStruct> Light::lightStructs;
+NameTable Light::lookupTable;
 std::shared_ptr<std::mutex> Light::editMutex;
 bool Light::factoryInitialized = false;
 bool Light::anyDirty = true;
@@ -138,7 +138,7 @@ void Light::updateComponents()
 {
 	if (!anyDirty) return;
 
-	for (int i = 0; i < MAX_LIGHTS; ++i) {
+	for (uint32_t i = 0; i < lights.size(); ++i) {
 		if (lights[i].isDirty()) {
             lights[i].markClean();
         }
@@ -150,7 +150,8 @@ void Light::clearAll()
 {
     if (!isFactoryInitialized()) return;
 
-    for (auto &light : lights) {
+    for (uint32_t i = 0; i < lights.size(); ++i) {
+		auto &light = lights[i];
 		if (light.initialized) {
 			Light::remove(light.name);
 		}
@@ -159,20 +160,27 @@ void Light::clearAll()
 
 /* Static Factory Implementations */
 Light* Light::create(std::string name) {
-    auto l = StaticFactory::create(editMutex, name, "Light", lookupTable, lights, MAX_LIGHTS);
+    auto l = StaticFactory::create(editMutex, name, "Light", lookupTable, lights);
     anyDirty = true;
     return l;
 }
 
 Light* Light::createFromTemperature(std::string name, float kelvin, float intensity) {
-    auto light = StaticFactory::create(editMutex, name, "Light", lookupTable, lights, MAX_LIGHTS);
+    auto light = StaticFactory::create(editMutex, name, "Light", lookupTable, lights);
     light->setTemperature(kelvin);
     light->setIntensity(intensity);
     return light;
 }
 
 Light* Light::createFromRGB(std::string name, glm::vec3 color, float intensity) {
-    auto light = StaticFactory::create(editMutex, name, "Light", lookupTable, lights, MAX_LIGHTS);
+    auto light = StaticFactory::create(editMutex, name, "Light", lookupTable, lights);
+    light->setColor(color);
+    light->setIntensity(intensity);
+    return light;
+}
+
+Light* Light::createUnique(std::string prefix, glm::vec3 color, float intensity) {
+    auto light = StaticFactory::createUnique(editMutex, prefix, "Light", lookupTable, lights);
     light->setColor(color);
     light->setIntensity(intensity);
     return light;
@@ -184,24 +192,30 @@ std::shared_ptr<std::mutex> Light::getEditMutex()
 }
 
 Light* Light::get(std::string name) {
-    return StaticFactory::get(editMutex, name, "Light", lookupTable, lights, MAX_LIGHTS);
+    return StaticFactory::get(editMutex, name, "Light", lookupTable, lights);
 }
 
 void Light::remove(std::string name) {
-    StaticFactory::remove(editMutex, name, "Light", lookupTable, lights, MAX_LIGHTS);
+    StaticFactory::remove(editMutex, name, "Light", lookupTable, lights);
     anyDirty = true;
 }
 
-Light* Light::getFront() {
+PagedArray<Light> &Light::getFront() {
     return lights;
 }
 
-LightStruct* Light::getFrontStruct() {
+PagedArray<LightStruct> &Light::getFrontStruct() {
     return lightStructs;
 }
 
 uint32_t Light::getCount() {
-    return MAX_LIGHTS;
+    return lights.size();
+}
+
+void Light::reserveTables(uint32_t count)
+{
+    lights.reserve(count);
+    lightStructs.reserve(count);
 }
 
 std::string Light::getName()
@@ -209,7 +223,7 @@ std::string Light::getName()
     return name;
 }
 
-std::map<std::string, uint32_t> Light::getNameToIdMap()
+const NameTable &Light::getNameToIdMap()
 {
 	return lookupTable;
 }
\ No newline at end of file
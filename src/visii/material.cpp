@@ -1,9 +1,9 @@
 #include <visii/material.h>
 #include <visii/texture.h>
 
-Material Material::materials[MAX_MATERIALS];
-MaterialStruct Material::materialStructs[MAX_MATERIALS];
-std::map<std::string, uint32_t> Material::lookupTable;
+PagedArray<Material> Material::materials;
+PagedArray<MaterialStruct> Material::materialStructs;
+NameTable Material::lookupTable;
 std::shared_ptr<std::mutex> Material::editMutex;
 bool Material::factoryInitialized = false;
 bool Material::anyDirty = true;
@@ -113,7 +113,7 @@ void Material::updateComponents()
 {
 	if (!anyDirty) return;
 
-	for (int i = 0; i < MAX_MATERIALS; ++i) {
+	for (uint32_t i = 0; i < materials.size(); ++i) {
 		if (materials[i].isDirty()) {
             materials[i].markClean();
         }
@@ -125,7 +125,8 @@ void Material::clearAll()
 {
 	if (!isFactoryInitialized()) return;
 
-	for (auto &material : materials) {
+	for (uint32_t i = 0; i < materials.size(); ++i) {
+		auto &material = materials[i];
 		if (material.initialized) {
 			Material::remove(material.name);
 		}
@@ -153,7 +154,7 @@ Material* Material::create(std::string name,
 	float clearcoat,
 	float clearcoat_roughness)
 {
-	auto mat = StaticFactory::create(editMutex, name, "Material", lookupTable, materials, MAX_MATERIALS);
+	auto mat = StaticFactory::create(editMutex, name, "Material", lookupTable, materials);
 	mat->setBaseColor(base_color);
 	mat->setRoughness(roughness);
 	mat->setMetallic(metallic);
@@ -176,31 +177,46 @@ Material* Material::create(std::string name,
 	return mat;
 }
 
+Material* Material::createUnique(std::string prefix)
+{
+	/* The constructor already applies the same defaults as create */
+	auto mat = StaticFactory::createUnique(editMutex, prefix, "Material", lookupTable, materials);
+	mat->markDirty();
+	anyDirty = true;
+	return mat;
+}
+
 std::shared_ptr<std::mutex> Material::getEditMutex()
 {
 	return editMutex;
 }
 
 Material* Material::get(std::string name) {
-	return StaticFactory::get(editMutex, name, "Material", lookupTable, materials, MAX_MATERIALS);
+	return StaticFactory::get(editMutex, name, "Material", lookupTable, materials);
 }
 
 void Material::remove(std::string name) {
-	StaticFactory::remove(editMutex, name, "Material", lookupTable, materials, MAX_MATERIALS);
+	StaticFactory::remove(editMutex, name, "Material", lookupTable, materials);
 	anyDirty = true;
 }
 
-MaterialStruct* Material::getFrontStruct()
+PagedArray<MaterialStruct> &Material::getFrontStruct()
 {
 	return materialStructs;
 }
 
-Material* Material::getFront() {
+PagedArray<Material> &Material::getFront() {
 	return materials;
 }
 
 uint32_t Material::getCount() {
-	return MAX_MATERIALS;
+	return materials.size();
+}
+
+void Material::reserveTables(uint32_t count)
+{
+	materials.reserve(count);
+	materialStructs.reserve(count);
 }
 
 std::string Material::getName()
@@ -208,7 +224,7 @@ std::string Material::getName()
     return name;
 }
 
-std::map<std::string, uint32_t> Material::getNameToIdMap()
+const NameTable &Material::getNameToIdMap()
 {
 	return lookupTable;
 }
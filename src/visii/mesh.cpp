@@ -10,6 +10,9 @@
 #include <sys/stat.h>
 #include <functional>
 #include <limits>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 
 #define GLM_ENABLE_EXPERIMENTAL
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
@@ -24,7 +27,9 @@
 
 // #include "Foton/Tools/Options.hxx"
 #include <visii/utilities/hash_combiner.h>
-#include <tiny_obj_loader.h>
+#include <visii/utilities/mapped_file.h>
+#include <visii/utilities/parallel.h>
+#include <visii/utilities/obj_parser.h>
 #include <tiny_stl.h>
 #include <tiny_gltf.h>
 
@@ -36,9 +41,9 @@
 // #undef MemoryBarrier
 // #endif
 
-Mesh Mesh::meshes[MAX_MESHES];
-MeshStruct Mesh::meshStructs[MAX_MESHES];
-std::map<std::string, uint32_t> Mesh::lookupTable;
+PagedArray<Mesh> Mesh::meshes;
+PagedArray<MeshStruct> Mesh::meshStructs;
+NameTable Mesh::lookupTable;
 std::shared_ptr<std::mutex> Mesh::editMutex;
 bool Mesh::factoryInitialized = false;
 bool Mesh::anyDirty = true;
@@ -92,6 +97,119 @@ struct hash<Vertex>
 };
 } // namespace std
 
+/* Vertex cache optimization, following Tom Forsyth's "Linear-Speed Vertex Cache Optimisation".
+   Triangles are greedily emitted by a score favoring vertices that are recently used and that 
+   have few remaining triangles, which keeps the working set of a small LRU cache hot. */
+namespace forsyth
+{
+const uint32_t CACHE_SIZE = 32;
+const float CACHE_DECAY_POWER = 1.5f;
+const float LAST_TRI_SCORE = 0.75f;
+const float VALENCE_BOOST_SCALE = 2.0f;
+const float VALENCE_BOOST_POWER = 0.5f;
+
+float vertexScore(int32_t cachePosition, uint32_t remainingValence)
+{
+	if (remainingValence == 0) return -1.0f;
+	float score = 0.0f;
+	if (cachePosition >= 0) {
+		if (cachePosition < 3) score = LAST_TRI_SCORE;
+		else {
+			float scaler = 1.0f / float(CACHE_SIZE - 3);
+			score = powf(1.0f - (cachePosition - 3) * scaler, CACHE_DECAY_POWER);
+		}
+	}
+	score += VALENCE_BOOST_SCALE * powf(float(remainingValence), -VALENCE_BOOST_POWER);
+	return score;
+}
+
+std::vector<uint32_t> reorderTriangles(const std::vector<uint32_t> &indices, uint32_t vertexCount)
+{
+	uint32_t numTris = uint32_t(indices.size() / 3);
+	if (numTris == 0) return indices;
+
+	/* Build vertex to triangle adjacency in CSR form */
+	std::vector<uint32_t> valence(vertexCount, 0);
+	for (auto i : indices) valence[i]++;
+	std::vector<uint32_t> offsets(vertexCount + 1, 0);
+	for (uint32_t v = 0; v < vertexCount; ++v) offsets[v + 1] = offsets[v] + valence[v];
+	std::vector<uint32_t> adjacency(indices.size());
+	std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+	for (uint32_t t = 0; t < numTris; ++t)
+		for (uint32_t c = 0; c < 3; ++c)
+			adjacency[fill[indices[t * 3 + c]]++] = t;
+
+	std::vector<int32_t> cachePosition(vertexCount, -1);
+	std::vector<float> vScore(vertexCount);
+	for (uint32_t v = 0; v < vertexCount; ++v) vScore[v] = vertexScore(-1, valence[v]);
+
+	std::vector<float> tScore(numTris);
+	std::vector<bool> emitted(numTris, false);
+	for (uint32_t t = 0; t < numTris; ++t)
+		tScore[t] = vScore[indices[t*3+0]] + vScore[indices[t*3+1]] + vScore[indices[t*3+2]];
+
+	std::vector<uint32_t> cache, nextCache;
+	cache.reserve(CACHE_SIZE + 3);
+	nextCache.reserve(CACHE_SIZE + 3);
+
+	std::vector<uint32_t> result;
+	result.reserve(indices.size());
+
+	uint32_t scanCursor = 0;
+	int64_t best = -1;
+	for (uint32_t emittedCount = 0; emittedCount < numTris; ++emittedCount) {
+		/* If no candidate is adjacent to the cache, fall back to the next unemitted triangle */
+		if (best < 0) {
+			while (emitted[scanCursor]) scanCursor++;
+			best = scanCursor;
+		}
+		uint32_t tri = uint32_t(best);
+		emitted[tri] = true;
+
+		/* Emit the triangle, and remove it from the adjacency of its vertices */
+		nextCache.clear();
+		for (uint32_t c = 0; c < 3; ++c) {
+			uint32_t v = indices[tri * 3 + c];
+			result.push_back(v);
+			nextCache.push_back(v);
+			uint32_t begin = offsets[v], end = offsets[v] + valence[v];
+			for (uint32_t a = begin; a < end; ++a) {
+				if (adjacency[a] == tri) { std::swap(adjacency[a], adjacency[end - 1]); break; }
+			}
+			valence[v]--;
+		}
+
+		/* Move the triangle's vertices to the front of the LRU cache */
+		for (auto v : cache) {
+			if (v != nextCache[0] && v != nextCache[1] && v != nextCache[2])
+				nextCache.push_back(v);
+		}
+		for (uint32_t i = CACHE_SIZE; i < nextCache.size(); ++i) {
+			cachePosition[nextCache[i]] = -1;
+			vScore[nextCache[i]] = vertexScore(-1, valence[nextCache[i]]);
+		}
+		if (nextCache.size() > CACHE_SIZE) nextCache.resize(CACHE_SIZE);
+		std::swap(cache, nextCache);
+
+		/* Rescore vertices in the cache, then the triangles which touch them */
+		for (uint32_t i = 0; i < cache.size(); ++i) {
+			cachePosition[cache[i]] = int32_t(i);
+			vScore[cache[i]] = vertexScore(int32_t(i), valence[cache[i]]);
+		}
+		best = -1;
+		float bestScore = -1.0f;
+		for (auto v : cache) {
+			for (uint32_t a = offsets[v]; a < offsets[v] + valence[v]; ++a) {
+				uint32_t t = adjacency[a];
+				tScore[t] = vScore[indices[t*3+0]] + vScore[indices[t*3+1]] + vScore[indices[t*3+2]];
+				if (tScore[t] > bestScore) { bestScore = tScore[t]; best = t; }
+			}
+		}
+	}
+	return result;
+}
+} // namespace forsyth
+
 Mesh::Mesh() {
 	this->initialized = false;
 }
@@ -368,7 +486,8 @@ void Mesh::clearAll()
 {
 	if (!isFactoryInitialized()) return;
 
-	for (auto &mesh : meshes) {
+	for (uint32_t i = 0; i < meshes.size(); ++i) {
+		auto &mesh = meshes[i];
 		if (mesh.initialized) {
 			// mesh.cleanup();
 			Mesh::remove(mesh.name);
@@ -547,7 +666,7 @@ void Mesh::updateComponents()
 // 	return ssbo_sizes;
 // }
 
-void Mesh::loadObj(std::string objPath)
+void Mesh::loadObj(std::string objPath, bool optimize)
 {
 	struct stat st;
 	if (stat(objPath.c_str(), &st) != 0)
@@ -558,7 +677,7 @@ void Mesh::loadObj(std::string objPath)
 	std::string err;
 
 	tinyobj::attrib_t attrib;
-	if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &err, objPath.c_str()))
+	if (!loadObjParallel(&attrib, &shapes, &materials, &err, objPath))
 		throw std::runtime_error( std::string("Error: Unable to load " + objPath));
 
 	std::vector<Vertex> vertices;
@@ -658,76 +777,173 @@ void Mesh::loadObj(std::string objPath)
 		generateSmoothNormals();
 	}
 
+	if (optimize) {
+		optimizeForLocality();
+	}
+
 	computeMetadata();
 	markDirty();
 }
 
 
-// void Mesh::load_stl(std::string stlPath) {
-// 	allowEdits = allow_edits;
-
-// 	struct stat st;
-// 	if (stat(stlPath.c_str(), &st) != 0)
-// 		throw std::runtime_error( std::string(stlPath + " does not exist!"));
-
-// 	std::vector<float> p;
-// 	std::vector<float> n;
-
-// 	if (!read_stl(stlPath, p, n) )
-// 		throw std::runtime_error( std::string("Error: Unable to load " + stlPath));
-
-// 	std::vector<Vertex> vertices;
-
-// 	/* STLs only have positions and face normals, so generate colors and UVs */
-// 	for (uint32_t i = 0; i < p.size() / 3; ++i) {
-// 		Vertex vertex = Vertex();
-// 		vertex.point = {
-// 			p[i * 3 + 0],
-// 			p[i * 3 + 1],
-// 			p[i * 3 + 2],
-// 			1.0f
-// 		};
-// 		vertex.normal = {
-// 			n[i * 3 + 0],
-// 			n[i * 3 + 1],
-// 			n[i * 3 + 2],
-// 			0.0f
-// 		};
-// 		vertices.push_back(vertex);
-// 	}
+void Mesh::loadStl(std::string stlPath)
+{
+	struct stat st;
+	if (stat(stlPath.c_str(), &st) != 0)
+		throw std::runtime_error( std::string(stlPath + " does not exist!"));
+
+	/* Binary STL: an 80 byte header, a triangle count, then 50 bytes per triangle 
+	   (a face normal, three corner positions, and a 16 bit attribute). */
+	MappedFile file(stlPath);
+	const uint64_t headerSize = 84;
+	const uint64_t facetSize = 50;
+	if (file.size() < headerSize)
+		throw std::runtime_error( std::string("Error: " + stlPath + " is not a valid STL file"));
+	
+	/* Some exporters pad the file past the last triangle, so only a file too short for its count is refused */
+	uint32_t numTris;
+	memcpy(&numTris, file.data() + 80, sizeof(uint32_t));
+	if (file.size() < headerSize + uint64_t(numTris) * facetSize)
+		throw std::runtime_error( std::string("Error: " + stlPath + " is not a binary STL file. Currently only binary STL files are supported."));
+	if (numTris == 0)
+		throw std::runtime_error( std::string("Error: " + stlPath + " contains no triangles"));
+	
+	uint64_t numCorners = uint64_t(numTris) * 3;
+	if (numCorners >= std::numeric_limits<uint32_t>::max())
+		throw std::runtime_error( std::string("Error: " + stlPath + " has too many triangles"));
+
+	/* Corners are read straight out of the mapping. Adding zero folds -0.0 into 0.0, so that 
+	   comparing bits is equivalent to comparing positions. */
+	const uint8_t *facets = file.data() + headerSize;
+	auto corner = [facets] (uint64_t c, uint32_t bits[3]) {
+		float p[3];
+		memcpy(p, facets + (c / 3) * facetSize + 12 + (c % 3) * 12, sizeof(p));
+		for (int i = 0; i < 3; ++i) { p[i] += 0.0f; memcpy(&bits[i], &p[i], sizeof(float)); }
+	};
 
-// 	/* Eliminate duplicate positions */
-// 	std::unordered_map<Vertex, uint32_t> uniqueVertexMap = {};
-// 	std::vector<Vertex> uniqueVertices;
-// 	for (int i = 0; i < vertices.size(); ++i)
-// 	{
-// 		Vertex vertex = vertices[i];
-// 		if (uniqueVertexMap.count(vertex) == 0)
-// 		{
-// 			uniqueVertexMap[vertex] = static_cast<uint32_t>(uniqueVertices.size());
-// 			uniqueVertices.push_back(vertex);
-// 		}
-// 		triangleIndices.push_back(uniqueVertexMap[vertex]);
-// 	}
+	/* Weld coincident corners with a spatial hash. Corners are first hashed in parallel,
+	   then each thread owns a disjoint partition of the hash space, so no locking is needed. 
+	   Every corner is mapped to the first corner which shares its position. */
+	std::vector<uint32_t> hashes(numCorners);
+	std::vector<uint32_t> representative(numCorners);
+	parallelFor(numCorners, [&] (uint64_t begin, uint64_t end, uint32_t) {
+		for (uint64_t c = begin; c < end; ++c) {
+			uint32_t b[3];
+			corner(c, b);
+			uint64_t h = b[0];
+			h = (h * 0x9E3779B97F4A7C15ull) ^ b[1];
+			h = (h * 0x9E3779B97F4A7C15ull) ^ b[2];
+			h ^= h >> 31; h *= 0xBF58476D1CE4E5B9ull; h ^= h >> 29; h *= 0x94D049BB133111EBull; h ^= h >> 32;
+			hashes[c] = uint32_t(h);
+		}
+	});
+
+	uint32_t numPartitions = getNumWorkerThreads();
+	auto partitionOf = [numPartitions] (uint32_t h) { return uint32_t((uint64_t(h) * numPartitions) >> 32); };
+	parallelFor(numPartitions, [&] (uint64_t pBegin, uint64_t pEnd, uint32_t) {
+		for (uint32_t p = uint32_t(pBegin); p < pEnd; ++p) {
+			uint64_t count = 0;
+			for (uint64_t c = 0; c < numCorners; ++c) count += (partitionOf(hashes[c]) == p);
+
+			/* Closed meshes share each vertex between ~6 corners, so start small and grow as needed. 
+			   Slots hold the position bits next to the corner index, so probes never go back to the file. */
+			struct Slot { uint32_t bits[3]; uint32_t corner; };
+			const uint32_t empty = std::numeric_limits<uint32_t>::max();
+			uint64_t tableSize = 16, tableCount = 0;
+			while (tableSize < count / 4) tableSize *= 2;
+			std::vector<Slot> table(tableSize, Slot{{0, 0, 0}, empty});
+			for (uint64_t c = 0; c < numCorners; ++c) {
+				uint32_t h = hashes[c];
+				if (partitionOf(h) != p) continue;
+				if (tableCount * 2 >= tableSize) {
+					std::vector<Slot> grown(tableSize * 2, Slot{{0, 0, 0}, empty});
+					for (auto &entry : table) {
+						if (entry.corner == empty) continue;
+						uint64_t slot = hashes[entry.corner] & (grown.size() - 1);
+						while (grown[slot].corner != empty) slot = (slot + 1) & (grown.size() - 1);
+						grown[slot] = entry;
+					}
+					table.swap(grown);
+					tableSize = table.size();
+				}
+				uint32_t b[3];
+				corner(c, b);
+				uint64_t slot = h & (tableSize - 1);
+				while (true) {
+					Slot &entry = table[slot];
+					if (entry.corner == empty) { 
+						entry = Slot{{b[0], b[1], b[2]}, uint32_t(c)};
+						representative[c] = uint32_t(c); 
+						tableCount++; 
+						break; 
+					}
+					if (entry.bits[0] == b[0] && entry.bits[1] == b[1] && entry.bits[2] == b[2]) { 
+						representative[c] = entry.corner; 
+						break; 
+					}
+					slot = (slot + 1) & (tableSize - 1);
+				}
+			}
+		}
+	}, 1);
+
+	/* Assign vertex ids in first use order using a parallel prefix sum over the unique corners. 
+	   The hash list is no longer needed, so it's reused to hold each unique corner's vertex id. */
+	std::vector<uint32_t> &vertexIds = hashes;
+	uint32_t numChunks = getNumWorkerThreads();
+	std::vector<uint32_t> chunkOffsets(numChunks + 1, 0);
+	auto chunkBegin = [numCorners, numChunks] (uint32_t i) { return (numCorners * i) / numChunks; };
+	parallelFor(numChunks, [&] (uint64_t begin, uint64_t end, uint32_t) {
+		for (uint32_t i = uint32_t(begin); i < end; ++i)
+			for (uint64_t c = chunkBegin(i); c < chunkBegin(i + 1); ++c)
+				chunkOffsets[i + 1] += (representative[c] == c);
+	}, 1);
+	for (uint32_t i = 0; i < numChunks; ++i) chunkOffsets[i + 1] += chunkOffsets[i];
+	uint32_t numVertices = chunkOffsets[numChunks];
+
+	positions.resize(numVertices);
+	parallelFor(numChunks, [&] (uint64_t begin, uint64_t end, uint32_t) {
+		for (uint32_t i = uint32_t(begin); i < end; ++i) {
+			uint32_t next = chunkOffsets[i];
+			for (uint64_t c = chunkBegin(i); c < chunkBegin(i + 1); ++c) {
+				if (representative[c] != c) continue;
+				float p[3];
+				memcpy(p, facets + (c / 3) * facetSize + 12 + (c % 3) * 12, sizeof(p));
+				positions[next] = glm::vec4(p[0], p[1], p[2], 1.0f);
+				vertexIds[c] = next++;
+			}
+		}
+	}, 1);
+
+	triangleIndices.resize(numCorners);
+	parallelFor(numCorners, [&] (uint64_t begin, uint64_t end, uint32_t) {
+		for (uint64_t c = begin; c < end; ++c)
+			triangleIndices[c] = vertexIds[representative[c]];
+	});
+
+	/* STL face normals are frequently missing or wrong, so generate area weighted vertex normals */
+	std::vector<glm::vec3> accumulated(numVertices, glm::vec3(0.0f));
+	for (uint64_t t = 0; t < numTris; ++t) {
+		uint32_t i0 = triangleIndices[t * 3 + 0], i1 = triangleIndices[t * 3 + 1], i2 = triangleIndices[t * 3 + 2];
+		glm::vec3 p0(positions[i0]), p1(positions[i1]), p2(positions[i2]);
+		glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+		accumulated[i0] += n; accumulated[i1] += n; accumulated[i2] += n;
+	}
+	normals.resize(numVertices);
+	parallelFor(numVertices, [&] (uint64_t begin, uint64_t end, uint32_t) {
+		for (uint64_t v = begin; v < end; ++v) {
+			float len = glm::length(accumulated[v]);
+			normals[v] = (len > 0.f) ? glm::vec4(accumulated[v] / len, 0.0f) : glm::vec4(0.0f, 0.0f, 1.0f, 0.0f);
+		}
+	});
 
-// 	/* Map vertices to buffers */
-// 	for (int i = 0; i < uniqueVertices.size(); ++i)
-// 	{
-// 		Vertex v = uniqueVertices[i];
-// 		positions.push_back(v.point);
-// 		colors.push_back(v.color);
-// 		normals.push_back(v.normal);
-// 		texcoords.push_back(v.texcoord);
-// 	}
+	/* STLs have no colors or texture coordinates */
+	colors.assign(numVertices, Vertex().color);
+	texCoords.assign(numVertices, glm::vec2(0.0f));
 
-// 	cleanup();
-// 	createPointBuffer(allow_edits, submit_immediately);
-// 	createColorBuffer(allow_edits, submit_immediately);
-// 	createTriangleIndexBuffer(allow_edits, submit_immediately);
-// 	createNormalBuffer(allow_edits, submit_immediately);
-// 	createTexCoordBuffer(allow_edits, submit_immediately);
-// 	compute_metadata(submit_immediately);
-// }
+	computeMetadata();
+	markDirty();
+}
 
 // void Mesh::load_glb(std::string glbPath)
 // {
@@ -1010,7 +1226,8 @@ void Mesh::loadData(
 	std::vector<glm::vec4> &normals_, 
 	std::vector<glm::vec4> &colors_, 
 	std::vector<glm::vec2> &texcoords_, 
-	std::vector<uint32_t> indices_
+	std::vector<uint32_t> indices_,
+	bool optimize
 )
 {
 	bool readingNormals = normals_.size() > 0;
@@ -1061,16 +1278,16 @@ void Mesh::loadData(
 
 	/* Don't bin positions as unique when editing, since it's unexpected for a user to lose positions */
 	bool allow_edits = false; // temporary...
-	if ((allow_edits && !readingIndices) || (!readingNormals)) {
+	if (readingIndices) {
+		triangleIndices = indices_;
+		uniqueVertices = vertices;
+	}
+	else if (allow_edits || (!readingNormals)) {
 		uniqueVertices = vertices;
 		for (int i = 0; i < vertices.size(); ++i) {
 			triangleIndices.push_back(i);
 		}
 	}
-	else if (readingIndices) {
-		triangleIndices = indices_;
-		uniqueVertices = vertices;
-	}
 	/* If indices werent supplied and editing isn't allowed, optimize by binning unique verts */
 	else {    
 		for (int i = 0; i < vertices.size(); ++i)
@@ -1099,6 +1316,10 @@ void Mesh::loadData(
 		generateSmoothNormals();
 	}
 
+	if (optimize) {
+		optimizeForLocality();
+	}
+
 	computeMetadata();
 	markDirty();
 }
@@ -1248,6 +1469,84 @@ void Mesh::generateSmoothNormals()
 	markDirty();
 }
 
+void Mesh::optimizeForLocality()
+{
+	if (triangleIndices.size() < 3) return;
+
+	/* Reorder triangles so that nearby triangles share recently used vertices */
+	triangleIndices = forsyth::reorderTriangles(triangleIndices, uint32_t(positions.size()));
+
+	/* Then remap vertices into first use order, so that vertex fetches walk memory linearly */
+	const uint32_t unused = std::numeric_limits<uint32_t>::max();
+	std::vector<uint32_t> remap(positions.size(), unused);
+	uint32_t nextVertex = 0;
+	for (auto &index : triangleIndices) {
+		if (remap[index] == unused) remap[index] = nextVertex++;
+		index = remap[index];
+	}
+
+	/* Vertices not referenced by any triangle are kept, but moved to the end */
+	for (auto &r : remap) if (r == unused) r = nextVertex++;
+
+	auto permute = [&remap] (auto &list) {
+		if (list.size() != remap.size()) return;
+		auto reordered = list;
+		for (uint32_t i = 0; i < remap.size(); ++i) reordered[remap[i]] = list[i];
+		list.swap(reordered);
+	};
+	permute(positions);
+	permute(normals);
+	permute(colors);
+	permute(texCoords);
+
+	markDirty();
+}
+
+float Mesh::getAverageCacheMissRatio(uint32_t cacheSize)
+{
+	uint32_t numTris = uint32_t(triangleIndices.size() / 3);
+	if (numTris == 0 || cacheSize == 0) return 0.f;
+
+	/* Simulates a FIFO post transform cache, as found in most hardware */
+	std::vector<uint32_t> timestamps(positions.size(), 0);
+	uint32_t time = cacheSize + 1;
+	uint32_t misses = 0;
+	for (auto index : triangleIndices) {
+		if (time - timestamps[index] > cacheSize) {
+			timestamps[index] = time++;
+			misses++;
+		}
+	}
+	return float(misses) / float(numTris);
+}
+
+float Mesh::getVertexFetchRatio()
+{
+	if (triangleIndices.size() == 0) return 0.f;
+
+	/* Simulates a small direct mapped cache with 64 byte lines over the position buffer.
+	   A ratio of 1.0 means every referenced vertex was fetched exactly once. */
+	const uint32_t lineSize = 64;
+	const uint32_t numLines = 256;
+	const uint64_t empty = std::numeric_limits<uint64_t>::max();
+	std::vector<uint64_t> tags(numLines, empty);
+	std::vector<bool> referenced(positions.size(), false);
+	uint64_t bytesFetched = 0;
+	uint32_t numReferenced = 0;
+	for (auto index : triangleIndices) {
+		if (!referenced[index]) { referenced[index] = true; numReferenced++; }
+		uint64_t start = uint64_t(index) * sizeof(glm::vec4);
+		uint64_t end = start + sizeof(glm::vec4) - 1;
+		for (uint64_t line = start / lineSize; line <= end / lineSize; ++line) {
+			if (tags[line % numLines] != line) {
+				tags[line % numLines] = line;
+				bytesFetched += lineSize;
+			}
+		}
+	}
+	return float(bytesFetched) / float(uint64_t(numReferenced) * sizeof(glm::vec4));
+}
+
 // void Mesh::edit_vertex_color(uint32_t index, glm::vec4 new_color)
 // {
 // 	auto vulkan = Libraries::Vulkan::Get();
@@ -1505,112 +1804,122 @@ std::shared_ptr<std::mutex> Mesh::getEditMutex()
 	return editMutex;
 }
 
+const std::vector<glm::vec4> &Mesh::getVerticesRef()
+{
+	return positions;
+}
+
+const std::vector<uint32_t> &Mesh::getTriangleIndicesRef()
+{
+	return triangleIndices;
+}
+
 /* Static Factory Implementations */
 Mesh* Mesh::get(std::string name) {
-	return StaticFactory::get(editMutex, name, "Mesh", lookupTable, meshes, MAX_MESHES);
+	return StaticFactory::get(editMutex, name, "Mesh", lookupTable, meshes);
 }
 
 Mesh* Mesh::createBox(std::string name, glm::vec3 size, glm::ivec3 segments)
 {
-	auto mesh = StaticFactory::create(editMutex, name, "Mesh", lookupTable, meshes, MAX_MESHES);
+	auto mesh = StaticFactory::create(editMutex, name, "Mesh", lookupTable, meshes);
 	try {
 		generator::BoxMesh gen_mesh{size, segments};
 		mesh->generateProcedural(gen_mesh, /* flip z = */ false);
 		anyDirty = true;
 		return mesh;
 	} catch (...) {
-		StaticFactory::removeIfExists(editMutex, name, "Mesh", lookupTable, meshes, MAX_MESHES);
+		StaticFactory::removeIfExists(editMutex, name, "Mesh", lookupTable, meshes);
 		throw;
 	}
 }
 
 Mesh* Mesh::createCappedCone(std::string name, float radius, float size, int slices, int segments, int rings, float start, float sweep)
 {
-	auto mesh = StaticFactory::create(editMutex, name, "Mesh", lookupTable, meshes, MAX_MESHES);
+	auto mesh = StaticFactory::create(editMutex, name, "Mesh", lookupTable, meshes);
 	try {
 		generator::CappedConeMesh gen_mesh{radius, size, slices, segments, rings, start, sweep};
 		mesh->generateProcedural(gen_mesh, /* flip z = */ false);
 		anyDirty = true;
 		return mesh;
 	} catch (...) {
-		StaticFactory::removeIfExists(editMutex, name, "Mesh", lookupTable, meshes, MAX_MESHES);
+		StaticFactory::removeIfExists(editMutex, name, "Mesh", lookupTable, meshes);
 		throw;
 	}
 }
 
 Mesh* Mesh::createCappedCylinder(std::string name, float radius, float size, int slices, int segments, int rings, float start, float sweep)
 {
-	auto mesh = StaticFactory::create(editMutex, name, "Mesh", lookupTable, meshes, MAX_MESHES);
+	auto mesh = StaticFactory::create(editMutex, name, "Mesh", lookupTable, meshes);
 	try {		
 		generator::CappedCylinderMesh gen_mesh{radius, size, slices, segments, rings, start, sweep};
 		mesh->generateProcedural(gen_mesh, /* flip z = */ false);
 		anyDirty = true;
 		return mesh;
 	} catch (...) {
-		StaticFactory::removeIfExists(editMutex, name, "Mesh", lookupTable, meshes, MAX_MESHES);
+		StaticFactory::removeIfExists(editMutex, name, "Mesh", lookupTable, meshes);
 		throw;
 	}
 }
 
 Mesh* Mesh::createCappedTube(std::string name, float radius, float innerRadius, float size, int slices, int segments, int rings, float start, float sweep)
 {
-	auto mesh = StaticFactory::create(editMutex, name, "Mesh", lookupTable, meshes, MAX_MESHES);
+	auto mesh = StaticFactory::create(editMutex, name, "Mesh", lookupTable, meshes);
 	try {
 		generator::CappedTubeMesh gen_mesh{radius, innerRadius, size, slices, segments, rings, start, sweep};
 		mesh->generateProcedural(gen_mesh, /* flip z = */ false);
 		anyDirty = true;
 		return mesh;
 	} catch (...) {
-		StaticFactory::removeIfExists(editMutex, name, "Mesh", lookupTable, meshes, MAX_MESHES);
+		StaticFactory::removeIfExists(editMutex, name, "Mesh", lookupTable, meshes);
 		throw;
 	}
 }
 
 Mesh* Mesh::createCapsule(std::string name, float radius, float size, int slices, int segments, int rings, float start, float sweep)
 {
-	auto mesh = StaticFactory::create(editMutex, name, "Mesh", lookupTable, meshes, MAX_MESHES);
+	auto mesh = StaticFactory::create(editMutex, name, "Mesh", lookupTable, meshes);
 	try {
 		generator::CapsuleMesh gen_mesh{radius, size, slices, segments, rings, start, sweep};
 		mesh->generateProcedural(gen_mesh, /* flip z = */ false);
 		anyDirty = true;
 		return mesh;
 	} catch (...) {
-		StaticFactory::removeIfExists(editMutex, name, "Mesh", lookupTable, meshes, MAX_MESHES);
+		StaticFactory::removeIfExists(editMutex, name, "Mesh", lookupTable, meshes);
 		throw;
 	}
 } 
 
 Mesh* Mesh::createCone(std::string name, float radius, float size, int slices, int segments, float start, float sweep)
 {
-	auto mesh = StaticFactory::create(editMutex, name, "Mesh", lookupTable, meshes, MAX_MESHES);
+	auto mesh = StaticFactory::create(editMutex, name, "Mesh", lookupTable, meshes);
 	try {
 		generator::ConeMesh gen_mesh{radius, size, slices, segments, start, sweep};
 		mesh->generateProcedural(gen_mesh, /* flip z = */ false);
 		anyDirty = true;
 		return mesh;
 	} catch (...) {
-		StaticFactory::removeIfExists(editMutex, name, "Mesh", lookupTable, meshes, MAX_MESHES);
+		StaticFactory::removeIfExists(editMutex, name, "Mesh", lookupTable, meshes);
 		throw;
 	}
 }
  
 Mesh* Mesh::createConvexPolygonFromCircle(std::string name, float radius, int sides, int segments, int rings)
 {
-	auto mesh = StaticFactory::create(editMutex, name, "Mesh", lookupTable, meshes, MAX_MESHES);
+	auto mesh = StaticFactory::create(editMutex, name, "Mesh", lookupTable, meshes);
 	try {
 		generator::ConvexPolygonMesh gen_mesh{radius, sides, segments, rings};
 		mesh->generateProcedural(gen_mesh, /* flip z = */ false);
 		anyDirty = true;
 		return mesh;
 	} catch (...) {
-		StaticFactory::removeIfExists(editMutex, name, "Mesh", lookupTable, meshes, MAX_MESHES);
+		StaticFactory::removeIfExists(editMutex, name, "Mesh", lookupTable, meshes);
 		throw;
 	}
 }
 
 Mesh* Mesh::createConvexPolygon(std::string name, std::vector<glm::vec2> vertices, int segments, int rings)
 {
-	auto mesh = StaticFactory::create(editMutex, name, "Mesh", lookupTable, meshes, MAX_MESHES);
+	auto mesh = StaticFactory::create(editMutex, name, "Mesh", lookupTable, meshes);
 	try {
 		std::vector<dvec2> verts;
 		for (uint32_t i = 0; i < vertices.size(); ++i) verts.push_back(dvec2(vertices[i]));
@@ -1619,91 +1928,91 @@ Mesh* Mesh::createConvexPolygon(std::string name, std::vector<glm::vec2> vertice
 		anyDirty = true;
 		return mesh;
 	} catch (...) {
-		StaticFactory::removeIfExists(editMutex, name, "Mesh", lookupTable, meshes, MAX_MESHES);
+		StaticFactory::removeIfExists(editMutex, name, "Mesh", lookupTable, meshes);
 		throw;
 	}
 }
 
 Mesh* Mesh::createCylinder(std::string name, float radius, float size, int slices, int segments, float start, float sweep)
 {
-	auto mesh = StaticFactory::create(editMutex, name, "Mesh", lookupTable, meshes, MAX_MESHES);
+	auto mesh = StaticFactory::create(editMutex, name, "Mesh", lookupTable, meshes);
 	try {
 		generator::CylinderMesh gen_mesh{radius, size, slices, segments, start, sweep};
 		mesh->generateProcedural(gen_mesh, /* flip z = */ false);
 		anyDirty = true;
 		return mesh;
 	} catch (...) {
-		StaticFactory::removeIfExists(editMutex, name, "Mesh", lookupTable, meshes, MAX_MESHES);
+		StaticFactory::removeIfExists(editMutex, name, "Mesh", lookupTable, meshes);
 		throw;
 	}
 }
 
 Mesh* Mesh::createDisk(std::string name, float radius, float innerRadius, int slices, int rings, float start, float sweep)
 {
-	auto mesh = StaticFactory::create(editMutex, name, "Mesh", lookupTable, meshes, MAX_MESHES);
+	auto mesh = StaticFactory::create(editMutex, name, "Mesh", lookupTable, meshes);
 	try {
 		generator::DiskMesh gen_mesh{radius, innerRadius, slices, rings, start, sweep};
 		mesh->generateProcedural(gen_mesh, /* flip z = */ false);
 		anyDirty = true;
 		return mesh;
 	} catch (...) {
-		StaticFactory::removeIfExists(editMutex, name, "Mesh", lookupTable, meshes, MAX_MESHES);
+		StaticFactory::removeIfExists(editMutex, name, "Mesh", lookupTable, meshes);
 		throw;
 	}
 }
 
 Mesh* Mesh::createDodecahedron(std::string name, float radius, int segments, int rings)
 {
-	auto mesh = StaticFactory::create(editMutex, name, "Mesh", lookupTable, meshes, MAX_MESHES);
+	auto mesh = StaticFactory::create(editMutex, name, "Mesh", lookupTable, meshes);
 	try {
 		generator::DodecahedronMesh gen_mesh{radius, segments, rings};
 		mesh->generateProcedural(gen_mesh, /* flip z = */ false);
 		anyDirty = true;
 		return mesh;
 	} catch (...) {
-		StaticFactory::removeIfExists(editMutex, name, "Mesh", lookupTable, meshes, MAX_MESHES);
+		StaticFactory::removeIfExists(editMutex, name, "Mesh", lookupTable, meshes);
 		throw;
 	}
 }
 
 Mesh* Mesh::createPlane(std::string name, vec2 size, ivec2 segments)
 {
-	auto mesh = StaticFactory::create(editMutex, name, "Mesh", lookupTable, meshes, MAX_MESHES);
+	auto mesh = StaticFactory::create(editMutex, name, "Mesh", lookupTable, meshes);
 	try {
 		generator::PlaneMesh gen_mesh{size, segments};
 		mesh->generateProcedural(gen_mesh, /* flip z = */ false);
 		anyDirty = true;
 		return mesh;
 	} catch (...) {
-		StaticFactory::removeIfExists(editMutex, name, "Mesh", lookupTable, meshes, MAX_MESHES);
+		StaticFactory::removeIfExists(editMutex, name, "Mesh", lookupTable, meshes);
 		throw;
 	}
 }
 
 Mesh* Mesh::createIcosahedron(std::string name, float radius, int segments)
 {
-	auto mesh = StaticFactory::create(editMutex, name, "Mesh", lookupTable, meshes, MAX_MESHES);
+	auto mesh = StaticFactory::create(editMutex, name, "Mesh", lookupTable, meshes);
 	try {
 		generator::IcosahedronMesh gen_mesh{radius, segments};
 		mesh->generateProcedural(gen_mesh, /* flip z = */ false);
 		anyDirty = true;
 		return mesh;
 	} catch (...) {
-		StaticFactory::removeIfExists(editMutex, name, "Mesh", lookupTable, meshes, MAX_MESHES);
+		StaticFactory::removeIfExists(editMutex, name, "Mesh", lookupTable, meshes);
 		throw;
 	}
 }
 
 Mesh* Mesh::createIcosphere(std::string name, float radius, int segments)
 {
-	auto mesh = StaticFactory::create(editMutex, name, "Mesh", lookupTable, meshes, MAX_MESHES);
+	auto mesh = StaticFactory::create(editMutex, name, "Mesh", lookupTable, meshes);
 	try {
 		generator::IcoSphereMesh gen_mesh{radius, segments};
 		mesh->generateProcedural(gen_mesh, /* flip z = */ false);
 		anyDirty = true;
 		return mesh;
 	} catch (...) {
-		StaticFactory::removeIfExists(editMutex, name, "Mesh", lookupTable, meshes, MAX_MESHES);
+		StaticFactory::removeIfExists(editMutex, name, "Mesh", lookupTable, meshes);
 		throw;
 	}
 }
@@ -1711,7 +2020,7 @@ Mesh* Mesh::createIcosphere(std::string name, float radius, int segments)
 /* Might add this later. Requires a callback which defines a function mapping R2->R */
 // Mesh* Mesh::createParametricMesh(std::string name, uint32_t x_segments = 16, uint32_t y_segments = 16)
 // {
-//     auto mesh = StaticFactory::create(editMutex, name, "Mesh", lookupTable, meshes, MAX_MESHES);
+//     auto mesh = StaticFactory::create(editMutex, name, "Mesh", lookupTable, meshes);
 //     if (!mesh) return nullptr;
 //     auto gen_mesh = generator::ParametricMesh( , glm::ivec2(x_segments, y_segments));
 //     mesh->generateProcedural(gen_mesh, /* flip z = */ false);
@@ -1720,7 +2029,7 @@ Mesh* Mesh::createIcosphere(std::string name, float radius, int segments)
 
 Mesh* Mesh::createRoundedBox(std::string name, float radius, vec3 size, int slices, ivec3 segments)
 {
-	auto mesh = StaticFactory::create(editMutex, name, "Mesh", lookupTable, meshes, MAX_MESHES);
+	auto mesh = StaticFactory::create(editMutex, name, "Mesh", lookupTable, meshes);
 	try {
 		generator::RoundedBoxMesh gen_mesh{
 			radius, size, slices, segments
@@ -1729,161 +2038,161 @@ Mesh* Mesh::createRoundedBox(std::string name, float radius, vec3 size, int slic
 		anyDirty = true;
 		return mesh;
 	} catch (...) {
-		StaticFactory::removeIfExists(editMutex, name, "Mesh", lookupTable, meshes, MAX_MESHES);
+		StaticFactory::removeIfExists(editMutex, name, "Mesh", lookupTable, meshes);
 		throw;
 	}
 }
 
 Mesh* Mesh::createSphere(std::string name, float radius, int slices, int segments, float sliceStart, float sliceSweep, float segmentStart, float segmentSweep)
 {
-	auto mesh = StaticFactory::create(editMutex, name, "Mesh", lookupTable, meshes, MAX_MESHES);
+	auto mesh = StaticFactory::create(editMutex, name, "Mesh", lookupTable, meshes);
 	try {
 		generator::SphereMesh gen_mesh{radius, slices, segments, sliceStart, sliceSweep, segmentStart, segmentSweep};
 		mesh->generateProcedural(gen_mesh, /* flip z = */ false);
 		anyDirty = true;
 		return mesh;
 	} catch (...) {
-		StaticFactory::removeIfExists(editMutex, name, "Mesh", lookupTable, meshes, MAX_MESHES);
+		StaticFactory::removeIfExists(editMutex, name, "Mesh", lookupTable, meshes);
 		throw;
 	}
 }
 
 Mesh* Mesh::createSphericalCone(std::string name, float radius, float size, int slices, int segments, int rings, float start, float sweep)
 {
-	auto mesh = StaticFactory::create(editMutex, name, "Mesh", lookupTable, meshes, MAX_MESHES);
+	auto mesh = StaticFactory::create(editMutex, name, "Mesh", lookupTable, meshes);
 	try {
 		generator::SphericalConeMesh gen_mesh{radius, size, slices, segments, rings, start, sweep};
 		mesh->generateProcedural(gen_mesh, /* flip z = */ false);
 		anyDirty = true;
 		return mesh;
 	} catch (...) {
-		StaticFactory::removeIfExists(editMutex, name, "Mesh", lookupTable, meshes, MAX_MESHES);
+		StaticFactory::removeIfExists(editMutex, name, "Mesh", lookupTable, meshes);
 		throw;
 	}
 }
 
 Mesh* Mesh::createSphericalTriangleFromSphere(std::string name, float radius, int segments)
 {
-	auto mesh = StaticFactory::create(editMutex, name, "Mesh", lookupTable, meshes, MAX_MESHES);
+	auto mesh = StaticFactory::create(editMutex, name, "Mesh", lookupTable, meshes);
 	try {
 		generator::SphericalTriangleMesh gen_mesh{radius, segments};
 		mesh->generateProcedural(gen_mesh, /* flip z = */ false);
 		anyDirty = true;
 		return mesh;
 	} catch (...) {
-		StaticFactory::removeIfExists(editMutex, name, "Mesh", lookupTable, meshes, MAX_MESHES);
+		StaticFactory::removeIfExists(editMutex, name, "Mesh", lookupTable, meshes);
 		throw;
 	}
 }
 
 Mesh* Mesh::createSphericalTriangleFromTriangle(std::string name, vec3 v0, vec3 v1, vec3 v2, int segments)
 {
-	auto mesh = StaticFactory::create(editMutex, name, "Mesh", lookupTable, meshes, MAX_MESHES);
+	auto mesh = StaticFactory::create(editMutex, name, "Mesh", lookupTable, meshes);
 	try {
 		generator::SphericalTriangleMesh gen_mesh{v0, v1, v2, segments};
 		mesh->generateProcedural(gen_mesh, /* flip z = */ false);
 		anyDirty = true;
 		return mesh;
 	} catch (...) {
-		StaticFactory::removeIfExists(editMutex, name, "Mesh", lookupTable, meshes, MAX_MESHES);
+		StaticFactory::removeIfExists(editMutex, name, "Mesh", lookupTable, meshes);
 		throw;
 	}
 }
 
 Mesh* Mesh::createSpring(std::string name, float minor, float major, float size, int slices, int segments, float minorStart, float minorSweep, float majorStart, float majorSweep)
 {
-	auto mesh = StaticFactory::create(editMutex, name, "Mesh", lookupTable, meshes, MAX_MESHES);
+	auto mesh = StaticFactory::create(editMutex, name, "Mesh", lookupTable, meshes);
 	try {
 		generator::SpringMesh gen_mesh{minor, major, size, slices, segments, minorStart, minorSweep, majorStart, majorSweep};
 		mesh->generateProcedural(gen_mesh, /* flip z = */ false);
 		anyDirty = true;
 		return mesh;
 	} catch (...) {
-		StaticFactory::removeIfExists(editMutex, name, "Mesh", lookupTable, meshes, MAX_MESHES);
+		StaticFactory::removeIfExists(editMutex, name, "Mesh", lookupTable, meshes);
 		throw;
 	}
 }
 
 Mesh* Mesh::createTeapotahedron(std::string name, int segments)
 {
-	auto mesh = StaticFactory::create(editMutex, name, "Mesh", lookupTable, meshes, MAX_MESHES);
+	auto mesh = StaticFactory::create(editMutex, name, "Mesh", lookupTable, meshes);
 	try {
 		generator::TeapotMesh gen_mesh(segments);
 		mesh->generateProcedural(gen_mesh, /* flip z = */ false);
 		anyDirty = true;
 		return mesh;
 	} catch (...) {
-		StaticFactory::removeIfExists(editMutex, name, "Mesh", lookupTable, meshes, MAX_MESHES);
+		StaticFactory::removeIfExists(editMutex, name, "Mesh", lookupTable, meshes);
 		throw;
 	}
 }
 
 Mesh* Mesh::createTorus(std::string name, float minor, float major, int slices, int segments, float minorStart, float minorSweep, float majorStart, float majorSweep)
 {
-	auto mesh = StaticFactory::create(editMutex, name, "Mesh", lookupTable, meshes, MAX_MESHES);
+	auto mesh = StaticFactory::create(editMutex, name, "Mesh", lookupTable, meshes);
 	try {
 		generator::TorusMesh gen_mesh{minor, major, slices, segments, minorStart, minorSweep, majorStart, majorSweep};
 		mesh->generateProcedural(gen_mesh, /* flip z = */ false);
 		anyDirty = true;
 		return mesh;
 	} catch (...) {
-		StaticFactory::removeIfExists(editMutex, name, "Mesh", lookupTable, meshes, MAX_MESHES);
+		StaticFactory::removeIfExists(editMutex, name, "Mesh", lookupTable, meshes);
 		throw;
 	}
 }
 
 Mesh* Mesh::createTorusKnot(std::string name, int p, int q, int slices, int segments)
 {
-	auto mesh = StaticFactory::create(editMutex, name, "Mesh", lookupTable, meshes, MAX_MESHES);
+	auto mesh = StaticFactory::create(editMutex, name, "Mesh", lookupTable, meshes);
 	try {
 		generator::TorusKnotMesh gen_mesh{p, q, slices, segments};
 		mesh->generateProcedural(gen_mesh, /* flip z = */ false);
 		anyDirty = true;
 		return mesh;
 	} catch (...) {
-		StaticFactory::removeIfExists(editMutex, name, "Mesh", lookupTable, meshes, MAX_MESHES);
+		StaticFactory::removeIfExists(editMutex, name, "Mesh", lookupTable, meshes);
 		throw;
 	}
 }
 
 Mesh* Mesh::createTriangleFromCircumscribedCircle(std::string name, float radius, int segments)
 {
-	auto mesh = StaticFactory::create(editMutex, name, "Mesh", lookupTable, meshes, MAX_MESHES);
+	auto mesh = StaticFactory::create(editMutex, name, "Mesh", lookupTable, meshes);
 	try {
 		generator::TriangleMesh gen_mesh{radius, segments};
 		mesh->generateProcedural(gen_mesh, /* flip z = */ false);
 		anyDirty = true;
 		return mesh;
 	} catch (...) {
-		StaticFactory::removeIfExists(editMutex, name, "Mesh", lookupTable, meshes, MAX_MESHES);
+		StaticFactory::removeIfExists(editMutex, name, "Mesh", lookupTable, meshes);
 		throw;
 	}
 }
 
 Mesh* Mesh::createTriangle(std::string name, vec3 v0, vec3 v1, vec3 v2, int segments)
 {
-	auto mesh = StaticFactory::create(editMutex, name, "Mesh", lookupTable, meshes, MAX_MESHES);
+	auto mesh = StaticFactory::create(editMutex, name, "Mesh", lookupTable, meshes);
 	try {
 		generator::TriangleMesh gen_mesh{v0, v1, v2, segments};
 		mesh->generateProcedural(gen_mesh, /* flip z = */ false);
 		anyDirty = true;
 		return mesh;
 	} catch (...) {
-		StaticFactory::removeIfExists(editMutex, name, "Mesh", lookupTable, meshes, MAX_MESHES);
+		StaticFactory::removeIfExists(editMutex, name, "Mesh", lookupTable, meshes);
 		throw;
 	}
 }
 
 Mesh* Mesh::createTube(std::string name, float radius, float innerRadius, float size, int slices, int segments, float start, float sweep)
 {
-	auto mesh = StaticFactory::create(editMutex, name, "Mesh", lookupTable, meshes, MAX_MESHES);
+	auto mesh = StaticFactory::create(editMutex, name, "Mesh", lookupTable, meshes);
 	try {
 		generator::TubeMesh gen_mesh{radius, innerRadius, size, slices, segments, start, sweep};
 		mesh->generateProcedural(gen_mesh, /* flip z = */ false);
 		anyDirty = true;
 		return mesh;
 	} catch (...) {
-		StaticFactory::removeIfExists(editMutex, name, "Mesh", lookupTable, meshes, MAX_MESHES);
+		StaticFactory::removeIfExists(editMutex, name, "Mesh", lookupTable, meshes);
 		throw;
 	}
 }
@@ -1894,7 +2203,7 @@ Mesh* Mesh::createTubeFromPolyline(std::string name, std::vector<glm::vec3> posi
 		throw std::runtime_error("Error: positions must be greater than 1!");
 	
 	using namespace generator;
-	auto mesh = StaticFactory::create(editMutex, name, "Mesh", lookupTable, meshes, MAX_MESHES);
+	auto mesh = StaticFactory::create(editMutex, name, "Mesh", lookupTable, meshes);
 	try {		
 		ParametricPath parametricPath {
 			[positions](double t) {
@@ -1933,7 +2242,7 @@ Mesh* Mesh::createTubeFromPolyline(std::string name, std::vector<glm::vec3> posi
 		anyDirty = true;
 		return mesh;
 	} catch (...) {
-		StaticFactory::removeIfExists(editMutex, name, "Mesh", lookupTable, meshes, MAX_MESHES);
+		StaticFactory::removeIfExists(editMutex, name, "Mesh", lookupTable, meshes);
 		throw;
 	}
 }
@@ -1944,7 +2253,7 @@ Mesh* Mesh::createRoundedRectangleTubeFromPolyline(std::string name, std::vector
 		throw std::runtime_error("Error: positions must be greater than 1!");
 	
 	using namespace generator;
-	auto mesh = StaticFactory::create(editMutex, name, "Mesh", lookupTable, meshes, MAX_MESHES);
+	auto mesh = StaticFactory::create(editMutex, name, "Mesh", lookupTable, meshes);
 	try {
 		
 		ParametricPath parametricPath {
@@ -1984,7 +2293,7 @@ Mesh* Mesh::createRoundedRectangleTubeFromPolyline(std::string name, std::vector
 		anyDirty = true;
 		return mesh;
 	} catch (...) {
-		StaticFactory::removeIfExists(editMutex, name, "Mesh", lookupTable, meshes, MAX_MESHES);
+		StaticFactory::removeIfExists(editMutex, name, "Mesh", lookupTable, meshes);
 		throw;
 	}
 }
@@ -1995,7 +2304,7 @@ Mesh* Mesh::createRectangleTubeFromPolyline(std::string name, std::vector<glm::v
 		throw std::runtime_error("Error: positions must be greater than 1!");
 	
 	using namespace generator;
-	auto mesh = StaticFactory::create(editMutex, name, "Mesh", lookupTable, meshes, MAX_MESHES);
+	auto mesh = StaticFactory::create(editMutex, name, "Mesh", lookupTable, meshes);
 	try {
 		ParametricPath parametricPath {
 			[positions](double t) {
@@ -2034,61 +2343,62 @@ Mesh* Mesh::createRectangleTubeFromPolyline(std::string name, std::vector<glm::v
 		anyDirty = true;
 		return mesh;
 	} catch (...) {
-		StaticFactory::removeIfExists(editMutex, name, "Mesh", lookupTable, meshes, MAX_MESHES);
+		StaticFactory::removeIfExists(editMutex, name, "Mesh", lookupTable, meshes);
 		throw;
 	}
 }
 
 
-Mesh* Mesh::createFromObj(std::string name, std::string path)
+Mesh* Mesh::createFromObj(std::string name, std::string path, bool optimize)
 {
-	auto create = [path] (Mesh* mesh) {
-		mesh->loadObj(path);
+	auto create = [path, optimize] (Mesh* mesh) {
+		mesh->loadObj(path, optimize);
 	};
 	
 	try {
-		return StaticFactory::create<Mesh>(editMutex, name, "Mesh", lookupTable, meshes, MAX_MESHES, create);
+		return StaticFactory::create<Mesh>(editMutex, name, "Mesh", lookupTable, meshes, create);
 	} catch (...) {
-		StaticFactory::removeIfExists(editMutex, name, "Mesh", lookupTable, meshes, MAX_MESHES);
+		StaticFactory::removeIfExists(editMutex, name, "Mesh", lookupTable, meshes);
 		throw;
 	}
 }
 
-// Mesh* Mesh::createFromStl(std::string name, std::string stlPath)
-// {
-// 	auto mesh = StaticFactory::create(editMutex, name, "Mesh", lookupTable, meshes, MAX_MESHES);
-// 	try {
-// 		mesh->load_stl(stlPath, allow_edits, submit_immediately);
-// 		anyDirty = true;
-// 		return mesh;
-// 	} catch (...) {
-// 		StaticFactory::removeIfExists(editMutex, name, "Mesh", lookupTable, meshes, MAX_MESHES);
-// 		throw;
-// 	}
-// }
+Mesh* Mesh::createFromStl(std::string name, std::string path)
+{
+	auto create = [path] (Mesh* mesh) {
+		mesh->loadStl(path);
+	};
+	
+	try {
+		return StaticFactory::create<Mesh>(editMutex, name, "Mesh", lookupTable, meshes, create);
+	} catch (...) {
+		StaticFactory::removeIfExists(editMutex, name, "Mesh", lookupTable, meshes);
+		throw;
+	}
+}
 
 // Mesh* Mesh::createFromGlb(std::string name, std::string glbPath)
 // {
-// 	auto mesh = StaticFactory::create(editMutex, name, "Mesh", lookupTable, meshes, MAX_MESHES);
+// 	auto mesh = StaticFactory::create(editMutex, name, "Mesh", lookupTable, meshes);
 // 	try {
 // 		mesh->load_glb(glbPath, allow_edits, submit_immediately);
 // 		anyDirty = true;
 // 		return mesh;
 // 	} catch (...) {
-// 		StaticFactory::removeIfExists(editMutex, name, "Mesh", lookupTable, meshes, MAX_MESHES);
+// 		StaticFactory::removeIfExists(editMutex, name, "Mesh", lookupTable, meshes);
 // 		throw;
 // 	}
 // }
 
 // Mesh* Mesh::createFromTetgen(std::string name, std::string path)
 // {
-// 	auto mesh = StaticFactory::create(editMutex, name, "Mesh", lookupTable, meshes, MAX_MESHES);
+// 	auto mesh = StaticFactory::create(editMutex, name, "Mesh", lookupTable, meshes);
 // 	try {
 // 		mesh->load_tetgen(path, allow_edits, submit_immediately);
 // 		anyDirty = true;
 // 		return mesh;
 // 	} catch (...) {
-// 		StaticFactory::removeIfExists(editMutex, name, "Mesh", lookupTable, meshes, MAX_MESHES);
+// 		StaticFactory::removeIfExists(editMutex, name, "Mesh", lookupTable, meshes);
 // 		throw;
 // 	}
 // }
@@ -2099,36 +2409,67 @@ Mesh* Mesh::createFromData (
 	std::vector<glm::vec4> normals, 
 	std::vector<glm::vec4> colors, 
 	std::vector<glm::vec2> texcoords, 
-	std::vector<uint32_t> indices
+	std::vector<uint32_t> indices,
+	bool optimize
+) {
+	auto create = [&positions, &normals, &colors, &texcoords, &indices, optimize] (Mesh* mesh) {
+		mesh->loadData(positions, normals, colors, texcoords, indices, optimize);
+	};
+	
+	try {
+		return StaticFactory::create<Mesh>(editMutex, name, "Mesh", lookupTable, meshes, create);
+	} catch (...) {
+		StaticFactory::removeIfExists(editMutex, name, "Mesh", lookupTable, meshes);
+		throw;
+	}
+}
+
+Mesh* Mesh::createUnique (
+	std::string prefix,
+	std::vector<glm::vec4> positions, 
+	std::vector<glm::vec4> normals, 
+	std::vector<glm::vec4> colors, 
+	std::vector<glm::vec2> texcoords, 
+	std::vector<uint32_t> indices,
+	bool optimize
 ) {
-	auto create = [&positions, &normals, &colors, &texcoords, &indices] (Mesh* mesh) {
-		mesh->loadData(positions, normals, colors, texcoords, indices);
+	/* The unique name is only known once the mesh is reserved, so keep it in case loading fails */
+	std::string name;
+	auto create = [&name, &positions, &normals, &colors, &texcoords, &indices, optimize] (Mesh* mesh) {
+		name = mesh->getName();
+		mesh->loadData(positions, normals, colors, texcoords, indices, optimize);
 	};
 	
 	try {
-		return StaticFactory::create<Mesh>(editMutex, name, "Mesh", lookupTable, meshes, MAX_MESHES, create);
+		return StaticFactory::createUnique<Mesh>(editMutex, prefix, "Mesh", lookupTable, meshes, create);
 	} catch (...) {
-		StaticFactory::removeIfExists(editMutex, name, "Mesh", lookupTable, meshes, MAX_MESHES);
+		if (!name.empty()) StaticFactory::removeIfExists(editMutex, name, "Mesh", lookupTable, meshes);
 		throw;
 	}
 }
 
 void Mesh::remove(std::string name) {
-	StaticFactory::remove(editMutex, name, "Mesh", lookupTable, meshes, MAX_MESHES);
+	StaticFactory::remove(editMutex, name, "Mesh", lookupTable, meshes);
 	anyDirty = true;
 }
 
-MeshStruct* Mesh::getFrontStruct()
+PagedArray<MeshStruct> &Mesh::getFrontStruct()
 {
 	return meshStructs;
 }
 
-Mesh* Mesh::getFront() {
+PagedArray<Mesh> &Mesh::getFront() {
 	return meshes;
 }
 
 uint32_t Mesh::getCount() {
-	return MAX_MESHES;
+	return meshes.size();
+}
+
+void Mesh::reserveTables(uint32_t count)
+{
+	meshes.reserve(count);
+	meshStructs.reserve(count);
 }
 
 std::string Mesh::getName()
@@ -2136,7 +2477,7 @@ std::string Mesh::getName()
     return name;
 }
 
-std::map<std::string, uint32_t> Mesh::getNameToIdMap()
+const NameTable &Mesh::getNameToIdMap()
 {
 	return lookupTable;
 }
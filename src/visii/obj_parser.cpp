@@ -0,0 +1,533 @@
+#include <visii/utilities/obj_parser.h>
+#include <visii/utilities/mapped_file.h>
+#include <visii/utilities/parallel.h>
+
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+#include <limits>
+#include <map>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+namespace {
+
+const uint32_t INHERIT_SMOOTHING = std::numeric_limits<uint32_t>::max();
+
+/* A state change which must be replayed in file order while merging chunks */
+struct ObjEvent {
+    uint64_t triOffset; // number of triangles in the chunk preceding this event
+    char type;          // 'm' usemtl, 'l' mtllib, 'g' group, 'o' object
+    std::string arg;
+};
+
+struct ObjChunk {
+    const char *begin = nullptr, *end = nullptr;
+    uint64_t numV = 0, numVn = 0, numVt = 0;
+    uint64_t offsetV = 0, offsetVn = 0, offsetVt = 0;
+    bool hasColors = false;                  // a vertex statement has more than three values
+
+    std::vector<tinyobj::index_t> corners;   // three per triangle
+    std::vector<uint32_t> smoothing;         // one per triangle
+    std::vector<ObjEvent> events;
+    uint32_t finalSmoothing = INHERIT_SMOOTHING;
+    std::string error;
+};
+
+inline bool isSpace(char c) { return c == ' ' || c == '\t'; }
+
+inline const char* skipSpace(const char *p, const char *end) {
+    while (p < end && isSpace(*p)) ++p;
+    return p;
+}
+
+/* Returns the rest of the line, without leading or trailing whitespace */
+inline std::string restOfLine(const char *p, const char *end) {
+    p = skipSpace(p, end);
+    while (end > p && (isSpace(end[-1]) || end[-1] == '\r')) --end;
+    return std::string(p, end);
+}
+
+/* A fast float parser. Falls back to strtod for anything unusual (eg nan, inf, hex floats) */
+inline bool parseFloat(const char *&p, const char *end, float &out)
+{
+    static const double powersOfTen[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+
+    p = skipSpace(p, end);
+    if (p >= end || *p == '\r') return false;
+
+    const char *start = p;
+    bool negative = false;
+    if (*p == '-' || *p == '+') { negative = (*p == '-'); ++p; }
+
+    uint64_t mantissa = 0;
+    int exponent = 0, numDigits = 0;
+    while (p < end && *p >= '0' && *p <= '9') {
+        if (numDigits < 19) { mantissa = mantissa * 10 + uint64_t(*p - '0'); numDigits += (mantissa != 0); }
+        else exponent++;
+        ++p;
+    }
+    bool hasDigits = (p != start) && !(p == start + 1 && (*start == '-' || *start == '+'));
+    if (p < end && *p == '.') {
+        ++p;
+        const char *fraction = p;
+        while (p < end && *p >= '0' && *p <= '9') {
+            if (numDigits < 19) { mantissa = mantissa * 10 + uint64_t(*p - '0'); numDigits += (mantissa != 0); exponent--; }
+            ++p;
+        }
+        hasDigits |= (p != fraction);
+    }
+    if (hasDigits && p < end && (*p == 'e' || *p == 'E')) {
+        const char *e = p + 1;
+        bool negativeExponent = false;
+        if (e < end && (*e == '-' || *e == '+')) { negativeExponent = (*e == '-'); ++e; }
+        if (e < end && *e >= '0' && *e <= '9') {
+            int value = 0;
+            while (e < end && *e >= '0' && *e <= '9') { if (value < 10000) value = value * 10 + (*e - '0'); ++e; }
+            exponent += negativeExponent ? -value : value;
+            p = e;
+        }
+    }
+
+    bool terminated = (p >= end) || isSpace(*p) || *p == '\r';
+    if (!hasDigits || !terminated) {
+        /* Unusual input, let the standard library handle it */
+        const char *tokenEnd = start;
+        while (tokenEnd < end && !isSpace(*tokenEnd) && *tokenEnd != '\r') ++tokenEnd;
+        std::string token(start, tokenEnd);
+        char *parsedEnd = nullptr;
+        double value = strtod(token.c_str(), &parsedEnd);
+        p = tokenEnd;
+        if (parsedEnd == token.c_str()) { out = 0.0f; return true; }
+        out = float(value);
+        return true;
+    }
+
+    double value = double(mantissa);
+    if (exponent < 0) value = (exponent >= -22) ? value / powersOfTen[-exponent] : value * pow(10.0, exponent);
+    else if (exponent > 0) value = (exponent <= 22) ? value * powersOfTen[exponent] : value * pow(10.0, exponent);
+    out = float(negative ? -value : value);
+    return true;
+}
+
+inline float parseFloatOr(const char *&p, const char *end, float fallback) {
+    float value;
+    return parseFloat(p, end, value) ? value : fallback;
+}
+
+inline int parseInt(const char *&p, const char *end) {
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) { negative = (*p == '-'); ++p; }
+    int value = 0;
+    while (p < end && *p >= '0' && *p <= '9') { value = value * 10 + (*p - '0'); ++p; }
+    return negative ? -value : value;
+}
+
+/* Same rules as tinyobj: 1 based, negative values are relative to the current count, zero is invalid */
+inline bool fixIndex(int idx, uint64_t count, int &result) {
+    if (idx > 0) { result = idx - 1; return true; }
+    if (idx < 0) { result = int(int64_t(count) + idx); return true; }
+    return false;
+}
+
+inline bool lineStartsWith(const char *p, const char *end, const char *keyword, size_t length) {
+    return (size_t(end - p) > length) && (strncmp(p, keyword, length) == 0) && isSpace(p[length]);
+}
+
+/* Calls func(lineBegin, lineEnd) for every line in [begin, end), with leading whitespace removed */
+template<class Func>
+inline void forEachLine(const char *begin, const char *end, Func func) {
+    const char *p = begin;
+    while (p < end) {
+        const char *newline = (const char*) memchr(p, '\n', size_t(end - p));
+        const char *lineEnd = newline ? newline : end;
+        const char *line = skipSpace(p, lineEnd);
+        if (line < lineEnd && *line != '#' && *line != '\r') func(line, lineEnd);
+        p = lineEnd + 1;
+    }
+}
+
+/* Whether the values after a vertex statement's keyword go past x, y and z */
+inline bool hasMoreThanThreeValues(const char *p, const char *end) {
+    for (int values = 0; values < 4; ++values) {
+        p = skipSpace(p, end);
+        if (p >= end || *p == '\r' || *p == '#') return false;
+        while (p < end && !isSpace(*p) && *p != '\r') ++p;
+    }
+    return true;
+}
+
+void countVertices(ObjChunk &chunk) {
+    forEachLine(chunk.begin, chunk.end, [&chunk] (const char *line, const char *lineEnd) {
+        if (line[0] != 'v' || (lineEnd - line) < 2) return;
+        if (isSpace(line[1])) {
+            chunk.numV++;
+            if (!chunk.hasColors) chunk.hasColors = hasMoreThanThreeValues(line + 2, lineEnd);
+        }
+        else if (line[1] == 'n' && (lineEnd - line) > 2 && isSpace(line[2])) chunk.numVn++;
+        else if (line[1] == 't' && (lineEnd - line) > 2 && isSpace(line[2])) chunk.numVt++;
+    });
+}
+
+/* Vertex and face statements can be parsed in separate passes. Vertex statements are always counted,
+   so that relative face indices resolve correctly */
+void parseChunk(ObjChunk &chunk, tinyobj::attrib_t &attrib, bool parseVertices, bool parseFaces) {
+    uint64_t v = chunk.offsetV, vn = chunk.offsetVn, vt = chunk.offsetVt;
+    uint32_t smoothing = INHERIT_SMOOTHING;
+    std::vector<tinyobj::index_t> face;
+
+    forEachLine(chunk.begin, chunk.end, [&] (const char *line, const char *lineEnd) {
+        if (!chunk.error.empty()) return;
+
+        if (line[0] == 'v' && (lineEnd - line) > 1 && isSpace(line[1])) {
+            if (!parseVertices) { v++; return; }
+            const char *p = line + 2;
+            float *pos = &attrib.vertices[v * 3];
+            pos[0] = parseFloatOr(p, lineEnd, 0.0f);
+            pos[1] = parseFloatOr(p, lineEnd, 0.0f);
+            pos[2] = parseFloatOr(p, lineEnd, 0.0f);
+            if (!attrib.colors.empty()) {
+                float *color = &attrib.colors[v * 3];
+                color[0] = parseFloatOr(p, lineEnd, 1.0f);
+                color[1] = parseFloatOr(p, lineEnd, 1.0f);
+                color[2] = parseFloatOr(p, lineEnd, 1.0f);
+            }
+            v++;
+        }
+        else if (lineStartsWith(line, lineEnd, "vn", 2)) {
+            if (!parseVertices) { vn++; return; }
+            const char *p = line + 3;
+            float *n = &attrib.normals[vn * 3];
+            n[0] = parseFloatOr(p, lineEnd, 0.0f);
+            n[1] = parseFloatOr(p, lineEnd, 0.0f);
+            n[2] = parseFloatOr(p, lineEnd, 0.0f);
+            vn++;
+        }
+        else if (lineStartsWith(line, lineEnd, "vt", 2)) {
+            if (!parseVertices) { vt++; return; }
+            const char *p = line + 3;
+            float *t = &attrib.texcoords[vt * 2];
+            t[0] = parseFloatOr(p, lineEnd, 0.0f);
+            t[1] = parseFloatOr(p, lineEnd, 0.0f);
+            vt++;
+        }
+        else if (!parseFaces) return;
+        else if (line[0] == 'f' && (lineEnd - line) > 1 && isSpace(line[1])) {
+            face.clear();
+            const char *p = skipSpace(line + 2, lineEnd);
+            while (p < lineEnd && *p != '\r') {
+                tinyobj::index_t index;
+                index.vertex_index = index.normal_index = index.texcoord_index = -1;
+                bool valid = fixIndex(parseInt(p, lineEnd), v, index.vertex_index);
+                if (valid && p < lineEnd && *p == '/') {
+                    ++p;
+                    if (p < lineEnd && *p == '/') {
+                        ++p;
+                        valid = fixIndex(parseInt(p, lineEnd), vn, index.normal_index);
+                    } else {
+                        valid = fixIndex(parseInt(p, lineEnd), vt, index.texcoord_index);
+                        if (valid && p < lineEnd && *p == '/') {
+                            ++p;
+                            valid = fixIndex(parseInt(p, lineEnd), vn, index.normal_index);
+                        }
+                    }
+                }
+                if (!valid) {
+                    chunk.error = "Failed parse `f' line(e.g. zero value for face index).\n";
+                    return;
+                }
+                while (p < lineEnd && !isSpace(*p) && *p != '\r') ++p;
+                face.push_back(index);
+                p = skipSpace(p, lineEnd);
+            }
+
+            /* Fan triangulation */
+            for (size_t k = 2; k < face.size(); ++k) {
+                chunk.corners.push_back(face[0]);
+                chunk.corners.push_back(face[k - 1]);
+                chunk.corners.push_back(face[k]);
+                chunk.smoothing.push_back(smoothing);
+            }
+        }
+        else if (line[0] == 's' && (lineEnd - line) > 1 && isSpace(line[1])) {
+            const char *p = skipSpace(line + 2, lineEnd);
+            if (p >= lineEnd || *p == '\r') return;
+            if ((lineEnd - p) >= 3 && strncmp(p, "off", 3) == 0) smoothing = 0;
+            else {
+                int id = parseInt(p, lineEnd);
+                smoothing = (id < 0) ? 0 : uint32_t(id);
+            }
+        }
+        else if (lineStartsWith(line, lineEnd, "usemtl", 6)) {
+            chunk.events.push_back({chunk.smoothing.size(), 'm', restOfLine(line + 7, lineEnd)});
+        }
+        else if (lineStartsWith(line, lineEnd, "mtllib", 6)) {
+            chunk.events.push_back({chunk.smoothing.size(), 'l', restOfLine(line + 7, lineEnd)});
+        }
+        else if (line[0] == 'g' && (lineEnd - line) > 1 && isSpace(line[1])) {
+            /* Like tinyobj, only the first group name is kept */
+            const char *p = skipSpace(line + 2, lineEnd);
+            const char *nameEnd = p;
+            while (nameEnd < lineEnd && !isSpace(*nameEnd) && *nameEnd != '\r') ++nameEnd;
+            chunk.events.push_back({chunk.smoothing.size(), 'g', std::string(p, nameEnd)});
+        }
+        else if (line[0] == 'o' && (lineEnd - line) > 1 && isSpace(line[1])) {
+            chunk.events.push_back({chunk.smoothing.size(), 'o', restOfLine(line + 2, lineEnd)});
+        }
+    });
+
+    chunk.finalSmoothing = smoothing;
+}
+
+/* Splits [data, data + size) into roughly equal chunks, ending each one on a line boundary */
+std::vector<ObjChunk> splitIntoChunks(const char *data, size_t size, uint64_t numChunks) {
+    std::vector<ObjChunk> chunks(numChunks);
+    const char *previous = data;
+    for (uint64_t i = 0; i < numChunks; ++i) {
+        const char *end = data + (size * (i + 1)) / numChunks;
+        if (i + 1 < numChunks) {
+            end = std::max(end, previous);
+            const char *newline = (const char*) memchr(end, '\n', size_t(data + size - end));
+            end = newline ? newline + 1 : data + size;
+        } else end = data + size;
+        chunks[i].begin = previous;
+        chunks[i].end = end;
+        previous = end;
+    }
+    return chunks;
+}
+
+/* Counts vertex statements in all chunks, assigns each chunk its offsets into the vertex arrays, 
+   and sizes those arrays. Colors are left empty, which the importer reads as white, unless some
+   vertex has them, so that files without colors don't pay for them */
+void allocateVertices(std::vector<ObjChunk> &chunks, tinyobj::attrib_t &attrib) {
+    parallelFor(chunks.size(), [&] (uint64_t begin, uint64_t end, uint32_t) {
+        for (uint64_t i = begin; i < end; ++i) countVertices(chunks[i]);
+    }, 1);
+    uint64_t numV = 0, numVn = 0, numVt = 0;
+    bool hasColors = false;
+    for (auto &chunk : chunks) {
+        chunk.offsetV = numV; chunk.offsetVn = numVn; chunk.offsetVt = numVt;
+        numV += chunk.numV; numVn += chunk.numVn; numVt += chunk.numVt;
+        hasColors |= chunk.hasColors;
+    }
+    attrib.vertices.resize(numV * 3);
+    attrib.colors.resize(hasColors ? numV * 3 : 0);
+    attrib.normals.resize(numVn * 3);
+    attrib.texcoords.resize(numVt * 2);
+}
+
+bool parseChunks(ObjChunk *chunks, uint64_t count, tinyobj::attrib_t &attrib, 
+    bool parseVertices, bool parseFaces, std::string *err) 
+{
+    parallelFor(count, [&] (uint64_t begin, uint64_t end, uint32_t) {
+        for (uint64_t i = begin; i < end; ++i) parseChunk(chunks[i], attrib, parseVertices, parseFaces);
+    }, 1);
+    for (uint64_t i = 0; i < count; ++i) {
+        if (!chunks[i].error.empty()) {
+            if (err) (*err) += chunks[i].error;
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Replays the faces and state changes of parsed chunks in file order, building shapes the same way tinyobj does.
+   Shapes are handed off as soon as they are complete, or once they reach maxTriangles */
+class ShapeBuilder {
+public:
+    ShapeBuilder(std::vector<tinyobj::material_t> *materials, std::string *err, const std::string &mtl_basedir,
+        uint64_t maxTriangles, const std::function<void(tinyobj::shape_t &)> &callback)
+        : materials(materials), err(err), mtl_basedir(mtl_basedir), maxTriangles(maxTriangles), callback(callback) {}
+
+    void merge(ObjChunk &chunk) {
+        uint64_t next = 0;
+        auto appendTriangles = [&] (uint64_t until) {
+            while (next < until) {
+                auto &mesh = shape.mesh;
+                uint64_t count = std::min(until - next, maxTriangles - mesh.num_face_vertices.size());
+                mesh.indices.insert(mesh.indices.end(), chunk.corners.begin() + next * 3, chunk.corners.begin() + (next + count) * 3);
+                mesh.num_face_vertices.insert(mesh.num_face_vertices.end(), count, 3);
+                mesh.material_ids.insert(mesh.material_ids.end(), count, material);
+                for (uint64_t t = next; t < next + count; ++t)
+                    mesh.smoothing_group_ids.push_back((chunk.smoothing[t] == INHERIT_SMOOTHING) ? smoothing : chunk.smoothing[t]);
+                next += count;
+                if (mesh.num_face_vertices.size() >= maxTriangles) flush();
+            }
+        };
+
+        for (auto &event : chunk.events) {
+            appendTriangles(event.triOffset);
+            if (event.type == 'm') {
+                auto it = material_map.find(event.arg);
+                material = (it != material_map.end()) ? it->second : -1;
+            }
+            else if (event.type == 'l') loadMaterials(event.arg);
+            else if (event.type == 'g' || event.type == 'o') {
+                flush();
+                name = event.arg;
+            }
+        }
+        appendTriangles(chunk.smoothing.size());
+        if (chunk.finalSmoothing != INHERIT_SMOOTHING) smoothing = chunk.finalSmoothing;
+
+        /* Release per chunk memory as we go */
+        std::vector<tinyobj::index_t>().swap(chunk.corners);
+        std::vector<uint32_t>().swap(chunk.smoothing);
+        std::vector<ObjEvent>().swap(chunk.events);
+    }
+
+    void flush() {
+        if (shape.mesh.indices.size() > 0) {
+            shape.name = name;
+            callback(shape);
+        }
+        shape = tinyobj::shape_t();
+    }
+
+private:
+    void loadMaterials(const std::string &arg) {
+        std::vector<std::string> filenames;
+        size_t start = 0;
+        while (start < arg.size()) {
+            size_t space = arg.find(' ', start);
+            if (space == std::string::npos) space = arg.size();
+            if (space > start) filenames.push_back(arg.substr(start, space - start));
+            start = space + 1;
+        }
+        bool found = false;
+        tinyobj::MaterialFileReader reader(mtl_basedir);
+        for (auto &mtl : filenames) {
+            std::string err_mtl;
+            bool ok = reader(mtl, materials, &material_map, &err_mtl);
+            if (err && !err_mtl.empty()) (*err) += err_mtl;
+            if (ok) { found = true; break; }
+        }
+        if (!found && err)
+            (*err) += "WARN: Failed to load material file(s). Use default material.\n";
+    }
+
+    std::vector<tinyobj::material_t> *materials;
+    std::string *err;
+    std::string mtl_basedir;
+    uint64_t maxTriangles;
+    std::function<void(tinyobj::shape_t &)> callback;
+
+    std::map<std::string, int> material_map;
+    int material = -1;
+    uint32_t smoothing = 0;
+    std::string name;
+    tinyobj::shape_t shape;
+};
+
+/* Using a few chunks per thread balances files whose density of vertex and face statements varies */
+const size_t minChunkSize = 1 << 20;
+
+/* Rough upper bound on the bytes of parsed face data produced per byte of face statements */
+const uint64_t faceBytesPerTextByte = 4;
+
+/* Bytes per triangle held by a shape_t: three index_t, plus a face vertex count, material id and smoothing id */
+const uint64_t shapeBytesPerTriangle = 3 * sizeof(tinyobj::index_t) + 1 + sizeof(int) + sizeof(uint32_t);
+
+} // namespace
+
+bool loadObjParallel(
+    tinyobj::attrib_t *attrib,
+    std::vector<tinyobj::shape_t> *shapes,
+    std::vector<tinyobj::material_t> *materials,
+    std::string *err,
+    const std::string &filename,
+    const std::string &mtl_basedir)
+{
+    struct stat st;
+    if (stat(filename.c_str(), &st) != 0) {
+        if (err) (*err) += "Cannot open file [" + filename + "]\n";
+        return false;
+    }
+
+    MappedFile file(filename);
+    const char *data = (const char*) file.data();
+    size_t size = file.size();
+
+    uint64_t numChunks = std::max<uint64_t>(1, std::min<uint64_t>(getNumWorkerThreads() * 4, size / minChunkSize));
+    std::vector<ObjChunk> chunks = splitIntoChunks(data, size, numChunks);
+
+    /* First pass, count vertex statements so that each chunk knows where its vertex data goes */
+    allocateVertices(chunks, *attrib);
+
+    /* Second pass, parse everything in place */
+    if (!parseChunks(chunks.data(), chunks.size(), *attrib, true, true, err)) return false;
+
+    /* Finally, replay state changes in file order to build shapes */
+    ShapeBuilder builder(materials, err, mtl_basedir, std::numeric_limits<uint64_t>::max(), 
+        [shapes] (tinyobj::shape_t &shape) { shapes->push_back(std::move(shape)); });
+    for (auto &chunk : chunks) builder.merge(chunk);
+    builder.flush();
+
+    return true;
+}
+
+bool loadObjStreaming(
+    tinyobj::attrib_t *attrib,
+    std::vector<tinyobj::material_t> *materials,
+    std::string *err,
+    const std::string &filename,
+    const std::string &mtl_basedir,
+    uint64_t memory_budget,
+    uint64_t consumer_bytes_per_triangle,
+    const std::function<void(tinyobj::shape_t &shape)> &callback)
+{
+    struct stat st;
+    if (stat(filename.c_str(), &st) != 0) {
+        if (err) (*err) += "Cannot open file [" + filename + "]\n";
+        return false;
+    }
+
+    MappedFile file(filename);
+    const char *data = (const char*) file.data();
+    size_t size = file.size();
+
+    /* Size chunks so that a batch of one chunk per thread produces at most a quarter of the budget in face data.
+       The vertex pool isn't known yet, so the budget is rechecked below */
+    uint64_t numThreads = getNumWorkerThreads();
+    uint64_t chunkSize = std::max<uint64_t>(64 << 10, memory_budget / (4 * faceBytesPerTextByte * numThreads));
+    chunkSize = std::min<uint64_t>(chunkSize, std::max<uint64_t>(minChunkSize, size / (numThreads * 4)));
+    uint64_t numChunks = std::max<uint64_t>(1, (size + chunkSize - 1) / chunkSize);
+    std::vector<ObjChunk> chunks = splitIntoChunks(data, size, numChunks);
+
+    /* Vertices may be referenced from anywhere in the file, so the vertex pool is always loaded in full */
+    allocateVertices(chunks, *attrib);
+    uint64_t vertexBytes = (attrib->vertices.size() + attrib->colors.size() + attrib->normals.size() 
+        + attrib->texcoords.size()) * sizeof(float);
+    if (vertexBytes >= memory_budget) {
+        if (err) (*err) += "Vertex data alone requires " + std::to_string(vertexBytes >> 20) 
+            + " MB, which exceeds the memory budget of " + std::to_string(memory_budget >> 20) + " MB\n";
+        return false;
+    }
+    if (!parseChunks(chunks.data(), chunks.size(), *attrib, true, false, err)) return false;
+
+    /* Split the remaining budget between parsed face data and shapes handed to the consumer */
+    uint64_t remaining = memory_budget - vertexBytes;
+    uint64_t batchTextBytes = std::max<uint64_t>(1, remaining / (2 * faceBytesPerTextByte));
+    uint64_t maxTriangles = std::max<uint64_t>(1024, remaining / (2 * (shapeBytesPerTriangle + consumer_bytes_per_triangle)));
+
+    /* Parse faces one batch of chunks at a time, handing shapes off as they complete */
+    ShapeBuilder builder(materials, err, mtl_basedir, maxTriangles, callback);
+    uint64_t first = 0;
+    while (first < numChunks) {
+        uint64_t last = first + 1, batchBytes = uint64_t(chunks[first].end - chunks[first].begin);
+        while (last < numChunks && batchBytes + uint64_t(chunks[last].end - chunks[last].begin) <= batchTextBytes) {
+            batchBytes += uint64_t(chunks[last].end - chunks[last].begin);
+            last++;
+        }
+        if (!parseChunks(&chunks[first], last - first, *attrib, false, true, err)) return false;
+        for (uint64_t i = first; i < last; ++i) builder.merge(chunks[i]);
+        first = last;
+    }
+    builder.flush();
+
+    return true;
+}
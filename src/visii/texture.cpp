@@ -4,9 +4,9 @@
 #include <stb_image_write.h>
 #include <cstring>
 
-Texture Texture::textures[MAX_TEXTURES];
-TextureStruct Texture::textureStructs[MAX_TEXTURES];
-std::map<std::string, uint32_t> Texture::lookupTable;
+PagedArray<Texture> Texture::textures;
+PagedArray<TextureStruct> Texture::textureStructs;
+NameTable Texture::lookupTable;
 std::shared_ptr<std::mutex> Texture::editMutex;
 bool Texture::factoryInitialized = false;
 bool Texture::anyDirty = true;
@@ -96,7 +96,7 @@ void Texture::updateComponents()
 {
 	if (!anyDirty) return;
 
-	for (int i = 0; i < MAX_TEXTURES; ++i) {
+	for (uint32_t i = 0; i < textures.size(); ++i) {
 		if (textures[i].isDirty()) {
             textures[i].markClean();
         }
@@ -108,7 +108,8 @@ void Texture::clearAll()
 {
     if (!isFactoryInitialized()) return;
 
-    for (auto &light : textures) {
+    for (uint32_t i = 0; i < textures.size(); ++i) {
+		auto &light = textures[i];
 		if (light.initialized) {
 			Texture::remove(light.name);
 		}
@@ -117,7 +118,7 @@ void Texture::clearAll()
 
 /* Static Factory Implementations */
 Texture* Texture::create(std::string name) {
-    auto l = StaticFactory::create(editMutex, name, "Texture", lookupTable, textures, MAX_TEXTURES);
+    auto l = StaticFactory::create(editMutex, name, "Texture", lookupTable, textures);
     anyDirty = true;
     return l;
 }
@@ -144,9 +145,9 @@ Texture* Texture::createFromImage(std::string name, std::string path, bool linea
     };
 
     try {
-        return StaticFactory::create<Texture>(editMutex, name, "Texture", lookupTable, textures, MAX_TEXTURES, create);
+        return StaticFactory::create<Texture>(editMutex, name, "Texture", lookupTable, textures, create);
     } catch (...) {
-		StaticFactory::removeIfExists(editMutex, name, "Texture", lookupTable, textures, MAX_TEXTURES);
+		StaticFactory::removeIfExists(editMutex, name, "Texture", lookupTable, textures);
 		throw;
 	}
 }
@@ -163,37 +164,65 @@ Texture* Texture::createFromData(std::string name, uint32_t width, uint32_t heig
     };
 
     try {
-        return StaticFactory::create<Texture>(editMutex, name, "Texture", lookupTable, textures, MAX_TEXTURES, create);
+        return StaticFactory::create<Texture>(editMutex, name, "Texture", lookupTable, textures, create);
     } catch (...) {
-		StaticFactory::removeIfExists(editMutex, name, "Texture", lookupTable, textures, MAX_TEXTURES);
+		StaticFactory::removeIfExists(editMutex, name, "Texture", lookupTable, textures);
 		throw;
 	}
 }
 
+Texture* Texture::createUnique(std::string prefix, uint32_t width, uint32_t height, std::vector<float> data)
+{
+    /* The unique name is only known once the texture is reserved, so keep it in case loading fails */
+    std::string name;
+    auto create = [&name, width, height, &data] (Texture* l) {
+        name = l->getName();
+        if (data.size() != (width * height * 4)) { throw std::runtime_error("Error: width * height * 4 does not equal length of data!"); }
+        l->texels.resize(width * height);
+        memcpy(l->texels.data(), data.data(), width * height * 4 * sizeof(float));
+        textureStructs[l->getId()].width = width;
+        textureStructs[l->getId()].height = height;
+        l->markDirty();
+    };
+
+    try {
+        return StaticFactory::createUnique<Texture>(editMutex, prefix, "Texture", lookupTable, textures, create);
+    } catch (...) {
+        if (!name.empty()) StaticFactory::removeIfExists(editMutex, name, "Texture", lookupTable, textures);
+        throw;
+    }
+}
+
 std::shared_ptr<std::mutex> Texture::getEditMutex()
 {
 	return editMutex;
 }
 
 Texture* Texture::get(std::string name) {
-    return StaticFactory::get(editMutex, name, "Texture", lookupTable, textures, MAX_TEXTURES);
+    return StaticFactory::get(editMutex, name, "Texture", lookupTable, textures);
 }
 
 void Texture::remove(std::string name) {
-    StaticFactory::remove(editMutex, name, "Texture", lookupTable, textures, MAX_TEXTURES);
+    StaticFactory::remove(editMutex, name, "Texture", lookupTable, textures);
     anyDirty = true;
 }
 
-Texture* Texture::getFront() {
+PagedArray<Texture> &Texture::getFront() {
     return textures;
 }
 
-TextureStruct* Texture::getFrontStruct() {
+PagedArray<TextureStruct> &Texture::getFrontStruct() {
     return textureStructs;
 }
 
 uint32_t Texture::getCount() {
-    return MAX_TEXTURES;
+    return textures.size();
+}
+
+void Texture::reserveTables(uint32_t count)
+{
+    textures.reserve(count);
+    textureStructs.reserve(count);
 }
 
 std::string Texture::getName()
@@ -201,7 +230,7 @@ std::string Texture::getName()
     return name;
 }
 
-std::map<std::string, uint32_t> Texture::getNameToIdMap()
+const NameTable &Texture::getNameToIdMap()
 {
 	return lookupTable;
 }
\ No newline at end of file
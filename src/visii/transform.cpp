@@ -1,14 +1,27 @@
 #include <visii/transform.h>
 #include <visii/entity.h>
+#include <visii/utilities/parallel.h>
+#include <visii/utilities/affine.h>
 
-Transform Transform::transforms[MAX_TRANSFORMS];
-TransformStruct Transform::transformStructs[MAX_TRANSFORMS];
-std::map<std::string, uint32_t> Transform::lookupTable;
+#include <algorithm>
+
+PagedArray<Transform> Transform::transforms;
+PagedArray<TransformStruct> Transform::transformStructs;
+PagedArray<glm::mat4> Transform::nextLocalToWorldMatrices;
+NameTable Transform::lookupTable;
+std::vector<int32_t> Transform::dirtyTransforms;
+std::atomic<bool> Transform::anyWorldDirty(false);
 
 std::shared_ptr<std::mutex> Transform::editMutex;
 bool Transform::factoryInitialized = false;
 bool Transform::anyDirty = true;
 
+/* Projective matrices can still be given to setTransform, and fall back to a full 4x4 multiply */
+static glm::mat4 multiply(const glm::mat4 &a, const glm::mat4 &b)
+{
+	return isAffine(b) ? affineMultiply(a, b) : a * b;
+}
+
 void Transform::initializeFactory()
 {
 	if (isFactoryInitialized()) return;
@@ -34,7 +47,7 @@ bool Transform::areAnyDirty()
 void Transform::markDirty() {
 	dirty = true;
 	anyDirty = true;
-	auto entityPointers = Entity::getFront();
+	auto &entityPointers = Entity::getFront();
 	for (auto &eid : entities) {
 		entityPointers[eid].markDirty();
 	}
@@ -42,10 +55,61 @@ void Transform::markDirty() {
 
 void Transform::updateComponents() 
 {
-	for (int i = 0; i < MAX_TRANSFORMS; ++i) {
-		if (!transforms[i].isFactoryInitialized()) continue;
-		transformStructs[i].worldToLocal = transforms[i].getWorldToLocalMatrix();
-		transformStructs[i].localToWorld = transforms[i].getLocalToWorldMatrix();
+	/* Gather every transform whose world matrix is out of date, ie the subtrees below all edited transforms.
+	Each one is flagged and listed exactly once. */
+	std::sort(dirtyTransforms.begin(), dirtyTransforms.end());
+	dirtyTransforms.erase(std::unique(dirtyTransforms.begin(), dirtyTransforms.end()), dirtyTransforms.end());
+	std::vector<int32_t> stale;
+	for (int32_t tid : dirtyTransforms) {
+		if (transforms[tid].initialized && transforms[tid].worldDirty) stale.push_back(tid);
+	}
+	for (size_t i = 0; i < stale.size(); ++i) {
+		for (int32_t cid = transforms[stale[i]].firstChild; cid != -1; cid = transforms[cid].nextSibling) {
+			auto &child = transforms[cid];
+			if (child.worldDirty) continue;
+			child.worldDirty = true;
+			stale.push_back(cid);
+		}
+	}
+
+	/* Subtrees are independent of each other once the transform above them is up to date */
+	std::vector<int32_t> frontier;
+	for (int32_t tid : stale) {
+		int32_t pid = transforms[tid].parent;
+		if ((pid == -1) || (!transforms[pid].worldDirty)) frontier.push_back(tid);
+	}
+
+	/* Update breadth first, parent before child, until there are enough subtrees to keep every thread busy */
+	size_t minParallelSubtrees = getNumWorkerThreads() * 4;
+	while ((frontier.size() > 0) && (frontier.size() < minParallelSubtrees)) {
+		std::vector<int32_t> next;
+		for (int32_t tid : frontier) {
+			transforms[tid].updateWorldMatrix();
+			for (int32_t cid = transforms[tid].firstChild; cid != -1; cid = transforms[cid].nextSibling) {
+				next.push_back(cid);
+			}
+		}
+		frontier.swap(next);
+	}
+
+	/* Then update the remaining subtrees in parallel, each depth first */
+	parallelFor(frontier.size(), [&frontier] (uint64_t begin, uint64_t end, uint32_t) {
+		for (uint64_t i = begin; i < end; ++i) {
+			for (int32_t tid : getSubtree(frontier[i])) {
+				transforms[tid].updateWorldMatrix();
+			}
+		}
+	}, 1);
+
+	/* Entities using any of the updated transforms need their instances rebuilt */
+	for (int32_t tid : stale) {
+		transforms[tid].worldDirty = false;
+		transforms[tid].markDirty();
+	}
+	dirtyTransforms.clear();
+	anyWorldDirty = false;
+
+	for (uint32_t i = 0; i < transforms.size(); ++i) {
 		transforms[i].markClean();
 	};
 	anyDirty = false;
@@ -55,7 +119,8 @@ void Transform::clearAll()
 {
 	if (!isFactoryInitialized()) return;
 
-	for (auto &transform : transforms) {
+	for (uint32_t i = 0; i < transforms.size(); ++i) {
+		auto &transform = transforms[i];
 		if (transform.initialized) {
 			Transform::remove(transform.name);
 		}
@@ -67,7 +132,18 @@ void Transform::clearAll()
 Transform* Transform::create(std::string name, 
 	vec3 scale, quat rotation, vec3 position) 
 {
-	auto t = StaticFactory::create(editMutex, name, "Transform", lookupTable, transforms, MAX_TRANSFORMS);
+	auto t = StaticFactory::create(editMutex, name, "Transform", lookupTable, transforms);
+	t->setPosition(position);
+	t->setRotation(rotation);
+	t->setScale(scale);
+	anyDirty = true;
+	return t;
+}
+
+Transform* Transform::createUnique(std::string prefix, 
+	vec3 scale, quat rotation, vec3 position) 
+{
+	auto t = StaticFactory::createUnique(editMutex, prefix, "Transform", lookupTable, transforms);
 	t->setPosition(position);
 	t->setRotation(rotation);
 	t->setScale(scale);
@@ -81,24 +157,44 @@ std::shared_ptr<std::mutex> Transform::getEditMutex()
 }
 
 Transform* Transform::get(std::string name) {
-	return StaticFactory::get(editMutex, name, "Transform", lookupTable, transforms, MAX_TRANSFORMS);
+	return StaticFactory::get(editMutex, name, "Transform", lookupTable, transforms);
 }
 
 void Transform::remove(std::string name) {
-	StaticFactory::remove(editMutex, name, "Transform", lookupTable, transforms, MAX_TRANSFORMS);
+	/* Children of the removed transform become roots, and are no longer affected by it */
+	auto transform = get(name);
+	if (transform) {
+		while (transform->firstChild != -1) {
+			auto &child = transforms[transform->firstChild];
+			child.unlinkFromParent();
+			child.markWorldDirty();
+		}
+		transform->unlinkFromParent();
+		transformStructs[transform->id].worldToLocal = glm::mat4(1.0);
+		transformStructs[transform->id].localToWorld = glm::mat4(1.0);
+		nextLocalToWorldMatrices[transform->id] = glm::mat4(1.0);
+	}
+	StaticFactory::remove(editMutex, name, "Transform", lookupTable, transforms);
 }
 
-TransformStruct* Transform::getFrontStruct()
+PagedArray<TransformStruct> &Transform::getFrontStruct()
 {
 	return transformStructs;
 }
 
-Transform* Transform::getFront() {
+PagedArray<Transform> &Transform::getFront() {
 	return transforms;
 }
 
 uint32_t Transform::getCount() {
-	return MAX_TRANSFORMS;
+	return transforms.size();
+}
+
+void Transform::reserveTables(uint32_t count)
+{
+	transforms.reserve(count);
+	transformStructs.reserve(count);
+	nextLocalToWorldMatrices.reserve(count);
 }
 
 std::string Transform::getName()
@@ -106,7 +202,7 @@ std::string Transform::getName()
     return name;
 }
 
-std::map<std::string, uint32_t> Transform::getNameToIdMap()
+const NameTable &Transform::getNameToIdMap()
 {
 	return lookupTable;
 }
@@ -140,32 +236,38 @@ std::string Transform::toString()
 
 vec3 Transform::transformDirection(vec3 direction)
 {
-	return vec3(localToParentRotation * vec4(direction, 0.0));
+	affineTransformDirections(getLocalToParentRotationMatrix(), &direction, &direction, 1);
+	return direction;
 }
 
 vec3 Transform::transformPoint(vec3 point)
 {
-	return vec3(localToParentMatrix * vec4(point, 1.0));
+	affineTransformPoints(getLocalToParentMatrix(), &point, &point, 1);
+	return point;
 }
 
 vec3 Transform::transformVector(vec3 vector)
 {
-	return vec3(localToParentMatrix * vec4(vector, 0.0));
+	affineTransformDirections(getLocalToParentMatrix(), &vector, &vector, 1);
+	return vector;
 }
 
 vec3 Transform::inverseTransformDirection(vec3 direction)
 {
-	return vec3(parentToLocalRotation * vec4(direction, 0.0));
+	affineTransformDirections(getParentToLocalRotationMatrix(), &direction, &direction, 1);
+	return direction;
 }
 
 vec3 Transform::inverseTransformPoint(vec3 point)
 {
-	return vec3(parentToLocalMatrix * vec4(point, 1.0));
+	affineTransformPoints(getParentToLocalMatrix(), &point, &point, 1);
+	return point;
 }
 
 vec3 Transform::inverseTransformVector(vec3 vector)
 {
-	return vec3(localToParentMatrix * vec4(vector, 0.0));
+	affineTransformDirections(getLocalToParentMatrix(), &vector, &vector, 1);
+	return vector;
 }
 
 glm::quat safeQuatLookAt(
@@ -234,15 +336,8 @@ void Transform::rotateAround(vec3 point, glm::quat rot)
 	newPosition = newPosition - direction * glm::inverse(rot);
 
 	rotation = glm::normalize(newRotation);
-	localToParentRotation = glm::toMat4(rotation);
-	parentToLocalRotation = glm::inverse(localToParentRotation);
-
 	position = newPosition;
-	localToParentTranslation = glm::translate(glm::mat4(1.0), position);
-	parentToLocalTranslation = glm::translate(glm::mat4(1.0), -position);
-
-	updateMatrix();
-	markDirty();
+	markWorldDirty();
 }
 
 void Transform::setTransform(glm::mat4 transformation, bool decompose)
@@ -272,13 +367,23 @@ void Transform::setTransform(glm::mat4 transformation, bool decompose)
 			setRotation(rotation);
 	}
 	else {
-		this->localToParentTransform = transformation;
-		this->parentToLocalTransform = glm::inverse(transformation);
-		updateMatrix();
+		localToParentTransform.reset(new glm::mat4(transformation));
+		markWorldDirty();
 	}
 	markDirty();
 }
 
+glm::mat4 Transform::getLocalToParentTransform()
+{
+	return (localToParentTransform) ? *localToParentTransform : glm::mat4(1.0);
+}
+
+glm::mat4 Transform::getParentToLocalTransform()
+{
+	if (!localToParentTransform) return glm::mat4(1.0);
+	return isAffine(*localToParentTransform) ? affineInverse(*localToParentTransform) : glm::inverse(*localToParentTransform);
+}
+
 quat Transform::getRotation()
 {
 	return rotation;
@@ -287,8 +392,7 @@ quat Transform::getRotation()
 void Transform::setRotation(quat newRotation)
 {
 	rotation = glm::normalize(newRotation);
-	updateRotation();
-	markDirty();
+	markWorldDirty();
 }
 
 // void Transform::setRotation(float angle, vec3 axis)
@@ -300,8 +404,6 @@ void Transform::setRotation(quat newRotation)
 void Transform::addRotation(quat additionalRotation)
 {
 	setRotation(getRotation() * additionalRotation);
-	updateRotation();
-	markDirty();
 }
 
 // void Transform::addRotation(float angle, vec3 axis)
@@ -310,17 +412,6 @@ void Transform::addRotation(quat additionalRotation)
 // 	markDirty();
 // }
 
-void Transform::updateRotation()
-{
-	localToParentRotation = glm::toMat4(rotation);
-	parentToLocalRotation = glm::inverse(localToParentRotation);
-
-	nextLocalToParentRotation = glm::toMat4(angularVelocity * rotation);
-	nextParentToLocalRotation = glm::inverse(localToParentRotation);
-	updateMatrix();
-	markDirty();
-}
-
 vec3 Transform::getPosition()
 {
 	return position;
@@ -328,31 +419,71 @@ vec3 Transform::getPosition()
 
 vec3 Transform::getRight()
 {
-	return right;
+	return glm::vec3(getLocalToParentMatrix()[0]);
 }
 
 vec3 Transform::getUp()
 {
-	return up;
+	return glm::vec3(getLocalToParentMatrix()[1]);
 }
 
 vec3 Transform::getForward()
 {
-	return forward;
+	return glm::vec3(getLocalToParentMatrix()[2]);
 }
 
 void Transform::setPosition(vec3 newPosition)
 {
 	position = newPosition;
-	updatePosition();
-	markDirty();
+	markWorldDirty();
+}
+
+void Transform::setPositionsRotations(
+	const std::vector<uint32_t> &ids,
+	const std::vector<float> &positions,
+	const std::vector<float> &rotations)
+{
+	if ((positions.size() != 0) && (positions.size() != ids.size() * 3))
+		throw std::runtime_error(std::string("Error: expected 3 position values per transform id, got "
+			+ std::to_string(positions.size()) + " values for " + std::to_string(ids.size()) + " ids"));
+
+	if ((rotations.size() != 0) && (rotations.size() != ids.size() * 4))
+		throw std::runtime_error(std::string("Error: expected 4 rotation values per transform id, got "
+			+ std::to_string(rotations.size()) + " values for " + std::to_string(ids.size()) + " ids"));
+
+	auto mutex = getEditMutex();
+	std::lock_guard<std::mutex> lock(*mutex.get());
+
+	/* Validate everything up front, so that a bad id leaves the scene untouched */
+	std::vector<bool> seen(transforms.size(), false);
+	for (uint32_t tid : ids) {
+		if ((tid >= transforms.size()) || (!transforms[tid].initialized))
+			throw std::runtime_error(std::string("Error: transform id " + std::to_string(tid) + " is invalid or uninitialized"));
+		if (seen[tid])
+			throw std::runtime_error(std::string("Error: transform id " + std::to_string(tid) + " appears more than once"));
+		seen[tid] = true;
+	}
+
+	/* Ids are unique, so every thread writes to disjoint transforms */
+	const float *p = (positions.size() > 0) ? positions.data() : nullptr;
+	const float *r = (rotations.size() > 0) ? rotations.data() : nullptr;
+	parallelFor(ids.size(), [&ids, p, r] (uint64_t begin, uint64_t end, uint32_t) {
+		for (uint64_t i = begin; i < end; ++i) {
+			auto &transform = transforms[ids[i]];
+			if (p) transform.position = glm::vec3(p[i * 3 + 0], p[i * 3 + 1], p[i * 3 + 2]);
+			if (r) transform.rotation = glm::normalize(glm::quat(r[i * 4 + 3], r[i * 4 + 0], r[i * 4 + 1], r[i * 4 + 2]));
+		}
+	});
+
+	if ((!p) && (!r)) return;
+	for (uint32_t tid : ids) {
+		transforms[tid].markWorldDirtyLocked();
+	}
 }
 
 void Transform::addPosition(vec3 additionalPosition)
 {
 	setPosition(getPosition() + additionalPosition);
-	updatePosition();
-	markDirty();
 }
 
 void Transform::setLinearVelocity(vec3 newLinearVelocity, float framesPerSecond, float mix)
@@ -360,8 +491,7 @@ void Transform::setLinearVelocity(vec3 newLinearVelocity, float framesPerSecond,
 	mix = glm::clamp(mix, 0.f, 1.f);
 	newLinearVelocity /= framesPerSecond;
 	linearVelocity = glm::mix(newLinearVelocity, linearVelocity, mix);
-	updatePosition();
-	markDirty();
+	markWorldDirty();
 }
 
 void Transform::setAngularVelocity(quat newAngularVelocity, float framesPerSecond, float mix)
@@ -371,8 +501,7 @@ void Transform::setAngularVelocity(quat newAngularVelocity, float framesPerSecon
 	newAngularVelocity[1] = newAngularVelocity[1] / framesPerSecond;
 	newAngularVelocity[2] = newAngularVelocity[2] / framesPerSecond;
 	angularVelocity = glm::lerp(newAngularVelocity, angularVelocity, mix);
-	updateRotation();
-	markDirty();
+	markWorldDirty();
 }
 
 void Transform::setScalarVelocity(vec3 newScalarVelocity, float framesPerSecond, float mix)
@@ -380,8 +509,7 @@ void Transform::setScalarVelocity(vec3 newScalarVelocity, float framesPerSecond,
 	mix = glm::clamp(mix, 0.f, 1.f);
 	newScalarVelocity /= framesPerSecond;
 	scalarVelocity = glm::mix(newScalarVelocity, scalarVelocity, mix);
-	updateScale();
-	markDirty();
+	markWorldDirty();
 }
 
 // void Transform::setPosition(float x, float y, float z)
@@ -396,16 +524,6 @@ void Transform::setScalarVelocity(vec3 newScalarVelocity, float framesPerSecond,
 // 	markDirty();
 // }
 
-void Transform::updatePosition()
-{
-	localToParentTranslation = glm::translate(glm::mat4(1.0), position);
-	parentToLocalTranslation = glm::translate(glm::mat4(1.0), -position);
-	nextLocalToParentTranslation = glm::translate(glm::mat4(1.0), position + linearVelocity);
-	nextParentToLocalTranslation = glm::translate(glm::mat4(1.0), -position + linearVelocity);
-	updateMatrix();
-	markDirty();
-}
-
 vec3 Transform::getScale()
 {
 	return scale;
@@ -414,8 +532,7 @@ vec3 Transform::getScale()
 void Transform::setScale(vec3 newScale)
 {
 	scale = newScale;
-	updateScale();
-	markDirty();
+	markWorldDirty();
 }
 
 // void Transform::setScale(float newScale)
@@ -428,8 +545,6 @@ void Transform::setScale(vec3 newScale)
 void Transform::addScale(vec3 additionalScale)
 {
 	setScale(getScale() + additionalScale);
-	updateScale();
-	markDirty();
 }
 
 // void Transform::setScale(float x, float y, float z)
@@ -450,125 +565,218 @@ void Transform::addScale(vec3 additionalScale)
 // 	markDirty();
 // }
 
-void Transform::updateScale()
+void Transform::markWorldDirty()
 {
-	localToParentScale = glm::scale(glm::mat4(1.0), scale);
-	parentToLocalScale = glm::scale(glm::mat4(1.0), glm::vec3(1.0 / scale.x, 1.0 / scale.y, 1.0 / scale.z));
-	nextLocalToParentScale = glm::scale(glm::mat4(1.0), scale + scalarVelocity);
-	nextParentToLocalScale = glm::scale(glm::mat4(1.0), glm::vec3(1.0 / (scale.x + scalarVelocity.x), 1.0 / (scale.y + scalarVelocity.y), 1.0 / (scale.z + scalarVelocity.z)));
-	updateMatrix();
-	markDirty();
+	auto mutex = getEditMutex();
+	std::lock_guard<std::mutex> lock(*mutex.get());
+	markWorldDirtyLocked();
 }
 
-void Transform::updateMatrix()
+void Transform::markWorldDirtyLocked()
 {
-	localToParentMatrix = (localToParentTransform * localToParentTranslation * localToParentRotation * localToParentScale);
-	parentToLocalMatrix = (parentToLocalScale * parentToLocalRotation * parentToLocalTranslation * parentToLocalTransform);
-
-	nextLocalToParentMatrix = (localToParentTransform * nextLocalToParentTranslation * nextLocalToParentRotation * nextLocalToParentScale);
-	nextParentToLocalMatrix = (nextParentToLocalScale * nextParentToLocalRotation * nextParentToLocalTranslation * parentToLocalTransform);
-
-	right = glm::vec3(localToParentMatrix[0]);
-	up = glm::vec3(localToParentMatrix[1]);
-	forward = glm::vec3(localToParentMatrix[2]);
-	position = glm::vec3(localToParentMatrix[3]);
-
-	updateChildren();
+	if (!worldDirty) {
+		worldDirty = true;
+		dirtyTransforms.push_back(id);
+		anyWorldDirty = true;
+	}
 	markDirty();
 }
 
-glm::mat4 Transform::computeWorldToLocalMatrix()
+void Transform::updateWorldMatrix()
 {
-	glm::mat4 parentMatrix = glm::mat4(1.0);
+	/* Both directions are composed down the hierarchy, so no inverse is ever taken of a world matrix */
+	auto &transformStruct = transformStructs[id];
+	transformStruct.worldToLocal = getParentToLocalMatrix();
+	transformStruct.localToWorld = getLocalToParentMatrix();
+	nextLocalToWorldMatrices[id] = getNextLocalToParentMatrix();
 	if (parent != -1) {
-		parentMatrix = transforms[parent].computeWorldToLocalMatrix();
-		return getParentToLocalMatrix() * parentMatrix;
+		transformStruct.worldToLocal = multiply(transformStruct.worldToLocal, transformStructs[parent].worldToLocal);
+		transformStruct.localToWorld = multiply(transformStructs[parent].localToWorld, transformStruct.localToWorld);
+		nextLocalToWorldMatrices[id] = multiply(nextLocalToWorldMatrices[parent], nextLocalToWorldMatrices[id]);
 	}
-	else return getParentToLocalMatrix();
 }
 
-glm::mat4 Transform::computeNextWorldToLocalMatrix()
+bool Transform::isWorldStale()
 {
-	glm::mat4 parentMatrix = glm::mat4(1.0);
-	if (parent != -1) {
-		parentMatrix = transforms[parent].computeNextWorldToLocalMatrix();
-		return getNextParentToLocalMatrix() * parentMatrix;
+	if (!anyWorldDirty) return false;
+	for (int32_t tid = id; tid != -1; tid = transforms[tid].parent) {
+		if (transforms[tid].worldDirty) return true;
 	}
-	else return getNextParentToLocalMatrix();
+	return false;
 }
 
-void Transform::updateWorldMatrix()
+void Transform::computeWorldMatrices(glm::mat4 &worldToLocal, glm::mat4 &localToWorld, glm::mat4 &nextLocalToWorld)
 {
-	if (parent == -1) {
-		worldToLocalMatrix = parentToLocalMatrix;
-		localToWorldMatrix = localToParentMatrix;
-		nextWorldToLocalMatrix = nextParentToLocalMatrix;
-		nextLocalToWorldMatrix = nextLocalToParentMatrix;
+	/* Cached world matrices above the highest edited ancestor are still valid, so start from there */
+	std::vector<int32_t> path;
+	size_t highestDirty = 0;
+	for (int32_t tid = id; tid != -1; tid = transforms[tid].parent) {
+		if (transforms[tid].worldDirty) highestDirty = path.size();
+		path.push_back(tid);
+	}
+
+	/* Composes in the same order as updateWorldMatrix, so results match what the next update will cache */
+	int32_t pid = transforms[path[highestDirty]].parent;
+	bool hasParent = (pid != -1);
+	if (hasParent) {
+		worldToLocal = transformStructs[pid].worldToLocal;
+		localToWorld = transformStructs[pid].localToWorld;
+		nextLocalToWorld = nextLocalToWorldMatrices[pid];
+	}
+	for (size_t i = highestDirty + 1; i-- > 0;) {
+		auto &transform = transforms[path[i]];
+		if (hasParent) {
+			worldToLocal = multiply(transform.getParentToLocalMatrix(), worldToLocal);
+			localToWorld = multiply(localToWorld, transform.getLocalToParentMatrix());
+			nextLocalToWorld = multiply(nextLocalToWorld, transform.getNextLocalToParentMatrix());
+		} else {
+			worldToLocal = transform.getParentToLocalMatrix();
+			localToWorld = transform.getLocalToParentMatrix();
+			nextLocalToWorld = transform.getNextLocalToParentMatrix();
+		}
+		hasParent = true;
+	}
+}
 
+void Transform::decomposeWorldMatrix(glm::vec3 &worldScale, glm::quat &worldRotation, glm::vec3 &worldTranslation)
+{
+	if (parent == -1) {
 		worldScale = scale;
 		worldTranslation = position;
 		worldRotation = rotation;
-		worldSkew = glm::vec3(0.f, 0.f, 0.f);
-		worldPerspective = glm::vec4(1.0f, 1.0f, 1.0f, 1.0f); // not sure what this should default to...
 	} else {
-		worldToLocalMatrix = computeWorldToLocalMatrix();
-		nextWorldToLocalMatrix = computeNextWorldToLocalMatrix();
-		localToWorldMatrix = glm::inverse(worldToLocalMatrix); 
-		nextLocalToWorldMatrix = glm::inverse(worldToLocalMatrix); 
-		glm::decompose(localToWorldMatrix, worldScale, worldRotation, worldTranslation, worldSkew, worldPerspective);
-		// glm::decompose(nextLocalToWorldMatrix, worldScale, worldRotation, worldTranslation, worldSkew, worldPerspective);
+		glm::vec3 worldSkew;
+		glm::vec4 worldPerspective;
+		glm::decompose(getLocalToWorldMatrix(), worldScale, worldRotation, worldTranslation, worldSkew, worldPerspective);
 	}
-	markDirty();
 }
 
 glm::mat4 Transform::getParentToLocalMatrix()
 {
-	return parentToLocalMatrix;
+	glm::mat4 matrix = affineFromInverseTRS(position, rotation, scale);
+	if (localToParentTransform) matrix = multiply(matrix, getParentToLocalTransform());
+	return matrix;
 }
 
 glm::mat4 Transform::getNextParentToLocalMatrix()
 {
-	return nextParentToLocalMatrix;
+	glm::mat4 matrix = affineFromInverseTRS(position + linearVelocity, angularVelocity * rotation, scale + scalarVelocity);
+	if (localToParentTransform) matrix = multiply(matrix, getParentToLocalTransform());
+	return matrix;
 }
 
 glm::mat4 Transform::getLocalToParentMatrix()
 {
-	return localToParentMatrix;
+	glm::mat4 matrix = affineFromTRS(position, rotation, scale);
+	if (localToParentTransform) matrix = affineMultiply(*localToParentTransform, matrix);
+	return matrix;
 }
 
 glm::mat4 Transform::getNextLocalToParentMatrix()
 {
-	return nextLocalToParentMatrix;
+	glm::mat4 matrix = affineFromTRS(position + linearVelocity, angularVelocity * rotation, scale + scalarVelocity);
+	if (localToParentTransform) matrix = affineMultiply(*localToParentTransform, matrix);
+	return matrix;
+}
+
+void Transform::setMotionKeys(const std::vector<float> &positions, const std::vector<float> &rotations, const std::vector<float> &scales)
+{
+	/* Every array that was given must agree on the number of keys */
+	size_t count = 0;
+	auto countKeys = [&count] (const std::vector<float> &values, size_t components, std::string what) {
+		if (values.size() == 0) return;
+		if ((values.size() % components) != 0)
+			throw std::runtime_error(std::string("Error: expected " + std::to_string(components) + " values per motion key " + what + ", got " + std::to_string(values.size()) + " values"));
+		if ((count != 0) && (values.size() / components != count))
+			throw std::runtime_error(std::string("Error: motion key " + what + " describe " + std::to_string(values.size() / components) + " keys, expected " + std::to_string(count)));
+		count = values.size() / components;
+	};
+	countKeys(positions, 3, "positions");
+	countKeys(rotations, 4, "rotations");
+	countKeys(scales, 3, "scales");
+	if ((count < 2) || (count > MAX_MOTION_KEYS))
+		throw std::runtime_error(std::string("Error: expected between 2 and " + std::to_string(MAX_MOTION_KEYS) + " motion keys, got " + std::to_string(count)));
+
+	std::vector<TRSKey> keys(count);
+	for (size_t i = 0; i < count; ++i) {
+		keys[i].translation = (positions.size() > 0) ? glm::vec3(positions[i * 3 + 0], positions[i * 3 + 1], positions[i * 3 + 2]) : position;
+		keys[i].rotation = (rotations.size() > 0) ? glm::normalize(glm::quat(rotations[i * 4 + 3], rotations[i * 4 + 0], rotations[i * 4 + 1], rotations[i * 4 + 2])) : rotation;
+		keys[i].scale = (scales.size() > 0) ? glm::vec3(scales[i * 3 + 0], scales[i * 3 + 1], scales[i * 3 + 2]) : scale;
+	}
+	motionKeys.swap(keys);
+	markWorldDirty();
+}
+
+void Transform::clearMotionKeys()
+{
+	if (motionKeys.empty()) return;
+	motionKeys = std::vector<TRSKey>();
+	markWorldDirty();
+}
+
+uint32_t Transform::getNumMotionKeys()
+{
+	return uint32_t(motionKeys.size());
+}
+
+glm::mat4 Transform::getLocalToParentMatrixAtTime(float time)
+{
+	TRSKey key;
+	if (motionKeys.size() > 0) {
+		key = sampleTRSKeys(motionKeys.data(), motionKeys.size(), time);
+	} else {
+		/* Without keys, move from the current pose towards the one reached by the end of the frame */
+		TRSKey keys[2];
+		keys[0].translation = position;
+		keys[0].rotation = rotation;
+		keys[0].scale = scale;
+		keys[1].translation = position + linearVelocity;
+		keys[1].rotation = angularVelocity * rotation;
+		keys[1].scale = scale + scalarVelocity;
+		key = sampleTRSKeys(keys, 2, time);
+	}
+	glm::mat4 matrix = affineFromTRS(key.translation, key.rotation, key.scale);
+	if (localToParentTransform) matrix = affineMultiply(*localToParentTransform, matrix);
+	return matrix;
+}
+
+glm::mat4 Transform::getLocalToWorldMatrixAtTime(float time)
+{
+	glm::mat4 matrix = getLocalToParentMatrixAtTime(time);
+	for (int32_t tid = parent; tid != -1; tid = transforms[tid].parent) {
+		matrix = multiply(transforms[tid].getLocalToParentMatrixAtTime(time), matrix);
+	}
+	return matrix;
 }
 
 glm::mat4 Transform::getLocalToParentTranslationMatrix()
 {
-	return localToParentTranslation;
+	return glm::translate(glm::mat4(1.0), position);
 }
 
 glm::mat4 Transform::getLocalToParentScaleMatrix()
 {
-	return localToParentScale;
+	return glm::scale(glm::mat4(1.0), scale);
 }
 
 glm::mat4 Transform::getLocalToParentRotationMatrix()
 {
-	return localToParentRotation;
+	return glm::toMat4(rotation);
 }
 
 glm::mat4 Transform::getParentToLocalTranslationMatrix()
 {
-	return parentToLocalTranslation;
+	return glm::translate(glm::mat4(1.0), -position);
 }
 
 glm::mat4 Transform::getParentToLocalScaleMatrix()
 {
-	return parentToLocalScale;
+	return glm::scale(glm::mat4(1.0), 1.f / scale);
 }
 
 glm::mat4 Transform::getParentToLocalRotationMatrix()
 {
-	return parentToLocalRotation;
+	return glm::toMat4(glm::conjugate(rotation));
 }
 
 void Transform::setParent(Transform *parent) {
@@ -581,23 +789,62 @@ void Transform::setParent(Transform *parent) {
 	if (parent->getId() == this->getId())
 		throw std::runtime_error(std::string("Error: a transform cannot be the parent of itself"));
 
-	this->parent = parent->getId();
-	transforms[parent->getId()].children.insert(this->id);
-	updateChildren();
-	markDirty();
+	for (int32_t tid = parent->parent; tid != -1; tid = transforms[tid].parent) {
+		if (tid == this->id)
+			throw std::runtime_error(std::string("Error: a transform cannot be parented to one of its descendants"));
+	}
+
+	unlinkFromParent();
+	linkToParent(parent->getId());
+	markWorldDirty();
 }
 
 void Transform::clearParent()
 {
-	if ((parent < 0) || (parent >= MAX_TRANSFORMS)){
-		parent = -1;
-		return;
+	if (parent == -1) return;
+	unlinkFromParent();
+	markWorldDirty();
+}
+
+void Transform::unlinkFromParent()
+{
+	if (parent == -1) return;
+	if (prevSibling != -1) transforms[prevSibling].nextSibling = nextSibling;
+	else transforms[parent].firstChild = nextSibling;
+	if (nextSibling != -1) transforms[nextSibling].prevSibling = prevSibling;
+	parent = prevSibling = nextSibling = -1;
+}
+
+void Transform::linkToParent(int32_t newParent)
+{
+	parent = newParent;
+	prevSibling = -1;
+	nextSibling = transforms[newParent].firstChild;
+	if (nextSibling != -1) transforms[nextSibling].prevSibling = id;
+	transforms[newParent].firstChild = id;
+}
+
+Transform::SubtreeIterator &Transform::SubtreeIterator::operator++()
+{
+	if (transforms[current].firstChild != -1) {
+		current = transforms[current].firstChild;
+		return *this;
 	}
-	
-	transforms[parent].children.erase(this->id);
-	this->parent = -1;
-	updateChildren();
-	markDirty();
+	/* Climb until reaching a transform with a sibling left to visit, without leaving the subtree */
+	while (current != root) {
+		if (transforms[current].nextSibling != -1) {
+			current = transforms[current].nextSibling;
+			return *this;
+		}
+		current = transforms[current].parent;
+	}
+	current = -1;
+	return *this;
+}
+
+Transform::Subtree Transform::getSubtree(int32_t root)
+{
+	return Subtree{root};
 }
 
 void Transform::addChild(Transform *object) {
@@ -610,10 +857,7 @@ void Transform::addChild(Transform *object) {
 	if (object->getId() == this->getId())
 		throw std::runtime_error(std::string("Error: a transform cannot be the child of itself"));
 
-	children.insert(object->getId());
-	transforms[object->getId()].parent = this->id;
-	transforms[object->getId()].updateWorldMatrix();
-	transforms[object->getId()].markDirty();
+	object->setParent(this);
 }
 
 void Transform::removeChild(Transform *object) {
@@ -626,86 +870,100 @@ void Transform::removeChild(Transform *object) {
 	if (object->getId() == this->getId())
 		throw std::runtime_error(std::string("Error: a transform cannot be the child of itself"));
 
-	children.erase(object->getId());
-	transforms[object->getId()].parent = -1;
-	transforms[object->getId()].updateWorldMatrix();
-	transforms[object->getId()].markDirty();
+	if (object->parent != this->id) return;
+	object->clearParent();
 }
 
 glm::mat4 Transform::getWorldToLocalMatrix() {
-	return worldToLocalMatrix;
+	if (isWorldStale()) {
+		glm::mat4 worldToLocal, localToWorld, nextLocalToWorld;
+		computeWorldMatrices(worldToLocal, localToWorld, nextLocalToWorld);
+		return worldToLocal;
+	}
+	return transformStructs[id].worldToLocal;
 }
 
 glm::mat4 Transform::getLocalToWorldMatrix() {
-	return localToWorldMatrix;
+	if (isWorldStale()) {
+		glm::mat4 worldToLocal, localToWorld, nextLocalToWorld;
+		computeWorldMatrices(worldToLocal, localToWorld, nextLocalToWorld);
+		return localToWorld;
+	}
+	return transformStructs[id].localToWorld;
 }
 
 glm::mat4 Transform::getNextLocalToWorldMatrix() {
-	return nextLocalToWorldMatrix;
+	if (isWorldStale()) {
+		glm::mat4 worldToLocal, localToWorld, nextLocalToWorld;
+		computeWorldMatrices(worldToLocal, localToWorld, nextLocalToWorld);
+		return nextLocalToWorld;
+	}
+	return nextLocalToWorldMatrices[id];
 }
 
 glm::quat Transform::getWorldRotation() {
+	glm::vec3 worldScale, worldTranslation;
+	glm::quat worldRotation;
+	decomposeWorldMatrix(worldScale, worldRotation, worldTranslation);
 	return worldRotation;
 }
 
 glm::vec3 Transform::getWorldTranslation() {
+	glm::vec3 worldScale, worldTranslation;
+	glm::quat worldRotation;
+	decomposeWorldMatrix(worldScale, worldRotation, worldTranslation);
 	return worldTranslation;
 }
 
 glm::vec3 Transform::getWorldScale() {
+	glm::vec3 worldScale, worldTranslation;
+	glm::quat worldRotation;
+	decomposeWorldMatrix(worldScale, worldRotation, worldTranslation);
 	return worldScale;
 }
 
 glm::mat4 Transform::getWorldToLocalRotationMatrix()
 {
-	return glm::toMat4(glm::inverse(worldRotation));
+	return glm::toMat4(glm::inverse(getWorldRotation()));
 }
 
 glm::mat4 Transform::getLocalToWorldRotationMatrix()
 {
-	return glm::toMat4(worldRotation);
+	return glm::toMat4(getWorldRotation());
 }
 
 glm::mat4 Transform::getWorldToLocalTranslationMatrix()
 {
 	glm::mat4 m(1.0);
-	m = glm::translate(m, -1.0f * worldTranslation);
+	m = glm::translate(m, -1.0f * getWorldTranslation());
 	return m;
 }
 
 glm::mat4 Transform::getLocalToWorldTranslationMatrix()
 {
 	glm::mat4 m(1.0);
-	m = glm::translate(m, worldTranslation);
+	m = glm::translate(m, getWorldTranslation());
 	return m;
 }
 
 glm::mat4 Transform::getWorldToLocalScaleMatrix()
 {
 	glm::mat4 m(1.0);
-	m = glm::scale(m, 1.0f / worldScale);
+	m = glm::scale(m, 1.0f / getWorldScale());
 	return m;
 }
 
 glm::mat4 Transform::getLocalToWorldScaleMatrix()
 {
 	glm::mat4 m(1.0);
-	m = glm::scale(m, worldScale);
+	m = glm::scale(m, getWorldScale());
 	return m;
 }
 
-void Transform::updateChildren()
-{
-	for (auto &c : children) {
-		auto &t = transforms[c];
-		t.updateChildren();
-	}
-
-	updateWorldMatrix();
-	markDirty();
-}
-
 TransformStruct &Transform::getStruct()
 {
+	if (isWorldStale()) {
+		computeWorldMatrices(transformStructs[id].worldToLocal, transformStructs[id].localToWorld, nextLocalToWorldMatrices[id]);
+	}
 	return transformStructs[id];
-}
\ No newline at end of file
+}
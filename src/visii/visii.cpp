@@ -6,17 +6,28 @@
 #include <imgui_impl_opengl3.h>
 #include <ImGuizmo.h>
 #include <visii/utilities/colors.h>
+#include <visii/utilities/affine.h>
+#include <visii/utilities/paged_array.h>
+#include <visii/utilities/parallel.h>
+#ifndef VISII_CPU_ONLY
 #include <owl/owl.h>
 #include <owl/helper/optix.h>
 #include <cuda_gl_interop.h>
 
 #include <devicecode/launch_params.h>
 #include <devicecode/path_tracer.h>
+#else
+#include <devicecode/render_data_flags.h>
+#endif
+#include <hostcode/cpu_renderer.h>
+#include <hostcode/launch_scheduler.h>
 
 #define PBRLUT_IMPLEMENTATION
 #include <visii/utilities/ggx_lookup_tables.h>
 
 #include <thread>
+#include <chrono>
+#include <memory>
 #include <future>
 #include <queue>
 #include <algorithm>
@@ -28,7 +39,9 @@
 #include <stb_image_write.h>
 
 // #define __optix_optix_function_table_h__
+#ifndef VISII_CPU_ONLY
 #include <optix_stubs.h>
+#endif
 // OptixFunctionTable g_optixFunctionTable;
 
 // #include <thrust/reduce.h>
@@ -47,6 +60,7 @@ static struct WindowData {
     ivec2 currentSize, lastSize;
 } WindowData;
 
+#ifndef VISII_CPU_ONLY
 /* Embedded via cmake */
 extern "C" char ptxCode[];
 
@@ -56,6 +70,7 @@ struct MeshData {
     OWLBuffer normals;
     OWLBuffer texCoords;
     OWLBuffer indices;
+    OWLBuffer triangleSamplingTable;
     OWLGeom geom;
     OWLGroup blas;
 };
@@ -80,26 +95,35 @@ static struct OptixData {
     OWLBuffer lightBuffer;
     OWLBuffer textureBuffer;
     OWLBuffer lightEntitiesBuffer;
+    OWLBuffer lightBVHBuffer;
+    OWLBuffer environmentSamplingTableBuffer;
     OWLBuffer instanceToEntityMapBuffer;
     OWLBuffer vertexListsBuffer;
     OWLBuffer normalListsBuffer;
     OWLBuffer texCoordListsBuffer;
     OWLBuffer indexListsBuffer;
+    OWLBuffer triangleSamplingTablesBuffer;
     OWLBuffer textureObjectsBuffer;
 
-    OWLTexture textureObjects[MAX_TEXTURES];
+    std::vector<OWLTexture> textureObjects;
 
     uint32_t numLightEntities;
 
     OWLRayGen rayGen;
+    OWLRayGen primaryRayGen;
     OWLMissProg missProg;
     OWLGeomType trianglesGeomType;
-    MeshData meshes[MAX_MESHES];
+    std::vector<MeshData> meshes;
     OWLGroup tlas;
+    std::vector<OWLGroup> motionSegmentTLASes; // one per motion segment, rebuilt in place while their sizes hold
+    size_t motionSegmentInstances = 0;
 
     std::vector<uint32_t> lightEntities;
+    LightBVH lightBVH;
+    LightBoundsCache lightBounds;
 
     bool enableDenoiser = false;
+    float launchTimeBudget = .1f; // seconds render() aims to spend in each launch
     OptixDenoiserSizes denoiserSizes;
     OptixDenoiser denoiser;
     OWLBuffer denoiserScratchBuffer;
@@ -107,9 +131,18 @@ static struct OptixData {
     OWLBuffer hdrIntensityBuffer;
 
     Texture* domeLightTexture = nullptr;
+    int32_t environmentSamplingTextureID = -1;
 
     OWLBuffer placeholder;
 } OptixData;
+#else
+/* Built without the OptiX backend, only the settings shared with the CPU backend are kept */
+static struct OptixData {
+    HostLaunchParams LP;
+    bool enableDenoiser = false;
+    float launchTimeBudget = .1f; // seconds render() aims to spend in each launch
+} OptixData;
+#endif
 
 static struct ViSII {
     struct Command {
@@ -124,6 +157,12 @@ static struct ViSII {
     bool headlessMode;
 } ViSII;
 
+/* Used in place of OptixData when initialized headless with the "cpu" backend */
+static struct HostData {
+    std::unique_ptr<CPURenderer> renderer;
+    HostLaunchParams launchParams;
+} HostData;
+
 void applyStyle()
 {
 	ImGuiStyle* style = &ImGui::GetStyle();
@@ -197,9 +236,15 @@ void resetAccumulation() {
 }
 
 int getDeviceCount() {
+    if (HostData.renderer) return 0;
+#ifndef VISII_CPU_ONLY
     return owlGetDeviceCount(OptixData.context);
+#else
+    return 0;
+#endif
 }
 
+#ifndef VISII_CPU_ONLY
 OWLContext contextCreate()
 {
     OWLContext context = owlContextCreate(/*requested Device IDs*/ nullptr, /* Num Devices */  0);
@@ -252,6 +297,16 @@ void bufferUpload(OWLBuffer buffer, const void *hostPtr)
     owlBufferUpload(buffer, hostPtr);
 }
 
+/* Component structs live in paged tables, so they are gathered into one contiguous copy for upload */
+template<class T>
+void bufferUploadTable(OWLBuffer buffer, const PagedArray<T> &table)
+{
+    std::vector<T> staging(table.size());
+    table.copyTo(staging.data(), table.size());
+    bufferResize(buffer, table.size());
+    bufferUpload(buffer, staging.data());
+}
+
 CUstream getStream(OWLContext context, int deviceId)
 {
     return owlContextGetStream(context, deviceId);
@@ -338,11 +393,8 @@ void instanceGroupSetChild(OWLGroup group, int whichChild, OWLGroup child)
 
 void instanceGroupSetTransform(OWLGroup group, size_t childID, glm::mat4 m44xfm)
 {
-    owl4x3f xfm = {
-        {m44xfm[0][0], m44xfm[0][1], m44xfm[0][2]}, 
-        {m44xfm[1][0], m44xfm[1][1], m44xfm[1][2]}, 
-        {m44xfm[2][0], m44xfm[2][1], m44xfm[2][2]},
-        {m44xfm[3][0], m44xfm[3][1], m44xfm[3][2]}};
+    owl4x3f xfm;
+    affinePack3x4(&m44xfm, (float*)&xfm, 1);
     owlInstanceGroupSetTransform(group, childID, xfm);
 }
 
@@ -367,6 +419,12 @@ void launchParamsSetTexture(OWLLaunchParams params, const char* varName, OWLText
     owlParamsSetTexture(params, varName, texture);
 }
 
+/* Names of the launch parameters holding the TLAS for each motion segment */
+static const char *motionSegmentNames[MAX_MOTION_KEYS - 1] = {
+    "motionSegment0", "motionSegment1", "motionSegment2", "motionSegment3", 
+    "motionSegment4", "motionSegment5", "motionSegment6"
+};
+
 void launchParamsSetGroup(OWLLaunchParams params, const char *varName, OWLGroup group) {
     owlParamsSetGroup(params, varName, group);
 }
@@ -376,8 +434,12 @@ void paramsLaunch2D(OWLRayGen rayGen, int dims_x, int dims_y, OWLLaunchParams la
     owlLaunch2D(rayGen, dims_x, dims_y, launchParams);
 }
 
+#endif
+
 void synchronizeDevices()
 {
+    if (HostData.renderer) return;
+#ifndef VISII_CPU_ONLY
     for (int i = 0; i < getDeviceCount(); i++) {
         cudaSetDevice(i);
         cudaDeviceSynchronize();
@@ -388,6 +450,7 @@ void synchronizeDevices()
         }
     }
     cudaSetDevice(0);
+#endif
 }
 
 void setCameraEntity(Entity* camera_entity)
@@ -424,7 +487,9 @@ void setIndirectLightingClamp(float clamp)
     clamp = std::max(float(clamp), float(0.f));
     OptixData.LP.indirectClamp = clamp;
     resetAccumulation();
-    launchParamsSetRaw(OptixData.launchParams, "indirectClamp", &OptixData.LP.indirectClamp);
+#ifndef VISII_CPU_ONLY
+    if (!HostData.renderer) launchParamsSetRaw(OptixData.launchParams, "indirectClamp", &OptixData.LP.indirectClamp);
+#endif
 }
 
 void setDirectLightingClamp(float clamp)
@@ -432,16 +497,26 @@ void setDirectLightingClamp(float clamp)
     clamp = std::max(float(clamp), float(0.f));
     OptixData.LP.directClamp = clamp;
     resetAccumulation();
-    launchParamsSetRaw(OptixData.launchParams, "directClamp", &OptixData.LP.directClamp);
+#ifndef VISII_CPU_ONLY
+    if (!HostData.renderer) launchParamsSetRaw(OptixData.launchParams, "directClamp", &OptixData.LP.directClamp);
+#endif
 }
 
 void setMaxBounceDepth(uint32_t depth)
 {
     OptixData.LP.maxBounceDepth = depth;
     resetAccumulation();
-    launchParamsSetRaw(OptixData.launchParams, "maxBounceDepth", &OptixData.LP.maxBounceDepth);
+#ifndef VISII_CPU_ONLY
+    if (!HostData.renderer) launchParamsSetRaw(OptixData.launchParams, "maxBounceDepth", &OptixData.LP.maxBounceDepth);
+#endif
+}
+
+void setLaunchTimeBudget(float seconds)
+{
+    OptixData.launchTimeBudget = std::max(seconds, 0.f);
 }
 
+#ifndef VISII_CPU_ONLY
 void initializeFrameBuffer(int fbWidth, int fbHeight) {
     synchronizeDevices();
 
@@ -502,7 +577,32 @@ void resizeOptixFrameBuffer(uint32_t width, uint32_t height)
 
     resetAccumulation();
 }
+#else
+/* Only reached with a window or the OptiX backend, neither of which a CPU only build can initialize */
+void initializeFrameBuffer(int fbWidth, int fbHeight) {}
+void resizeOptixFrameBuffer(uint32_t width, uint32_t height) {}
+#endif
 
+void resizeHostFrameBuffer(uint32_t width, uint32_t height)
+{
+    OptixData.LP.frameSize.x = width;
+    OptixData.LP.frameSize.y = height;
+    HostData.renderer->resize(width, height);
+    resetAccumulation();
+}
+
+/* Returns the final frame buffer of the backend in use. Devices must be synchronized before reading it. */
+const glm::vec4 *getFrameBufferPointer()
+{
+#ifndef VISII_CPU_ONLY
+    if (HostData.renderer) return HostData.renderer->frameBuffer.data();
+    return (const glm::vec4*) bufferGetPointer(OptixData.frameBuffer, 0);
+#else
+    return HostData.renderer->frameBuffer.data();
+#endif
+}
+
+#ifndef VISII_CPU_ONLY
 void updateFrameBuffer()
 {
     glfwGetFramebufferSize(WindowData.window, &WindowData.currentSize.x, &WindowData.currentSize.y);
@@ -527,6 +627,7 @@ void initializeOptix(bool headless)
     OWLVarDecl launchParamVars[] = {
         { "frameSize",               OWL_USER_TYPE(glm::ivec2),         OWL_OFFSETOF(LaunchParams, frameSize)},
         { "frameID",                 OWL_USER_TYPE(uint64_t),           OWL_OFFSETOF(LaunchParams, frameID)},
+        { "samplesPerLaunch",        OWL_USER_TYPE(uint32_t),           OWL_OFFSETOF(LaunchParams, samplesPerLaunch)},
         { "frameBuffer",             OWL_BUFPTR,                        OWL_OFFSETOF(LaunchParams, frameBuffer)},
         { "normalBuffer",            OWL_BUFPTR,                        OWL_OFFSETOF(LaunchParams, normalBuffer)},
         { "albedoBuffer",            OWL_BUFPTR,                        OWL_OFFSETOF(LaunchParams, albedoBuffer)},
@@ -541,11 +642,20 @@ void initializeOptix(bool headless)
         { "lights",                  OWL_BUFPTR,                        OWL_OFFSETOF(LaunchParams, lights)},
         { "textures",                OWL_BUFPTR,                        OWL_OFFSETOF(LaunchParams, textures)},
         { "lightEntities",           OWL_BUFPTR,                        OWL_OFFSETOF(LaunchParams, lightEntities)},
+        { "lightBVH",                OWL_BUFPTR,                        OWL_OFFSETOF(LaunchParams, lightBVH)},
         { "vertexLists",             OWL_BUFFER,                        OWL_OFFSETOF(LaunchParams, vertexLists)},
         { "normalLists",             OWL_BUFFER,                        OWL_OFFSETOF(LaunchParams, normalLists)},
         { "texCoordLists",           OWL_BUFFER,                        OWL_OFFSETOF(LaunchParams, texCoordLists)},
         { "indexLists",              OWL_BUFFER,                        OWL_OFFSETOF(LaunchParams, indexLists)},
+        { "triangleSamplingTables",  OWL_BUFFER,                        OWL_OFFSETOF(LaunchParams, triangleSamplingTables)},
         { "numLightEntities",        OWL_USER_TYPE(uint32_t),           OWL_OFFSETOF(LaunchParams, numLightEntities)},
+        { "numEntities",             OWL_USER_TYPE(uint32_t),           OWL_OFFSETOF(LaunchParams, numEntities)},
+        { "numTransforms",           OWL_USER_TYPE(uint32_t),           OWL_OFFSETOF(LaunchParams, numTransforms)},
+        { "numMaterials",            OWL_USER_TYPE(uint32_t),           OWL_OFFSETOF(LaunchParams, numMaterials)},
+        { "numCameras",              OWL_USER_TYPE(uint32_t),           OWL_OFFSETOF(LaunchParams, numCameras)},
+        { "numMeshes",               OWL_USER_TYPE(uint32_t),           OWL_OFFSETOF(LaunchParams, numMeshes)},
+        { "numLights",               OWL_USER_TYPE(uint32_t),           OWL_OFFSETOF(LaunchParams, numLights)},
+        { "numTextures",             OWL_USER_TYPE(uint32_t),           OWL_OFFSETOF(LaunchParams, numTextures)},
         { "instanceToEntityMap",     OWL_BUFPTR,                        OWL_OFFSETOF(LaunchParams, instanceToEntityMap)},
         { "domeLightIntensity",      OWL_USER_TYPE(float),              OWL_OFFSETOF(LaunchParams, domeLightIntensity)},
         { "directClamp",             OWL_USER_TYPE(float),              OWL_OFFSETOF(LaunchParams, directClamp)},
@@ -553,11 +663,21 @@ void initializeOptix(bool headless)
         { "maxBounceDepth",          OWL_USER_TYPE(uint32_t),           OWL_OFFSETOF(LaunchParams, maxBounceDepth)},
         { "environmentMapID",        OWL_USER_TYPE(uint32_t),           OWL_OFFSETOF(LaunchParams, environmentMapID)},
         { "environmentMapRotation",  OWL_USER_TYPE(glm::quat),          OWL_OFFSETOF(LaunchParams, environmentMapRotation)},
+        { "environmentSamplingTable", OWL_BUFPTR,                       OWL_OFFSETOF(LaunchParams, environmentSamplingTable)},
+        { "environmentSamplingTableSize", OWL_USER_TYPE(glm::ivec2),    OWL_OFFSETOF(LaunchParams, environmentSamplingTableSize)},
         { "textureObjects",          OWL_BUFPTR,                        OWL_OFFSETOF(LaunchParams, textureObjects)},
         { "GGX_E_AVG_LOOKUP",        OWL_TEXTURE,                       OWL_OFFSETOF(LaunchParams, GGX_E_AVG_LOOKUP)},
         { "GGX_E_LOOKUP",            OWL_TEXTURE,                       OWL_OFFSETOF(LaunchParams, GGX_E_LOOKUP)},
         { "renderDataMode",          OWL_USER_TYPE(uint32_t),           OWL_OFFSETOF(LaunchParams, renderDataMode)},
         { "renderDataBounce",        OWL_USER_TYPE(uint32_t),           OWL_OFFSETOF(LaunchParams, renderDataBounce)},
+        { "numMotionSegments",       OWL_USER_TYPE(uint32_t),           OWL_OFFSETOF(LaunchParams, numMotionSegments)},
+        { "motionSegment0",          OWL_GROUP,                         OWL_OFFSETOF(LaunchParams, motionSegments) + 0 * sizeof(OptixTraversableHandle)},
+        { "motionSegment1",          OWL_GROUP,                         OWL_OFFSETOF(LaunchParams, motionSegments) + 1 * sizeof(OptixTraversableHandle)},
+        { "motionSegment2",          OWL_GROUP,                         OWL_OFFSETOF(LaunchParams, motionSegments) + 2 * sizeof(OptixTraversableHandle)},
+        { "motionSegment3",          OWL_GROUP,                         OWL_OFFSETOF(LaunchParams, motionSegments) + 3 * sizeof(OptixTraversableHandle)},
+        { "motionSegment4",          OWL_GROUP,                         OWL_OFFSETOF(LaunchParams, motionSegments) + 4 * sizeof(OptixTraversableHandle)},
+        { "motionSegment5",          OWL_GROUP,                         OWL_OFFSETOF(LaunchParams, motionSegments) + 5 * sizeof(OptixTraversableHandle)},
+        { "motionSegment6",          OWL_GROUP,                         OWL_OFFSETOF(LaunchParams, motionSegments) + 6 * sizeof(OptixTraversableHandle)},
         { /* sentinel to mark end of list */ }
     };
     OD.launchParams = launchParamsCreate(OD.context, sizeof(LaunchParams), launchParamVars, -1);
@@ -579,20 +699,23 @@ void initializeOptix(bool headless)
     launchParamsSetRaw(OD.launchParams, "frameSize", &OD.LP.frameSize);
 
     /* Create Component Buffers */
-    OD.entityBuffer              = deviceBufferCreate(OD.context, OWL_USER_TYPE(EntityStruct),        MAX_ENTITIES,   nullptr);
-    OD.transformBuffer           = deviceBufferCreate(OD.context, OWL_USER_TYPE(TransformStruct),     MAX_TRANSFORMS, nullptr);
-    OD.cameraBuffer              = deviceBufferCreate(OD.context, OWL_USER_TYPE(CameraStruct),        MAX_CAMERAS,    nullptr);
-    OD.materialBuffer            = deviceBufferCreate(OD.context, OWL_USER_TYPE(MaterialStruct),      MAX_MATERIALS,  nullptr);
-    OD.meshBuffer                = deviceBufferCreate(OD.context, OWL_USER_TYPE(MeshStruct),          MAX_MESHES,     nullptr);
-    OD.lightBuffer               = deviceBufferCreate(OD.context, OWL_USER_TYPE(LightStruct),         MAX_LIGHTS,     nullptr);
-    OD.textureBuffer             = deviceBufferCreate(OD.context, OWL_USER_TYPE(TextureStruct),       MAX_TEXTURES,   nullptr);
+    OD.entityBuffer              = deviceBufferCreate(OD.context, OWL_USER_TYPE(EntityStruct),        1,              nullptr);
+    OD.transformBuffer           = deviceBufferCreate(OD.context, OWL_USER_TYPE(TransformStruct),     1,              nullptr);
+    OD.cameraBuffer              = deviceBufferCreate(OD.context, OWL_USER_TYPE(CameraStruct),        1,              nullptr);
+    OD.materialBuffer            = deviceBufferCreate(OD.context, OWL_USER_TYPE(MaterialStruct),      1,              nullptr);
+    OD.meshBuffer                = deviceBufferCreate(OD.context, OWL_USER_TYPE(MeshStruct),          1,              nullptr);
+    OD.lightBuffer               = deviceBufferCreate(OD.context, OWL_USER_TYPE(LightStruct),         1,              nullptr);
+    OD.textureBuffer             = deviceBufferCreate(OD.context, OWL_USER_TYPE(TextureStruct),       1,              nullptr);
     OD.lightEntitiesBuffer       = deviceBufferCreate(OD.context, OWL_USER_TYPE(uint32_t),            1,              nullptr);
+    OD.lightBVHBuffer            = deviceBufferCreate(OD.context, OWL_USER_TYPE(LightBVHNode),        1,              nullptr);
+    OD.environmentSamplingTableBuffer = deviceBufferCreate(OD.context, OWL_USER_TYPE(AliasTableEntry), 1,              nullptr);
     OD.instanceToEntityMapBuffer = deviceBufferCreate(OD.context, OWL_USER_TYPE(uint32_t),            1,              nullptr);
-    OD.vertexListsBuffer         = deviceBufferCreate(OD.context, OWL_BUFFER,                         MAX_MESHES,     nullptr);
-    OD.normalListsBuffer         = deviceBufferCreate(OD.context, OWL_BUFFER,                         MAX_MESHES,     nullptr);
-    OD.texCoordListsBuffer       = deviceBufferCreate(OD.context, OWL_BUFFER,                         MAX_MESHES,     nullptr);
-    OD.indexListsBuffer          = deviceBufferCreate(OD.context, OWL_BUFFER,                         MAX_MESHES,     nullptr);
-    OD.textureObjectsBuffer      = deviceBufferCreate(OD.context, OWL_TEXTURE,                        MAX_TEXTURES,   nullptr);
+    OD.vertexListsBuffer         = deviceBufferCreate(OD.context, OWL_BUFFER,                         1,              nullptr);
+    OD.normalListsBuffer         = deviceBufferCreate(OD.context, OWL_BUFFER,                         1,              nullptr);
+    OD.texCoordListsBuffer       = deviceBufferCreate(OD.context, OWL_BUFFER,                         1,              nullptr);
+    OD.indexListsBuffer          = deviceBufferCreate(OD.context, OWL_BUFFER,                         1,              nullptr);
+    OD.triangleSamplingTablesBuffer = deviceBufferCreate(OD.context, OWL_BUFFER,                      1,              nullptr);
+    OD.textureObjectsBuffer      = deviceBufferCreate(OD.context, OWL_TEXTURE,                        1,              nullptr);
 
     
 
@@ -604,17 +727,21 @@ void initializeOptix(bool headless)
     launchParamsSetBuffer(OD.launchParams, "lights",              OD.lightBuffer);
     launchParamsSetBuffer(OD.launchParams, "textures",            OD.textureBuffer);
     launchParamsSetBuffer(OD.launchParams, "lightEntities",       OD.lightEntitiesBuffer);
+    launchParamsSetBuffer(OD.launchParams, "lightBVH",            OD.lightBVHBuffer);
+    launchParamsSetBuffer(OD.launchParams, "environmentSamplingTable", OD.environmentSamplingTableBuffer);
     launchParamsSetBuffer(OD.launchParams, "instanceToEntityMap", OD.instanceToEntityMapBuffer);
     launchParamsSetBuffer(OD.launchParams, "vertexLists",         OD.vertexListsBuffer);
     launchParamsSetBuffer(OD.launchParams, "normalLists",         OD.normalListsBuffer);
     launchParamsSetBuffer(OD.launchParams, "texCoordLists",       OD.texCoordListsBuffer);
     launchParamsSetBuffer(OD.launchParams, "indexLists",          OD.indexListsBuffer);
+    launchParamsSetBuffer(OD.launchParams, "triangleSamplingTables", OD.triangleSamplingTablesBuffer);
     launchParamsSetBuffer(OD.launchParams, "textureObjects",      OD.textureObjectsBuffer);
 
     OD.LP.environmentMapID = -1;
     OD.LP.environmentMapRotation = glm::quat(1,0,0,0);
     launchParamsSetRaw(OD.launchParams, "environmentMapID", &OD.LP.environmentMapID);
     launchParamsSetRaw(OD.launchParams, "environmentMapRotation", &OD.LP.environmentMapRotation);
+    launchParamsSetRaw(OD.launchParams, "environmentSamplingTableSize", &OD.LP.environmentSamplingTableSize);
                             
     OWLTexture GGX_E_AVG_LOOKUP = texture2DCreate(OD.context,
                             OWL_TEXEL_FORMAT_R32F,
@@ -657,6 +784,9 @@ void initializeOptix(bool headless)
     instanceGroupSetChild(world, 0, trianglesGroup); 
     groupBuildAccel(world);
     launchParamsSetGroup(OD.launchParams, "world", world);
+    for (uint32_t i = 0; i < MAX_MOTION_KEYS - 1; ++i) {
+        launchParamsSetGroup(OD.launchParams, motionSegmentNames[i], world);
+    }
 
     // Setup miss prog 
     OWLVarDecl missProgVars[] = {{ /* sentinel to mark end of list */ }};
@@ -665,6 +795,7 @@ void initializeOptix(bool headless)
     // Setup ray gen program
     OWLVarDecl rayGenVars[] = {{ /* sentinel to mark end of list */ }};
     OD.rayGen = rayGenCreate(OD.context,OD.module,"rayGen", sizeof(RayGenData), rayGenVars,-1);
+    OD.primaryRayGen = rayGenCreate(OD.context,OD.module,"primaryRayGen", sizeof(RayGenData), rayGenVars,-1);
 
     // Build *SBT* required to trace the groups   
     buildPrograms(OD.context);
@@ -703,6 +834,7 @@ void initializeOptix(bool headless)
 
     OD.placeholder = owlDeviceBufferCreate(OD.context, OWL_USER_TYPE(void*), 1, nullptr);
 }
+#endif
 
 void initializeImgui()
 {
@@ -718,8 +850,289 @@ void initializeImgui()
     ImGui_ImplOpenGL3_Init(glsl_version);
 }
 
+/* Returns the largest number of motion keys on any transform */
+uint32_t getNumMotionKeys()
+{
+    uint32_t numMotionKeys = 0;
+    auto &transforms = Transform::getFront();
+    for (uint32_t tid = 0; tid < Transform::getCount(); ++tid) {
+        if (!transforms[tid].isInitialized()) continue;
+        numMotionKeys = std::max(numMotionKeys, transforms[tid].getNumMotionKeys());
+    }
+    return numMotionKeys;
+}
+
+/* Returns an instance's transform at one of the numMotionSegments + 1 keys spread evenly over the frame */
+glm::mat4 getInstanceKeyMatrix(Transform* transform, uint32_t numMotionKeys, uint32_t numMotionSegments, uint32_t key)
+{
+    if (numMotionKeys == 0) return (key == 0) ? transform->getLocalToWorldMatrix() : transform->getNextLocalToWorldMatrix();
+    return transform->getLocalToWorldMatrixAtTime(float(key) / float(numMotionSegments));
+}
+
+/* 
+ * Brings the bounds on where each light entity is and which way it shines up to date, for the light BVH. A light's
+ * power is its intensity, times the luminance of its color, times the world space area of its mesh. Lights without
+ * a mesh can't be sampled by the tracers, so they get no power, and are never picked. Only lights whose entity, mesh,
+ * transform or light changed are recomputed, by placing their mesh's cached object space bounds in the world.
+ * The caller holds the Entity and Mesh edit mutexes. Returns whether any light's bounds changed.
+*/
+bool updateLightBounds(LightBoundsCache &cache, const std::vector<uint32_t> &lightEntities)
+{
+    auto &entities = Entity::getFront();
+    std::vector<LightBoundsCache::Source> sources(lightEntities.size());
+    for (size_t i = 0; i < lightEntities.size(); ++i) {
+        Entity &entity = entities[lightEntities[i]];
+        Light *light = entity.getLight();
+        Mesh *mesh = entity.getMesh();
+        Transform *transform = entity.getTransform();
+        LightBoundsCache::Source &source = sources[i];
+        source.entityID = lightEntities[i];
+        if (!light || !mesh || !transform) continue;
+
+        uint32_t mid = mesh->getId();
+        if (mid >= cache.meshes.size()) cache.meshes.resize(mid + 1);
+        glm::vec3 color = light->getColor();
+        float luminance = 0.2126f * color.r + 0.7152f * color.g + 0.0722f * color.b;
+        source.meshID = int32_t(mid);
+        source.meshVersion = cache.meshes[mid].version;
+        source.localToWorld = transform->getLocalToWorldMatrix();
+        source.radiance = light->getIntensity() * luminance;
+    }
+
+    std::vector<uint32_t> changed;
+    std::vector<uint32_t> meshesToCompute;
+    cache.lights.resize(lightEntities.size());
+    for (uint32_t i = 0; i < sources.size(); ++i) {
+        if ((i < cache.sources.size()) && (cache.sources[i] == sources[i])) continue;
+        changed.push_back(i);
+        int32_t mid = sources[i].meshID;
+        if ((mid >= 0) && !cache.meshes[mid].computed) {
+            cache.meshes[mid].computed = true;
+            meshesToCompute.push_back(uint32_t(mid));
+        }
+    }
+    cache.sources = std::move(sources);
+    if (changed.empty()) return false;
+
+    auto &meshes = Mesh::getFront();
+    parallelFor(meshesToCompute.size(), [&] (uint64_t begin, uint64_t end, uint32_t) {
+        for (uint64_t i = begin; i < end; ++i) {
+            uint32_t mid = meshesToCompute[i];
+            cache.meshes[mid].bounds = computeObjectLightBounds(meshes[mid].getVerticesRef(), meshes[mid].getTriangleIndicesRef());
+        }
+    }, 1);
+    parallelFor(changed.size(), [&] (uint64_t begin, uint64_t end, uint32_t) {
+        for (uint64_t i = begin; i < end; ++i) {
+            const LightBoundsCache::Source &source = cache.sources[changed[i]];
+            cache.lights[changed[i]] = (source.meshID < 0) ? LightBounds() :
+                transformMeshLightBounds(cache.meshes[source.meshID].bounds, source.localToWorld, source.radiance);
+        }
+    }, 256);
+    return true;
+}
+
+/* 
+ * Brings a light BVH up to date with the light entities. It's rebuilt when lights were added or removed since it was
+ * built, and otherwise only refit, which is much cheaper when lights just move or change brightness. The caller
+ * holds the Entity and Mesh edit mutexes.
+*/
+void updateLightBVH(LightBVH &bvh, LightBoundsCache &cache, const std::vector<uint32_t> &lightEntities)
+{
+    bool sameEntities = (cache.sources.size() == lightEntities.size());
+    for (size_t i = 0; sameEntities && (i < lightEntities.size()); ++i) sameEntities = (cache.sources[i].entityID == lightEntities[i]);
+    if (!updateLightBounds(cache, lightEntities) && sameEntities) return;
+    if (!sameEntities || !bvh.refit(cache.lights)) bvh.build(cache.lights);
+}
+
+/* Whether the dome light's sampling table, last built from the given texture, is out of date */
+bool isEnvironmentSamplingTableDirty(int32_t builtTextureID)
+{
+    int32_t textureID = OptixData.LP.environmentMapID;
+    if (textureID != builtTextureID) return true;
+    if ((textureID < 0) || (uint32_t(textureID) >= Texture::getCount())) return false;
+    return Texture::getFront()[textureID].isDirty();
+}
+
+/* 
+ * Builds the table the dome light is sampled from, for the texture it currently uses. The table stays empty, and 
+ * the dome light is only reached by escaping paths, when it has no texture or the texture is black.
+*/
+std::vector<AliasTableEntry> buildDomeLightSamplingTable(int32_t textureID, glm::ivec2 &size)
+{
+    size = glm::ivec2(0);
+    if ((textureID < 0) || (uint32_t(textureID) >= Texture::getCount())) return {};
+    Texture &texture = Texture::getFront()[textureID];
+    if (!texture.isInitialized()) return {};
+
+    std::vector<AliasTableEntry> table = buildEnvironmentSamplingTable(texture.getTexels(), texture.getWidth(), texture.getHeight());
+    if (!table.empty()) size = glm::ivec2(texture.getWidth(), texture.getHeight());
+    return table;
+}
+
+/* Copies the first count structs of a component table into the CPU renderer */
+template<class T>
+void hostCopyTable(std::vector<T> &dest, const PagedArray<T> &table, uint32_t count)
+{
+    dest.resize(count);
+    table.copyTo(dest.data(), count);
+}
+
+/* The CPU backend's version of updateComponents, which copies component data into the CPU renderer */
+void updateHostComponents()
+{
+    CPURenderer &renderer = *HostData.renderer;
+
+    // If any of the components are dirty, reset accumulation
+    if (Mesh::areAnyDirty()) resetAccumulation();
+    if (Material::areAnyDirty()) resetAccumulation();
+    if (Camera::areAnyDirty()) resetAccumulation();
+    if (Transform::areAnyDirty()) resetAccumulation();
+    if (Entity::areAnyDirty()) resetAccumulation();
+    if (Light::areAnyDirty()) resetAccumulation();
+    if (Texture::areAnyDirty()) resetAccumulation();
+
+    // Light bounds depend on which entities are lights, on their meshes and transforms, and on the lights themselves
+    bool lightBoundsDirty = Entity::areAnyDirty() || Transform::areAnyDirty() || Mesh::areAnyDirty() || Light::areAnyDirty();
+
+    // Rotating the dome light doesn't change its sampling table, since directions are rotated into the texture's frame
+    bool environmentSamplingDirty = isEnvironmentSamplingTableDirty(renderer.environmentSamplingTextureID);
+
+    // Manage Meshes: Build / Rebuild BLAS
+    if (Mesh::areAnyDirty()) {
+        auto mutex = Mesh::getEditMutex();
+        std::lock_guard<std::mutex> lock(*mutex.get());
+        auto &meshes = Mesh::getFront();
+        for (uint32_t mid = 0; mid < Mesh::getCount(); ++mid) {
+            if (!meshes[mid].isDirty()) continue;
+            renderer.lightBounds.invalidateMesh(mid);
+            if (!meshes[mid].isInitialized()) { renderer.clearMesh(mid); continue; }
+            renderer.setMesh(mid, meshes[mid].getVertices(), meshes[mid].getNormals(), 
+                meshes[mid].getTexCoords(), meshes[mid].getTriangleIndices());
+        }
+        Mesh::updateComponents();
+        hostCopyTable(renderer.meshes, Mesh::getFrontStruct(), Mesh::getCount());
+    }
+
+    // Manage transforms. Done before entities, for the same reason as on the GPU
+    if (Transform::areAnyDirty()) {
+        auto mutex = Transform::getEditMutex();
+        std::lock_guard<std::mutex> lock(*mutex.get());
+
+        Transform::updateComponents();
+        hostCopyTable(renderer.transforms, Transform::getFrontStruct(), Transform::getCount());
+    }
+
+    // Manage Entities: Build / Rebuild TLAS
+    if (Entity::areAnyDirty()) {
+        auto mutex = Entity::getEditMutex();
+        std::lock_guard<std::mutex> lock(*mutex.get());
+
+        uint32_t numMotionKeys = getNumMotionKeys();
+        uint32_t numMotionSegments = std::max(numMotionKeys, 2u) - 1;
+
+        std::vector<CPURenderer::Instance> instances;
+        auto &entities = Entity::getFront();
+        for (uint32_t eid = 0; eid < Entity::getCount(); ++eid) {
+            if (!entities[eid].isInitialized()) continue;
+            if (!entities[eid].getTransform()) continue;
+            if (!entities[eid].getMesh()) continue;
+            if (!entities[eid].getMaterial() && !entities[eid].getLight()) continue;
+            if (!renderer.hasMesh(entities[eid].getMesh()->getId())) continue;
+
+            CPURenderer::Instance instance;
+            instance.entityID = eid;
+            instance.meshID = entities[eid].getMesh()->getId();
+            for (uint32_t key = 0; key <= numMotionSegments; ++key) {
+                instance.keys.push_back(getInstanceKeyMatrix(entities[eid].getTransform(), numMotionKeys, numMotionSegments, key));
+            }
+            instances.push_back(std::move(instance));
+        }
+        renderer.setInstances(std::move(instances));
+
+        renderer.lightEntities.resize(0);
+        for (uint32_t eid = 0; eid < Entity::getCount(); ++eid) {
+            if (!entities[eid].isInitialized()) continue;
+            if (!entities[eid].getTransform()) continue;
+            if (!entities[eid].getLight()) continue;
+            renderer.lightEntities.push_back(eid);
+        }
+
+        Entity::updateComponents();
+        hostCopyTable(renderer.entities, Entity::getFrontStruct(), Entity::getCount());
+    }
+
+    // Manage textures
+    if (Texture::areAnyDirty()) {
+        auto mutex = Texture::getEditMutex();
+        std::lock_guard<std::mutex> lock(*mutex.get());
+
+        auto &textures = Texture::getFront();
+        for (uint32_t tid = 0; tid < Texture::getCount(); ++tid) {
+            if (!textures[tid].isInitialized()) { renderer.clearTexture(tid); continue; }
+            if (textures[tid].isDirty()) {
+                renderer.setTexture(tid, textures[tid].getWidth(), textures[tid].getHeight(), textures[tid].getTexels());
+            }
+        }
+        Texture::updateComponents();
+        hostCopyTable(renderer.textures, Texture::getFrontStruct(), Texture::getCount());
+    }
+
+    // Manage Cameras
+    if (Camera::areAnyDirty()) {
+        auto mutex = Camera::getEditMutex();
+        std::lock_guard<std::mutex> lock(*mutex.get());
+
+        Camera::updateComponents();
+        hostCopyTable(renderer.cameras, Camera::getFrontStruct(), Camera::getCount());
+    }
+
+    // Manage materials
+    if (Material::areAnyDirty()) {
+        auto mutex = Material::getEditMutex();
+        std::lock_guard<std::mutex> lock(*mutex.get());
+
+        Material::updateComponents();
+        hostCopyTable(renderer.materials, Material::getFrontStruct(), Material::getCount());
+    }
+
+    // Manage lights
+    if (Light::areAnyDirty()) {
+        auto mutex = Light::getEditMutex();
+        std::lock_guard<std::mutex> lock(*mutex.get());
+
+        Light::updateComponents();
+        hostCopyTable(renderer.lights, Light::getFrontStruct(), Light::getCount());
+    }
+
+    if (lightBoundsDirty) {
+        auto mutex = Entity::getEditMutex();
+        std::lock_guard<std::mutex> lock(*mutex.get());
+        auto meshMutex = Mesh::getEditMutex();
+        std::lock_guard<std::mutex> meshLock(*meshMutex.get());
+
+        updateLightBVH(renderer.lightBVH, renderer.lightBounds, renderer.lightEntities);
+
+        // setMesh clears a mesh's table when it changes
+        auto &entities = Entity::getFront();
+        for (uint32_t eid : renderer.lightEntities) {
+            if (entities[eid].getMesh()) renderer.buildTriangleSamplingTable(entities[eid].getMesh()->getId());
+        }
+    }
+
+    if (environmentSamplingDirty) {
+        auto mutex = Texture::getEditMutex();
+        std::lock_guard<std::mutex> lock(*mutex.get());
+
+        renderer.environmentSamplingTextureID = OptixData.LP.environmentMapID;
+        renderer.environmentSamplingTable = buildDomeLightSamplingTable(renderer.environmentSamplingTextureID, renderer.environmentSamplingTableSize);
+    }
+}
+
 void updateComponents()
 {
+    if (HostData.renderer) { updateHostComponents(); return; }
+
+#ifndef VISII_CPU_ONLY
     auto &OD = OptixData;
 
     // If any of the components are dirty, reset accumulation
@@ -731,13 +1144,22 @@ void updateComponents()
     if (Light::areAnyDirty()) resetAccumulation();
     if (Texture::areAnyDirty()) resetAccumulation();
 
+    // Light bounds depend on which entities are lights, on their meshes and transforms, and on the lights themselves
+    bool lightBoundsDirty = Entity::areAnyDirty() || Transform::areAnyDirty() || Mesh::areAnyDirty() || Light::areAnyDirty();
+
+    // Rotating the dome light doesn't change its sampling table, since directions are rotated into the texture's frame
+    bool environmentSamplingDirty = isEnvironmentSamplingTableDirty(OD.environmentSamplingTextureID);
+
     // Manage Meshes: Build / Rebuild BLAS
     if (Mesh::areAnyDirty()) {
         auto mutex = Mesh::getEditMutex();
         std::lock_guard<std::mutex> lock(*mutex.get());
-        Mesh* meshes = Mesh::getFront();
+        auto &meshes = Mesh::getFront();
+        OD.meshes.resize(Mesh::getCount());
         for (uint32_t mid = 0; mid < Mesh::getCount(); ++mid) {
             if (!meshes[mid].isDirty()) continue;
+            OD.lightBounds.invalidateMesh(mid);
+            if (OD.meshes[mid].triangleSamplingTable) { owlBufferRelease(OD.meshes[mid].triangleSamplingTable); OD.meshes[mid].triangleSamplingTable = nullptr; }
             if (!meshes[mid].isInitialized()) {
                 if (OD.meshes[mid].vertices) { owlBufferRelease(OD.meshes[mid].vertices); OD.meshes[mid].vertices = nullptr; }
                 if (OD.meshes[mid].colors) { owlBufferRelease(OD.meshes[mid].colors); OD.meshes[mid].colors = nullptr; }
@@ -780,24 +1202,41 @@ void updateComponents()
             texCoordLists[mid] = OD.meshes[mid].texCoords;
             indexLists[mid] = OD.meshes[mid].indices;
         }
+        bufferResize(OD.vertexListsBuffer, vertexLists.size());
+        bufferResize(OD.texCoordListsBuffer, texCoordLists.size());
+        bufferResize(OD.indexListsBuffer, indexLists.size());
+        bufferResize(OD.normalListsBuffer, normalLists.size());
         bufferUpload(OD.vertexListsBuffer, vertexLists.data());
         bufferUpload(OD.texCoordListsBuffer, texCoordLists.data());
         bufferUpload(OD.indexListsBuffer, indexLists.data());
         bufferUpload(OD.normalListsBuffer, normalLists.data());
         Mesh::updateComponents();
-        bufferUpload(OptixData.meshBuffer, Mesh::getFrontStruct());
+        bufferUploadTable(OptixData.meshBuffer, Mesh::getFrontStruct());
+        OD.LP.numMeshes = Mesh::getCount();
+        launchParamsSetRaw(OD.launchParams, "numMeshes", &OD.LP.numMeshes);
     }
 
+    // Manage transforms. Done before entities, since updating world matrices 
+    // flags the entities below any edited transform as needing new instance transforms
+    if (Transform::areAnyDirty()) {
+        auto mutex = Transform::getEditMutex();
+        std::lock_guard<std::mutex> lock(*mutex.get());
+
+        Transform::updateComponents();
+        bufferUploadTable(OptixData.transformBuffer, Transform::getFrontStruct());
+        OD.LP.numTransforms = Transform::getCount();
+        launchParamsSetRaw(OD.launchParams, "numTransforms", &OD.LP.numTransforms);
+    }   
+
     // Manage Entities: Build / Rebuild TLAS
     if (Entity::areAnyDirty()) {
         auto mutex = Entity::getEditMutex();
         std::lock_guard<std::mutex> lock(*mutex.get());
 
         std::vector<OWLGroup> instances;
-        std::vector<glm::mat4> t0InstanceTransforms;
-        std::vector<glm::mat4> t1InstanceTransforms;
+        std::vector<Transform*> instanceTransforms;
         std::vector<uint32_t> instanceToEntityMap;
-        Entity* entities = Entity::getFront();
+        auto &entities = Entity::getFront();
         for (uint32_t eid = 0; eid < Entity::getCount(); ++eid) {
             // if (!entities[eid].isDirty()) continue; // if any entities are dirty, need to rebuild entire TLAS
             if (!entities[eid].isInitialized()) continue;
@@ -807,49 +1246,61 @@ void updateComponents()
 
             OWLGroup blas = OD.meshes[entities[eid].getMesh()->getId()].blas;
             if (!blas) return;
-            glm::mat4 localToWorld = entities[eid].getTransform()->getLocalToWorldMatrix();
-            glm::mat4 nextLocalToWorld = entities[eid].getTransform()->getNextLocalToWorldMatrix();
             instances.push_back(blas);
-            t0InstanceTransforms.push_back(localToWorld);            
-            t1InstanceTransforms.push_back(nextLocalToWorld);            
+            instanceTransforms.push_back(entities[eid].getTransform());
             instanceToEntityMap.push_back(eid);
         }
 
-        std::vector<owl4x3f>     t0Transforms;
-        std::vector<owl4x3f>     t1Transforms;
-        // if (OD.tlas) {owlGroupRelease(OD.tlas); OD.tlas = nullptr;}
-        // not sure why, but if I release this TLAS, I get the following error
-        // python3d: /home/runner/work/ViSII/ViSII/externals/owl/owl/ObjectRegistry.cpp:83: 
-        //   owl::RegisteredObject* owl::ObjectRegistry::getPtr(int): Assertion `objects[ID]' failed.
-        OD.tlas = instanceGroupCreate(OD.context, instances.size());
-        for (uint32_t iid = 0; iid < instances.size(); ++iid) {
-            instanceGroupSetChild(OD.tlas, iid, instances[iid]); 
-            glm::mat4 xfm0 = t0InstanceTransforms[iid];
-            glm::mat4 xfm1 = t1InstanceTransforms[iid];
-            
-            owl4x3f oxfm0 = {
-                {xfm0[0][0], xfm0[0][1], xfm0[0][2]}, 
-                {xfm0[1][0], xfm0[1][1], xfm0[1][2]}, 
-                {xfm0[2][0], xfm0[2][1], xfm0[2][2]},
-                {xfm0[3][0], xfm0[3][1], xfm0[3][2]}};
-            t0Transforms.push_back(oxfm0);
-
-            owl4x3f oxfm1 = {
-                {xfm1[0][0], xfm1[0][1], xfm1[0][2]}, 
-                {xfm1[1][0], xfm1[1][1], xfm1[1][2]}, 
-                {xfm1[2][0], xfm1[2][1], xfm1[2][2]},
-                {xfm1[3][0], xfm1[3][1], xfm1[3][2]}};
-            t1Transforms.push_back(oxfm1);
+        // OWL instances interpolate linearly between two transforms. When any transform has motion keys, 
+        // the frame is split into one segment per pair of consecutive keys, each with its own TLAS, and 
+        // rays pick the segment covering their time.
+        uint32_t numMotionKeys = getNumMotionKeys();
+        uint32_t numMotionSegments = std::max(numMotionKeys, 2u) - 1;
+
+        std::vector<std::vector<owl4x3f>> keyTransforms(numMotionSegments + 1, std::vector<owl4x3f>(instances.size()));
+        std::vector<glm::mat4> xfms(instances.size());
+        for (uint32_t key = 0; key <= numMotionSegments; ++key) {
+            for (uint32_t iid = 0; iid < instances.size(); ++iid) {
+                xfms[iid] = getInstanceKeyMatrix(instanceTransforms[iid], numMotionKeys, numMotionSegments, key);
+            }
+            affinePack3x4(xfms.data(), (float*)keyTransforms[key].data(), instances.size());
         }
-        
-        owlInstanceGroupSetTransforms(OD.tlas,0,(const float*)t0Transforms.data());
-        owlInstanceGroupSetTransforms(OD.tlas,1,(const float*)t1Transforms.data());
 
         bufferResize(OD.instanceToEntityMapBuffer, instanceToEntityMap.size());
         bufferUpload(OD.instanceToEntityMapBuffer, instanceToEntityMap.data());
-        groupBuildAccel(OD.tlas);
+
+        // Instance groups have a fixed size, so the segment TLASes are only replaced when the number of instances
+        // or segments changes, and are otherwise given their new children and transforms and rebuilt in place.
+        // Replaced groups are released only once no launch parameter refers to them anymore, since OWL asserts
+        // on released groups which are still referenced.
+        std::vector<OWLGroup> retiredTLASes;
+        if ((OD.motionSegmentTLASes.size() != numMotionSegments) || (OD.motionSegmentInstances != instances.size())) {
+            retiredTLASes.swap(OD.motionSegmentTLASes);
+            for (uint32_t segment = 0; segment < numMotionSegments; ++segment) {
+                OD.motionSegmentTLASes.push_back(instanceGroupCreate(OD.context, instances.size()));
+            }
+            OD.motionSegmentInstances = instances.size();
+        }
+        for (uint32_t segment = 0; segment < numMotionSegments; ++segment) {
+            OWLGroup tlas = OD.motionSegmentTLASes[segment];
+            for (uint32_t iid = 0; iid < instances.size(); ++iid) {
+                instanceGroupSetChild(tlas, iid, instances[iid]); 
+            }
+            owlInstanceGroupSetTransforms(tlas,0,(const float*)keyTransforms[segment].data());
+            owlInstanceGroupSetTransforms(tlas,1,(const float*)keyTransforms[segment + 1].data());
+            groupBuildAccel(tlas);
+        }
+        // Segments past the last one are never picked, and share the first TLAS
+        for (uint32_t segment = 0; segment < MAX_MOTION_KEYS - 1; ++segment) {
+            OWLGroup tlas = OD.motionSegmentTLASes[(segment < numMotionSegments) ? segment : 0];
+            launchParamsSetGroup(OD.launchParams, motionSegmentNames[segment], tlas);
+        }
+        OD.tlas = OD.motionSegmentTLASes[0];
+        OD.LP.numMotionSegments = numMotionSegments;
+        launchParamsSetRaw(OD.launchParams, "numMotionSegments", &OD.LP.numMotionSegments);
         launchParamsSetGroup(OD.launchParams, "world", OD.tlas);
         buildSBT(OD.context);
+        for (OWLGroup tlas : retiredTLASes) owlGroupRelease(tlas);
     
         OD.lightEntities.resize(0);
         for (uint32_t eid = 0; eid < Entity::getCount(); ++eid) {
@@ -864,7 +1315,9 @@ void updateComponents()
         launchParamsSetRaw(OD.launchParams, "numLightEntities", &OD.LP.numLightEntities);
 
         Entity::updateComponents();
-        bufferUpload(OptixData.entityBuffer,    Entity::getFrontStruct());
+        bufferUploadTable(OptixData.entityBuffer, Entity::getFrontStruct());
+        OD.LP.numEntities = Entity::getCount();
+        launchParamsSetRaw(OD.launchParams, "numEntities", &OD.LP.numEntities);
     }
 
     // Manage textures
@@ -872,8 +1325,8 @@ void updateComponents()
         auto mutex = Texture::getEditMutex();
         std::lock_guard<std::mutex> lock(*mutex.get());
 
-        Texture* textures = Texture::getFront();
-        std::vector<OWLTexture> textureObjects(Texture::getCount());
+        auto &textures = Texture::getFront();
+        OD.textureObjects.resize(Texture::getCount(), nullptr);
         for (uint32_t tid = 0; tid < Texture::getCount(); ++tid) {
             if (!textures[tid].isInitialized()) {
                 if (OD.textureObjects[tid]) { owlTexture2DDestroy(OD.textureObjects[tid]); OD.textureObjects[tid] = nullptr; }
@@ -887,28 +1340,24 @@ void updateComponents()
                     OWL_TEXTURE_LINEAR);        
             }
         }
-        bufferUpload(OD.textureObjectsBuffer, OD.textureObjects);
+        bufferResize(OD.textureObjectsBuffer, OD.textureObjects.size());
+        bufferUpload(OD.textureObjectsBuffer, OD.textureObjects.data());
         
         Texture::updateComponents();
-        bufferUpload(OptixData.textureBuffer, Texture::getFrontStruct());
+        bufferUploadTable(OptixData.textureBuffer, Texture::getFrontStruct());
+        OD.LP.numTextures = Texture::getCount();
+        launchParamsSetRaw(OD.launchParams, "numTextures", &OD.LP.numTextures);
     }
     
-    // Manage transforms
-    if (Transform::areAnyDirty()) {
-        auto mutex = Transform::getEditMutex();
-        std::lock_guard<std::mutex> lock(*mutex.get());
-
-        Transform::updateComponents();
-        bufferUpload(OptixData.transformBuffer, Transform::getFrontStruct());
-    }   
-
     // Manage Cameras
     if (Camera::areAnyDirty()) {
         auto mutex = Camera::getEditMutex();
         std::lock_guard<std::mutex> lock(*mutex.get());
 
         Camera::updateComponents();
-        bufferUpload(OptixData.cameraBuffer,    Camera::getFrontStruct());
+        bufferUploadTable(OptixData.cameraBuffer, Camera::getFrontStruct());
+        OD.LP.numCameras = Camera::getCount();
+        launchParamsSetRaw(OD.launchParams, "numCameras", &OD.LP.numCameras);
     }    
 
     // Manage materials
@@ -917,7 +1366,9 @@ void updateComponents()
         std::lock_guard<std::mutex> lock(*mutex.get());
 
         Material::updateComponents();
-        bufferUpload(OptixData.materialBuffer,  Material::getFrontStruct());
+        bufferUploadTable(OptixData.materialBuffer, Material::getFrontStruct());
+        OD.LP.numMaterials = Material::getCount();
+        launchParamsSetRaw(OD.launchParams, "numMaterials", &OD.LP.numMaterials);
     }
 
     // Manage lights
@@ -926,13 +1377,84 @@ void updateComponents()
         std::lock_guard<std::mutex> lock(*mutex.get());
 
         Light::updateComponents();
-        bufferUpload(OptixData.lightBuffer,     Light::getFrontStruct());
+        bufferUploadTable(OptixData.lightBuffer, Light::getFrontStruct());
+        OD.LP.numLights = Light::getCount();
+        launchParamsSetRaw(OD.launchParams, "numLights", &OD.LP.numLights);
     }
+
+    // Uploaded alongside lightEntities, with one leaf per light entity
+    if (lightBoundsDirty) {
+        auto mutex = Entity::getEditMutex();
+        std::lock_guard<std::mutex> lock(*mutex.get());
+        auto meshMutex = Mesh::getEditMutex();
+        std::lock_guard<std::mutex> meshLock(*meshMutex.get());
+
+        updateLightBVH(OD.lightBVH, OD.lightBounds, OD.lightEntities);
+        if (!OD.lightBVH.nodes.empty()) {
+            bufferResize(OD.lightBVHBuffer, OD.lightBVH.nodes.size());
+            bufferUpload(OD.lightBVHBuffer, OD.lightBVH.nodes.data());
+        }
+
+        // Meshes used by lights get a table to pick their triangles by area, built the first time it's needed.
+        // Tables are released above when their meshes change.
+        auto &entities = Entity::getFront();
+        for (uint32_t eid : OD.lightEntities) {
+            Mesh *mesh = entities[eid].getMesh();
+            if (!mesh) continue;
+            uint32_t mid = mesh->getId();
+            if ((mid >= OD.meshes.size()) || !OD.meshes[mid].indices || OD.meshes[mid].triangleSamplingTable) continue;
+            std::vector<AliasTableEntry> table = buildTriangleAreaTable(mesh->getVerticesRef(), mesh->getTriangleIndicesRef());
+            OD.meshes[mid].triangleSamplingTable = deviceBufferCreate(OD.context, OWL_USER_TYPE(AliasTableEntry), table.size(), table.data());
+        }
+        std::vector<OWLBuffer> triangleSamplingTables(OD.meshes.size(), nullptr);
+        for (uint32_t mid = 0; mid < OD.meshes.size(); ++mid) {
+            triangleSamplingTables[mid] = OD.meshes[mid].triangleSamplingTable;
+        }
+        bufferResize(OD.triangleSamplingTablesBuffer, triangleSamplingTables.size());
+        bufferUpload(OD.triangleSamplingTablesBuffer, triangleSamplingTables.data());
+    }
+
+    if (environmentSamplingDirty) {
+        auto mutex = Texture::getEditMutex();
+        std::lock_guard<std::mutex> lock(*mutex.get());
+
+        OD.environmentSamplingTextureID = OD.LP.environmentMapID;
+        std::vector<AliasTableEntry> environmentSamplingTable = buildDomeLightSamplingTable(OD.environmentSamplingTextureID, OD.LP.environmentSamplingTableSize);
+        if (!environmentSamplingTable.empty()) {
+            bufferResize(OD.environmentSamplingTableBuffer, environmentSamplingTable.size());
+            bufferUpload(OD.environmentSamplingTableBuffer, environmentSamplingTable.data());
+        }
+        launchParamsSetRaw(OD.launchParams, "environmentSamplingTableSize", &OD.LP.environmentSamplingTableSize);
+    }
+#endif
 }
 
-void updateLaunchParams()
+/* Sets up the next launch to trace the given number of samples per pixel, and moves frameID past them */
+void updateLaunchParams(uint32_t samplesPerLaunch = 1)
 {
+    OptixData.LP.samplesPerLaunch = std::max(samplesPerLaunch, 1u);
+    if (HostData.renderer) {
+        auto &LP = OptixData.LP;
+        auto &HLP = HostData.launchParams;
+        HLP.frameSize = LP.frameSize;
+        HLP.frameID = LP.frameID;
+        HLP.samplesPerLaunch = LP.samplesPerLaunch;
+        HLP.domeLightIntensity = LP.domeLightIntensity;
+        HLP.directClamp = LP.directClamp;
+        HLP.indirectClamp = LP.indirectClamp;
+        HLP.maxBounceDepth = LP.maxBounceDepth;
+        HLP.cameraEntity = LP.cameraEntity;
+        HLP.environmentMapID = LP.environmentMapID;
+        HLP.environmentMapRotation = LP.environmentMapRotation;
+        HLP.renderDataMode = LP.renderDataMode;
+        HLP.renderDataBounce = LP.renderDataBounce;
+        LP.frameID += LP.samplesPerLaunch;
+        return;
+    }
+
+#ifndef VISII_CPU_ONLY
     launchParamsSetRaw(OptixData.launchParams, "frameID", &OptixData.LP.frameID);
+    launchParamsSetRaw(OptixData.launchParams, "samplesPerLaunch", &OptixData.LP.samplesPerLaunch);
     launchParamsSetRaw(OptixData.launchParams, "frameSize", &OptixData.LP.frameSize);
     launchParamsSetRaw(OptixData.launchParams, "cameraEntity", &OptixData.LP.cameraEntity);
     launchParamsSetRaw(OptixData.launchParams, "domeLightIntensity", &OptixData.LP.domeLightIntensity);
@@ -940,18 +1462,38 @@ void updateLaunchParams()
     launchParamsSetRaw(OptixData.launchParams, "environmentMapRotation", &OptixData.LP.environmentMapRotation);
     launchParamsSetRaw(OptixData.launchParams, "renderDataMode", &OptixData.LP.renderDataMode);
     launchParamsSetRaw(OptixData.launchParams, "renderDataBounce", &OptixData.LP.renderDataBounce);
-    OptixData.LP.frameID ++;
+    OptixData.LP.frameID += OptixData.LP.samplesPerLaunch;
+#endif
 }
 
 void traceRays()
 {
+    if (HostData.renderer) { HostData.renderer->render(HostData.launchParams); return; }
+
+#ifndef VISII_CPU_ONLY
     auto &OD = OptixData;
     
     /* Trace Rays */
     paramsLaunch2D(OD.rayGen, OD.LP.frameSize.x, OD.LP.frameSize.y, OD.launchParams);
+#endif
+}
+
+/* Traces camera rays only, leaving vec4(position, depth) in the frame buffer and vec4(normal, entity id) in the normal buffer */
+void tracePrimaryRays()
+{
+    if (HostData.renderer) { HostData.renderer->renderPrimary(HostData.launchParams); return; }
+
+#ifndef VISII_CPU_ONLY
+    auto &OD = OptixData;
+    paramsLaunch2D(OD.primaryRayGen, OD.LP.frameSize.x, OD.LP.frameSize.y, OD.launchParams);
+#endif
 }
 
 void denoiseImage() {
+    // The CPU backend has no denoiser, and leaves its frame buffer as is
+    if (HostData.renderer) return;
+
+#ifndef VISII_CPU_ONLY
     synchronizeDevices();
 
     auto &OD = OptixData;
@@ -1019,10 +1561,12 @@ void denoiseImage() {
     ));
 
     synchronizeDevices();
+#endif
 }
 
 void drawFrameBufferToWindow()
 {
+#ifndef VISII_CPU_ONLY
     auto &OD = OptixData;
     synchronizeDevices();
 
@@ -1069,6 +1613,7 @@ void drawFrameBufferToWindow()
     glDisable(GL_TEXTURE_2D);
     glBindTexture(GL_TEXTURE_2D, 0);
     glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+#endif
 }
 
 void drawGUI()
@@ -1174,7 +1719,7 @@ std::vector<float> readFrameBuffer() {
         int num_devices = getDeviceCount();
         synchronizeDevices();
 
-        const glm::vec4 *fb = (const glm::vec4*)bufferGetPointer(OptixData.frameBuffer,0);
+        const glm::vec4 *fb = getFrameBufferPointer();
         for (uint32_t test = 0; test < frameBuffer.size(); test += 4) {
             frameBuffer[test + 0] = fb[test / 4].r;
             frameBuffer[test + 1] = fb[test / 4].g;
@@ -1202,12 +1747,14 @@ std::vector<float> render(uint32_t width, uint32_t height, uint32_t samplesPerPi
             initializeFrameBuffer(width, height);
         }
         
-        resizeOptixFrameBuffer(width, height);
+        if (HostData.renderer) resizeHostFrameBuffer(width, height);
+        else resizeOptixFrameBuffer(width, height);
         resetAccumulation();
         updateComponents();
 
-        for (uint32_t i = 0; i < samplesPerPixel; ++i) {
-            // std::cout<<i<<std::endl;
+        LaunchScheduler scheduler(OptixData.launchTimeBudget, MAX_SAMPLES_PER_LAUNCH);
+        uint32_t traced = 0;
+        while (traced < samplesPerPixel) {
             if (!ViSII.headlessMode) {
                 auto glfw = Libraries::GLFW::Get();
                 glfw->poll_events();
@@ -1216,9 +1763,16 @@ std::vector<float> render(uint32_t width, uint32_t height, uint32_t samplesPerPi
                 glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
             }
 
-            updateLaunchParams();
+            uint32_t samples = scheduler.next(samplesPerPixel - traced);
+            auto start = std::chrono::steady_clock::now();
+            updateLaunchParams(samples);
             traceRays();
-            if (OptixData.enableDenoiser)
+            synchronizeDevices();
+            scheduler.record(samples, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+            traced += samples;
+
+            // Nothing reads the denoised image back, so without a window only the final one is worth denoising
+            if (OptixData.enableDenoiser && (!ViSII.headlessMode || (traced == samplesPerPixel)))
             {
                 denoiseImage();
             }
@@ -1226,9 +1780,9 @@ std::vector<float> render(uint32_t width, uint32_t height, uint32_t samplesPerPi
             if (!ViSII.headlessMode) {
                 drawFrameBufferToWindow();
                 glfwSetWindowTitle(WindowData.window, 
-                    (std::to_string(i) + std::string("/") + std::to_string(samplesPerPixel)).c_str());
+                    (std::to_string(traced) + std::string("/") + std::to_string(samplesPerPixel)).c_str());
             }
-            std::cout<< "\r" << i << "/" << samplesPerPixel;
+            std::cout<< "\r" << traced << "/" << samplesPerPixel;
         }      
         if (!ViSII.headlessMode) {
             glfwSetWindowTitle(WindowData.window, 
@@ -1239,7 +1793,7 @@ std::vector<float> render(uint32_t width, uint32_t height, uint32_t samplesPerPi
 
         synchronizeDevices();
 
-        const glm::vec4 *fb = (const glm::vec4*) bufferGetPointer(OptixData.frameBuffer,0);
+        const glm::vec4 *fb = getFrameBufferPointer();
         for (uint32_t test = 0; test < frameBuffer.size(); test += 4) {
             frameBuffer[test + 0] = fb[test / 4].r;
             frameBuffer[test + 1] = fb[test / 4].g;
@@ -1264,8 +1818,97 @@ std::string trim(const std::string& line)
     return start == end ? std::string() : line.substr(start, end - start + 1);
 }
 
+std::string toLowerTrimmed(const std::string &option)
+{
+    std::string result = trim(option);
+    std::transform(result.begin(), result.end(), result.begin(),
+        [](unsigned char c){ return std::tolower(c); });
+    return result;
+}
+
+std::vector<float> renderPrimaryData(uint32_t width, uint32_t height, uint32_t startFrame, uint32_t frameCount, std::vector<std::string> options)
+{
+    // Which component of which primary buffer each option reads. Scalars are splatted across rgb.
+    enum class PrimaryField { POSITION, DEPTH, NORMAL, ENTITY_ID };
+    std::vector<PrimaryField> fields;
+    bool needsNormalBuffer = false;
+    for (auto &_option : options) {
+        std::string option = toLowerTrimmed(_option);
+        if (option == std::string("depth")) fields.push_back(PrimaryField::DEPTH);
+        else if (option == std::string("position")) fields.push_back(PrimaryField::POSITION);
+        else if (option == std::string("normal")) fields.push_back(PrimaryField::NORMAL);
+        else if (option == std::string("entity_id")) fields.push_back(PrimaryField::ENTITY_ID);
+        else {
+            throw std::runtime_error(std::string("Error, unknown option : \"") + _option + std::string("\". ")
+            + std::string("Available options are \"depth\", \"position\", \"normal\", and \"entity_id\""));
+        }
+        needsNormalBuffer |= (fields.back() == PrimaryField::NORMAL) || (fields.back() == PrimaryField::ENTITY_ID);
+    }
+
+    size_t numPixels = size_t(width) * size_t(height);
+    std::vector<float> frameBuffer(numPixels * 4 * fields.size());
+
+    auto readPrimaryBuffers = [&frameBuffer, &fields, needsNormalBuffer, numPixels, width, height, startFrame, frameCount] () {
+        if (!ViSII.headlessMode) {
+            using namespace Libraries;
+            auto glfw = GLFW::Get();
+            glfw->resize_window("ViSII", width, height);
+            initializeFrameBuffer(width, height);
+        }
+
+        if (HostData.renderer) resizeHostFrameBuffer(width, height);
+        else resizeOptixFrameBuffer(width, height);
+        updateComponents();
+
+        // Nothing accumulates across frames, so only the last frame renderData would have traced is needed
+        if (startFrame >= frameCount) return;
+        OptixData.LP.frameID = frameCount - 1;
+        updateLaunchParams();
+        tracePrimaryRays();
+        synchronizeDevices();
+
+        const glm::vec4 *positionDepth = getFrameBufferPointer();
+        std::vector<glm::vec4> normalEntityCopy;
+        const glm::vec4 *normalEntity = nullptr;
+        if (HostData.renderer) normalEntity = HostData.renderer->normalBuffer.data();
+#ifndef VISII_CPU_ONLY
+        else if (needsNormalBuffer) {
+            normalEntityCopy.resize(numPixels);
+            cudaMemcpy(normalEntityCopy.data(), bufferGetPointer(OptixData.normalBuffer, 0), numPixels * sizeof(glm::vec4), cudaMemcpyDeviceToHost);
+            normalEntity = normalEntityCopy.data();
+        }
+#endif
+
+        for (size_t f = 0; f < fields.size(); ++f) {
+            float *out = &frameBuffer[f * numPixels * 4];
+            for (size_t i = 0; i < numPixels; ++i) {
+                glm::vec3 v;
+                if (fields[f] == PrimaryField::POSITION) v = glm::vec3(positionDepth[i]);
+                else if (fields[f] == PrimaryField::DEPTH) v = glm::vec3(positionDepth[i].w);
+                else if (fields[f] == PrimaryField::NORMAL) v = glm::vec3(normalEntity[i]);
+                else v = glm::vec3(normalEntity[i].w);
+                out[i * 4 + 0] = v.x;
+                out[i * 4 + 1] = v.y;
+                out[i * 4 + 2] = v.z;
+                out[i * 4 + 3] = 1.f;
+            }
+        }
+    };
+
+    auto future = enqueueCommand(readPrimaryBuffers);
+    future.wait();
+
+    return frameBuffer;
+}
+
 std::vector<float> renderData(uint32_t width, uint32_t height, uint32_t startFrame, uint32_t frameCount, uint32_t bounce, std::string _option)
 {
+    // Metadata at the first visible surface only needs camera rays, not the path tracer
+    std::string primaryOption = toLowerTrimmed(_option);
+    if ((bounce == 0) && ((primaryOption == "depth") || (primaryOption == "position") || (primaryOption == "normal") || (primaryOption == "entity_id"))) {
+        return renderPrimaryData(width, height, startFrame, frameCount, {primaryOption});
+    }
+
     std::vector<float> frameBuffer(width * height * 4);
 
     auto readFrameBuffer = [&frameBuffer, width, height, startFrame, frameCount, bounce, _option] () {
@@ -1277,9 +1920,7 @@ std::vector<float> renderData(uint32_t width, uint32_t height, uint32_t startFra
         }
 
         // remove trailing whitespace from option, convert to lowercase
-        std::string option = trim(_option);
-        std::transform(option.begin(), option.end(), option.begin(),
-            [](unsigned char c){ return std::tolower(c); });
+        std::string option = toLowerTrimmed(_option);
 
         if (option == std::string("none")) {
             OptixData.LP.renderDataMode = RenderDataFlags::NONE;
@@ -1308,7 +1949,8 @@ std::vector<float> renderData(uint32_t width, uint32_t height, uint32_t startFra
             + std::string("\"normal\", \"denoise_normal\", \"denoise_albedo\", and \"entity_id\""));
         }
         
-        resizeOptixFrameBuffer(width, height);
+        if (HostData.renderer) resizeHostFrameBuffer(width, height);
+        else resizeOptixFrameBuffer(width, height);
         OptixData.LP.frameID = startFrame;
         OptixData.LP.renderDataBounce = bounce;
         updateComponents();
@@ -1338,7 +1980,7 @@ std::vector<float> renderData(uint32_t width, uint32_t height, uint32_t startFra
 
         synchronizeDevices();
 
-        const glm::vec4 *fb = (const glm::vec4*) bufferGetPointer(OptixData.frameBuffer,0);
+        const glm::vec4 *fb = getFrameBufferPointer();
         for (uint32_t test = 0; test < frameBuffer.size(); test += 4) {
             frameBuffer[test + 0] = fb[test / 4].r;
             frameBuffer[test + 1] = fb[test / 4].g;
@@ -1455,6 +2097,11 @@ void initializeInteractive(bool windowOnTop)
     // don't initialize more than once
     if (initialized == true) return;
 
+#ifdef VISII_CPU_ONLY
+    throw std::runtime_error("Error: this build of ViSII has no OptiX backend, and can only be initialized headless "
+        "with the \"cpu\" backend. Rebuild with -DVISII_BUILD_OPTIX=ON to open a window");
+#else
+
     initialized = true;
     close = false;
     initializeComponentFactories();
@@ -1511,22 +2158,39 @@ void initializeInteractive(bool windowOnTop)
     auto wait = [] () {};
     auto future = enqueueCommand(wait);
     future.wait();
+#endif
 }
 
-void initializeHeadless()
+void initializeHeadless(std::string backend)
 {
     // don't initialize more than once
     if (initialized == true) return;
 
+    std::transform(backend.begin(), backend.end(), backend.begin(),
+        [](unsigned char c){ return std::tolower(c); });
+    if ((backend != "optix") && (backend != "cpu")) {
+        throw std::runtime_error(std::string("Error, unknown backend : \"") + backend + std::string("\". ")
+            + std::string("Available backends are \"optix\" and \"cpu\""));
+    }
+#ifdef VISII_CPU_ONLY
+    if (backend == "optix") {
+        throw std::runtime_error("Error: this build of ViSII has no OptiX backend, only the \"cpu\" one. "
+            "Rebuild with -DVISII_BUILD_OPTIX=ON to render on the GPU");
+    }
+#endif
+
     initialized = true;
     close = false;
     initializeComponentFactories();
 
-    auto loop = []() {
+    auto loop = [backend]() {
         ViSII.render_thread_id = std::this_thread::get_id();
         ViSII.headlessMode = true;
 
-        initializeOptix(/*headless = */ true);
+        if (backend == "cpu") HostData.renderer = std::make_unique<CPURenderer>();
+#ifndef VISII_CPU_ONLY
+        else initializeOptix(/*headless = */ true);
+#endif
 
         while (!close)
         {
@@ -1557,8 +2221,11 @@ void cleanup()
             close = true;
             renderThread.join();
         }
+#ifndef VISII_CPU_ONLY
         if (OptixData.denoiser)
             OPTIX_CHECK(optixDenoiserDestroy(OptixData.denoiser));
+#endif
+        HostData.renderer.reset();
     }
     initialized = false;
 }
@@ -0,0 +1,453 @@
+#include <visii/visii.h>
+
+#include <thread>
+#include <atomic>
+#include <iostream>
+#include <fstream>
+#include <map>
+#include <string>
+#include <cstring>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <limits>
+
+// Must match the configuration used where TINYGLTF_IMPLEMENTATION is defined (mesh.cpp)
+#define TINYGLTF_NO_FS
+#define TINYGLTF_NO_STB_IMAGE_WRITE
+#include <tiny_gltf.h>
+#include <stb_image.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+/* Since tinygltf is built without filesystem support, we supply our own callbacks */
+static bool gltfFileExists(const std::string &abs_filename, void *)
+{
+    struct stat st;
+    return stat(abs_filename.c_str(), &st) == 0;
+}
+
+static std::string gltfExpandFilePath(const std::string &filepath, void *)
+{
+    return filepath;
+}
+
+static bool gltfReadWholeFile(std::vector<unsigned char> *out, std::string *err, const std::string &filepath, void *)
+{
+    std::ifstream f(filepath.c_str(), std::ifstream::binary);
+    if (!f) {
+        if (err) (*err) += "File open error : " + filepath + "\n";
+        return false;
+    }
+    f.seekg(0, f.end);
+    size_t sz = static_cast<size_t>(f.tellg());
+    f.seekg(0, f.beg);
+    out->resize(sz);
+    if (sz > 0) f.read(reinterpret_cast<char *>(out->data()), static_cast<std::streamsize>(sz));
+    return true;
+}
+
+static bool gltfWriteWholeFile(std::string *err, const std::string &, const std::vector<unsigned char> &, void *)
+{
+    if (err) (*err) += "Writing glTF files is not supported\n";
+    return false;
+}
+
+/* Rather than decoding images one at a time while parsing, keep the encoded bytes
+   around so that all images can be decoded in parallel afterwards. */
+static bool gltfDeferImageData(tinygltf::Image *image, std::string *, std::string *,
+    int, int, const unsigned char *bytes, int size, void *)
+{
+    image->as_is = true;
+    image->image.assign(bytes, bytes + size);
+    return true;
+}
+
+/* Throws unless every element of the accessor lies within its buffer view, and the view lies within its buffer */
+static void checkAccessorBounds(const tinygltf::Model &model, const tinygltf::Accessor &accessor, int stride, const std::string &what)
+{
+    const auto &view = model.bufferViews[accessor.bufferView];
+    const auto &buffer = model.buffers[view.buffer];
+    int numComponents = tinygltf::GetTypeSizeInBytes(static_cast<uint32_t>(accessor.type));
+    int componentSize = tinygltf::GetComponentSizeInBytes(static_cast<uint32_t>(accessor.componentType));
+    if (stride < 0 || numComponents < 0 || componentSize < 0)
+        throw std::runtime_error("Error: invalid " + what + " \"" + accessor.name + "\"");
+    if ((view.byteOffset > buffer.data.size()) || (view.byteLength > buffer.data.size() - view.byteOffset))
+        throw std::runtime_error("Error: buffer view of " + what + " \"" + accessor.name + "\" is out of bounds");
+    if (accessor.count == 0) return;
+
+    // Written to avoid overflow, since counts and offsets come straight from the file
+    size_t elementSize = size_t(numComponents) * size_t(componentSize);
+    if ((accessor.byteOffset > view.byteLength) || (elementSize > view.byteLength - accessor.byteOffset)
+        || ((stride > 0) && ((accessor.count - 1) > (view.byteLength - accessor.byteOffset - elementSize) / size_t(stride))))
+        throw std::runtime_error("Error: " + what + " \"" + accessor.name + "\" is out of bounds");
+}
+
+/* Reads an accessor as a list of floats, "components" floats per element. Normalized
+   integer types are mapped to [0, 1], and missing components are left as zero */
+static std::vector<float> readAccessorFloats(const tinygltf::Model &model, int accessorIdx, int components)
+{
+    const auto &accessor = model.accessors[accessorIdx];
+    if (accessor.bufferView < 0) return std::vector<float>(accessor.count * components, 0.0f);
+
+    const auto &view = model.bufferViews[accessor.bufferView];
+    const auto &buffer = model.buffers[view.buffer];
+    int stride = accessor.ByteStride(view);
+    checkAccessorBounds(model, accessor, stride, "accessor");
+    int numComponents = std::min(tinygltf::GetTypeSizeInBytes(static_cast<uint32_t>(accessor.type)), components);
+
+    std::vector<float> result(accessor.count * components, 0.0f);
+    const unsigned char *base = buffer.data.data() + view.byteOffset + accessor.byteOffset;
+
+    for (size_t i = 0; i < accessor.count; ++i) {
+        const unsigned char *element = base + i * stride;
+        for (int c = 0; c < numComponents; ++c) {
+            float value = 0.0f;
+            switch (accessor.componentType) {
+                case TINYGLTF_COMPONENT_TYPE_FLOAT: { float v; memcpy(&v, element + c * 4, 4); value = v; break; }
+                case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE: { value = element[c] / (accessor.normalized ? 255.0f : 1.0f); break; }
+                case TINYGLTF_COMPONENT_TYPE_BYTE: { value = std::max(int8_t(element[c]) / (accessor.normalized ? 127.0f : 1.0f), -1.0f); break; }
+                case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT: { uint16_t v; memcpy(&v, element + c * 2, 2); value = v / (accessor.normalized ? 65535.0f : 1.0f); break; }
+                case TINYGLTF_COMPONENT_TYPE_SHORT: { int16_t v; memcpy(&v, element + c * 2, 2); value = std::max(v / (accessor.normalized ? 32767.0f : 1.0f), -1.0f); break; }
+                case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT: { uint32_t v; memcpy(&v, element + c * 4, 4); value = float(v); break; }
+                default: throw std::runtime_error("Error: unsupported accessor component type for \"" + accessor.name + "\"");
+            }
+            result[i * components + c] = value;
+        }
+    }
+    return result;
+}
+
+static std::vector<uint32_t> readAccessorIndices(const tinygltf::Model &model, int accessorIdx)
+{
+    const auto &accessor = model.accessors[accessorIdx];
+    if (accessor.bufferView < 0) return std::vector<uint32_t>(accessor.count, 0);
+
+    const auto &view = model.bufferViews[accessor.bufferView];
+    const auto &buffer = model.buffers[view.buffer];
+    int stride = accessor.ByteStride(view);
+    checkAccessorBounds(model, accessor, stride, "index accessor");
+
+    std::vector<uint32_t> result(accessor.count, 0);
+    const unsigned char *base = buffer.data.data() + view.byteOffset + accessor.byteOffset;
+
+    switch (accessor.componentType) {
+        case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+            for (size_t i = 0; i < accessor.count; ++i) result[i] = base[i * stride];
+            break;
+        case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+            for (size_t i = 0; i < accessor.count; ++i) { uint16_t v; memcpy(&v, base + i * stride, 2); result[i] = v; }
+            break;
+        case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
+            for (size_t i = 0; i < accessor.count; ++i) memcpy(&result[i], base + i * stride, 4);
+            break;
+        default: throw std::runtime_error("Error: unsupported index type for \"" + accessor.name + "\"");
+    }
+    return result;
+}
+
+std::vector<Entity*> importGLTF(std::string name_prefix, std::string filepath, glm::vec3 position, glm::vec3 scale, glm::quat rotation)
+{
+    struct stat st;
+    if (stat(filepath.c_str(), &st) != 0)
+        throw std::runtime_error( std::string(filepath + " does not exist!"));
+
+    tinygltf::TinyGLTF loader;
+    tinygltf::FsCallbacks fs = {&gltfFileExists, &gltfExpandFilePath, &gltfReadWholeFile, &gltfWriteWholeFile, nullptr};
+    loader.SetFsCallbacks(fs);
+    loader.SetImageLoader(&gltfDeferImageData, nullptr);
+
+    tinygltf::Model model;
+    std::string err, warn;
+    bool isBinary = (filepath.size() >= 4) && (filepath.substr(filepath.size() - 4) == ".glb" || filepath.substr(filepath.size() - 4) == ".GLB");
+    bool loaded = (isBinary)
+        ? loader.LoadBinaryFromFile(&model, &err, &warn, filepath)
+        : loader.LoadASCIIFromFile(&model, &err, &warn, filepath);
+    if (warn.size() > 0)
+        std::cout<< warn << std::endl;
+    if (!loaded)
+        throw std::runtime_error( std::string("Error: Unable to load " + filepath + ". " + err));
+
+    /* Roots of the default scene, or without scenes, every node which isn't anyone's child */
+    std::vector<int> roots;
+    if (model.scenes.size() > 0) {
+        int sceneIdx = (model.defaultScene >= 0 && model.defaultScene < int(model.scenes.size())) ? model.defaultScene : 0;
+        roots = model.scenes[sceneIdx].nodes;
+    } else {
+        std::vector<bool> isChild(model.nodes.size(), false);
+        for (auto &node : model.nodes) for (auto child : node.children)
+            if (child >= 0 && child < int(model.nodes.size())) isChild[child] = true;
+        for (uint32_t i = 0; i < model.nodes.size(); ++i) if (!isChild[i]) roots.push_back(int(i));
+    }
+
+    /* glTF requires nodes to form disjoint trees. Check that before creating any transforms, so a malformed file
+       can't index past the node list, or loop forever on a cycle. Nodes are walked with an explicit stack, since
+       a deep hierarchy could overflow the call stack. */
+    {
+        std::vector<bool> visited(model.nodes.size(), false);
+        std::vector<int> stack(roots.rbegin(), roots.rend());
+        while (!stack.empty()) {
+            int nodeIdx = stack.back();
+            stack.pop_back();
+            if (nodeIdx < 0 || nodeIdx >= int(model.nodes.size()))
+                throw std::runtime_error("Error: " + filepath + " references node " + std::to_string(nodeIdx) + ", which does not exist");
+            if (visited[nodeIdx])
+                throw std::runtime_error("Error: node " + std::to_string(nodeIdx) + " of " + filepath + " has more than one parent, or is its own ancestor");
+            visited[nodeIdx] = true;
+            for (auto child : model.nodes[nodeIdx].children) stack.push_back(child);
+        }
+    }
+
+    /* Decode all images in parallel. The flip matches Texture::createFromImage, and is set once
+       up front since stb stores it globally. */
+    struct DecodedImage { int width = 0, height = 0; std::vector<unsigned char> pixels; std::string error; };
+    std::vector<DecodedImage> decoded(model.images.size());
+    {
+        stbi_set_flip_vertically_on_load(true);
+        std::atomic<uint32_t> next(0);
+        auto decode = [&] () {
+            for (uint32_t i = next++; i < model.images.size(); i = next++) {
+                auto &image = model.images[i];
+                int x, y, num_channels;
+                unsigned char *pixels = stbi_load_from_memory(image.image.data(), int(image.image.size()), &x, &y, &num_channels, STBI_rgb_alpha);
+                if (!pixels) {
+                    decoded[i].error = std::string(stbi_failure_reason());
+                    continue;
+                }
+                decoded[i].width = x;
+                decoded[i].height = y;
+                decoded[i].pixels.assign(pixels, pixels + x * y * 4);
+                stbi_image_free(pixels);
+                image.image.clear();
+                image.image.shrink_to_fit();
+            }
+        };
+        uint32_t numThreads = std::max(1u, std::min(std::thread::hardware_concurrency(), uint32_t(model.images.size())));
+        std::vector<std::thread> workers;
+        for (uint32_t t = 1; t < numThreads; ++t) workers.emplace_back(decode);
+        decode();
+        for (auto &w : workers) w.join();
+    }
+
+    /* Textures are created lazily, since color data needs to be linearized while other data does not */
+    std::map<std::pair<int, bool>, Texture*> texture_map;
+    auto getTexture = [&] (int textureIdx, bool linear) -> Texture* {
+        if (textureIdx < 0 || textureIdx >= int(model.textures.size())) return nullptr;
+        int source = model.textures[textureIdx].source;
+        if (source < 0 || source >= int(model.images.size())) return nullptr;
+        auto key = std::make_pair(source, linear);
+        if (texture_map.find(key) != texture_map.end()) return texture_map[key];
+
+        auto &image = decoded[source];
+        if (image.error.size() > 0) {
+            std::cout<< "Warning: failed to decode image " << source << ". Reason: " << image.error << std::endl;
+            return texture_map[key] = nullptr;
+        }
+
+        std::vector<float> texels(image.pixels.size());
+        float gamma = linear ? 1.0f : 2.2f;
+        for (size_t i = 0; i < image.pixels.size(); ++i) {
+            float v = image.pixels[i] / 255.0f;
+            texels[i] = ((i % 4) == 3 || linear) ? v : powf(v, gamma);
+        }
+        std::string base = model.images[source].name.size() > 0 ? model.images[source].name : std::string("image_") + std::to_string(source);
+        return texture_map[key] = Texture::createUnique(name_prefix + base + (linear ? "_linear" : ""), image.width, image.height, texels);
+    };
+
+    std::vector<Material*> materialComponents;
+    std::vector<Light*> lightComponents;
+    for (uint32_t i = 0; i < model.materials.size(); ++i) {
+        auto &mat = model.materials[i];
+        auto material = Material::createUnique(name_prefix + mat.name);
+        materialComponents.push_back(material);
+
+        /* Defaults for the metal/roughness workflow */
+        material->setRoughness(1.0);
+        material->setMetallic(1.0);
+
+        auto value = [&mat] (std::string key) -> const tinygltf::Parameter* {
+            auto it = mat.values.find(key);
+            if (it != mat.values.end()) return &it->second;
+            it = mat.additionalValues.find(key);
+            if (it != mat.additionalValues.end()) return &it->second;
+            return nullptr;
+        };
+
+        if (auto p = value("baseColorFactor")) {
+            if (p->number_array.size() >= 3) {
+                auto c = p->ColorFactor();
+                material->setBaseColor(vec3(c[0], c[1], c[2]));
+                material->setAlpha(float(c[3]));
+            }
+        }
+        if (auto p = value("metallicFactor")) material->setMetallic(float(p->Factor()));
+        if (auto p = value("roughnessFactor")) material->setRoughness(float(p->Factor()));
+
+        if (auto p = value("baseColorTexture")) {
+            if (auto tex = getTexture(p->TextureIndex(), false)) {
+                material->setBaseColorTexture(tex);
+                auto alphaMode = value("alphaMode");
+                if (alphaMode && alphaMode->string_value != "OPAQUE")
+                    material->setAlphaTexture(tex, 3);
+            }
+        }
+
+        /* glTF packs roughness into green and metallic into blue */
+        if (auto p = value("metallicRoughnessTexture")) {
+            if (auto tex = getTexture(p->TextureIndex(), true)) {
+                material->setRoughnessTexture(tex, 1);
+                material->setMetallicTexture(tex, 2);
+            }
+        }
+
+        if (auto p = value("normalTexture")) {
+            if (auto tex = getTexture(p->TextureIndex(), true))
+                material->setNormalMapTexture(tex);
+        }
+
+        /* Emissive materials become lights, shared by every entity using the material. The light's color is the
+           emissive factor scaled to a maximum of one, and the rest goes into its intensity, along with any
+           KHR_materials_emissive_strength. An emissive texture replaces the light's color, which is an
+           approximation of glTF's product of factor and texture. Occlusion textures bake in shadowing that the
+           path tracer already computes, so they are left out. */
+        glm::vec3 emissive = glm::vec3(0.0f);
+        if (auto p = value("emissiveFactor")) {
+            if (p->number_array.size() >= 3)
+                emissive = glm::vec3(float(p->number_array[0]), float(p->number_array[1]), float(p->number_array[2]));
+        }
+        float strength = 1.0f;
+        auto extension = mat.extensions.find("KHR_materials_emissive_strength");
+        if (extension != mat.extensions.end() && extension->second.Has("emissiveStrength")) {
+            auto &v = extension->second.Get("emissiveStrength");
+            strength = v.IsInt() ? float(v.Get<int>()) : float(v.Get<double>());
+        }
+        float peak = std::max(emissive.r, std::max(emissive.g, emissive.b));
+        Light* light = nullptr;
+        if (peak > 0.0f && strength > 0.0f) {
+            light = Light::createUnique(name_prefix + mat.name + "_emission", emissive / peak, peak * strength);
+            auto p = value("emissiveTexture");
+            if (auto tex = (p) ? getTexture(p->TextureIndex(), false) : nullptr)
+                light->setColorTexture(tex);
+        }
+        lightComponents.push_back(light);
+    }
+
+    Material* defaultMaterial = nullptr;
+
+    /* Create one mesh component per primitive, shared by every node instancing it */
+    std::vector<std::vector<std::pair<Mesh*, int>>> meshComponents(model.meshes.size());
+    for (uint32_t i = 0; i < model.meshes.size(); ++i) {
+        auto &gltfMesh = model.meshes[i];
+        for (uint32_t j = 0; j < gltfMesh.primitives.size(); ++j) {
+            auto &primitive = gltfMesh.primitives[j];
+            if (primitive.mode != TINYGLTF_MODE_TRIANGLES && primitive.mode != -1) {
+                std::cout<< "Warning: skipping non-triangle primitive in mesh " << gltfMesh.name << std::endl;
+                continue;
+            }
+            auto attr = [&primitive] (std::string key) {
+                auto it = primitive.attributes.find(key);
+                return (it == primitive.attributes.end()) ? -1 : it->second;
+            };
+            if (attr("POSITION") < 0) continue;
+
+            auto p = readAccessorFloats(model, attr("POSITION"), 3);
+            std::vector<glm::vec4> positions(p.size() / 3);
+            for (size_t v = 0; v < positions.size(); ++v)
+                positions[v] = glm::vec4(p[v * 3 + 0], p[v * 3 + 1], p[v * 3 + 2], 1.0f);
+
+            std::vector<glm::vec4> normals;
+            if (attr("NORMAL") >= 0) {
+                auto n = readAccessorFloats(model, attr("NORMAL"), 3);
+                normals.resize(n.size() / 3);
+                for (size_t v = 0; v < normals.size(); ++v)
+                    normals[v] = glm::vec4(n[v * 3 + 0], n[v * 3 + 1], n[v * 3 + 2], 0.0f);
+            }
+
+            std::vector<glm::vec4> colors;
+            if (attr("COLOR_0") >= 0) {
+                bool hasAlpha = model.accessors[attr("COLOR_0")].type == TINYGLTF_TYPE_VEC4;
+                auto c = readAccessorFloats(model, attr("COLOR_0"), 4);
+                colors.resize(c.size() / 4);
+                for (size_t v = 0; v < colors.size(); ++v)
+                    colors[v] = glm::vec4(c[v * 4 + 0], c[v * 4 + 1], c[v * 4 + 2], hasAlpha ? c[v * 4 + 3] : 1.0f);
+            }
+
+            /* Images are flipped on load, so flip the v coordinate to match */
+            std::vector<glm::vec2> texcoords;
+            if (attr("TEXCOORD_0") >= 0) {
+                auto t = readAccessorFloats(model, attr("TEXCOORD_0"), 2);
+                texcoords.resize(t.size() / 2);
+                for (size_t v = 0; v < texcoords.size(); ++v)
+                    texcoords[v] = glm::vec2(t[v * 2 + 0], 1.0f - t[v * 2 + 1]);
+            }
+
+            std::vector<uint32_t> indices;
+            if (primitive.indices >= 0) {
+                indices = readAccessorIndices(model, primitive.indices);
+            } else {
+                indices.resize(positions.size());
+                for (uint32_t v = 0; v < indices.size(); ++v) indices[v] = v;
+            }
+            if (indices.size() % 3 != 0) indices.resize(indices.size() - (indices.size() % 3));
+            if (indices.size() < 3) continue;
+
+            std::string base = name_prefix + (gltfMesh.name.size() > 0 ? gltfMesh.name : std::string("mesh_") + std::to_string(i)) + "_" + std::to_string(j);
+            auto mesh = Mesh::createUnique(base, positions, normals, colors, texcoords, indices, true);
+            meshComponents[i].push_back({mesh, primitive.material});
+        }
+    }
+
+    /* A root transform carries the requested position, scale and rotation for the whole scene */
+    Transform* root = Transform::createUnique(name_prefix + "root");
+    root->setPosition(position);
+    root->setScale(scale);
+    root->setRotation(rotation);
+
+    std::vector<Entity*> entities;
+    std::vector<std::pair<int, Transform*>> stack;
+    for (auto it = roots.rbegin(); it != roots.rend(); ++it) stack.push_back({*it, root});
+    while (!stack.empty()) {
+        int nodeIdx = stack.back().first;
+        Transform* parent = stack.back().second;
+        stack.pop_back();
+
+        auto &node = model.nodes[nodeIdx];
+        std::string nodeName = name_prefix + (node.name.size() > 0 ? node.name : std::string("node_") + std::to_string(nodeIdx));
+
+        Transform* transform = Transform::createUnique(nodeName);
+        if (node.matrix.size() == 16) {
+            glm::dmat4 m = glm::make_mat4(node.matrix.data());
+            transform->setTransform(glm::mat4(m));
+        } else {
+            if (node.translation.size() == 3)
+                transform->setPosition(vec3(node.translation[0], node.translation[1], node.translation[2]));
+            if (node.scale.size() == 3)
+                transform->setScale(vec3(node.scale[0], node.scale[1], node.scale[2]));
+            if (node.rotation.size() == 4) // glTF stores quaternions as xyzw, glm constructs them as wxyz
+                transform->setRotation(quat(float(node.rotation[3]), float(node.rotation[0]), float(node.rotation[1]), float(node.rotation[2])));
+        }
+        transform->setParent(parent);
+
+        if (node.mesh >= 0 && node.mesh < int(meshComponents.size())) {
+            for (auto &meshAndMaterial : meshComponents[node.mesh]) {
+                Entity* entity = Entity::createUnique(nodeName);
+                entity->setTransform(transform);
+                entity->setMesh(meshAndMaterial.first);
+                int materialIdx = meshAndMaterial.second;
+                if (materialIdx >= 0 && materialIdx < int(materialComponents.size())) {
+                    entity->setMaterial(materialComponents[materialIdx]);
+                    if (lightComponents[materialIdx]) entity->setLight(lightComponents[materialIdx]);
+                } else {
+                    if (!defaultMaterial) defaultMaterial = Material::createUnique(name_prefix + "default");
+                    entity->setMaterial(defaultMaterial);
+                }
+                entities.push_back(entity);
+            }
+        }
+
+        for (auto it = node.children.rbegin(); it != node.children.rend(); ++it) stack.push_back({*it, transform});
+    }
+
+    return entities;
+}
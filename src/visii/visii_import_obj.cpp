@@ -10,10 +10,14 @@
 #include <functional>
 #include <limits>
 
-#include <tiny_obj_loader.h>
+#include <visii/utilities/obj_parser.h>
 #include <glm/glm.hpp>
 #include <stb_image_write.h>
 
+/* Approximate peak memory used per triangle while converting a shape into a mesh: the staging buffers below, 
+   plus the intermediate vertex lists and deduplication map used by Mesh::createFromData */
+const uint64_t OBJ_IMPORT_BYTES_PER_TRIANGLE = 1024;
+
 struct OBJTextureInfo {
     std::string path = "";
     bool is_bump = false;
@@ -27,7 +31,7 @@ struct OBJTextureInfoCompare {
 };
 
 
-std::vector<Entity*> importOBJ(std::string name_prefix, std::string filepath, std::string mtl_base_dir, glm::vec3 position, glm::vec3 scale, glm::quat rotation)
+std::vector<Entity*> importOBJ(std::string name_prefix, std::string filepath, std::string mtl_base_dir, glm::vec3 position, glm::vec3 scale, glm::quat rotation, uint32_t memory_budget_mb)
 {
     struct stat st;
     if (stat(filepath.c_str(), &st) != 0)
@@ -47,11 +51,6 @@ std::vector<Entity*> importOBJ(std::string name_prefix, std::string filepath, st
 	std::string err;
 
 	tinyobj::attrib_t attrib;
-	if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &err, filepath.c_str(), mtl_base_dir.c_str()))
-		throw std::runtime_error( std::string("Error: Unable to load " + filepath));
-
-    if (err.size() > 0)
-        std::cout<< err << std::endl;
 
     std::vector<Material*> materialComponents;
     std::vector<Transform*> transformComponents;
@@ -60,156 +59,145 @@ std::vector<Entity*> importOBJ(std::string name_prefix, std::string filepath, st
     std::set<OBJTextureInfo, OBJTextureInfoCompare> texture_paths;
     std::map<std::string, Texture*> texture_map;
 
-    if (materials.size() >= MAX_MATERIALS) {
-        throw std::runtime_error(std::string("Error, total materials found is ") 
-            + std::to_string(materials.size()) 
-            + std::string(" but max supported materials is set to ")
-            + std::to_string(MAX_MATERIALS) 
-        );
-    }
-
-    int offset = 0; // sometimes there are duplicate material names...
-    for (uint32_t i = 0; i < materials.size(); ++i) {
-        int offset = 0;
-        while (true) {
-            std::string name = std::string(name_prefix + materials[i].name) + ((offset == 0) ? std::string("") : std::to_string(offset));
-            if (Material::get(name) != nullptr) {
-                offset++; continue;
-            }
-            materialComponents.push_back(Material::create(name));
-            break;
-        };
-
-        int illum_group = materials[i].illum;
-
-        // Meaning of illum group
-        // 0. Color on and Ambient off
-        // 1. Color on and Ambient on
-        // 2. Highlight on
-        // 3. Reflection on and Ray trace on
-        // 4. Transparency: Glass on, Reflection: Ray trace on
-        // 5. Reflection: Fresnel on and Ray trace on
-        // 6. Transparency: Refraction on, Reflection: Fresnel off and Ray trace on
-        // 7. Transparency: Refraction on, Reflection: Fresnel on and Ray trace on
-        // 8. Reflection on and Ray trace off
-        // 9. Transparency: Glass on, Reflection: Ray trace off
-        // 10. Casts shadows onto invisible surfaces
-
-        if (materials[i].alpha_texname.length() > 0)
-            texture_paths.insert({materials[i].alpha_texname, false});
-
-        if (materials[i].ambient_texname.length() > 0)
-            texture_paths.insert({materials[i].ambient_texname, false});
+    /* Creates components for any materials which were loaded since the last call */
+    auto createMaterials = [&] () {
+        uint32_t first = uint32_t(materialComponents.size());
+        for (uint32_t i = first; i < materials.size(); ++i) {
+            materialComponents.push_back(Material::createUnique(name_prefix + materials[i].name));
+
+            int illum_group = materials[i].illum;
+
+            // Meaning of illum group
+            // 0. Color on and Ambient off
+            // 1. Color on and Ambient on
+            // 2. Highlight on
+            // 3. Reflection on and Ray trace on
+            // 4. Transparency: Glass on, Reflection: Ray trace on
+            // 5. Reflection: Fresnel on and Ray trace on
+            // 6. Transparency: Refraction on, Reflection: Fresnel off and Ray trace on
+            // 7. Transparency: Refraction on, Reflection: Fresnel on and Ray trace on
+            // 8. Reflection on and Ray trace off
+            // 9. Transparency: Glass on, Reflection: Ray trace off
+            // 10. Casts shadows onto invisible surfaces
+
+            if (materials[i].alpha_texname.length() > 0)
+                texture_paths.insert({materials[i].alpha_texname, false});
+
+            if (materials[i].ambient_texname.length() > 0)
+                texture_paths.insert({materials[i].ambient_texname, false});
         
-        if (materials[i].bump_texname.length() > 0)
-            texture_paths.insert({materials[i].bump_texname, true});
+            if (materials[i].bump_texname.length() > 0)
+                texture_paths.insert({materials[i].bump_texname, true});
 
-        if (materials[i].displacement_texname.length() > 0)
-            texture_paths.insert({materials[i].displacement_texname, false});
+            if (materials[i].displacement_texname.length() > 0)
+                texture_paths.insert({materials[i].displacement_texname, false});
         
-        if (materials[i].diffuse_texname.length() > 0)
-            texture_paths.insert({materials[i].diffuse_texname, false});
+            if (materials[i].diffuse_texname.length() > 0)
+                texture_paths.insert({materials[i].diffuse_texname, false});
 
-        if (materials[i].emissive_texname.length() > 0)
-            texture_paths.insert({materials[i].emissive_texname, false});
+            if (materials[i].emissive_texname.length() > 0)
+                texture_paths.insert({materials[i].emissive_texname, false});
 
-        if (materials[i].metallic_texname.length() > 0)
-            texture_paths.insert({materials[i].metallic_texname, false});
+            if (materials[i].metallic_texname.length() > 0)
+                texture_paths.insert({materials[i].metallic_texname, false});
 
-        if (materials[i].normal_texname.length() > 0)
-            texture_paths.insert({materials[i].normal_texname, false});
+            if (materials[i].normal_texname.length() > 0)
+                texture_paths.insert({materials[i].normal_texname, false});
 
-        if (materials[i].reflection_texname.length() > 0)
-            texture_paths.insert({materials[i].reflection_texname, false});
+            if (materials[i].reflection_texname.length() > 0)
+                texture_paths.insert({materials[i].reflection_texname, false});
 
-        if (materials[i].roughness_texname.length() > 0)
-            texture_paths.insert({materials[i].roughness_texname, false});
+            if (materials[i].roughness_texname.length() > 0)
+                texture_paths.insert({materials[i].roughness_texname, false});
 
-        if (materials[i].sheen_texname.length() > 0)
-            texture_paths.insert({materials[i].sheen_texname, false});
+            if (materials[i].sheen_texname.length() > 0)
+                texture_paths.insert({materials[i].sheen_texname, false});
 
-        if (materials[i].specular_highlight_texname.length() > 0)
-            texture_paths.insert({materials[i].specular_highlight_texname, false});
+            if (materials[i].specular_highlight_texname.length() > 0)
+                texture_paths.insert({materials[i].specular_highlight_texname, false});
 
-        if (materials[i].specular_texname.length() > 0)
-            texture_paths.insert({materials[i].specular_texname, false});
+            if (materials[i].specular_texname.length() > 0)
+                texture_paths.insert({materials[i].specular_texname, false});
 
-        materialComponents[i]->setBaseColor(vec3(materials[i].diffuse[0], materials[i].diffuse[1], materials[i].diffuse[2]));
-        materialComponents[i]->setRoughness(1.0);
-        materialComponents[i]->setMetallic(0.0);
+            materialComponents[i]->setBaseColor(vec3(materials[i].diffuse[0], materials[i].diffuse[1], materials[i].diffuse[2]));
+            materialComponents[i]->setRoughness(1.0);
+            materialComponents[i]->setMetallic(0.0);
 
-        if (illum_group == 6) {
-            materialComponents[i]->setTransmission(1.0);
+            if (illum_group == 6) {
+                materialComponents[i]->setTransmission(1.0);
+            }
         }
-    }
 
-    for (auto &pathobj : texture_paths)
-    {
-        if (pathobj.is_bump)
-            continue; // TODO
-            // texture_map[pathobj.path] = Texture::CreateFromBumpPNG(mtl_base_dir + pathobj.path, mtl_base_dir + pathobj.path);
-        else 
-            texture_map[pathobj.path] = Texture::createFromImage(name_prefix + mtl_base_dir + pathobj.path, mtl_base_dir + pathobj.path);
-        // Maybe think of a better name here? Could accidentally conflict...
-    }
+        for (auto &pathobj : texture_paths)
+        {
+            if (texture_map.find(pathobj.path) != texture_map.end()) continue;
+            if (pathobj.is_bump)
+                continue; // TODO
+                // texture_map[pathobj.path] = Texture::CreateFromBumpPNG(mtl_base_dir + pathobj.path, mtl_base_dir + pathobj.path);
+            else 
+                texture_map[pathobj.path] = Texture::createFromImage(name_prefix + mtl_base_dir + pathobj.path, mtl_base_dir + pathobj.path);
+            // Maybe think of a better name here? Could accidentally conflict...
+        }
 
-    for (uint32_t i = 0; i < materials.size(); ++i) {
+        for (uint32_t i = first; i < materials.size(); ++i) {
 
-        if (materials[i].alpha_texname.length() > 0) {
-            materialComponents[i]->setAlphaTexture(texture_map[materials[i].alpha_texname]);
-        }
+            if (materials[i].alpha_texname.length() > 0) {
+                materialComponents[i]->setAlphaTexture(texture_map[materials[i].alpha_texname]);
+            }
 
-        if (materials[i].diffuse_texname.length() > 0) {
-            materialComponents[i]->setBaseColorTexture(texture_map[materials[i].diffuse_texname]);
-        }
+            if (materials[i].diffuse_texname.length() > 0) {
+                materialComponents[i]->setBaseColorTexture(texture_map[materials[i].diffuse_texname]);
+            }
         
-        // if (materials[i].bump_texname.length() > 0) {
-            // materialComponents[i]->setBumpTexture(texture_map[materials[i].bump_texname]);
-        // }
+            // if (materials[i].bump_texname.length() > 0) {
+                // materialComponents[i]->setBumpTexture(texture_map[materials[i].bump_texname]);
+            // }
 
-        if (materials[i].normal_texname.length() > 0) {
-            materialComponents[i]->setNormalMapTexture(texture_map[materials[i].normal_texname]);
-        }
+            if (materials[i].normal_texname.length() > 0) {
+                materialComponents[i]->setNormalMapTexture(texture_map[materials[i].normal_texname]);
+            }
 
-        // if (materials[i].displacement_texname.length() > 0) {
-            // materialComponents[i]->setBumpTexture(texture_map[materials[i].displacement_texname]);
-        // }
+            // if (materials[i].displacement_texname.length() > 0) {
+                // materialComponents[i]->setBumpTexture(texture_map[materials[i].displacement_texname]);
+            // }
 
-        if (materials[i].roughness_texname.length() > 0) {
-            materialComponents[i]->setRoughnessTexture(texture_map[materials[i].roughness_texname]);
-        }
+            if (materials[i].roughness_texname.length() > 0) {
+                materialComponents[i]->setRoughnessTexture(texture_map[materials[i].roughness_texname]);
+            }
 
-        if (materials[i].metallic_texname.length() > 0) {
-            materialComponents[i]->setMetallicTexture(texture_map[materials[i].metallic_texname]);
-        }
+            if (materials[i].metallic_texname.length() > 0) {
+                materialComponents[i]->setMetallicTexture(texture_map[materials[i].metallic_texname]);
+            }
 
-        if (materials[i].specular_texname.length() > 0)
-            materialComponents[i]->setSpecularTexture(texture_map[materials[i].specular_texname]);
+            if (materials[i].specular_texname.length() > 0)
+                materialComponents[i]->setSpecularTexture(texture_map[materials[i].specular_texname]);
 
-        if (materials[i].sheen_texname.length() > 0)
-            materialComponents[i]->setSheenTexture(texture_map[materials[i].sheen_texname]);
+            if (materials[i].sheen_texname.length() > 0)
+                materialComponents[i]->setSheenTexture(texture_map[materials[i].sheen_texname]);
 
-        // TODO:
-        // if (materials[i].ambient_texname.length() > 0)
-        //     texture_paths.insert(materials[i].ambient_texname);
+            // TODO:
+            // if (materials[i].ambient_texname.length() > 0)
+            //     texture_paths.insert(materials[i].ambient_texname);
 
-        // if (materials[i].emissive_texname.length() > 0)
-        //     texture_paths.insert(materials[i].emissive_texname);
+            // if (materials[i].emissive_texname.length() > 0)
+            //     texture_paths.insert(materials[i].emissive_texname);
 
-        // if (materials[i].reflection_texname.length() > 0)
-        //     texture_paths.insert(materials[i].reflection_texname);
+            // if (materials[i].reflection_texname.length() > 0)
+            //     texture_paths.insert(materials[i].reflection_texname);
 
-        // if (materials[i].specular_highlight_texname.length() > 0)
-        //     texture_paths.insert(materials[i].specular_highlight_texname);
+            // if (materials[i].specular_highlight_texname.length() > 0)
+            //     texture_paths.insert(materials[i].specular_highlight_texname);
 
-    }
+        }
+    };
 
-    for (uint32_t i = 0; i < shapes.size(); ++i) {
+    /* Creates an entity for each material used by the given shape */
+    auto createShape = [&] (tinyobj::shape_t &shape) {
 
         /* Determine how many materials are in this shape... */
         std::set<uint32_t> material_ids;
-        for (uint32_t j = 0; j < shapes[i].mesh.material_ids.size(); ++j) {
-            material_ids.insert(shapes[i].mesh.material_ids[j]);
+        for (uint32_t j = 0; j < shape.mesh.material_ids.size(); ++j) {
+            material_ids.insert(shape.mesh.material_ids[j]);
         }
 
         uint32_t mat_offset = 0;
@@ -226,18 +214,18 @@ std::vector<Entity*> importOBJ(std::string name_prefix, std::string filepath, st
 
             /* For each face */
             size_t index_offset = 0;
-            for (size_t f = 0; f < shapes[i].mesh.num_face_vertices.size(); f++) {
-                int fv = shapes[i].mesh.num_face_vertices[f];
+            for (size_t f = 0; f < shape.mesh.num_face_vertices.size(); f++) {
+                int fv = shape.mesh.num_face_vertices[f];
 
                 /* Skip any faces which don't use the current material */
-                if (shapes[i].mesh.material_ids[f] != material_id) {
+                if (shape.mesh.material_ids[f] != material_id) {
                     index_offset += fv;
                     continue;
                 }
 
                 // Loop over vertices in the face.
                 for (size_t v = 0; v < fv; v++) {
-                    auto index = shapes[i].mesh.indices[index_offset + v];
+                    auto index = shape.mesh.indices[index_offset + v];
                     positions.push_back(glm::vec4(
                         attrib.vertices[3 * index.vertex_index + 0],
                         attrib.vertices[3 * index.vertex_index + 1],
@@ -282,28 +270,9 @@ std::vector<Entity*> importOBJ(std::string name_prefix, std::string filepath, st
             /* We need at least one point to render... */
             if (positions.size() < 3) continue;
 
-            Entity* entity;
-            Transform* transform;
-            int offset = 0;
-            while (true) {
-                std::string name = std::string(name_prefix + shapes[i].name + "_" + std::to_string(mat_offset)) 
-                                               + ((offset == 0) ? std::string("") : std::to_string(offset));
-                if (Entity::get(name) != nullptr) {
-                    offset++; continue;
-                }
-                entity = Entity::create(name);
-                break;
-            };
-
-            while (true) {
-                std::string name = std::string(name_prefix + shapes[i].name + "_" + std::to_string(mat_offset)) 
-                                               + ((offset == 0) ? std::string("") : std::to_string(offset));
-                if (Transform::get(name) != nullptr) {
-                    offset++; continue;
-                }
-                transform = Transform::create(name);
-                break;
-            };
+            std::string shapeName = name_prefix + shape.name + "_" + std::to_string(mat_offset);
+            Entity* entity = Entity::createUnique(shapeName);
+            Transform* transform = Transform::createUnique(shapeName);
             
             transform->setPosition(position);
             transform->setScale(scale);
@@ -316,17 +285,36 @@ std::vector<Entity*> importOBJ(std::string name_prefix, std::string filepath, st
             // separate entities...
             entity->setMaterial(materialComponents[material_id]);
 
-            while (true) {
-                std::string name = std::string(name_prefix + shapes[i].name + "_" + std::to_string(mat_offset)) 
-                                               + ((offset == 0) ? std::string("") : std::to_string(offset));
-                if (Mesh::get(name) != nullptr) {
-                    offset++; continue;
-                }
-                auto mesh = Mesh::createFromData(name, positions, normals, colors, texcoords);
-                entity->setMesh(mesh);
-                break;
-            };
+            auto mesh = Mesh::createUnique(shapeName, std::move(positions), std::move(normals), std::move(colors), std::move(texcoords), std::vector<uint32_t>(), true);
+            entity->setMesh(mesh);
         }
+    };
+
+    if (memory_budget_mb == 0) {
+        if (!loadObjParallel(&attrib, &shapes, &materials, &err, filepath, mtl_base_dir))
+            throw std::runtime_error( std::string("Error: Unable to load " + filepath));
+
+        if (err.size() > 0)
+            std::cout<< err << std::endl;
+
+        createMaterials();
+        for (auto &shape : shapes) createShape(shape);
+    }
+    else {
+        /* Materials are loaded as mtllib statements are reached, so create components for them as shapes arrive. 
+           Each shape's staging buffers are released before the next shape is parsed. */
+        auto onShape = [&] (tinyobj::shape_t &shape) {
+            createMaterials();
+            createShape(shape);
+        };
+        uint64_t budget = uint64_t(memory_budget_mb) << 20;
+        if (!loadObjStreaming(&attrib, &materials, &err, filepath, mtl_base_dir, budget, OBJ_IMPORT_BYTES_PER_TRIANGLE, onShape))
+            throw std::runtime_error( std::string("Error: Unable to load " + filepath + ". " + err));
+
+        if (err.size() > 0)
+            std::cout<< err << std::endl;
+
+        createMaterials();
     }
 
     return entities;
@@ -0,0 +1,166 @@
+/*
+ * Benchmarks the affine helpers in utilities/affine.h against the plain glm expressions Transform used before them,
+ * on the work of a transform update: composing each local matrix from its scale, rotation and position, and both
+ * world matrices of a random hierarchy of joints, parent before child.
+ *
+ * - glm: local matrices multiplied out of separate translation, rotation and scale matrices, the rotation inverted
+ *   with glm::inverse, and each localToWorld taken as the general 4x4 inverse of its worldToLocal.
+ * - affine: local matrices built directly with affineFromTRS and affineFromInverseTRS, and both world matrices
+ *   composed down the hierarchy with affineMultiply.
+ *
+ * Single operations (compose, invert, multiply, transform points) are timed on their own as well. Both paths must
+ * agree to within rounding, and the largest relative difference is printed.
+ *
+ * Build with -DVISII_BUILD_AFFINE_BENCHMARK=ON and run benchmark_affine, optionally with the number of joints.
+ * Exits with a non-zero status if the two paths disagree.
+*/
+
+#include <visii/utilities/affine.h>
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtx/quaternion.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+static const uint32_t DEFAULT_JOINTS = 10000;
+static const uint32_t FRAMES = 100;
+static const uint32_t POINTS = 1000000;
+static const float TOLERANCE = 1e-4f;
+
+struct Joint {
+    glm::vec3 position;
+    glm::quat rotation;
+    glm::vec3 scale;
+    int32_t parent;
+};
+
+static double now()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/* Runs f once to warm up, then FRAMES more times, and returns the average time of one run in milliseconds */
+template<typename F>
+static double timeFrames(F f)
+{
+    f();
+    double start = now();
+    for (uint32_t i = 0; i < FRAMES; ++i) f();
+    return (now() - start) * 1000.0 / FRAMES;
+}
+
+/* Keeps the optimizer from dropping results which are never read */
+static volatile float sink;
+static void consume(const glm::mat4 &m) { sink = m[3][0]; }
+
+static glm::mat4 glmLocalToParent(const Joint &j)
+{
+    return glm::translate(glm::mat4(1.0), j.position) * glm::toMat4(j.rotation) * glm::scale(glm::mat4(1.0), j.scale);
+}
+
+static glm::mat4 glmParentToLocal(const Joint &j)
+{
+    return glm::scale(glm::mat4(1.0), glm::vec3(1.0 / j.scale.x, 1.0 / j.scale.y, 1.0 / j.scale.z))
+        * glm::inverse(glm::toMat4(j.rotation)) * glm::translate(glm::mat4(1.0), -j.position);
+}
+
+static void updateGlm(const std::vector<Joint> &joints, std::vector<glm::mat4> &worldToLocal, std::vector<glm::mat4> &localToWorld)
+{
+    for (size_t i = 0; i < joints.size(); ++i) {
+        const Joint &j = joints[i];
+        if (j.parent == -1) {
+            worldToLocal[i] = glmParentToLocal(j);
+            localToWorld[i] = glmLocalToParent(j);
+        } else {
+            worldToLocal[i] = glmParentToLocal(j) * worldToLocal[j.parent];
+            localToWorld[i] = glm::inverse(worldToLocal[i]);
+        }
+    }
+}
+
+static void updateAffine(const std::vector<Joint> &joints, std::vector<glm::mat4> &worldToLocal, std::vector<glm::mat4> &localToWorld)
+{
+    for (size_t i = 0; i < joints.size(); ++i) {
+        const Joint &j = joints[i];
+        worldToLocal[i] = affineFromInverseTRS(j.position, j.rotation, j.scale);
+        localToWorld[i] = affineFromTRS(j.position, j.rotation, j.scale);
+        if (j.parent != -1) {
+            worldToLocal[i] = affineMultiply(worldToLocal[i], worldToLocal[j.parent]);
+            localToWorld[i] = affineMultiply(localToWorld[j.parent], localToWorld[i]);
+        }
+    }
+}
+
+static float maxRelativeDifference(const std::vector<glm::mat4> &a, const std::vector<glm::mat4> &b)
+{
+    float result = 0.f;
+    for (size_t i = 0; i < a.size(); ++i)
+        for (int c = 0; c < 4; ++c)
+            for (int r = 0; r < 4; ++r)
+                result = std::max(result, std::fabs(a[i][c][r] - b[i][c][r]) / std::max(1.f, std::fabs(b[i][c][r])));
+    return result;
+}
+
+static void report(const char *what, double glmTime, double affineTime)
+{
+    printf("%-28s glm %8.3f ms, affine %8.3f ms (%.1fx)\n", what, glmTime, affineTime, glmTime / std::max(affineTime, 1e-9));
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t numJoints = (argc > 1) ? uint32_t(std::strtoul(argv[1], nullptr, 10)) : DEFAULT_JOINTS;
+    numJoints = std::max(numJoints, 1u);
+
+    // Most joints hang off a random earlier one, which keeps the hierarchy shallow, as in a rig. Scales are away from
+    // one to exercise the inverses.
+    std::mt19937 rng(0);
+    std::uniform_real_distribution<float> unit(-1.f, 1.f), scale(.5f, 2.f);
+    std::vector<Joint> joints(numJoints);
+    for (uint32_t i = 0; i < numJoints; ++i) {
+        joints[i].position = glm::vec3(unit(rng), unit(rng), unit(rng));
+        joints[i].rotation = glm::normalize(glm::quat(unit(rng), unit(rng), unit(rng), unit(rng)));
+        joints[i].scale = glm::vec3(scale(rng), scale(rng), scale(rng));
+        joints[i].parent = (i == 0 || (rng() % 8) == 0) ? -1 : int32_t(rng() % i);
+    }
+
+    std::vector<glm::mat4> glmWorldToLocal(numJoints), glmLocalToWorld(numJoints);
+    std::vector<glm::mat4> worldToLocal(numJoints), localToWorld(numJoints);
+
+    printf("%u joints, %u frames\n", numJoints, FRAMES);
+    report("hierarchy update",
+        timeFrames([&] { updateGlm(joints, glmWorldToLocal, glmLocalToWorld); }),
+        timeFrames([&] { updateAffine(joints, worldToLocal, localToWorld); }));
+
+    float difference = std::max(maxRelativeDifference(worldToLocal, glmWorldToLocal), maxRelativeDifference(localToWorld, glmLocalToWorld));
+    printf("largest relative difference %g\n", difference);
+
+    report("compose local to parent",
+        timeFrames([&] { for (auto &j : joints) consume(glmLocalToParent(j)); }),
+        timeFrames([&] { for (auto &j : joints) consume(affineFromTRS(j.position, j.rotation, j.scale)); }));
+    report("compose parent to local",
+        timeFrames([&] { for (auto &j : joints) consume(glmParentToLocal(j)); }),
+        timeFrames([&] { for (auto &j : joints) consume(affineFromInverseTRS(j.position, j.rotation, j.scale)); }));
+    report("invert",
+        timeFrames([&] { for (auto &m : glmLocalToWorld) consume(glm::inverse(m)); }),
+        timeFrames([&] { for (auto &m : localToWorld) consume(affineInverse(m)); }));
+    report("multiply",
+        timeFrames([&] { for (uint32_t i = 1; i < numJoints; ++i) consume(glmLocalToWorld[i - 1] * glmLocalToWorld[i]); }),
+        timeFrames([&] { for (uint32_t i = 1; i < numJoints; ++i) consume(affineMultiply(localToWorld[i - 1], localToWorld[i])); }));
+
+    std::vector<glm::vec3> points(POINTS), transformed(POINTS);
+    for (auto &p : points) p = glm::vec3(unit(rng), unit(rng), unit(rng));
+    const glm::mat4 &m = localToWorld[numJoints - 1];
+    report("transform 1M points",
+        timeFrames([&] { for (uint32_t i = 0; i < POINTS; ++i) transformed[i] = glm::vec3(m * glm::vec4(points[i], 1.f)); sink = transformed[POINTS - 1].x; }),
+        timeFrames([&] { affineTransformPoints(m, points.data(), transformed.data(), POINTS); sink = transformed[POINTS - 1].x; }));
+
+    bool same = difference <= TOLERANCE;
+    printf("%s\n", same ? "both paths agree" : "FAIL: the paths disagree");
+    return same ? 0 : 1;
+}
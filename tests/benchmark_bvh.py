@@ -0,0 +1,73 @@
+#%%
+import sys, os, time, random
+os.add_dll_directory(os.path.join(os.getcwd(), '..', 'install'))
+sys.path.append(os.path.join(os.getcwd(), "..", "install"))
+
+import visii
+
+# The random scene from examples/02.random_scene.py, and the dragon from examples/04.load_obj_file.py
+# when examples/download_content.sh has been run
+NUM_OBJECTS = int(os.environ.get("BVH_BENCHMARK_OBJECTS", "10000"))
+DRAGON_PATH = os.path.join(os.getcwd(), "..", "examples", "content", "dragon", "dragon.obj")
+WIDTH = 500
+HEIGHT = 250
+
+#%%
+# BVHs are built on the CPU backend, the first time a frame is traced after the scene changes
+visii.initialize_headless(backend = "cpu")
+
+camera = visii.entity.create(
+    name = "camera",
+    transform = visii.transform.create("camera"),
+    camera = visii.camera.create_perspective_from_fov(name = "camera", field_of_view = 0.785398, aspect = float(WIDTH) / float(HEIGHT)))
+camera.get_transform().look_at(visii.vec3(0, 0, 0), visii.vec3(1, 0, 0), visii.vec3(0, 0, 5))
+visii.set_camera_entity(camera)
+
+def trace(label):
+    start = time.time()
+    visii.render_data(width = WIDTH, height = HEIGHT, start_frame = 0, frame_count = 1, bounce = 0, options = "entity_id")
+    elapsed = time.time() - start
+    print("{}: {:.1f} ms, {:.2f} Mrays/s".format(label, elapsed * 1000., WIDTH * HEIGHT / elapsed / 1e6))
+    return elapsed
+
+#%%
+random.seed(0)
+meshes = [
+    visii.mesh.create_sphere("mesh_0"),
+    visii.mesh.create_torus_knot("mesh_1"),
+    visii.mesh.create_teapotahedron("mesh_2"),
+    visii.mesh.create_rounded_box("mesh_3"),
+    visii.mesh.create_spring("mesh_4"),
+    visii.mesh.create_icosphere("mesh_5"),
+]
+if os.path.exists(DRAGON_PATH):
+    meshes.append(visii.mesh.create_from_obj("dragon", DRAGON_PATH))
+
+objects = []
+for i in range(NUM_OBJECTS):
+    obj = visii.entity.create(
+        name = str(i),
+        mesh = meshes[i % len(meshes)],
+        transform = visii.transform.create(str(i),
+            position = visii.vec3(random.uniform(-5, 5), random.uniform(-5, 5), random.uniform(-10, 3)),
+            scale = visii.vec3(random.uniform(0.15, 0.2), random.uniform(0.15, 0.2), random.uniform(0.15, 0.2))),
+        material = visii.material.create(str(i)))
+    objects.append(obj)
+
+# Bottom level BVHs for every mesh, then the top level BVH over all instances
+build = trace("build and trace") - trace("trace")
+print("bvh build: {:.1f} ms for {} meshes and {} instances".format(build * 1000., len(meshes), NUM_OBJECTS))
+
+# Moving objects only refits the top level BVH
+for obj in objects:
+    obj.get_transform().add_position(visii.vec3(random.uniform(-.1, .1), random.uniform(-.1, .1), random.uniform(-.1, .1)))
+refit = trace("refit and trace") - trace("trace")
+print("tlas refit: {:.1f} ms".format(refit * 1000.))
+
+# Adding an object changes which entities are instanced, so the top level BVH is rebuilt
+visii.entity.create(name = "extra", mesh = meshes[0], transform = visii.transform.create("extra"), material = visii.material.create("extra"))
+rebuild = trace("rebuild and trace") - trace("trace")
+print("tlas rebuild: {:.1f} ms".format(rebuild * 1000.))
+
+# %%
+visii.cleanup()
@@ -0,0 +1,39 @@
+#%%
+import sys, os, time
+os.add_dll_directory(os.path.join(os.getcwd(), '..', 'install'))
+sys.path.append(os.path.join(os.getcwd(), "..", "install"))
+
+import visii
+
+NUM_COMPONENTS = 100000
+NUM_DUPLICATES = 10000
+
+#%%
+visii.initialize_headless()
+
+# Named creation, followed by a lookup of every name
+names = ["transform_{}".format(i) for i in range(NUM_COMPONENTS - NUM_DUPLICATES)]
+start = time.time()
+for name in names:
+    visii.transform.create(name)
+print("transform.create: {:.2f} s for {} transforms".format(time.time() - start, len(names)))
+
+start = time.time()
+for name in names:
+    assert visii.transform.get(name) is not None
+print("transform.get: {:.2f} s for {} names".format(time.time() - start, len(names)))
+
+# Many components sharing one name, as happens when importing scenes with unnamed shapes
+start = time.time()
+for i in range(NUM_DUPLICATES):
+    visii.transform.create_unique("shape")
+print("transform.create_unique: {:.2f} s for {} transforms".format(time.time() - start, NUM_DUPLICATES))
+assert visii.transform.get("shape") is not None
+assert visii.transform.get("shape{}".format(NUM_DUPLICATES - 1)) is not None
+
+name_to_id = visii.transform.get_name_to_id_map()
+assert len(name_to_id) == NUM_COMPONENTS
+assert name_to_id[names[0]] == visii.transform.get(names[0]).get_id()
+
+# %%
+visii.cleanup()
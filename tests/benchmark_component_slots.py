@@ -0,0 +1,39 @@
+#%%
+import sys, os, time
+os.add_dll_directory(os.path.join(os.getcwd(), '..', 'install'))
+sys.path.append(os.path.join(os.getcwd(), "..", "install"))
+
+import visii
+
+SIZES = [1000, 10000, 100000]
+
+#%%
+visii.initialize_headless()
+
+# Allocation should cost the same per component no matter how full the table is
+for size in SIZES:
+    names = ["entity_{}".format(i) for i in range(size)]
+    start = time.time()
+    for name in names:
+        visii.entity.create(name)
+    created = time.time() - start
+
+    start = time.time()
+    for name in names:
+        visii.entity.remove(name)
+    removed = time.time() - start
+    print("{} entities: {:.2f} us per create, {:.2f} us per remove".format(
+        size, created / size * 1e6, removed / size * 1e6))
+
+# Freed slots are handed out again lowest first, and existing ids never move
+entities = [visii.entity.create("entity_{}".format(i)) for i in range(100)]
+ids = [e.get_id() for e in entities]
+for i in range(0, 100, 2):
+    visii.entity.remove("entity_{}".format(i))
+for i in range(0, 100, 2):
+    assert visii.entity.create("refill_{}".format(i)).get_id() == ids[i]
+for i in range(1, 100, 2):
+    assert visii.entity.get("entity_{}".format(i)).get_id() == ids[i]
+
+# %%
+visii.cleanup()
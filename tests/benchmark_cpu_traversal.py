@@ -0,0 +1,64 @@
+#%%
+import sys, os, time, random
+os.add_dll_directory(os.path.join(os.getcwd(), '..', 'install'))
+sys.path.append(os.path.join(os.getcwd(), "..", "install"))
+
+import visii
+
+# Rays per second for primary visibility metadata on the CPU backend. Camera rays are traced in packets
+# as wide as the VISII_CPU_SIMD instruction set the library was built with, and are not shaded.
+# The last timing shades one sample per pixel, whose rays per second only count camera rays.
+NUM_OBJECTS = 1000
+WIDTH = 1920
+HEIGHT = 1080
+FRAMES = 4
+
+#%%
+visii.initialize_headless(backend = "cpu")
+
+camera = visii.entity.create(
+    name = "camera",
+    transform = visii.transform.create("camera"),
+    camera = visii.camera.create_perspective_from_fov(name = "camera", field_of_view = 0.785398, aspect = float(WIDTH) / float(HEIGHT)))
+camera.get_transform().look_at(visii.vec3(0, 0, 0), visii.vec3(0, 1, 0), visii.vec3(0, 0, 8))
+visii.set_camera_entity(camera)
+
+random.seed(0)
+meshes = [visii.mesh.create_sphere("sphere"), visii.mesh.create_teapotahedron("teapot"), visii.mesh.create_torus_knot("knot")]
+for i in range(NUM_OBJECTS):
+    visii.entity.create(
+        name = str(i),
+        mesh = meshes[i % len(meshes)],
+        transform = visii.transform.create(str(i),
+            position = visii.vec3(random.uniform(-3, 3), random.uniform(-3, 3), random.uniform(-5, 1)),
+            scale = visii.vec3(.2, .2, .2)),
+        material = visii.material.create(str(i)))
+
+# Build the BVHs before timing anything
+visii.render_data(width = WIDTH, height = HEIGHT, start_frame = 0, frame_count = 1, bounce = 0, options = "entity_id")
+
+def timed(label, trace):
+    start = time.time()
+    for frame in range(FRAMES):
+        trace(frame)
+    elapsed = time.time() - start
+    print("{}: {:.1f} ms per frame, {:.2f} Mrays/s".format(label, elapsed * 1000. / FRAMES, WIDTH * HEIGHT * FRAMES / elapsed / 1e6))
+
+# Metadata at bounce 0 only traces camera rays, and nothing accumulates, so each call traces its last frame
+for option in ["entity_id", "depth", "normal"]:
+    timed("render_data " + option,
+        lambda frame: visii.render_data(width = WIDTH, height = HEIGHT, start_frame = frame, frame_count = frame + 1, bounce = 0, options = option))
+
+timed("render_primary_data all",
+    lambda frame: visii.render_primary_data(width = WIDTH, height = HEIGHT, start_frame = frame, frame_count = frame + 1, options = ["depth", "position", "normal", "entity_id"]))
+
+# For comparison, metadata which still runs the path tracer
+timed("render_data denoise_normal",
+    lambda frame: visii.render_data(width = WIDTH, height = HEIGHT, start_frame = frame, frame_count = frame + 1, bounce = 0, options = "denoise_normal"))
+
+# A shaded sample traces each tile's shadow rays and bounce rays as streams too, a bounce at a time
+timed("render 1 spp",
+    lambda frame: visii.render(width = WIDTH, height = HEIGHT, samples_per_pixel = 1))
+
+# %%
+visii.cleanup()
@@ -0,0 +1,188 @@
+/*
+ * Benchmarks the light BVH in hostcode/light_bvh.h on the CPU, for a scene of many small emissive panels, such as
+ * screens, LEDs and windows, spread through a building sized volume.
+ *
+ * - Time to compute each light's bounds, build the tree, and refit it after every light has moved.
+ * - Time to pick a light with sampleLightBVH, against sampleAliasTable over light power alone.
+ * - Noise: the variance, relative to the mean, of a one sample estimate of the unshadowed light reaching random
+ *   points, with each light treated as a point at its center. The lower, the fewer samples a render needs.
+ *
+ * Build with -DVISII_BUILD_LIGHT_BVH_BENCHMARK=ON and run benchmark_light_bvh, optionally with the number of lights.
+*/
+
+#include <hostcode/alias_table.h>
+#include <hostcode/light_bvh.h>
+
+// Included for the host in the same order as in the CPU renderer, which lights.h relies on
+#include <visii/light_struct.h>
+#include <devicecode/disney_bsdf.h>
+#include <devicecode/lights.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+static const uint32_t DEFAULT_LIGHTS = 10000;
+static const uint32_t QUERIES = 1000000;
+static const uint32_t NOISE_POINTS = 200;
+static const uint32_t NOISE_SAMPLES = 2000;
+
+struct Panel {
+    glm::vec3 center;
+    glm::vec3 normal;
+    float size;
+    float radiance;
+};
+
+static double now()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static glm::vec3 randomDirection(LCGRand &rng)
+{
+    float z = 1.f - 2.f * lcg_randomf(rng);
+    float phi = 6.283185307f * lcg_randomf(rng);
+    float r = std::sqrt(std::max(0.f, 1.f - z * z));
+    return glm::vec3(r * std::cos(phi), r * std::sin(phi), z);
+}
+
+/* Ten floors of a 100 by 100 meter building, with most panels facing up or sideways and a few much brighter */
+static std::vector<Panel> randomPanels(uint32_t count, LCGRand &rng)
+{
+    std::vector<Panel> panels(count);
+    for (auto &panel : panels) {
+        float floor = float(int(lcg_randomf(rng) * 10.f)) * 4.f;
+        panel.center = glm::vec3(lcg_randomf(rng) * 100.f, lcg_randomf(rng) * 100.f, floor + lcg_randomf(rng) * 3.f);
+        float facing = lcg_randomf(rng);
+        if (facing < .5f) panel.normal = glm::vec3(0.f, 0.f, -1.f);
+        else panel.normal = glm::normalize(glm::vec3(randomDirection(rng).x, randomDirection(rng).y, 0.f) + glm::vec3(1e-4f, 0.f, 0.f));
+        panel.size = .05f + lcg_randomf(rng) * .5f;
+        panel.radiance = (lcg_randomf(rng) < .02f) ? 500.f : 5.f + lcg_randomf(rng) * 20.f;
+    }
+    return panels;
+}
+
+static std::vector<LightBounds> panelBounds(const std::vector<Panel> &panels)
+{
+    const std::vector<uint32_t> indices = {0, 1, 2, 0, 2, 3};
+    std::vector<LightBounds> bounds(panels.size());
+    for (size_t i = 0; i < panels.size(); ++i) {
+        const Panel &panel = panels[i];
+        glm::vec3 t = glm::normalize(glm::cross(panel.normal, (std::fabs(panel.normal.x) < .9f) ? glm::vec3(1, 0, 0) : glm::vec3(0, 1, 0)));
+        glm::vec3 b = glm::cross(panel.normal, t);
+        std::vector<glm::vec4> vertices = {
+            glm::vec4(-t - b, 1.f), glm::vec4(t - b, 1.f), glm::vec4(t + b, 1.f), glm::vec4(-t + b, 1.f)
+        };
+        glm::mat4 localToWorld = glm::mat4(panel.size * .5f);
+        localToWorld[3] = glm::vec4(panel.center, 1.f);
+        bounds[i] = computeMeshLightBounds(vertices, indices, localToWorld, panel.radiance);
+    }
+    return bounds;
+}
+
+/* Light from a panel reaching a point with normal n, as if it were a point light at its center */
+static double contribution(const Panel &panel, const glm::vec3 &p, const glm::vec3 &n)
+{
+    glm::vec3 d = panel.center - p;
+    double d2 = glm::dot(d, d);
+    glm::vec3 w = d / float(std::sqrt(d2));
+    double area = panel.size * panel.size;
+    return panel.radiance * area * std::fabs(glm::dot(w, panel.normal)) * std::max(glm::dot(w, n), 0.f) / std::max(d2, 1e-2);
+}
+
+/* The variance of a one sample estimate, divided by the squared mean, averaged over random points */
+template<class Pick>
+static double relativeVariance(const std::vector<Panel> &panels, const Pick &pick)
+{
+    LCGRand rng;
+    rng.state = 17;
+    double total = 0.0;
+    uint32_t points = 0;
+    for (uint32_t i = 0; i < NOISE_POINTS; ++i) {
+        glm::vec3 p = glm::vec3(lcg_randomf(rng) * 100.f, lcg_randomf(rng) * 100.f, float(int(lcg_randomf(rng) * 10.f)) * 4.f);
+        glm::vec3 n = glm::vec3(0.f, 0.f, 1.f);
+        double sum = 0.0, sum2 = 0.0;
+        for (uint32_t s = 0; s < NOISE_SAMPLES; ++s) {
+            float pdf;
+            uint32_t light = pick(p, n, lcg_randomf(rng), pdf);
+            double estimate = (pdf > 0.f) ? contribution(panels[light], p, n) / pdf : 0.0;
+            sum += estimate;
+            sum2 += estimate * estimate;
+        }
+        double mean = sum / NOISE_SAMPLES;
+        if (mean <= 0.0) continue;
+        total += (sum2 / NOISE_SAMPLES - mean * mean) / (mean * mean);
+        points++;
+    }
+    return (points > 0) ? total / points : 0.0;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t numLights = (argc > 1) ? uint32_t(std::atoi(argv[1])) : DEFAULT_LIGHTS;
+    if (numLights == 0) numLights = DEFAULT_LIGHTS;
+    LCGRand rng;
+    rng.state = 1;
+
+    std::vector<Panel> panels = randomPanels(numLights, rng);
+    double start = now();
+    std::vector<LightBounds> bounds = panelBounds(panels);
+    double boundsTime = now() - start;
+
+    LightBVH bvh;
+    start = now();
+    bvh.build(bounds);
+    double buildTime = now() - start;
+
+    // Nudge every panel, as an animation would, then refit
+    std::vector<Panel> moved = panels;
+    for (auto &panel : moved) panel.center += glm::vec3(lcg_randomf(rng), lcg_randomf(rng), lcg_randomf(rng)) * .2f - glm::vec3(.1f);
+    std::vector<LightBounds> movedBounds = panelBounds(moved);
+    start = now();
+    bvh.refit(movedBounds);
+    double refitTime = now() - start;
+
+    printf("%u lights, %zu nodes\n", numLights, bvh.nodes.size());
+    printf("light bounds: %8.2f ms\n", boundsTime * 1000.);
+    printf("build:        %8.2f ms\n", buildTime * 1000.);
+    printf("refit:        %8.2f ms\n", refitTime * 1000.);
+
+    std::vector<float> powers(bounds.size());
+    for (size_t i = 0; i < bounds.size(); ++i) powers[i] = movedBounds[i].power;
+    std::vector<AliasTableEntry> powerTable = buildAliasTable(powers);
+
+    auto pickByPower = [&] (const glm::vec3 &, const glm::vec3 &, float rand, float &pdf) {
+        return sampleAliasTable(powerTable.data(), uint32_t(powerTable.size()), rand, pdf);
+    };
+    auto pickFromBVH = [&] (const glm::vec3 &p, const glm::vec3 &n, float rand, float &pdf) {
+        return sampleLightBVH(bvh.nodes.data(), numLights, p, n, rand, pdf);
+    };
+
+    // Throughput, over points spread through the building
+    std::vector<glm::vec3> points(1024);
+    for (auto &p : points) p = glm::vec3(lcg_randomf(rng) * 100.f, lcg_randomf(rng) * 100.f, lcg_randomf(rng) * 40.f);
+    auto throughput = [&] (const char *name, auto pick) {
+        LCGRand r;
+        r.state = 3;
+        uint64_t checksum = 0;
+        double begin = now();
+        for (uint32_t q = 0; q < QUERIES; ++q) {
+            float pdf;
+            checksum += pick(points[q & 1023], glm::vec3(0.f, 0.f, 1.f), lcg_randomf(r), pdf);
+        }
+        double elapsed = now() - begin;
+        printf("%-14s %8.1f ns per pick (%llu)\n", name, elapsed * 1e9 / QUERIES, (unsigned long long)(checksum & 0xff));
+    };
+    printf("\n== picking a light ==\n");
+    throughput("by power", pickByPower);
+    throughput("light bvh", pickFromBVH);
+
+    printf("\n== noise, as relative variance of one sample ==\n");
+    double powerVariance = relativeVariance(moved, pickByPower);
+    double bvhVariance = relativeVariance(moved, pickFromBVH);
+    printf("by power:  %10.2f\n", powerVariance);
+    printf("light bvh: %10.2f (%.1fx lower)\n", bvhVariance, powerVariance / std::max(bvhVariance, 1e-12));
+    return 0;
+}
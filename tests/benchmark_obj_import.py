@@ -0,0 +1,61 @@
+#%%
+import sys, os, time, random
+os.add_dll_directory(os.path.join(os.getcwd(), '..', 'install'))
+sys.path.append(os.path.join(os.getcwd(), "..", "install"))
+
+import visii
+
+# Approximate size of the generated OBJ file, in megabytes
+TARGET_MB = int(os.environ.get("OBJ_BENCHMARK_MB", "1024"))
+OBJ_PATH = os.environ.get("OBJ_BENCHMARK_PATH", "benchmark_large.obj")
+
+#%%
+# Write a large grid of quads, with normals and texture coordinates, split into a few groups
+def write_grid(path, target_mb):
+    # Each grid cell costs roughly 110 bytes of vertex data and 50 bytes of face data
+    cells = (target_mb * 1024 * 1024) // 160
+    res = max(2, int(cells ** 0.5))
+    random.seed(0)
+    with open(path, "w") as f:
+        for y in range(res + 1):
+            f.write("".join(
+                "v {:.6f} {:.6f} {:.6f}\nvn 0 0 1\nvt {:.6f} {:.6f}\n".format(
+                    x / res, y / res, random.random() * 0.01, x / res, y / res)
+                for x in range(res + 1)))
+        for y in range(res):
+            if y % max(1, res // 8) == 0:
+                f.write("g group_{}\n".format(y))
+            lines = []
+            for x in range(res):
+                a = y * (res + 1) + x + 1
+                b, c, d = a + 1, a + res + 2, a + res + 1
+                lines.append("f {0}/{0}/{0} {1}/{1}/{1} {2}/{2}/{2} {3}/{3}/{3}\n".format(a, b, c, d))
+            f.write("".join(lines))
+    return res * res * 2
+
+if not os.path.exists(OBJ_PATH):
+    start = time.time()
+    triangles = write_grid(OBJ_PATH, TARGET_MB)
+    print("Generated {} ({} triangles) in {:.2f}s".format(OBJ_PATH, triangles, time.time() - start))
+print("File size: {:.1f} MB".format(os.path.getsize(OBJ_PATH) / (1024.0 * 1024.0)))
+
+#%%
+visii.initialize_headless()
+
+# These timings are end to end, parsing and then building the visii meshes. For parsing alone against the
+# tinyobj parser it replaces, build and run tests/benchmark_obj_parser.cpp (VISII_BUILD_OBJ_PARSER_BENCHMARK).
+start = time.time()
+visii.mesh.create_from_obj("benchmark_mesh", OBJ_PATH, optimize = False)
+print("visii.mesh.create_from_obj: {:.2f}s".format(time.time() - start))
+
+start = time.time()
+visii.import_obj("benchmark_", OBJ_PATH, os.path.dirname(os.path.abspath(OBJ_PATH)) + "/")
+print("visii.import_obj: {:.2f}s".format(time.time() - start))
+
+# Streaming mode, which bounds the memory used while importing
+start = time.time()
+visii.import_obj("benchmark_streaming_", OBJ_PATH, os.path.dirname(os.path.abspath(OBJ_PATH)) + "/", memory_budget_mb = 2048)
+print("visii.import_obj (2 GB budget): {:.2f}s".format(time.time() - start))
+
+# %%
+visii.cleanup()
@@ -0,0 +1,120 @@
+/*
+ * Benchmarks loadObjParallel in utilities/obj_parser.h against the tinyobj::LoadObj it replaces. Both parse the same
+ * file into the same tinyobj attrib, shapes and materials, and nothing else, so the timings compare like for like.
+ * Building meshes from the parsed data is the same for both, and is timed end to end by tests/benchmark_obj_import.py.
+ *
+ * Build with -DVISII_BUILD_OBJ_PARSER_BENCHMARK=ON and run benchmark_obj_parser, optionally with the path of an OBJ
+ * file. Without one, a grid of roughly OBJ_BENCHMARK_MB megabytes (256 by default) is written to benchmark_grid.obj.
+ * Exits with a non-zero status if the two parsers disagree.
+*/
+
+#define TINYOBJLOADER_IMPLEMENTATION
+#include <visii/utilities/obj_parser.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+static double now()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/*
+ * A grid of quads with normals and texture coordinates, split into a few groups, like benchmark_obj_import.py's.
+ * Cells are a unit wide, since tinyobj's ear clipping only picks the same diagonal as a fan for polygons which are
+ * large enough for it to find their plane.
+*/
+static void writeGrid(const std::string &path, uint64_t targetMB)
+{
+    // Each grid cell costs roughly 110 bytes of vertex data and 50 bytes of face data
+    uint64_t cells = (targetMB * 1024 * 1024) / 160;
+    uint64_t res = std::max<uint64_t>(2, uint64_t(std::sqrt(double(cells))));
+    std::mt19937 rng(0);
+    std::uniform_real_distribution<float> jitter(0.f, .01f);
+    FILE *f = fopen(path.c_str(), "w");
+    if (!f) throw std::runtime_error("Error: unable to write " + path);
+    for (uint64_t y = 0; y <= res; ++y) {
+        for (uint64_t x = 0; x <= res; ++x) {
+            fprintf(f, "v %llu %llu %.6f\nvn 0 0 1\nvt %.6f %.6f\n", (unsigned long long) x, (unsigned long long) y, jitter(rng), double(x) / res, double(y) / res);
+        }
+    }
+    for (uint64_t y = 0; y < res; ++y) {
+        if (y % std::max<uint64_t>(1, res / 8) == 0) fprintf(f, "g group_%llu\n", (unsigned long long) y);
+        for (uint64_t x = 0; x < res; ++x) {
+            uint64_t a = y * (res + 1) + x + 1, b = a + 1, c = a + res + 2, d = a + res + 1;
+            fprintf(f, "f %llu/%llu/%llu %llu/%llu/%llu %llu/%llu/%llu %llu/%llu/%llu\n",
+                (unsigned long long) a, (unsigned long long) a, (unsigned long long) a,
+                (unsigned long long) b, (unsigned long long) b, (unsigned long long) b,
+                (unsigned long long) c, (unsigned long long) c, (unsigned long long) c,
+                (unsigned long long) d, (unsigned long long) d, (unsigned long long) d);
+        }
+    }
+    fclose(f);
+}
+
+static uint64_t countTriangles(const std::vector<tinyobj::shape_t> &shapes)
+{
+    uint64_t count = 0;
+    for (auto &shape : shapes) count += shape.mesh.indices.size() / 3;
+    return count;
+}
+
+int main(int argc, char **argv)
+{
+    std::string path = (argc > 1) ? argv[1] : "benchmark_grid.obj";
+    if (argc <= 1) {
+        const char *mb = getenv("OBJ_BENCHMARK_MB");
+        uint64_t targetMB = mb ? std::strtoull(mb, nullptr, 10) : 256;
+        if (!std::ifstream(path).good()) {
+            double start = now();
+            writeGrid(path, targetMB);
+            printf("wrote %s in %.2fs\n", path.c_str(), now() - start);
+        }
+    }
+    std::string baseDir = (path.find_last_of("/\\") == std::string::npos) ? std::string("") : path.substr(0, path.find_last_of("/\\") + 1);
+
+    tinyobj::attrib_t refAttrib;
+    std::vector<tinyobj::shape_t> refShapes;
+    std::vector<tinyobj::material_t> refMaterials;
+    std::string refErr;
+    double start = now();
+    bool refLoaded = tinyobj::LoadObj(&refAttrib, &refShapes, &refMaterials, &refErr, path.c_str(), baseDir.c_str(), true);
+    double refTime = now() - start;
+    if (!refLoaded) { printf("tinyobj failed to parse %s: %s\n", path.c_str(), refErr.c_str()); return 1; }
+
+    tinyobj::attrib_t attrib;
+    std::vector<tinyobj::shape_t> shapes;
+    std::vector<tinyobj::material_t> materials;
+    std::string err;
+    start = now();
+    bool loaded = loadObjParallel(&attrib, &shapes, &materials, &err, path, baseDir);
+    double time = now() - start;
+    if (!loaded) { printf("loadObjParallel failed to parse %s: %s\n", path.c_str(), err.c_str()); return 1; }
+
+    printf("%zu vertices, %llu triangles in %zu shapes, %u threads\n", refAttrib.vertices.size() / 3,
+        (unsigned long long) countTriangles(refShapes), refShapes.size(), std::thread::hardware_concurrency());
+    printf("tinyobj::LoadObj: %8.2fs\n", refTime);
+    printf("loadObjParallel:  %8.2fs (%.1fx faster)\n", time, refTime / std::max(time, 1e-9));
+
+    bool same = (attrib.vertices == refAttrib.vertices) && (attrib.normals == refAttrib.normals)
+        && (attrib.texcoords == refAttrib.texcoords) && (shapes.size() == refShapes.size());
+    for (size_t i = 0; same && i < shapes.size(); ++i) {
+        same &= (shapes[i].name == refShapes[i].name) && (shapes[i].mesh.indices.size() == refShapes[i].mesh.indices.size())
+            && (shapes[i].mesh.material_ids == refShapes[i].mesh.material_ids);
+        for (size_t c = 0; same && c < shapes[i].mesh.indices.size(); ++c) {
+            const auto &a = shapes[i].mesh.indices[c], &b = refShapes[i].mesh.indices[c];
+            same &= (a.vertex_index == b.vertex_index) && (a.normal_index == b.normal_index) && (a.texcoord_index == b.texcoord_index);
+        }
+    }
+    printf("%s\n", same ? "both parsers produce the same data" : "FAIL: the parsers disagree");
+    return same ? 0 : 1;
+}
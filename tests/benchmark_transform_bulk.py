@@ -0,0 +1,50 @@
+#%%
+import sys, os, time, math, random
+os.add_dll_directory(os.path.join(os.getcwd(), '..', 'install'))
+sys.path.append(os.path.join(os.getcwd(), "..", "install"))
+
+import visii
+
+NUM_BODIES = 10000
+STEPS = 20
+
+#%%
+visii.initialize_headless()
+
+bodies = [visii.transform.create("body_{}".format(i)) for i in range(NUM_BODIES)]
+ids = [t.get_id() for t in bodies]
+
+# Stand in for the state a physics engine would report each step
+random.seed(0)
+def simulate(step):
+    positions = [random.uniform(-10, 10) for i in range(NUM_BODIES * 3)]
+    rotations = []
+    for i in range(NUM_BODIES):
+        angle = .01 * step + .001 * i
+        rotations.extend([0, 0, math.sin(angle / 2), math.cos(angle / 2)])
+    return positions, rotations
+
+#%%
+# One edit per body, as done by examples prior to the bulk setter
+elapsed = 0
+for s in range(STEPS):
+    positions, rotations = simulate(s)
+    start = time.time()
+    for i, t in enumerate(bodies):
+        t.set_position(visii.vec3(positions[i * 3 + 0], positions[i * 3 + 1], positions[i * 3 + 2]))
+        # visii quat expects w as the first argument
+        t.set_rotation(visii.quat(rotations[i * 4 + 3], rotations[i * 4 + 0], rotations[i * 4 + 1], rotations[i * 4 + 2]))
+    elapsed += time.time() - start
+print("Per transform setters: {:.2f} ms per step".format(elapsed / STEPS * 1000))
+
+# All bodies in a single call. Rotations are (x, y, z, w), as reported by most physics engines.
+elapsed = 0
+for s in range(STEPS):
+    positions, rotations = simulate(s)
+    start = time.time()
+    visii.transform.set_positions_rotations(ids, positions, rotations)
+    elapsed += time.time() - start
+print("transform.set_positions_rotations: {:.2f} ms per step".format(elapsed / STEPS * 1000))
+
+# %%
+visii.cleanup()
@@ -0,0 +1,81 @@
+#%%
+import sys, os, time, math
+os.add_dll_directory(os.path.join(os.getcwd(), '..', 'install'))
+sys.path.append(os.path.join(os.getcwd(), "..", "install"))
+
+import visii
+
+NUM_RIGS = 100
+SPINE_JOINTS = 20
+LIMBS = 4
+LIMB_JOINTS = 20
+FRAMES = 10
+
+#%%
+visii.initialize_headless()
+
+# Build articulated rigs, each a spine with several limbs hanging off of it
+joints = []
+end_effectors = []
+for r in range(NUM_RIGS):
+    root = visii.transform.create("rig_{}".format(r), position = visii.vec3(r, 0, 0))
+    joints.append(root)
+    spine = [root]
+    for j in range(SPINE_JOINTS - 1):
+        t = visii.transform.create("rig_{}_spine_{}".format(r, j), position = visii.vec3(0, .1, 0))
+        t.set_parent(spine[-1])
+        spine.append(t)
+    joints.extend(spine[1:])
+    for l in range(LIMBS):
+        parent = spine[-1 - l * 4]
+        for j in range(LIMB_JOINTS):
+            t = visii.transform.create("rig_{}_limb_{}_{}".format(r, l, j), position = visii.vec3(.1, 0, 0))
+            t.set_parent(parent)
+            joints.append(t)
+            parent = t
+        end_effectors.append(parent)
+print("{} joints in {} rigs".format(len(joints), NUM_RIGS))
+
+#%%
+# Edits only flag transforms as dirty. World matrices are recomputed together,
+# parent before child, the next time the renderer updates its components.
+start = time.time()
+for f in range(FRAMES):
+    for i, joint in enumerate(joints):
+        joint.set_rotation(visii.angleAxis(.01 * f + .001 * i, visii.vec3(0, 0, 1)))
+edit_time = (time.time() - start) / FRAMES
+print("Posing all joints: {:.2f} ms per frame".format(edit_time * 1000))
+
+# The batched pass runs when the renderer updates its components, which a one pixel render does. The cost of a
+# render with nothing to update is measured first, and taken off.
+def render_pixel():
+    visii.render(width = 1, height = 1, samples_per_pixel = 1)
+
+render_pixel()
+start = time.time()
+for f in range(FRAMES):
+    render_pixel()
+render_time = (time.time() - start) / FRAMES
+
+update_time = 0.
+for f in range(FRAMES):
+    for i, joint in enumerate(joints):
+        joint.set_rotation(visii.angleAxis(.02 * f + .001 * i, visii.vec3(0, 0, 1)))
+    start = time.time()
+    render_pixel()
+    update_time += time.time() - start
+update_time = max(update_time / FRAMES - render_time, 0.)
+print("Updating all world matrices: {:.2f} ms per frame ({:.3f} us per joint, after {:.2f} us per edit)".format(
+    update_time * 1000, update_time * 1e6 / len(joints), edit_time * 1e6 / len(joints)))
+
+# Querying before the next update still returns up to date world matrices
+start = time.time()
+for f in range(FRAMES):
+    joints[0].set_rotation(visii.angleAxis(.01 * f, visii.vec3(0, 0, 1)))
+    for effector in end_effectors:
+        effector.get_local_to_world_matrix()
+query_time = (time.time() - start) / FRAMES
+print("Querying {} end effectors: {:.2f} ms per frame".format(len(end_effectors), query_time * 1000))
+
+# %%
+visii.cleanup()
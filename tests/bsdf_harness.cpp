@@ -0,0 +1,407 @@
+/*
+ * Benchmarks and validates the Disney BSDF in devicecode/disney_bsdf.h on the CPU, through the same
+ * host stand-ins the CPU renderer compiles it with, so that none of this needs a GPU.
+ *
+ * - Throughput of evaluating, evaluating the pdf of, and sampling each lobe.
+ * - Energy conservation: the directional albedo of white metals stays below one. The Disney diffuse retro-reflection
+ *   and the sheen and clearcoat layers are added on top of the base lobes, so those albedos are reported, not checked.
+ * - Consistency of sampling and pdf: a chi-square test of sampled directions against the pdf integrated over bins.
+ * - The GGX_E and GGX_E_avg lookup tables against numerical integrals of single scattering GGX.
+ *
+ * Build with -DVISII_BUILD_BSDF_HARNESS=ON and run bsdf_harness. It exits with a non-zero status if any check fails.
+*/
+
+#define PBRLUT_IMPLEMENTATION
+#include <visii/utilities/ggx_lookup_tables.h>
+
+#include <devicecode/disney_bsdf.h>
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+static const float TWO_PI = 6.283185307179586f;
+
+/* Chi-square tests are run this many times, so each is held to a significance level of 1% / count */
+static const int NUM_CHI2_TESTS = 12;
+static const uint32_t CHI2_SAMPLES = 1000000;
+static const uint32_t CHI2_THETA_BINS = 20;
+static const uint32_t CHI2_PHI_BINS = 40;
+static const double CHI2_MIN_EXPECTED = 5.0;
+
+static const uint32_t ALBEDO_SAMPLES = 400000;
+static const uint32_t BENCHMARK_SAMPLES = 2000000;
+
+/* Largest error allowed between a lookup table entry, as the renderer reads it, and the integral it stands for */
+static const float LUT_TOLERANCE = .02f;
+
+struct NamedMaterial {
+    std::string name;
+    DisneyMaterial mat;
+
+    /* disney_pdf has energy kludges for metals and transmission, and glass has no single pdf matching its sampling */
+    bool pdfMatchesSampling;
+
+    /* Whether the directional albedo is expected to stay below one */
+    bool energyBounded;
+};
+
+static DisneyMaterial whiteMaterial()
+{
+    DisneyMaterial mat;
+    mat.base_color = make_float3(1.f);
+    mat.metallic = 0.f;
+    mat.specular = .5f;
+    mat.roughness = .5f;
+    mat.specular_tint = 0.f;
+    mat.anisotropy = 0.f;
+    mat.sheen = 0.f;
+    mat.sheen_tint = .5f;
+    mat.clearcoat = 0.f;
+    // The clearcoat lobe is sampled even when its weight is zero, and at full gloss its peak is too narrow for the chi-square bins
+    mat.clearcoat_gloss = .5f;
+    mat.ior = 1.45f;
+    mat.specular_transmission = 0.f;
+    mat.transmission_roughness = 0.f;
+    mat.flatness = 0.f;
+    return mat;
+}
+
+/* One material per lobe, each as isolated as the Disney parameters allow */
+static std::vector<NamedMaterial> lobeMaterials()
+{
+    std::vector<NamedMaterial> materials;
+    DisneyMaterial mat;
+
+    mat = whiteMaterial(); mat.specular = 0.f;
+    materials.push_back({"diffuse", mat, true, false});
+
+    mat = whiteMaterial(); mat.specular = 0.f; mat.flatness = 1.f;
+    materials.push_back({"subsurface", mat, true, false});
+
+    mat = whiteMaterial(); mat.specular = 0.f; mat.sheen = 1.f;
+    materials.push_back({"sheen", mat, true, false});
+
+    mat = whiteMaterial(); mat.metallic = 1.f; mat.roughness = .3f;
+    materials.push_back({"metal", mat, true, true});
+
+    mat = whiteMaterial(); mat.metallic = 1.f; mat.roughness = .5f; mat.anisotropy = .8f;
+    materials.push_back({"anisotropic metal", mat, true, true});
+
+    mat = whiteMaterial(); mat.clearcoat = 1.f; mat.clearcoat_gloss = .8f;
+    materials.push_back({"clearcoat", mat, true, false});
+
+    mat = whiteMaterial(); mat.roughness = .1f; mat.specular_transmission = 1.f; mat.transmission_roughness = .2f;
+    materials.push_back({"glass", mat, false, false});
+
+    return materials;
+}
+
+static float3 directionFromAngles(float cosTheta, float phi)
+{
+    float sinTheta = sqrt(max(0.f, 1.f - cosTheta * cosTheta));
+    return make_float3(sinTheta * cos(phi), sinTheta * sin(phi), cosTheta);
+}
+
+/* The shading frame used throughout: the normal along z, tangents along x and y */
+static const float3 N = {0.f, 0.f, 1.f};
+static const float3 V_X = {1.f, 0.f, 0.f};
+static const float3 V_Y = {0.f, 1.f, 0.f};
+
+static HostTexture lookupTexture(const float *texels, uint32_t width, uint32_t height)
+{
+    // Clamped like the texture objects the GPU renderer creates for the lookup tables
+    HostTexture texture;
+    texture.width = width;
+    texture.height = height;
+    texture.channels = 1;
+    texture.wrap = false;
+    texture.texels.assign(texels, texels + width * height);
+    return texture;
+}
+
+static double now()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/* Upper regularized incomplete gamma function Q(a, x), the p-value of a chi-square statistic 2x with 2a degrees of freedom */
+static double incompleteGammaQ(double a, double x)
+{
+    if (x <= 0.) return 1.;
+    double gln = std::lgamma(a);
+    if (x < a + 1.) {
+        double sum = 1. / a, term = sum;
+        for (int n = 1; n < 1000; ++n) {
+            term *= x / (a + n);
+            sum += term;
+            if (std::fabs(term) < std::fabs(sum) * 1e-12) break;
+        }
+        return 1. - sum * std::exp(-x + a * std::log(x) - gln);
+    }
+    // Continued fraction, by the modified Lentz method
+    double b = x + 1. - a, c = 1. / 1e-300, d = 1. / b, h = d;
+    for (int i = 1; i < 1000; ++i) {
+        double an = -i * (i - a);
+        b += 2.;
+        d = an * d + b; if (std::fabs(d) < 1e-300) d = 1e-300;
+        c = b + an / c; if (std::fabs(c) < 1e-300) c = 1e-300;
+        d = 1. / d;
+        double delta = d * c;
+        h *= delta;
+        if (std::fabs(delta - 1.) < 1e-12) break;
+    }
+    return std::exp(-x + a * std::log(x) - gln) * h;
+}
+
+/* Bins directions by cos(theta) and phi, which splits the sphere into cells of equal solid angle */
+static uint32_t directionBin(const float3 &w)
+{
+    float cosTheta = min(max(w.z, -1.f), 1.f);
+    float phi = atan2(w.y, w.x);
+    if (phi < 0.f) phi += TWO_PI;
+    uint32_t t = min(uint32_t((cosTheta + 1.f) * .5f * CHI2_THETA_BINS), CHI2_THETA_BINS - 1);
+    uint32_t p = min(uint32_t(phi / TWO_PI * CHI2_PHI_BINS), CHI2_PHI_BINS - 1);
+    return t * CHI2_PHI_BINS + p;
+}
+
+/*
+ * Samples directions with sample_disney_brdf, and compares how many land in each bin against the number
+ * disney_pdf predicts. Samples rejected for reflecting below the surface carry no density in disney_pdf either,
+ * so the expected counts are not renormalized. Returns the p-value.
+*/
+static double chiSquareTest(const DisneyMaterial &mat, const float3 &w_o, uint32_t seed, double &pdfIntegral)
+{
+    const HostTexture GGX_E = lookupTexture(&::GGX_E[0][0], GGX_E_size[0], GGX_E_size[1]);
+    const HostTexture GGX_E_AVG = lookupTexture(::GGX_E_avg, GGX_E_avg_size, 1);
+
+    const uint32_t numBins = CHI2_THETA_BINS * CHI2_PHI_BINS;
+    std::vector<double> observed(numBins, 0.), expected(numBins, 0.);
+
+    LCGRand rng;
+    rng.state = murmur_hash3_finalize(seed);
+    for (uint32_t i = 0; i < CHI2_SAMPLES; ++i) {
+        float3 w_i; float pdf; bool is_specular;
+        sample_disney_brdf(mat, N, w_o, V_X, V_Y, rng, w_i, pdf, is_specular, &GGX_E, &GGX_E_AVG);
+        if (pdf <= 0.f || all_zero(w_i)) continue;
+        observed[directionBin(normalize(w_i))] += 1.;
+    }
+
+    // Integrate the pdf over each bin on a finer grid, in the same cos(theta) and phi coordinates
+    const uint32_t SUB = 16;
+    double cellArea = (2. / CHI2_THETA_BINS) * (TWO_PI / CHI2_PHI_BINS) / double(SUB * SUB);
+    pdfIntegral = 0.;
+    for (uint32_t t = 0; t < CHI2_THETA_BINS; ++t) {
+        for (uint32_t p = 0; p < CHI2_PHI_BINS; ++p) {
+            double sum = 0.;
+            for (uint32_t st = 0; st < SUB; ++st) {
+                for (uint32_t sp = 0; sp < SUB; ++sp) {
+                    float cosTheta = -1.f + 2.f * (t + (st + .5f) / SUB) / CHI2_THETA_BINS;
+                    float phi = TWO_PI * (p + (sp + .5f) / SUB) / CHI2_PHI_BINS;
+                    sum += disney_pdf(mat, N, w_o, directionFromAngles(cosTheta, phi), V_X, V_Y);
+                }
+            }
+            expected[t * CHI2_PHI_BINS + p] = sum * cellArea * CHI2_SAMPLES;
+            pdfIntegral += sum * cellArea;
+        }
+    }
+
+    // Pool bins with too few expected samples, so that the statistic follows the chi-square distribution
+    double chi2 = 0., pooledObserved = 0., pooledExpected = 0.;
+    int dof = -1;
+    for (uint32_t b = 0; b < numBins; ++b) {
+        if (expected[b] < CHI2_MIN_EXPECTED) {
+            pooledObserved += observed[b];
+            pooledExpected += expected[b];
+            continue;
+        }
+        chi2 += (observed[b] - expected[b]) * (observed[b] - expected[b]) / expected[b];
+        dof++;
+    }
+    if (pooledExpected >= CHI2_MIN_EXPECTED) {
+        chi2 += (pooledObserved - pooledExpected) * (pooledObserved - pooledExpected) / pooledExpected;
+        dof++;
+    } else if (pooledObserved > 0.) {
+        // Samples where the pdf says there should be (almost) none
+        return 0.;
+    }
+    if (dof < 1) return 1.;
+    return incompleteGammaQ(dof * .5, chi2 * .5);
+}
+
+/* Estimates the fraction of light arriving from w_o that the material reflects or transmits, with its standard error */
+static float directionalAlbedo(const DisneyMaterial &mat, const float3 &w_o, uint32_t seed, float &standardError)
+{
+    const HostTexture GGX_E = lookupTexture(&::GGX_E[0][0], GGX_E_size[0], GGX_E_size[1]);
+    const HostTexture GGX_E_AVG = lookupTexture(::GGX_E_avg, GGX_E_avg_size, 1);
+
+    LCGRand rng;
+    rng.state = murmur_hash3_finalize(seed);
+    double sum = 0., sumSquares = 0.;
+    for (uint32_t i = 0; i < ALBEDO_SAMPLES; ++i) {
+        float3 w_i; float pdf; bool is_specular;
+        float3 f = sample_disney_brdf(mat, N, w_o, V_X, V_Y, rng, w_i, pdf, is_specular, &GGX_E, &GGX_E_AVG);
+        double weight = (pdf > 0.f) ? double(luminance(f)) / pdf : 0.;
+        if (!std::isfinite(weight)) weight = 0.;
+        sum += weight;
+        sumSquares += weight * weight;
+    }
+    double mean = sum / ALBEDO_SAMPLES;
+    double variance = max(float(sumSquares / ALBEDO_SAMPLES - mean * mean), 0.f);
+    standardError = float(std::sqrt(variance / ALBEDO_SAMPLES));
+    return float(mean);
+}
+
+/* Smith's Lambda for GGX, from which the height correlated masking-shadowing term is built */
+static double smithLambda(double cosTheta, double alpha)
+{
+    double tan2 = std::max(0., 1. - cosTheta * cosTheta) / (cosTheta * cosTheta);
+    return .5 * (-1. + std::sqrt(1. + alpha * alpha * tan2));
+}
+
+/*
+ * Directional albedo of single scattering GGX with a Fresnel term of one, for a view direction at cos(theta) = mu.
+ * Half vectors are placed on a stratified grid distributed as D(h) cos(theta_h), and the lookup tables were
+ * generated with the height correlated Smith term, so that is what is integrated here.
+*/
+static double ggxAlbedo(double mu, double alpha)
+{
+    const int GRID = 256;
+    mu = std::max(mu, 1e-4);
+    double sinO = std::sqrt(1. - mu * mu);
+    double lambdaO = smithLambda(mu, alpha);
+    double sum = 0.;
+    for (int i = 0; i < GRID; ++i) {
+        for (int j = 0; j < GRID; ++j) {
+            double u = (i + .5) / GRID, v = (j + .5) / GRID;
+            double phi = 2. * M_PI * u;
+            double cos2 = (1. - v) / (1. + (alpha * alpha - 1.) * v);
+            double cosH = std::sqrt(cos2), sinH = std::sqrt(std::max(0., 1. - cos2));
+            double hx = sinH * std::cos(phi), hz = cosH;
+            double oDotH = sinO * hx + mu * hz;
+            if (oDotH <= 0.) continue;
+            double iz = 2. * oDotH * hz - mu;
+            if (iz <= 0.) continue;
+            // f cos / pdf, with pdf(w_i) = D cos_h / (4 o.h) and f = D G / (4 mu_o mu_i)
+            sum += oDotH / (mu * cosH * (1. + lambdaO + smithLambda(iz, alpha)));
+        }
+    }
+    return sum / (GRID * GRID);
+}
+
+static bool checkLookupTables()
+{
+    const HostTexture GGX_E = lookupTexture(&::GGX_E[0][0], GGX_E_size[0], GGX_E_size[1]);
+    const HostTexture GGX_E_AVG = lookupTexture(::GGX_E_avg, GGX_E_avg_size, 1);
+
+    // Read at texel centres the way disney_multiscatter reads them: E at (cos(theta), roughness), E_avg at roughness
+    const uint32_t MU_STEPS = uint32_t(GGX_E_size[0]), ROUGHNESS_STEPS = uint32_t(GGX_E_size[1]);
+    double maxError = 0., sumError = 0., maxAvgError = 0.;
+    float worstMu = 0.f, worstRoughness = 0.f;
+    for (uint32_t r = 0; r < ROUGHNESS_STEPS; ++r) {
+        float roughness = (r + .5f) / ROUGHNESS_STEPS;
+        double alpha = std::max(double(roughness) * roughness, double(MIN_ALPHA));
+        double average = 0.;
+        for (uint32_t m = 0; m < MU_STEPS; ++m) {
+            float mu = (m + .5f) / MU_STEPS;
+            double reference = ggxAlbedo(mu, alpha);
+            average += 2. * reference * mu / MU_STEPS;
+            double error = std::fabs(tex2D<float>(&GGX_E, mu, roughness) - reference);
+            sumError += error;
+            if (error > maxError) { maxError = error; worstMu = mu; worstRoughness = roughness; }
+        }
+        maxAvgError = std::max(maxAvgError, std::fabs(tex2D<float>(&GGX_E_AVG, roughness, .5f) - average));
+    }
+    double meanError = sumError / (MU_STEPS * ROUGHNESS_STEPS);
+    bool pass = (meanError < LUT_TOLERANCE) && (maxAvgError < LUT_TOLERANCE);
+    printf("GGX_E: mean error %.4f, max error %.4f at cos(theta) %.3f roughness %.3f\n", meanError, maxError, worstMu, worstRoughness);
+    printf("GGX_E_avg: max error %.4f\n", maxAvgError);
+    printf("lookup tables: %s\n", pass ? "pass" : "FAIL");
+    return pass;
+}
+
+static void benchmark(const std::vector<NamedMaterial> &materials)
+{
+    const HostTexture GGX_E = lookupTexture(&::GGX_E[0][0], GGX_E_size[0], GGX_E_size[1]);
+    const HostTexture GGX_E_AVG = lookupTexture(::GGX_E_avg, GGX_E_avg_size, 1);
+
+    // Directions are generated up front, so only the BSDF is timed
+    LCGRand rng;
+    rng.state = 1;
+    std::vector<float3> outgoing(BENCHMARK_SAMPLES), incoming(BENCHMARK_SAMPLES);
+    for (uint32_t i = 0; i < BENCHMARK_SAMPLES; ++i) {
+        outgoing[i] = directionFromAngles(lcg_randomf(rng), TWO_PI * lcg_randomf(rng));
+        incoming[i] = directionFromAngles(2.f * lcg_randomf(rng) - 1.f, TWO_PI * lcg_randomf(rng));
+    }
+
+    printf("%-20s %12s %12s %12s\n", "lobe", "eval M/s", "pdf M/s", "sample M/s");
+    for (auto &material : materials) {
+        float sink = 0.f;
+        double t0 = now();
+        for (uint32_t i = 0; i < BENCHMARK_SAMPLES; ++i) {
+            sink += disney_brdf(material.mat, N, outgoing[i], incoming[i], V_X, V_Y, &GGX_E, &GGX_E_AVG).x;
+        }
+        double t1 = now();
+        for (uint32_t i = 0; i < BENCHMARK_SAMPLES; ++i) {
+            sink += disney_pdf(material.mat, N, outgoing[i], incoming[i], V_X, V_Y);
+        }
+        double t2 = now();
+        for (uint32_t i = 0; i < BENCHMARK_SAMPLES; ++i) {
+            float3 w_i; float pdf; bool is_specular;
+            sink += sample_disney_brdf(material.mat, N, outgoing[i], V_X, V_Y, rng, w_i, pdf, is_specular, &GGX_E, &GGX_E_AVG).x + pdf;
+        }
+        double t3 = now();
+        printf("%-20s %12.2f %12.2f %12.2f%s\n", material.name.c_str(),
+            BENCHMARK_SAMPLES / (t1 - t0) / 1e6, BENCHMARK_SAMPLES / (t2 - t1) / 1e6, BENCHMARK_SAMPLES / (t3 - t2) / 1e6,
+            std::isfinite(sink) ? "" : " (non finite results)");
+    }
+}
+
+int main(int argc, char **argv)
+{
+    std::vector<NamedMaterial> materials = lobeMaterials();
+    const float viewCosines[] = {.9f, .5f, .2f};
+    bool pass = true;
+
+    printf("== throughput ==\n");
+    benchmark(materials);
+
+    printf("\n== energy conservation ==\n");
+    for (auto &material : materials) {
+        for (float mu : viewCosines) {
+            float standardError;
+            float albedo = directionalAlbedo(material.mat, directionFromAngles(mu, .3f), 17, standardError);
+            bool checked = material.energyBounded;
+            bool ok = !checked || (albedo <= 1.f + 4.f * standardError + .01f);
+            pass &= ok;
+            printf("%-20s cos(theta_o) %.1f: albedo %.4f +- %.4f %s\n", material.name.c_str(), mu, albedo, standardError,
+                !checked ? "" : ok ? "pass" : "FAIL");
+        }
+    }
+
+    printf("\n== sampling against pdf ==\n");
+    double significance = .01 / NUM_CHI2_TESTS;
+    int numTests = 0;
+    for (auto &material : materials) {
+        if (!material.pdfMatchesSampling) continue;
+        for (float mu : {.8f, .3f}) {
+            double pdfIntegral;
+            double pValue = chiSquareTest(material.mat, directionFromAngles(mu, .3f), 1234 + numTests, pdfIntegral);
+            bool ok = pValue >= significance;
+            pass &= ok;
+            numTests++;
+            printf("%-20s cos(theta_o) %.1f: p-value %.3g, pdf integral %.4f %s\n", material.name.c_str(), mu, pValue, pdfIntegral, ok ? "pass" : "FAIL");
+        }
+    }
+    if (numTests > NUM_CHI2_TESTS) {
+        printf("NUM_CHI2_TESTS is lower than the %d tests run\n", numTests);
+        pass = false;
+    }
+
+    printf("\n== lookup tables ==\n");
+    pass &= checkLookupTables();
+
+    printf("\n%s\n", pass ? "all checks passed" : "some checks FAILED");
+    return pass ? 0 : 1;
+}
@@ -0,0 +1,236 @@
+/*
+ * Unit tests for the Walker alias tables built in hostcode/alias_table.h, from weights, triangle areas and
+ * dome light textures, and sampled by sampleAliasTable and sampleEnvironment in devicecode/lights.h. The probability each table gives an item is worked out exactly from its thresholds
+ * and aliases, then checked against the weights, and against how often the item is actually sampled.
+ *
+ * Build with -DVISII_BUILD_CPU_TESTS=ON and run through ctest. Exits with a non-zero status if any check fails.
+*/
+
+#include <hostcode/alias_table.h>
+
+// Included for the host in the same order as in the CPU renderer, which lights.h relies on
+#include <visii/light_struct.h>
+#include <devicecode/disney_bsdf.h>
+#include <devicecode/lights.h>
+
+#include <cstdio>
+#include <limits>
+#include <string>
+#include <vector>
+
+static bool pass = true;
+
+static void check(bool ok, const std::string &what)
+{
+    if (!ok) printf("FAIL: %s\n", what.c_str());
+    pass &= ok;
+}
+
+/* The probability of picking each item, summed over the slots which can give it */
+static std::vector<double> tableProbabilities(const std::vector<AliasTableEntry> &table)
+{
+    std::vector<double> probabilities(table.size(), 0.0);
+    for (size_t slot = 0; slot < table.size(); ++slot) {
+        double threshold = std::min(std::max(double(table[slot].threshold), 0.0), 1.0);
+        probabilities[slot] += threshold / table.size();
+        probabilities[table[slot].alias] += (1.0 - threshold) / table.size();
+    }
+    return probabilities;
+}
+
+static void checkTable(const std::string &name, const std::vector<float> &weights, const std::vector<double> &expected)
+{
+    std::vector<AliasTableEntry> table = buildAliasTable(weights);
+    check(table.size() == weights.size(), name + ": one entry per weight");
+    if (table.size() != weights.size()) return;
+
+    bool aliasesInRange = true;
+    for (auto &entry : table) aliasesInRange &= (entry.alias < table.size());
+    check(aliasesInRange, name + ": aliases are in range");
+    if (!aliasesInRange) return;
+
+    std::vector<double> probabilities = tableProbabilities(table);
+    double maxTableError = 0.0, maxPdfError = 0.0;
+    for (size_t i = 0; i < table.size(); ++i) {
+        maxTableError = std::max(maxTableError, std::fabs(probabilities[i] - expected[i]));
+        maxPdfError = std::max(maxPdfError, std::fabs(double(table[i].pdf) - expected[i]));
+    }
+    check(maxTableError < 1e-6, name + ": table probabilities match the weights, off by " + std::to_string(maxTableError));
+    check(maxPdfError < 1e-6, name + ": stored pdfs match the weights, off by " + std::to_string(maxPdfError));
+
+    // Sampled frequencies, within five standard deviations of the expected counts
+    const uint32_t SAMPLES = 1000000;
+    std::vector<uint32_t> counts(table.size(), 0);
+    LCGRand rng;
+    rng.state = 7;
+    bool pdfsReturned = true;
+    for (uint32_t s = 0; s < SAMPLES; ++s) {
+        float pdf;
+        uint32_t item = sampleAliasTable(table.data(), uint32_t(table.size()), lcg_randomf(rng), pdf);
+        if (item >= table.size()) { pdfsReturned = false; break; }
+        pdfsReturned &= (pdf == table[item].pdf) && (pdf > 0.f);
+        counts[item]++;
+    }
+    check(pdfsReturned, name + ": samples are in range, with the pdf of the sampled item");
+    bool frequenciesMatch = true;
+    for (size_t i = 0; i < table.size(); ++i) {
+        double mean = expected[i] * SAMPLES;
+        double sigma = std::sqrt(mean * (1.0 - expected[i]));
+        frequenciesMatch &= std::fabs(counts[i] - mean) <= 5.0 * sigma + 1.0;
+    }
+    check(frequenciesMatch, name + ": sampled frequencies match the weights");
+    printf("%s: %zu items, max table error %.2g\n", name.c_str(), table.size(), maxTableError);
+}
+
+static std::vector<double> normalized(const std::vector<float> &weights)
+{
+    double total = 0.0;
+    for (float w : weights) total += w;
+    std::vector<double> result;
+    for (float w : weights) result.push_back(w / total);
+    return result;
+}
+
+/* Triangles with very uneven sizes, enough of them that their areas are computed in parallel */
+static void checkTriangleAreas()
+{
+    const uint32_t NUM_TRIANGLES = 20000;
+    std::vector<glm::vec4> vertices;
+    std::vector<uint32_t> indices;
+    std::vector<float> areas;
+    LCGRand rng;
+    rng.state = 11;
+    for (uint32_t t = 0; t < NUM_TRIANGLES; ++t) {
+        float width = std::pow(lcg_randomf(rng), 4.f) * 10.f + .001f, height = lcg_randomf(rng);
+        uint32_t base = uint32_t(vertices.size());
+        vertices.push_back(glm::vec4(0.f, 0.f, float(t % 7), 1.f));
+        vertices.push_back(glm::vec4(width, 0.f, float(t % 7) + 1.f, 1.f));
+        vertices.push_back(glm::vec4(0.f, height, float(t % 7) + 1.f, 1.f));
+        indices.insert(indices.end(), {base, base + 1, base + 2});
+        areas.push_back(.5f * std::sqrt(height * height + width * width + width * width * height * height));
+    }
+
+    // A degenerate triangle, and one with an index past the end, can't be picked
+    indices.insert(indices.end(), {0, 0, 1});
+    areas.push_back(0.f);
+    indices.insert(indices.end(), {0, 1, uint32_t(vertices.size())});
+    areas.push_back(0.f);
+
+    std::vector<AliasTableEntry> table = buildTriangleAreaTable(vertices, indices);
+    check(table.size() == areas.size(), "triangle areas: one entry per triangle");
+    if (table.size() != areas.size()) return;
+    std::vector<double> expected = normalized(areas);
+    std::vector<double> probabilities = tableProbabilities(table);
+    double maxError = 0.0;
+    for (size_t t = 0; t < table.size(); ++t) {
+        maxError = std::max(maxError, std::fabs(double(table[t].pdf) - expected[t]));
+        maxError = std::max(maxError, std::fabs(probabilities[t] - expected[t]));
+    }
+    check(maxError * table.size() < 1e-4, "triangle areas: triangles are picked in proportion to area, off by " + std::to_string(maxError));
+    check((table[NUM_TRIANGLES].pdf == 0.f) && (table[NUM_TRIANGLES + 1].pdf == 0.f), "triangle areas: degenerate and invalid triangles are never picked");
+    printf("triangle areas: %zu triangles, max error %.2g\n", table.size(), maxError);
+}
+
+/* A dim dome light with a small bright sun, a black row, and a broken texel */
+static void checkEnvironment()
+{
+    const uint32_t WIDTH = 64, HEIGHT = 32;
+    std::vector<glm::vec4> texels(WIDTH * HEIGHT, glm::vec4(.1f, .2f, .3f, 1.f));
+    for (uint32_t row = 20; row < 22; ++row) {
+        for (uint32_t column = 40; column < 42; ++column) texels[row * WIDTH + column] = glm::vec4(1000.f, 900.f, 800.f, 1.f);
+    }
+    for (uint32_t column = 0; column < WIDTH; ++column) texels[5 * WIDTH + column] = glm::vec4(0.f);
+    texels[7 * WIDTH + 3] = glm::vec4(std::numeric_limits<float>::quiet_NaN());
+
+    std::vector<AliasTableEntry> table = buildEnvironmentSamplingTable(texels, WIDTH, HEIGHT);
+    check(table.size() == HEIGHT + WIDTH * HEIGHT, "environment: one row table, then one table per row");
+    if (table.size() != HEIGHT + WIDTH * HEIGHT) return;
+    check(buildEnvironmentSamplingTable(std::vector<glm::vec4>(WIDTH * HEIGHT, glm::vec4(0.f)), WIDTH, HEIGHT).empty(),
+        "environment: black textures have no table");
+
+    // Texel probabilities against luminance times sin(theta)
+    std::vector<float> weights;
+    for (uint32_t row = 0; row < HEIGHT; ++row) {
+        for (uint32_t column = 0; column < WIDTH; ++column) {
+            const glm::vec4 &t = texels[row * WIDTH + column];
+            float weight = (.2126f * t.r + .7152f * t.g + .0722f * t.b) * std::sin(3.14159265f * (row + .5f) / HEIGHT);
+            weights.push_back(std::isfinite(weight) ? weight : 0.f);
+        }
+    }
+    std::vector<double> expected = normalized(weights);
+    double maxError = 0.0;
+    for (uint32_t row = 0; row < HEIGHT; ++row) {
+        for (uint32_t column = 0; column < WIDTH; ++column) {
+            double probability = double(table[row].pdf) * table[HEIGHT + row * WIDTH + column].pdf;
+            maxError = std::max(maxError, std::fabs(probability - expected[row * WIDTH + column]));
+        }
+    }
+    check(maxError < 1e-6, "environment: texels are picked in proportion to luminance and solid angle, off by " + std::to_string(maxError));
+
+    // The density integrates to one over the sphere, where d(omega) = 2 pi^2 sin(theta) du dv
+    const uint32_t SUBDIVISIONS = 4;
+    const ivec2 size = ivec2(WIDTH, HEIGHT);
+    double integral = 0.0;
+    for (uint32_t y = 0; y < HEIGHT * SUBDIVISIONS; ++y) {
+        for (uint32_t x = 0; x < WIDTH * SUBDIVISIONS; ++x) {
+            vec2 uv = vec2((x + .5f) / (WIDTH * SUBDIVISIONS), (y + .5f) / (HEIGHT * SUBDIVISIONS));
+            double solidAngle = 2. * M_PI * M_PI * std::sin(M_PI * uv.y) / (WIDTH * HEIGHT * SUBDIVISIONS * SUBDIVISIONS);
+            integral += environmentPdf(table.data(), size, uv) * solidAngle;
+        }
+    }
+    check(std::fabs(integral - 1.0) < 1e-3, "environment: the density integrates to " + std::to_string(integral));
+
+    // Sampled directions map back to where they were sampled, with the density environmentPdf gives them
+    LCGRand rng;
+    rng.state = 5;
+    double maxPdfError = 0.0, maxUVError = 0.0;
+    uint32_t sunSamples = 0;
+    const uint32_t SAMPLES = 200000;
+    for (uint32_t s = 0; s < SAMPLES; ++s) {
+        float pdf;
+        vec2 uv = sampleEnvironment(table.data(), size, lcg_randomf(rng), lcg_randomf(rng), lcg_randomf(rng), lcg_randomf(rng), pdf);
+        vec2 roundTrip = environmentDirectionToUV(environmentUVToDirection(uv));
+        float du = std::fabs(roundTrip.x - uv.x);
+        du = std::min(du, 1.f - du);
+        if (std::sin(M_PI * uv.y) > 1e-3) maxUVError = std::max(maxUVError, double(std::max(du, std::fabs(roundTrip.y - uv.y))));
+        maxPdfError = std::max(maxPdfError, std::fabs(double(pdf) - environmentPdf(table.data(), size, uv)) / std::max(double(pdf), 1e-6));
+        if ((uv.x * WIDTH >= 40.f) && (uv.x * WIDTH < 42.f) && (uv.y * HEIGHT >= 20.f) && (uv.y * HEIGHT < 22.f)) sunSamples++;
+    }
+    double sunProbability = 0.0;
+    for (uint32_t row = 20; row < 22; ++row) for (uint32_t column = 40; column < 42; ++column) sunProbability += expected[row * WIDTH + column];
+    double sunSigma = std::sqrt(SAMPLES * sunProbability * (1.0 - sunProbability));
+    check(maxUVError < 1e-4, "environment: directions map back to the texture coordinates they came from, off by " + std::to_string(maxUVError));
+    check(maxPdfError < 1e-3, "environment: sampled densities match environmentPdf, off by a factor of " + std::to_string(maxPdfError));
+    check(std::fabs(sunSamples - SAMPLES * sunProbability) <= 5.0 * sunSigma, "environment: the sun is sampled as often as its share of the light");
+    printf("environment: %ux%u texels, density integral %.5f, sun sampled %.3f of the time\n", WIDTH, HEIGHT, integral, double(sunSamples) / SAMPLES);
+}
+
+int main(int argc, char **argv)
+{
+    check(buildAliasTable({}).empty(), "no weights give an empty table");
+
+    checkTable("single", {3.f}, {1.0});
+    checkTable("uniform", std::vector<float>(100, 2.f), std::vector<double>(100, .01));
+
+    // One bright key light among many dim fill lights
+    std::vector<float> keyAndFill(50, .01f);
+    keyAndFill[17] = 1000.f;
+    checkTable("key and fill", keyAndFill, normalized(keyAndFill));
+
+    std::vector<float> skewed;
+    LCGRand rng;
+    rng.state = 3;
+    for (int i = 0; i < 1000; ++i) skewed.push_back(std::pow(lcg_randomf(rng), 8.f) * 100.f + 1e-3f);
+    checkTable("skewed", skewed, normalized(skewed));
+
+    // Items which can't be picked, and all of them unpickable
+    const float NaN = std::numeric_limits<float>::quiet_NaN(), INF = std::numeric_limits<float>::infinity();
+    checkTable("zero weights", {0.f, 1.f, -2.f, NaN, 3.f, INF, 0.f}, {0.0, .25, 0.0, 0.0, .75, 0.0, 0.0});
+    checkTable("all zero", std::vector<float>(8, 0.f), std::vector<double>(8, .125));
+
+    checkTriangleAreas();
+    checkEnvironment();
+
+    printf("\n%s\n", pass ? "all checks passed" : "some checks FAILED");
+    return pass ? 0 : 1;
+}
@@ -0,0 +1,49 @@
+#%%
+import sys, os
+os.add_dll_directory(os.path.join(os.getcwd(), '..', 'install'))
+sys.path.append(os.path.join(os.getcwd(), "..", "install"))
+
+import visii
+
+# Well past the 100 light and 100 camera tables the renderer used to be compiled with
+NUM_LIGHTS = 1500
+NUM_CAMERAS = 300
+
+#%%
+visii.initialize_headless()
+
+cameras = [visii.camera.create_perspective_from_fov(name = "camera_{}".format(i), field_of_view = 0.785398, aspect = 1., near = .1)
+    for i in range(NUM_CAMERAS)]
+camera_entity = visii.entity.create(
+    name = "camera",
+    transform = visii.transform.create("camera_transform", position = visii.vec3(0., 0., 20.)),
+    camera = cameras[-1])
+visii.set_camera_entity(camera_entity)
+
+# A grid of small emissive spheres, all sharing one mesh
+sphere = visii.mesh.create_sphere("sphere", radius = .05)
+for i in range(NUM_LIGHTS):
+    visii.entity.create(
+        name = "light_{}".format(i),
+        transform = visii.transform.create("light_transform_{}".format(i),
+            position = visii.vec3(i % 40 - 20., i // 40 - 20., 0.)),
+        mesh = sphere,
+        light = visii.light.create_from_rgb("light_{}".format(i), visii.vec3(1., 1., 1.), 1.))
+
+assert visii.light.get_count() >= NUM_LIGHTS
+assert visii.camera.get_count() >= NUM_CAMERAS
+assert visii.light.get("light_{}".format(NUM_LIGHTS - 1)).get_id() == NUM_LIGHTS - 1
+
+pixels = visii.render(width = 16, height = 16, samples_per_pixel = 4)
+assert any(p > 0. for p in pixels), "expected the lights to be visible"
+
+# Removed slots are reused before the tables grow again
+count = visii.light.get_count()
+visii.light.remove("light_7")
+assert visii.light.create("light_again").get_id() == 7
+assert visii.light.get_count() == count
+
+print("Component tables grew past their old limits")
+
+# %%
+visii.cleanup()
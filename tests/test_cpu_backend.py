@@ -0,0 +1,66 @@
+#%%
+import sys, os
+os.add_dll_directory(os.path.join(os.getcwd(), '..', 'install'))
+sys.path.append(os.path.join(os.getcwd(), "..", "install"))
+
+import math
+import visii
+
+WIDTH = 64
+HEIGHT = 64
+
+#%%
+# Path traces on the CPU, so this runs on machines without an OptiX capable GPU, and with libraries built
+# without CUDA through -DVISII_BUILD_OPTIX=OFF
+visii.initialize_headless(backend = "cpu")
+
+camera_entity = visii.entity.create(
+    name = "camera",
+    transform = visii.transform.create("camera_transform", position = visii.vec3(0., 0., 5.)),
+    camera = visii.camera.create_perspective_from_fov(name = "camera", field_of_view = 0.785398, aspect = 1., near = .1))
+visii.set_camera_entity(camera_entity)
+visii.set_dome_light_intensity(0.)
+
+floor = visii.entity.create(
+    name = "floor",
+    mesh = visii.mesh.create_plane("floor"),
+    transform = visii.transform.create("floor"),
+    material = visii.material.create("floor"))
+floor.get_material().set_roughness(1.0)
+
+light = visii.entity.create(
+    name = "light",
+    mesh = visii.mesh.create_sphere("light", radius = .25),
+    transform = visii.transform.create("light", position = visii.vec3(0., 0., 1.5)),
+    light = visii.light.create("light"))
+light.get_light().set_intensity(10.)
+
+pixels = visii.render(width = WIDTH, height = HEIGHT, samples_per_pixel = 16)
+assert len(pixels) == WIDTH * HEIGHT * 4
+assert all(math.isfinite(p) for p in pixels)
+center = ((HEIGHT // 2) * WIDTH + WIDTH // 2) * 4
+assert pixels[center] > 1., "expected the light to be visible in the middle of the image"
+assert any(0. < p < 1. for p in pixels), "expected the floor to be lit by the light"
+
+# Metadata of the surfaces seen by the camera comes from camera rays alone
+depth = visii.render_data(width = WIDTH, height = HEIGHT, start_frame = 0, frame_count = 1, bounce = 0, options = "depth")
+assert abs(depth[center] - 3.25) < .05
+
+visii.render_to_png(width = WIDTH, height = HEIGHT, samples_per_pixel = 4, image_path = "cpu_backend.png")
+assert os.path.exists("cpu_backend.png")
+
+# Batching several samples per pixel into each launch traces the same samples as one launch per sample, so with a
+# budget of zero, and one large enough for all 16 samples to share launches, the images match
+visii.set_launch_time_budget(0.)
+unbatched = visii.render(width = WIDTH, height = HEIGHT, samples_per_pixel = 16)
+visii.set_launch_time_budget(100.)
+batched = visii.render(width = WIDTH, height = HEIGHT, samples_per_pixel = 16)
+visii.set_launch_time_budget(.1)
+assert all(abs(a - b) <= 1e-5 * max(1., abs(a)) for a, b in zip(unbatched, batched)), \
+    "expected the same image with one sample per launch and with several"
+
+print("CPU backend rendered the scene")
+
+# %%
+os.remove("cpu_backend.png")
+visii.cleanup()
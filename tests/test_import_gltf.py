@@ -0,0 +1,108 @@
+#%%
+import sys, os
+os.add_dll_directory(os.path.join(os.getcwd(), '..', 'install'))
+sys.path.append(os.path.join(os.getcwd(), "..", "install"))
+
+import base64, json, struct
+import visii
+
+#%%
+visii.initialize_headless()
+
+# %%
+# A unit quad, written as an embedded glTF with a parent node, a child node holding the quad, and an emissive material
+positions = [0., 0., 0.,  1., 0., 0.,  1., 1., 0.,  0., 1., 0.]
+indices = [0, 1, 2, 0, 2, 3]
+data = struct.pack("<12f", *positions) + struct.pack("<6H", *indices)
+
+QUAD_ACCESSORS = [
+    {"bufferView": 0, "componentType": 5126, "count": 4, "type": "VEC3", "min": [0, 0, 0], "max": [1, 1, 0]},
+    {"bufferView": 1, "componentType": 5123, "count": 6, "type": "SCALAR"},
+]
+QUAD_VIEWS = [
+    {"buffer": 0, "byteOffset": 0, "byteLength": 48},
+    {"buffer": 0, "byteOffset": 48, "byteLength": 12},
+]
+
+def write_gltf(path, nodes, scene_nodes, accessors = QUAD_ACCESSORS, views = QUAD_VIEWS):
+    gltf = {
+        "asset": {"version": "2.0"},
+        "buffers": [{"byteLength": len(data), "uri": "data:application/octet-stream;base64," + base64.b64encode(data).decode()}],
+        "bufferViews": views,
+        "accessors": accessors,
+        "materials": [
+            {"name": "glow", "emissiveFactor": [1., .5, .25], "extensions": {"KHR_materials_emissive_strength": {"emissiveStrength": 4.}}},
+            {"name": "plain"},
+        ],
+        "meshes": [
+            {"name": "glowing_quad", "primitives": [{"attributes": {"POSITION": 0}, "indices": 1, "material": 0}]},
+            {"name": "plain_quad", "primitives": [{"attributes": {"POSITION": 0}, "indices": 1, "material": 1}]},
+        ],
+        "nodes": nodes,
+        "scenes": [{"nodes": scene_nodes}],
+        "scene": 0,
+    }
+    with open(path, "w") as f:
+        json.dump(gltf, f)
+
+write_gltf("test_import.gltf", [
+    {"name": "parent", "translation": [0., 0., 2.], "children": [1, 2]},
+    {"name": "glowing", "mesh": 0, "translation": [1., 0., 0.]},
+    {"name": "plain", "mesh": 1},
+], [0])
+
+entities = visii.import_gltf("gltf_", "test_import.gltf")
+assert len(entities) == 2, "expected one entity per primitive"
+glowing = [e for e in entities if e.get_light() is not None]
+assert len(glowing) == 1, "expected the emissive material to become a light"
+light = glowing[0].get_light()
+assert abs(light.get_intensity() - 4.) < 1e-5, "expected the light intensity to carry the peak factor and strength"
+color = light.get_color()
+assert abs(color.x - 1.) < 1e-5 and abs(color.y - .5) < 1e-5 and abs(color.z - .25) < 1e-5
+
+# The child node's transform is placed under its parent's
+translation = glowing[0].get_transform().get_world_translation()
+assert abs(translation.x - 1.) < 1e-5 and abs(translation.z - 2.) < 1e-5
+assert len(glowing[0].get_mesh().get_triangle_indices()) == 6
+
+# %%
+# Malformed hierarchies are refused before any component is created
+malformed = {
+    "test_missing_node.gltf": ([{"name": "parent", "children": [7]}], [0]),
+    "test_cycle.gltf": ([{"name": "a", "children": [1]}, {"name": "b", "children": [0]}], [0]),
+    "test_shared_child.gltf": ([{"name": "a", "children": [2]}, {"name": "b", "children": [2]}, {"name": "c", "mesh": 1}], [0, 1]),
+    "test_missing_root.gltf": ([{"name": "a", "mesh": 1}], [-1]),
+}
+for path, (nodes, scene_nodes) in malformed.items():
+    write_gltf(path, nodes, scene_nodes)
+    try:
+        visii.import_gltf("bad_", path)
+        assert False, "expected " + path + " to be refused"
+    except RuntimeError:
+        pass
+    assert visii.transform.get("bad_root") is None
+    assert visii.material.get("bad_plain") is None
+
+# Accessors reaching past the end of their buffer view, by a whole element or by part of the last one, and views
+# reaching past the end of their buffer, are refused rather than read
+quad = [{"name": "quad", "mesh": 1}]
+truncated = {
+    "test_long_positions.gltf": ([dict(QUAD_ACCESSORS[0], count = 5), QUAD_ACCESSORS[1]], QUAD_VIEWS),
+    "test_short_view.gltf": (QUAD_ACCESSORS, [dict(QUAD_VIEWS[0], byteLength = 44), QUAD_VIEWS[1]]),
+    "test_offset_indices.gltf": ([QUAD_ACCESSORS[0], dict(QUAD_ACCESSORS[1], byteOffset = 2)], QUAD_VIEWS),
+    "test_long_view.gltf": (QUAD_ACCESSORS, [QUAD_VIEWS[0], dict(QUAD_VIEWS[1], byteLength = 24)]),
+}
+for path, (accessors, views) in truncated.items():
+    write_gltf(path, quad, [0], accessors, views)
+    try:
+        visii.import_gltf("truncated_", path)
+        assert False, "expected " + path + " to be refused"
+    except RuntimeError:
+        pass
+
+print("glTF import passed")
+
+# %%
+for path in ["test_import.gltf"] + list(malformed) + list(truncated):
+    os.remove(path)
+visii.cleanup()
@@ -0,0 +1,137 @@
+/*
+ * Unit tests for LaunchScheduler in hostcode/launch_scheduler.h, which picks how many samples per pixel render()
+ * traces in each launch. Batches are checked to start at one sample, to grow by at most twice from one launch to
+ * the next, to fit the budget once the cost of a sample is known, and to never pass the remaining samples or the
+ * cap. A budget of zero must trace one sample per launch. Simulated renders with a fixed cost per sample then check
+ * that every sample is traced, and that launches stay within the budget.
+ *
+ * Build with -DVISII_BUILD_CPU_TESTS=ON and run through ctest. Exits with a non-zero status if any check fails.
+*/
+
+#include <hostcode/launch_scheduler.h>
+
+#include <cstdio>
+#include <limits>
+#include <string>
+#include <vector>
+
+static bool pass = true;
+
+static void check(bool ok, const std::string &what)
+{
+    if (!ok) printf("FAIL: %s\n", what.c_str());
+    pass &= ok;
+}
+
+/* The batch sizes of a render of samplesPerPixel samples, where each sample takes secondsPerSample */
+static std::vector<uint32_t> simulate(double budget, uint32_t samplesPerPixel, double secondsPerSample)
+{
+    LaunchScheduler scheduler(budget, MAX_SAMPLES_PER_LAUNCH);
+    std::vector<uint32_t> batches;
+    uint32_t traced = 0;
+    while (traced < samplesPerPixel) {
+        uint32_t samples = scheduler.next(samplesPerPixel - traced);
+        if (samples == 0) break;
+        scheduler.record(samples, samples * secondsPerSample);
+        batches.push_back(samples);
+        traced += samples;
+    }
+    return batches;
+}
+
+static uint32_t total(const std::vector<uint32_t> &batches)
+{
+    uint32_t sum = 0;
+    for (uint32_t samples : batches) sum += samples;
+    return sum;
+}
+
+int main(int argc, char **argv)
+{
+    // Nothing left to trace
+    {
+        LaunchScheduler scheduler(.1, MAX_SAMPLES_PER_LAUNCH);
+        check(scheduler.next(0) == 0, "no samples are traced when none remain");
+        scheduler.record(1, .01);
+        check(scheduler.next(0) == 0, "no samples are traced when none remain, once measured");
+    }
+
+    // The first launch traces one sample to measure its cost, then batches at most double until they fill the budget.
+    // Times are powers of two, so that the running average is exact.
+    {
+        LaunchScheduler scheduler(1., MAX_SAMPLES_PER_LAUNCH);
+        uint32_t samples = scheduler.next(1000);
+        check(samples == 1, "the first launch traces one sample");
+        for (uint32_t expect : {2u, 4u, 8u, 16u, 16u}) {
+            scheduler.record(samples, .0625 * samples);
+            samples = scheduler.next(1000);
+            check(samples == expect, "at 1/16 s a sample, batches grow to " + std::to_string(expect) + ", got " + std::to_string(samples));
+        }
+    }
+
+    // A budget of zero always traces one sample per launch
+    {
+        LaunchScheduler scheduler(0., MAX_SAMPLES_PER_LAUNCH);
+        bool one = true;
+        for (int i = 0; i < 10; ++i) {
+            uint32_t samples = scheduler.next(1000);
+            one &= (samples == 1);
+            scheduler.record(samples, 1e-6);
+        }
+        check(one, "a budget of zero traces one sample per launch");
+    }
+
+    // Batches never pass the remaining samples or the cap
+    {
+        LaunchScheduler scheduler(1000., 16);
+        uint32_t samples = scheduler.next(1000);
+        for (int i = 0; i < 10; ++i) {
+            scheduler.record(samples, 1e-6 * samples);
+            samples = scheduler.next(1000);
+        }
+        check(samples == 16, "batches stop at the cap, got " + std::to_string(samples));
+        check(scheduler.next(5) == 5, "batches stop at the remaining samples");
+        check(LaunchScheduler(1000., 0).next(1000) == 1, "a cap of zero still traces one sample");
+    }
+
+    // Free samples still only double, and a slow launch shrinks the next one through the running average
+    {
+        LaunchScheduler scheduler(.1, MAX_SAMPLES_PER_LAUNCH);
+        scheduler.record(1, 0.);
+        check(scheduler.next(1000) == 2, "a launch which took no time at most doubles the batch");
+        scheduler.record(2, .02);
+        scheduler.record(4, .4);
+        check(scheduler.next(1000) == 1, "a slow launch brings the batch back down, got " + std::to_string(scheduler.next(1000)));
+    }
+
+    // Launches without samples, or with a time which isn't a number, are ignored
+    {
+        LaunchScheduler scheduler(.1, MAX_SAMPLES_PER_LAUNCH);
+        scheduler.record(0, .01);
+        scheduler.record(1, -1.);
+        scheduler.record(1, std::numeric_limits<double>::quiet_NaN());
+        check(scheduler.next(1000) == 1, "invalid measurements leave the scheduler unmeasured");
+    }
+
+    // Simulated renders trace every sample, in launches within the budget
+    for (double secondsPerSample : {1e-5, 1e-3, .03, .2}) {
+        for (uint32_t samplesPerPixel : {1u, 7u, 64u, 4096u}) {
+            std::string name = std::to_string(samplesPerPixel) + " samples at " + std::to_string(secondsPerSample) + " s each";
+            std::vector<uint32_t> batches = simulate(.1, samplesPerPixel, secondsPerSample);
+            check(total(batches) == samplesPerPixel, name + ": every sample is traced");
+            bool withinBudget = true;
+            for (uint32_t samples : batches) withinBudget &= (samples == 1) || (samples * secondsPerSample <= .1 + 1e-9);
+            check(withinBudget, name + ": launches of more than one sample stay within the budget");
+
+            std::vector<uint32_t> unbatched = simulate(0., samplesPerPixel, secondsPerSample);
+            check(unbatched.size() == samplesPerPixel, name + ": a budget of zero takes one launch per sample");
+        }
+    }
+
+    // Cheap samples are batched up to the cap, which cuts the number of launches
+    std::vector<uint32_t> batches = simulate(.1, 4096, 1e-6);
+    check(batches.size() < 20, "cheap samples take few launches, got " + std::to_string(batches.size()));
+
+    printf("\n%s\n", pass ? "all checks passed" : "some checks FAILED");
+    return pass ? 0 : 1;
+}
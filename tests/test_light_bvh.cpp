@@ -0,0 +1,287 @@
+/*
+ * Unit tests for the light BVH built and refit in hostcode/light_bvh.h, and walked by sampleLightBVH in
+ * devicecode/lights.h. The probability of picking each light from a point is worked out exactly by visiting every
+ * leaf, then checked to sum to one, to leave out no light which can reach the point, and against how often each
+ * light is actually sampled.
+ *
+ * Build with -DVISII_BUILD_CPU_TESTS=ON and run through ctest. Exits with a non-zero status if any check fails.
+*/
+
+#include <hostcode/light_bvh.h>
+
+// Included for the host in the same order as in the CPU renderer, which lights.h relies on
+#include <visii/light_struct.h>
+#include <devicecode/disney_bsdf.h>
+#include <devicecode/lights.h>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+static bool pass = true;
+
+static void check(bool ok, const std::string &what)
+{
+    if (!ok) printf("FAIL: %s\n", what.c_str());
+    pass &= ok;
+}
+
+static glm::vec3 randomDirection(LCGRand &rng)
+{
+    float z = 1.f - 2.f * lcg_randomf(rng);
+    float phi = 2.f * 3.14159265f * lcg_randomf(rng);
+    float r = std::sqrt(std::max(0.f, 1.f - z * z));
+    return glm::vec3(r * std::cos(phi), r * std::sin(phi), z);
+}
+
+/* A unit square light facing along normal, as two triangles */
+static LightBounds quadLight(const glm::vec3 &center, const glm::vec3 &normal, float size, float radiance)
+{
+    glm::vec3 t = glm::normalize(glm::cross(normal, (std::fabs(normal.x) < .9f) ? glm::vec3(1, 0, 0) : glm::vec3(0, 1, 0)));
+    glm::vec3 b = glm::cross(normal, t);
+    std::vector<glm::vec4> vertices = {
+        glm::vec4(-t - b, 1.f), glm::vec4(t - b, 1.f), glm::vec4(t + b, 1.f), glm::vec4(-t + b, 1.f)
+    };
+    glm::mat4 localToWorld = glm::mat4(size * .5f);
+    localToWorld[3] = glm::vec4(center, 1.f);
+    return computeMeshLightBounds(vertices, {0, 1, 2, 0, 2, 3}, localToWorld, radiance);
+}
+
+static std::vector<LightBounds> randomLights(uint32_t count, uint32_t seed)
+{
+    LCGRand rng;
+    rng.state = seed;
+    std::vector<LightBounds> lights;
+    for (uint32_t i = 0; i < count; ++i) {
+        glm::vec3 center = glm::vec3(lcg_randomf(rng), lcg_randomf(rng), lcg_randomf(rng)) * 20.f - glm::vec3(10.f);
+        lights.push_back(quadLight(center, randomDirection(rng), .1f + lcg_randomf(rng), .1f + 10.f * lcg_randomf(rng)));
+    }
+    return lights;
+}
+
+/* The probability sampleLightBVH gives each light, found by following every branch */
+static void pickProbabilities(const std::vector<LightBVHNode> &nodes, uint32_t node, double prob,
+    const glm::vec3 &p, const glm::vec3 &n, std::vector<double> &probabilities)
+{
+    if (nodes[node].isLeaf) { probabilities[nodes[node].index] += prob; return; }
+    double importance0 = lightBoundsImportance(nodes[node + 1].bounds, p, n);
+    double importance1 = lightBoundsImportance(nodes[nodes[node].index].bounds, p, n);
+    if (importance0 + importance1 <= 0.0) return;
+    pickProbabilities(nodes, node + 1, prob * importance0 / (importance0 + importance1), p, n, probabilities);
+    pickProbabilities(nodes, nodes[node].index, prob * importance1 / (importance0 + importance1), p, n, probabilities);
+}
+
+static bool contains(const LightBounds &outer, const LightBounds &inner)
+{
+    if (!(inner.power > 0.f)) return true;
+    bool box = (glm::min(outer.boundsMin, inner.boundsMin) == outer.boundsMin) && (glm::max(outer.boundsMax, inner.boundsMax) == outer.boundsMax);
+    if (outer.cosThetaO <= -1.f) return box;
+    float thetaOuter = std::acos(glm::clamp(outer.cosThetaO, -1.f, 1.f));
+    float thetaInner = std::acos(glm::clamp(inner.cosThetaO, -1.f, 1.f));
+    float thetaAxes = std::acos(glm::clamp(glm::dot(outer.axis, inner.axis), -1.f, 1.f));
+    return box && (thetaAxes + thetaInner <= thetaOuter + 1e-3f);
+}
+
+/* Every node bounds its children, and every light appears in exactly one leaf */
+static void checkTree(const std::string &name, const LightBVH &bvh, const std::vector<LightBounds> &lights)
+{
+    check(bvh.nodes.size() == lights.size() * 2 - 1, name + ": one leaf per light");
+    std::vector<int> leaves(lights.size(), 0);
+    bool bounded = true, powerAdds = true;
+    for (size_t i = 0; i < bvh.nodes.size(); ++i) {
+        const LightBVHNode &node = bvh.nodes[i];
+        if (node.isLeaf) { if (node.index < leaves.size()) leaves[node.index]++; continue; }
+        const LightBounds &a = bvh.nodes[i + 1].bounds, &b = bvh.nodes[node.index].bounds;
+        bounded &= contains(node.bounds, a) && contains(node.bounds, b);
+        powerAdds &= std::fabs(node.bounds.power - a.power - b.power) <= 1e-4f * node.bounds.power;
+    }
+    bool eachOnce = true;
+    for (int count : leaves) eachOnce &= (count == 1);
+    check(eachOnce, name + ": every light is in exactly one leaf");
+    check(bounded, name + ": nodes bound their children");
+    check(powerAdds, name + ": node power is the sum of its children's");
+}
+
+static void checkSampling(const std::string &name, const LightBVH &bvh, const std::vector<LightBounds> &lights, uint32_t seed)
+{
+    LCGRand rng;
+    rng.state = seed;
+    double maxSumError = 0.0, maxPdfError = 0.0;
+    uint32_t missing = 0;
+    for (int point = 0; point < 20; ++point) {
+        glm::vec3 p = glm::vec3(lcg_randomf(rng), lcg_randomf(rng), lcg_randomf(rng)) * 24.f - glm::vec3(12.f);
+        glm::vec3 n = randomDirection(rng);
+        std::vector<double> probabilities(lights.size(), 0.0);
+        pickProbabilities(bvh.nodes, 0, 1.0, p, n, probabilities);
+
+        double sum = 0.0;
+        for (size_t i = 0; i < lights.size(); ++i) {
+            sum += probabilities[i];
+            // A light can reach the point unless it's behind the point's tangent plane, which lights don't cross here
+            glm::vec3 center = (lights[i].boundsMin + lights[i].boundsMax) * .5f;
+            if ((lights[i].power > 0.f) && (probabilities[i] <= 0.0) && (std::fabs(glm::dot(center - p, n)) > 1.f)) missing++;
+        }
+        maxSumError = std::max(maxSumError, std::fabs(sum - 1.0));
+
+        // sampleLightBVH's pdf matches the probability of the light it returns
+        for (int s = 0; s < 200; ++s) {
+            float pdf;
+            uint32_t light = sampleLightBVH(bvh.nodes.data(), uint32_t(lights.size()), p, n, lcg_randomf(rng), pdf);
+            if (light < lights.size()) maxPdfError = std::max(maxPdfError, std::fabs(pdf - probabilities[light]) / probabilities[light]);
+        }
+    }
+    check(maxSumError < 1e-4, name + ": probabilities sum to one, off by " + std::to_string(maxSumError));
+    check(missing == 0, name + ": lights facing the point can be picked, " + std::to_string(missing) + " can't");
+    check(maxPdfError < 1e-3, name + ": sampled pdfs match, off by " + std::to_string(maxPdfError));
+}
+
+/* How often each light is sampled from one point, against its probability */
+static void checkFrequencies(const LightBVH &bvh, const std::vector<LightBounds> &lights)
+{
+    glm::vec3 p(0.f), n(0.f, 0.f, 1.f);
+    std::vector<double> probabilities(lights.size(), 0.0);
+    pickProbabilities(bvh.nodes, 0, 1.0, p, n, probabilities);
+
+    LCGRand rng;
+    rng.state = 11;
+    const int samples = 1000000;
+    std::vector<double> counts(lights.size(), 0.0);
+    for (int s = 0; s < samples; ++s) {
+        float pdf;
+        uint32_t light = sampleLightBVH(bvh.nodes.data(), uint32_t(lights.size()), p, n, lcg_randomf(rng), pdf);
+        if (pdf > 0.f) counts[light] += 1.0;
+    }
+    double maxError = 0.0;
+    for (size_t i = 0; i < lights.size(); ++i) {
+        double sigma = std::sqrt(probabilities[i] * (1.0 - probabilities[i]) / samples);
+        maxError = std::max(maxError, std::fabs(counts[i] / samples - probabilities[i]) / std::max(sigma, 1e-9));
+    }
+    check(maxError < 5.0, "sampled frequencies match the probabilities, worst off by " + std::to_string(maxError) + " sigma");
+}
+
+static void checkCones()
+{
+    LCGRand rng;
+    rng.state = 5;
+    bool covered = true;
+    for (int i = 0; i < 1000; ++i) {
+        glm::vec3 a = randomDirection(rng), b = randomDirection(rng);
+        float cosA = std::cos(lcg_randomf(rng) * 1.5f), cosB = std::cos(lcg_randomf(rng) * 1.5f);
+        glm::vec3 axis = a;
+        float cosTheta = cosA;
+        unionDirectionCone(axis, cosTheta, b, cosB);
+        // The far edges of both cones, in the plane through both axes
+        glm::vec3 k = glm::cross(a, b);
+        if (glm::dot(k, k) < 1e-6f) continue;
+        k = glm::normalize(k);
+        glm::vec3 edgeA = a * cosA - glm::cross(k, a) * std::sqrt(1.f - cosA * cosA);
+        glm::vec3 edgeB = b * cosB + glm::cross(k, b) * std::sqrt(1.f - cosB * cosB);
+        covered &= (glm::dot(axis, a) >= cosTheta - 1e-4f) && (glm::dot(axis, b) >= cosTheta - 1e-4f);
+        covered &= (glm::dot(axis, edgeA) >= cosTheta - 1e-4f) && (glm::dot(axis, edgeB) >= cosTheta - 1e-4f);
+    }
+    check(covered, "cone unions cover both cones");
+
+    LightBounds quad = quadLight(glm::vec3(1, 2, 3), glm::vec3(0, 0, 1), 2.f, 3.f);
+    check(std::fabs(quad.power - 12.f) < 1e-4f, "quad light power is radiance times area, got " + std::to_string(quad.power));
+    check((std::fabs(quad.axis.z) > .9999f) && (quad.cosThetaO > .9999f), "quad light normals are a single direction");
+    check(quad.twoSided == 1, "mesh lights are two sided");
+    check(quadLight(glm::vec3(0), glm::vec3(0, 0, 1), 1.f, 0.f).power == 0.f, "black lights have no power");
+}
+
+/*
+ * Object space bounds placed in the world must hold every world space triangle of a curved mesh, under rotations,
+ * shears and uneven or mirroring scales, and match bounds computed in world space for flat meshes and rotations.
+*/
+static void checkTransformedBounds()
+{
+    LCGRand rng;
+    rng.state = 9;
+
+    // A bumpy patch, whose normals spread up to about 50 degrees from +z
+    std::vector<glm::vec4> vertices;
+    std::vector<uint32_t> indices;
+    const uint32_t res = 8;
+    for (uint32_t y = 0; y <= res; ++y)
+        for (uint32_t x = 0; x <= res; ++x)
+            vertices.push_back(glm::vec4(float(x) / res, float(y) / res, .1f * std::sin(7.f * x / res) * std::cos(5.f * y / res), 1.f));
+    for (uint32_t y = 0; y < res; ++y)
+        for (uint32_t x = 0; x < res; ++x) {
+            uint32_t a = y * (res + 1) + x, b = a + 1, c = a + res + 2, d = a + res + 1;
+            indices.insert(indices.end(), {a, b, c, a, c, d});
+        }
+    MeshLightBounds object = computeObjectLightBounds(vertices, indices);
+
+    bool bounded = true, sameForRotations = true;
+    for (int i = 0; i < 200; ++i) {
+        glm::mat4 localToWorld(1.f);
+        for (int c = 0; c < 3; ++c)
+            localToWorld[c] = glm::vec4(glm::vec3(lcg_randomf(rng), lcg_randomf(rng), lcg_randomf(rng)) * 4.f - glm::vec3(2.f), 0.f);
+        localToWorld[3] = glm::vec4(randomDirection(rng) * 5.f, 1.f);
+        LightBounds b = transformMeshLightBounds(object, localToWorld, 1.f);
+        if (!(b.power > 0.f)) continue;
+        for (size_t t = 0; t < indices.size(); t += 3) {
+            glm::vec3 v[3];
+            for (int k = 0; k < 3; ++k) {
+                v[k] = glm::vec3(localToWorld * vertices[indices[t + k]]);
+                bounded &= glm::all(glm::lessThanEqual(b.boundsMin - glm::vec3(1e-4f), v[k]));
+                bounded &= glm::all(glm::lessThanEqual(v[k], b.boundsMax + glm::vec3(1e-4f)));
+            }
+            glm::vec3 n = glm::normalize(glm::cross(v[1] - v[0], v[2] - v[0]));
+            bounded &= (b.cosThetaO <= -1.f) || (std::fabs(glm::dot(n, b.axis)) >= b.cosThetaO - 1e-4f);
+        }
+
+        // A rotation of the same patch
+        glm::vec3 x = randomDirection(rng), y = glm::normalize(glm::cross(x, randomDirection(rng)));
+        glm::mat4 rotation(glm::vec4(x, 0.f), glm::vec4(y, 0.f), glm::vec4(glm::cross(x, y), 0.f), localToWorld[3]);
+        LightBounds placed = transformMeshLightBounds(object, rotation, 1.f);
+        std::vector<glm::vec4> rotated;
+        for (const glm::vec4 &v : vertices) rotated.push_back(rotation * v);
+        LightBounds world = computeMeshLightBounds(rotated, indices, glm::mat4(1.f), 1.f);
+        sameForRotations &= (std::fabs(glm::dot(placed.axis, world.axis)) > .9999f) && (std::fabs(placed.cosThetaO - world.cosThetaO) < 1e-4f);
+        sameForRotations &= std::fabs(placed.power - world.power) < 1e-4f * world.power;
+    }
+    check(bounded, "transformed bounds hold every triangle of the mesh in the world");
+    check(sameForRotations, "rotated bounds keep the mesh's cone and area");
+}
+
+int main(int argc, char **argv)
+{
+    checkCones();
+    checkTransformedBounds();
+
+    LightBVH empty;
+    empty.build({});
+    check(empty.nodes.empty(), "no lights give an empty tree");
+
+    // A single light, and a few with some that can't be sampled
+    std::vector<LightBounds> one = randomLights(1, 1);
+    LightBVH single;
+    single.build(one);
+    checkTree("single", single, one);
+    checkSampling("single", single, one, 2);
+
+    std::vector<LightBounds> some = randomLights(40, 3);
+    some[3] = some[17] = some[30] = LightBounds();
+    LightBVH withBlack;
+    withBlack.build(some);
+    checkTree("some black", withBlack, some);
+    checkSampling("some black", withBlack, some, 4);
+    checkFrequencies(withBlack, some);
+
+    std::vector<LightBounds> many = randomLights(2000, 5);
+    LightBVH bvh;
+    bvh.build(many);
+    checkTree("many", bvh, many);
+    checkSampling("many", bvh, many, 6);
+
+    // Move every light, including black ones which start to shine, and refit
+    std::vector<LightBounds> moved = randomLights(2000, 7);
+    moved[10] = LightBounds();
+    check(bvh.refit(moved), "refit keeps the tree when the number of lights is the same");
+    checkTree("refit", bvh, moved);
+    checkSampling("refit", bvh, moved, 8);
+    check(!bvh.refit(randomLights(10, 9)), "refit fails when the number of lights changes");
+
+    printf("\n%s\n", pass ? "all checks passed" : "some checks FAILED");
+    return pass ? 0 : 1;
+}
@@ -0,0 +1,41 @@
+#%%
+import sys, os, random
+os.add_dll_directory(os.path.join(os.getcwd(), '..', 'install'))
+sys.path.append(os.path.join(os.getcwd(), "..", "install"))
+
+import visii
+
+#%%
+visii.initialize_headless()
+
+# %%
+# Start from a regular grid, then shuffle its triangles to mimic an unordered asset
+plane = visii.mesh.create_plane("plane", segments = visii.ivec2(128, 128))
+positions = list(plane.get_vertices())
+normals = list(plane.get_normals())
+indices = list(plane.get_triangle_indices())
+
+triangles = [indices[i:i+3] for i in range(0, len(indices), 3)]
+random.seed(0)
+random.shuffle(triangles)
+shuffled = [i for tri in triangles for i in tri]
+
+unoptimized = visii.mesh.create_from_data("unoptimized", positions, normals, indices = shuffled, optimize = False)
+optimized = visii.mesh.create_from_data("optimized", positions, normals, indices = shuffled, optimize = True)
+
+# %%
+acmr_before = unoptimized.get_average_cache_miss_ratio()
+acmr_after = optimized.get_average_cache_miss_ratio()
+fetch_before = unoptimized.get_vertex_fetch_ratio()
+fetch_after = optimized.get_vertex_fetch_ratio()
+print("ACMR: ", acmr_before, "->", acmr_after)
+print("Fetch ratio: ", fetch_before, "->", fetch_after)
+
+assert acmr_after < acmr_before
+assert fetch_after < fetch_before
+assert len(optimized.get_triangle_indices()) == len(shuffled)
+assert abs(optimized.get_min_aabb_corner().x - unoptimized.get_min_aabb_corner().x) < 1e-6
+assert abs(optimized.get_max_aabb_corner().y - unoptimized.get_max_aabb_corner().y) < 1e-6
+
+# %%
+visii.cleanup()
@@ -0,0 +1,65 @@
+#%%
+import sys, os
+os.add_dll_directory(os.path.join(os.getcwd(), '..', 'install'))
+sys.path.append(os.path.join(os.getcwd(), "..", "install"))
+
+import math, struct
+import visii
+
+#%%
+visii.initialize_headless()
+
+# %%
+# A unit cube as a binary STL: 12 triangles, whose 36 corners share 8 positions
+corners = [(x, y, z) for x in (0., 1.) for y in (0., 1.) for z in (0., 1.)]
+faces = [
+    (0, 2, 3, 1), (4, 5, 7, 6), # x = 0, x = 1
+    (0, 1, 5, 4), (2, 6, 7, 3), # y = 0, y = 1
+    (0, 4, 6, 2), (1, 3, 7, 5), # z = 0, z = 1
+]
+triangles = []
+for a, b, c, d in faces:
+    triangles += [(a, b, c), (a, c, d)]
+
+def write_stl(path, triangles, count = None, padding = b""):
+    with open(path, "wb") as f:
+        f.write(b"binary cube".ljust(80, b" "))
+        f.write(struct.pack("<I", len(triangles) if count is None else count))
+        for tri in triangles:
+            # Face normals are left at zero, since the loader generates its own
+            f.write(struct.pack("<3f", 0., 0., 0.))
+            for i in tri:
+                x, y, z = corners[i]
+                # Negative zero has different bits but the same position, and must still be welded
+                f.write(struct.pack("<3f", -0. if x == 0. and i == 6 else x, y, z))
+            f.write(struct.pack("<H", 0))
+        f.write(padding)
+
+write_stl("test_cube.stl", triangles)
+cube = visii.mesh.create_from_stl("cube", "test_cube.stl")
+assert len(cube.get_vertices()) == 8, "expected coincident corners to be welded"
+assert len(cube.get_triangle_indices()) == 36
+for n in cube.get_normals():
+    assert abs(math.sqrt(n.x * n.x + n.y * n.y + n.z * n.z) - 1.) < 1e-5
+assert abs(cube.get_min_aabb_corner().x) < 1e-6 and abs(cube.get_max_aabb_corner().z - 1.) < 1e-6
+
+# Bytes past the last triangle are ignored
+write_stl("test_cube_padded.stl", triangles, padding = b"\0" * 37)
+padded = visii.mesh.create_from_stl("padded_cube", "test_cube_padded.stl")
+assert len(padded.get_vertices()) == 8 and len(padded.get_triangle_indices()) == 36
+
+# A file too short for its triangle count is refused
+write_stl("test_cube_truncated.stl", triangles, count = len(triangles) + 1)
+try:
+    visii.mesh.create_from_stl("truncated_cube", "test_cube_truncated.stl")
+    assert False, "expected a truncated STL to be refused"
+except RuntimeError:
+    pass
+assert visii.mesh.get("truncated_cube") is None
+
+print("STL import passed")
+
+# %%
+for path in ["test_cube.stl", "test_cube_padded.stl", "test_cube_truncated.stl"]:
+    os.remove(path)
+visii.cleanup()
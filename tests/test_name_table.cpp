@@ -0,0 +1,186 @@
+/*
+ * Unit tests for NameTable in utilities/name_table.h, the name to id lookup of the StaticFactory tables. Names are
+ * picked to land on the same home slot, including clusters which wrap around the end of the table, so that erase has
+ * to shift later entries back. A long run of random inserts and erases is then checked against a std::unordered_map,
+ * looking every name up every thousand steps.
+ *
+ * Build with -DVISII_BUILD_CPU_TESTS=ON and run through ctest. Exits with a non-zero status if any check fails.
+*/
+
+#include <visii/utilities/name_table.h>
+
+#include <cstdio>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+static bool pass = true;
+
+static void check(bool ok, const std::string &what)
+{
+    if (!ok) printf("FAIL: %s\n", what.c_str());
+    pass &= ok;
+}
+
+/* Slots in a table holding up to 12 names, the first size it grows to */
+static const uint32_t SLOTS = 16;
+
+/* The same hash as NameTable::hashName, to find names which collide */
+static uint32_t hashName(const std::string &name)
+{
+    uint64_t hash = 14695981039346656037ull;
+    for (unsigned char c : name) {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    return uint32_t(hash ^ (hash >> 32));
+}
+
+/* Returns count distinct names whose home slot in a table of SLOTS slots is home */
+static std::vector<std::string> namesWithHome(uint32_t home, size_t count, const std::string &prefix)
+{
+    std::vector<std::string> names;
+    for (uint32_t i = 0; names.size() < count; ++i) {
+        std::string name = prefix + std::to_string(i);
+        if ((hashName(name) & (SLOTS - 1)) == home) names.push_back(name);
+    }
+    return names;
+}
+
+/* Checks that table holds exactly the names and ids of reference */
+static void checkMatches(const NameTable &table, const std::unordered_map<std::string, uint32_t> &reference, const std::string &when)
+{
+    check(table.size() == reference.size(), "size matches " + when);
+    for (auto &entry : reference) {
+        uint32_t id = UINT32_MAX;
+        if (!table.find(entry.first, id) || (id != entry.second)) {
+            check(false, "\"" + entry.first + "\" is found with its id " + when);
+            return;
+        }
+    }
+    size_t visited = 0;
+    table.forEach([&] (const std::string &name, uint32_t id) {
+        auto it = reference.find(name);
+        check((it != reference.end()) && (it->second == id), "forEach only visits names in the table " + when);
+        visited++;
+    });
+    check(visited == reference.size(), "forEach visits every name " + when);
+}
+
+int main(int argc, char **argv)
+{
+    // An empty table
+    {
+        NameTable table;
+        uint32_t id;
+        check(!table.find("missing", id), "an empty table finds nothing");
+        check(!table.erase("missing"), "erasing from an empty table fails");
+        check(table.makeUnique("mesh") == "mesh", "an unused prefix is unique as is");
+    }
+
+    // A cluster starting at the last slot wraps around to the first ones. Erasing from its middle must shift
+    // the later entries back, even across the end of the table.
+    {
+        NameTable table;
+        std::unordered_map<std::string, uint32_t> reference;
+        std::vector<std::string> wrapped = namesWithHome(SLOTS - 1, 5, "wrapped_");
+        for (uint32_t i = 0; i < wrapped.size(); ++i) {
+            table.insert(wrapped[i], i);
+            reference[wrapped[i]] = i;
+        }
+        checkMatches(table, reference, "after filling a wrapping cluster");
+
+        for (uint32_t i : {1u, 0u, 3u}) {
+            check(table.erase(wrapped[i]), "erasing \"" + wrapped[i] + "\" succeeds");
+            check(!table.contains(wrapped[i]), "\"" + wrapped[i] + "\" is gone once erased");
+            check(!table.erase(wrapped[i]), "erasing \"" + wrapped[i] + "\" twice fails");
+            reference.erase(wrapped[i]);
+            checkMatches(table, reference, "after erasing \"" + wrapped[i] + "\" from a wrapping cluster");
+        }
+    }
+
+    // Entries displaced from a later home slot sit in the same cluster, and must not be shifted in front of it
+    {
+        NameTable table;
+        std::unordered_map<std::string, uint32_t> reference;
+        std::vector<std::string> first = namesWithHome(4, 3, "first_");
+        std::vector<std::string> second = namesWithHome(5, 3, "second_");
+        std::vector<std::string> order = {first[0], second[0], first[1], second[1], first[2], second[2]};
+        for (uint32_t i = 0; i < order.size(); ++i) {
+            table.insert(order[i], i);
+            reference[order[i]] = i;
+        }
+        for (const std::string &name : first) {
+            table.erase(name);
+            reference.erase(name);
+            checkMatches(table, reference, "after erasing \"" + name + "\" from a shared cluster");
+        }
+
+        // Freed slots and names are reused
+        for (uint32_t i = 0; i < first.size(); ++i) {
+            table.insert(first[i], 100 + i);
+            reference[first[i]] = 100 + i;
+        }
+        checkMatches(table, reference, "after inserting erased names again");
+    }
+
+    // Inserting a name again replaces its id
+    {
+        NameTable table;
+        table.insert("camera", 1);
+        table.insert("camera", 2);
+        uint32_t id = 0;
+        check(table.size() == 1, "inserting a name twice keeps one entry");
+        check(table.find("camera", id) && (id == 2), "inserting a name twice keeps the latest id");
+    }
+
+    // Unique names count up from 1, and never return a name in the table, even after erasing earlier ones
+    {
+        NameTable table;
+        table.insert("mesh", 0);
+        std::string a = table.makeUnique("mesh");
+        check(a == "mesh1", "the first unique name after the prefix is prefix1, got " + a);
+        table.insert(a, 1);
+        table.insert("mesh2", 2);
+        std::string b = table.makeUnique("mesh");
+        check(b == "mesh3", "names already in the table are skipped, got " + b);
+        table.insert(b, 3);
+        table.erase("mesh1");
+        std::string c = table.makeUnique("mesh");
+        check(!table.contains(c) && (c.compare(0, 4, "mesh") == 0), "unique names stay unique after erasing, got " + c);
+    }
+
+    // Random churn over a pool of names, growing well past the first table size, then shrinking
+    {
+        NameTable table;
+        std::unordered_map<std::string, uint32_t> reference;
+        std::mt19937 rng(0);
+        const uint32_t POOL = 3000;
+        for (uint32_t step = 0; step < 200000; ++step) {
+            std::string name = "component_" + std::to_string(rng() % POOL);
+            bool insert = (rng() % 100) < ((step < 100000) ? 60 : 40);
+            if (insert) {
+                table.insert(name, step);
+                reference[name] = step;
+            } else {
+                bool erased = table.erase(name);
+                check(erased == (reference.erase(name) == 1), "erase reports whether \"" + name + "\" was in the table");
+            }
+            if ((step % 1000) == 0) checkMatches(table, reference, "during churn, at step " + std::to_string(step));
+            if (!pass) break;
+        }
+        checkMatches(table, reference, "after churn");
+
+        for (auto &entry : reference) table.erase(entry.first);
+        reference.clear();
+        checkMatches(table, reference, "after erasing every name");
+
+        table.insert("again", 7);
+        table.clear();
+        check(!table.contains("again") && table.size() == 0, "clear empties the table");
+    }
+
+    printf("\n%s\n", pass ? "all checks passed" : "some checks FAILED");
+    return pass ? 0 : 1;
+}
@@ -0,0 +1,158 @@
+/*
+ * Checks the memory bound of loadObjStreaming in utilities/obj_parser.h, which importOBJ uses when given a memory
+ * budget. Every heap allocation made by this program is counted, and the peak while streaming a generated OBJ must
+ * stay within the budget, with the callback holding as much memory per triangle as it claims to need. The same file
+ * loaded by loadObjParallel, which keeps every shape at once, is checked to go over that budget, and to produce the
+ * same triangles.
+ *
+ * Build with -DVISII_BUILD_CPU_TESTS=ON and run through ctest. Exits with a non-zero status if any check fails.
+*/
+
+#define TINYOBJLOADER_IMPLEMENTATION
+#include <visii/utilities/obj_parser.h>
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+
+/* Live and peak heap bytes, kept by the replacement operator new and delete below */
+static std::atomic<uint64_t> liveBytes(0);
+static std::atomic<uint64_t> peakBytes(0);
+
+/* Allocations carry their size in a header, so that delete knows how much to subtract */
+static const size_t HEADER = 16;
+
+void* operator new(size_t size)
+{
+    char *block = (char*) malloc(size + HEADER);
+    if (!block) throw std::bad_alloc();
+    *(size_t*) block = size;
+    uint64_t live = liveBytes += size;
+    uint64_t peak = peakBytes.load();
+    while (live > peak && !peakBytes.compare_exchange_weak(peak, live)) {}
+    return block + HEADER;
+}
+
+void operator delete(void *pointer) noexcept
+{
+    if (!pointer) return;
+    char *block = (char*) pointer - HEADER;
+    liveBytes -= *(size_t*) block;
+    free(block);
+}
+
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete[](void *pointer) noexcept { operator delete(pointer); }
+void operator delete(void *pointer, size_t) noexcept { operator delete(pointer); }
+void operator delete[](void *pointer, size_t) noexcept { operator delete(pointer); }
+
+static bool pass = true;
+
+static void check(bool ok, const std::string &what)
+{
+    if (!ok) printf("FAIL: %s\n", what.c_str());
+    pass &= ok;
+}
+
+/* A grid of unit quads with normals and texture coordinates, in a few groups */
+static void writeGrid(const std::string &path, uint32_t res)
+{
+    FILE *f = fopen(path.c_str(), "w");
+    for (uint32_t y = 0; y <= res; ++y)
+        for (uint32_t x = 0; x <= res; ++x)
+            fprintf(f, "v %u %u 0\nvn 0 0 1\nvt %.6f %.6f\n", x, y, double(x) / res, double(y) / res);
+    for (uint32_t y = 0; y < res; ++y) {
+        if (y % (res / 4) == 0) fprintf(f, "g group_%u\n", y);
+        for (uint32_t x = 0; x < res; ++x) {
+            uint32_t a = y * (res + 1) + x + 1, b = a + 1, c = a + res + 2, d = a + res + 1;
+            fprintf(f, "f %u/%u/%u %u/%u/%u %u/%u/%u %u/%u/%u\n", a, a, a, b, b, b, c, c, c, d, d, d);
+        }
+    }
+    fclose(f);
+}
+
+int main(int argc, char **argv)
+{
+    const std::string path = "test_obj_streaming.obj";
+    const uint32_t res = 500;
+    writeGrid(path, res);
+    const uint64_t numTriangles = uint64_t(res) * res * 2;
+
+    // Per vertex positions, normals and texture coordinates, as loaded into the pool. The grid has no colors, so none are kept.
+    const uint64_t vertexBytes = uint64_t(res + 1) * (res + 1) * 8 * sizeof(float);
+    const uint64_t budget = vertexBytes + (8 << 20);
+    const uint64_t consumerBytesPerTriangle = 64;
+
+    uint64_t streamedTriangles = 0, pieces = 0;
+    uint64_t baseline = liveBytes.load();
+    peakBytes = baseline;
+    {
+        tinyobj::attrib_t attrib;
+        std::vector<tinyobj::material_t> materials;
+        std::string err;
+        bool loaded = loadObjStreaming(&attrib, &materials, &err, path, "", budget, consumerBytesPerTriangle,
+            [&] (tinyobj::shape_t &shape) {
+                // Stands in for the staging buffers importOBJ fills from each shape
+                uint64_t triangles = shape.mesh.indices.size() / 3;
+                std::vector<char> staging(triangles * consumerBytesPerTriangle, 1);
+                streamedTriangles += triangles;
+                pieces++;
+            });
+        check(loaded, "streaming load succeeds: " + err);
+        check(attrib.colors.empty(), "no colors are kept for a file without them");
+    }
+    uint64_t streamingPeak = peakBytes.load() - baseline;
+    printf("budget %.1f MB, streaming peak %.1f MB in %llu pieces\n", budget / 1048576.0, streamingPeak / 1048576.0, (unsigned long long) pieces);
+    check(streamedTriangles == numTriangles, "every triangle is streamed, got " + std::to_string(streamedTriangles));
+    check(pieces > 4, "shapes larger than the budget are handed off in pieces");
+    check(streamingPeak <= budget, "peak memory while streaming stays within the budget");
+
+    baseline = liveBytes.load();
+    peakBytes = baseline;
+    uint64_t loadedTriangles = 0;
+    {
+        tinyobj::attrib_t attrib;
+        std::vector<tinyobj::shape_t> shapes;
+        std::vector<tinyobj::material_t> materials;
+        std::string err;
+        check(loadObjParallel(&attrib, &shapes, &materials, &err, path, ""), "parallel load succeeds: " + err);
+        for (auto &shape : shapes) loadedTriangles += shape.mesh.indices.size() / 3;
+    }
+    uint64_t parallelPeak = peakBytes.load() - baseline;
+    printf("without a budget, peak %.1f MB\n", parallelPeak / 1048576.0);
+    check(loadedTriangles == numTriangles, "the parallel parser loads every triangle");
+    check(parallelPeak > budget, "the file needs more than the budget when loaded at once, so the check above means something");
+
+    // A budget smaller than the vertex pool is refused rather than exceeded
+    {
+        tinyobj::attrib_t attrib;
+        std::vector<tinyobj::material_t> materials;
+        std::string err;
+        check(!loadObjStreaming(&attrib, &materials, &err, path, "", vertexBytes / 2, consumerBytesPerTriangle,
+            [] (tinyobj::shape_t &) {}), "a budget below the vertex data is refused");
+    }
+
+    remove(path.c_str());
+
+    // Colors are kept once any vertex has them, and vertices without them are white
+    {
+        const std::string colorPath = "test_obj_colors.obj";
+        FILE *f = fopen(colorPath.c_str(), "w");
+        fprintf(f, "v 0 0 0\nv 1 0 0 .5 .25 0\nv 0 1 0\nf 1 2 3\n");
+        fclose(f);
+        tinyobj::attrib_t attrib;
+        std::vector<tinyobj::shape_t> shapes;
+        std::vector<tinyobj::material_t> materials;
+        std::string err;
+        check(loadObjParallel(&attrib, &shapes, &materials, &err, colorPath, ""), "a file with colors loads: " + err);
+        std::vector<float> expected = {1, 1, 1, .5f, .25f, 0, 1, 1, 1};
+        check(attrib.colors == expected, "colors are read, and default to white");
+        remove(colorPath.c_str());
+    }
+
+    printf("\n%s\n", pass ? "all checks passed" : "some checks FAILED");
+    return pass ? 0 : 1;
+}
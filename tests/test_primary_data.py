@@ -0,0 +1,78 @@
+#%%
+import sys, os
+os.add_dll_directory(os.path.join(os.getcwd(), '..', 'install'))
+sys.path.append(os.path.join(os.getcwd(), "..", "install"))
+
+import math
+import visii
+
+WIDTH = 64
+HEIGHT = 64
+MISS = 3.4028234663852886e+38 # FLT_MAX
+
+#%%
+visii.initialize_headless(backend = "cpu")
+
+camera_entity = visii.entity.create(
+    name = "camera",
+    transform = visii.transform.create("camera_transform", position = visii.vec3(0., 0., 5.)),
+    camera = visii.camera.create_perspective_from_fov(name = "camera", field_of_view = 0.785398, aspect = 1.))
+visii.set_camera_entity(camera_entity)
+
+box = visii.entity.create(
+    name = "box",
+    mesh = visii.mesh.create_box("box"),
+    transform = visii.transform.create("box"),
+    material = visii.material.create("box"))
+
+# Hidden from the camera, so camera rays pass through it to the box
+hidden = visii.entity.create(
+    name = "hidden",
+    mesh = visii.mesh.create_sphere("hidden", radius = .5),
+    transform = visii.transform.create("hidden", position = visii.vec3(0., 0., 2.)),
+    material = visii.material.create("hidden"))
+hidden.set_visibility(camera = False)
+
+options = ["depth", "position", "normal", "entity_id"]
+data = visii.render_primary_data(width = WIDTH, height = HEIGHT, start_frame = 0, frame_count = 1, options = options)
+assert len(data) == len(options) * WIDTH * HEIGHT * 4
+size = WIDTH * HEIGHT * 4
+depth, position, normal, entity_id = [data[i * size : (i + 1) * size] for i in range(len(options))]
+
+center = ((HEIGHT // 2) * WIDTH + WIDTH // 2) * 4
+assert entity_id[center] == box.get_id(), "expected the box, behind the hidden sphere"
+assert all(depth[i + 3] == 1. for i in range(0, size, 4))
+
+# Checked against the camera rather than render_data, which returns these options from the same camera rays. The camera
+# only sees the front face of the box, at z = 1, four units away. Camera rays are jittered by up to half a pixel, so each
+# pixel is checked against where its whole footprint lands on that plane, and pixels straddling the edge of the face
+# are left out. Like rayGen, rays which skip the hidden sphere measure their depth from where they left it.
+half_extent = 4. * math.tan(0.785398 / 2.)
+shadow_radius = 4. * math.tan(math.asin(.5 / 3.))
+hits = misses = 0
+for row in range(HEIGHT):
+    for column in range(WIDTH):
+        i = (row * WIDTH + column) * 4
+        # Rows are stored bottom up, and pixel centers sit on whole pixels counted from the top
+        x_lo, x_hi = [half_extent * (2. * (column + a) / WIDTH - 1.) for a in (-.5, .5)]
+        y_lo, y_hi = [half_extent * (2. * (row + a) / HEIGHT - 1.) for a in (.5, 1.5)]
+        if x_lo > -1. and x_hi < 1. and y_lo > -1. and y_hi < 1.:
+            x, y, z = position[i : i + 3]
+            assert abs(z - 1.) < 1e-4 and x_lo - 1e-4 <= x <= x_hi + 1e-4 and y_lo - 1e-4 <= y <= y_hi + 1e-4, (column, row, x, y, z)
+            assert normal[i + 2] > .999, (column, row)
+            assert entity_id[i] == box.get_id(), (column, row)
+            behind = 0. < depth[i] < 1.5
+            direct = abs(depth[i] - math.sqrt(x * x + y * y + (5. - z) ** 2)) < 1e-3
+            r = math.sqrt(x * x + y * y)
+            assert behind if r < shadow_radius - .08 else direct if r > shadow_radius + .08 else (behind or direct), (column, row, depth[i])
+            hits += 1
+        elif x_hi < -1. or x_lo > 1. or y_hi < -1. or y_lo > 1.:
+            for buffer in (depth, position, normal, entity_id):
+                assert list(buffer[i : i + 3]) == [MISS] * 3, (column, row)
+            misses += 1
+assert hits > WIDTH * HEIGHT // 4 and misses > WIDTH * HEIGHT // 4, (hits, misses)
+
+print("Primary data matches the camera")
+
+# %%
+visii.cleanup()
@@ -0,0 +1,66 @@
+#%%
+import sys, os, random
+os.add_dll_directory(os.path.join(os.getcwd(), '..', 'install'))
+sys.path.append(os.path.join(os.getcwd(), "..", "install"))
+
+import visii
+
+NUM_TRANSFORMS = 200
+TOLERANCE = 1e-4
+
+#%%
+visii.initialize_headless()
+
+# Random transforms with non uniform scales, most of them parented to an earlier one
+random.seed(0)
+def rand_vec3(lo, hi):
+    return visii.vec3(random.uniform(lo, hi), random.uniform(lo, hi), random.uniform(lo, hi))
+
+transforms = []
+parents = []
+for i in range(NUM_TRANSFORMS):
+    t = visii.transform.create("t_{}".format(i),
+        scale = rand_vec3(.5, 2.),
+        rotation = visii.normalize(visii.quat(*[random.uniform(-1, 1) for j in range(4)])),
+        position = rand_vec3(-2, 2))
+    parent = random.randrange(i) if (i > 0 and random.random() < .8) else None
+    if parent is not None:
+        t.set_parent(transforms[parent])
+    transforms.append(t)
+    parents.append(parent)
+
+# %%
+def assert_close(a, b, what):
+    for c in range(4):
+        for r in range(4):
+            assert abs(a[c][r] - b[c][r]) <= TOLERANCE * max(1., abs(b[c][r])), \
+                "{}: {} != {}".format(what, a, b)
+
+# Reference matrices, composed with plain glm products and general inverses
+def reference_local(t):
+    return visii.translate(visii.mat4(1.), t.get_position()) * visii.mat4_cast(t.get_rotation()) * visii.scale(visii.mat4(1.), t.get_scale())
+
+def reference_world(i):
+    local = reference_local(transforms[i])
+    if parents[i] is None: return local
+    return reference_world(parents[i]) * local
+
+for i, t in enumerate(transforms):
+    local = reference_local(t)
+    assert_close(t.get_local_to_parent_matrix(), local, "local to parent")
+    assert_close(t.get_parent_to_local_matrix(), visii.inverse(local), "parent to local")
+
+    world = reference_world(i)
+    assert_close(t.get_local_to_world_matrix(), world, "local to world")
+    assert_close(t.get_world_to_local_matrix(), visii.inverse(world), "world to local")
+
+    p = rand_vec3(-1, 1)
+    expected = local * visii.vec4(p, 1.)
+    actual = t.transform_point(p)
+    for k in range(3):
+        assert abs(actual[k] - expected[k]) <= TOLERANCE * max(1., abs(expected[k])), "transform point"
+
+print("All transforms match their reference matrices")
+
+# %%
+visii.cleanup()
@@ -0,0 +1,67 @@
+#%%
+import sys, os
+os.add_dll_directory(os.path.join(os.getcwd(), '..', 'install'))
+sys.path.append(os.path.join(os.getcwd(), "..", "install"))
+
+import visii
+
+# A 100k deep chain, far deeper than any update or query which recursed over the hierarchy could survive
+CHAIN_LENGTH = 100000
+
+#%%
+visii.initialize_headless()
+
+camera_entity = visii.entity.create(
+    name="camera",
+    transform=visii.transform.create("camera_transform"),
+    camera=visii.camera.create_perspective_from_fov(name = "camera", field_of_view = 0.785398, aspect = 1., near = .1))
+visii.set_camera_entity(camera_entity)
+
+# A single very deep chain, each link one unit further along x than its parent
+chain = []
+for i in range(CHAIN_LENGTH):
+    t = visii.transform.create("link_{}".format(i), position = visii.vec3(1, 0, 0))
+    if i > 0: t.set_parent(chain[-1])
+    chain.append(t)
+
+# Queried both before and after the renderer's update, neither of which may recurse
+assert chain[-1].get_local_to_world_matrix()[3][0] == CHAIN_LENGTH
+visii.render_to_png(width = 8, height = 8, samples_per_pixel = 1, image_path = "tmp_hierarchy.png")
+assert chain[-1].get_local_to_world_matrix()[3][0] == CHAIN_LENGTH
+assert chain[CHAIN_LENGTH // 2].get_world_to_local_matrix()[3][0] == -(CHAIN_LENGTH // 2 + 1)
+
+# %%
+# Cycles are rejected, and leave the hierarchy untouched
+for parent, child in [(chain[-1], chain[0]), (chain[1000], chain[10]), (chain[5], chain[5])]:
+    try:
+        child.set_parent(parent)
+        assert False, "expected set_parent to fail"
+    except RuntimeError:
+        pass
+    try:
+        parent.add_child(child)
+        assert False, "expected add_child to fail"
+    except RuntimeError:
+        pass
+assert chain[-1].get_local_to_world_matrix()[3][0] == CHAIN_LENGTH
+
+# Reparenting moves the whole subtree, and removes it from its old parent
+half = CHAIN_LENGTH // 2
+chain[half].set_parent(chain[0])
+assert chain[-1].get_local_to_world_matrix()[3][0] == CHAIN_LENGTH - half + 1
+chain[half - 1].remove_child(chain[half])
+assert chain[-1].get_local_to_world_matrix()[3][0] == CHAIN_LENGTH - half + 1
+chain[0].remove_child(chain[half])
+assert chain[-1].get_local_to_world_matrix()[3][0] == CHAIN_LENGTH - half
+
+# Removing a transform turns its children into roots
+visii.transform.remove("link_10")
+assert chain[11].get_local_to_world_matrix()[3][0] == 1
+chain[0].set_position(visii.vec3(5, 0, 0))
+assert chain[12].get_local_to_world_matrix()[3][0] == 2
+assert chain[9].get_local_to_world_matrix()[3][0] == 14
+
+os.remove("tmp_hierarchy.png")
+
+# %%
+visii.cleanup()
@@ -0,0 +1,61 @@
+#%%
+import sys, os, math
+os.add_dll_directory(os.path.join(os.getcwd(), '..', 'install'))
+sys.path.append(os.path.join(os.getcwd(), "..", "install"))
+
+import visii
+
+NUM_KEYS = 5
+TOLERANCE = 1e-4
+
+#%%
+visii.initialize_headless()
+
+# A transform spinning half a turn about z while sliding along x, given as five keys.
+# Interpolating between just the first and last pose would not rotate at all.
+positions = []
+rotations = []
+for k in range(NUM_KEYS):
+    angle = math.pi * k / (NUM_KEYS - 1)
+    positions += [float(k), 0., 0.]
+    rotations += [0., 0., math.sin(angle * .5), math.cos(angle * .5)]
+
+spinner = visii.transform.create("spinner")
+spinner.set_motion_keys(positions, rotations)
+assert spinner.get_num_motion_keys() == NUM_KEYS
+
+child = visii.transform.create("child", position = visii.vec3(0., 1., 0.))
+child.set_parent(spinner)
+
+# %%
+def assert_close(a, b, what):
+    for c in range(4):
+        for r in range(4):
+            assert abs(a[c][r] - b[c][r]) <= TOLERANCE * max(1., abs(b[c][r])), \
+                "{}: {} != {}".format(what, a, b)
+
+for i in range(17):
+    time = i / 16.
+    expected = visii.translate(visii.mat4(1.), visii.vec3(time * (NUM_KEYS - 1), 0., 0.)) * \
+        visii.mat4_cast(visii.angleAxis(math.pi * time, visii.vec3(0., 0., 1.)))
+    assert_close(spinner.get_local_to_parent_matrix_at_time(time), expected, "spinner at {}".format(time))
+
+    child_expected = expected * visii.translate(visii.mat4(1.), visii.vec3(0., 1., 0.))
+    assert_close(child.get_local_to_world_matrix_at_time(time), child_expected, "child at {}".format(time))
+
+# Mismatched or out of range key counts are rejected
+for bad in [([0., 0., 0.], []), ([0.] * 6, [0., 0., 0., 1.]), ([0.] * 3 * 9, [])]:
+    try:
+        spinner.set_motion_keys(*bad)
+        assert False, "expected set_motion_keys to fail"
+    except RuntimeError:
+        pass
+
+spinner.clear_motion_keys()
+assert spinner.get_num_motion_keys() == 0
+assert_close(spinner.get_local_to_parent_matrix_at_time(0.), spinner.get_local_to_parent_matrix(), "cleared keys")
+
+print("Motion keys sample as expected")
+
+# %%
+visii.cleanup()
@@ -0,0 +1,87 @@
+#%%
+import sys, os, random
+os.add_dll_directory(os.path.join(os.getcwd(), '..', 'install'))
+sys.path.append(os.path.join(os.getcwd(), "..", "install"))
+
+import visii
+
+NUM_TRANSFORMS = 200
+TOLERANCE = 1e-4
+
+#%%
+visii.initialize_headless()
+
+camera_entity = visii.entity.create(
+    name="camera",
+    transform=visii.transform.create("camera_transform"),
+    camera=visii.camera.create_perspective_from_fov(name = "camera", field_of_view = 0.785398, aspect = 1., near = .1))
+visii.set_camera_entity(camera_entity)
+
+# Random moving transforms, most of them parented to an earlier one
+random.seed(1)
+def rand_vec3(lo, hi):
+    return visii.vec3(random.uniform(lo, hi), random.uniform(lo, hi), random.uniform(lo, hi))
+
+transforms = []
+parents = []
+velocities = []
+for i in range(NUM_TRANSFORMS):
+    t = visii.transform.create("t_{}".format(i),
+        scale = rand_vec3(.5, 2.),
+        rotation = visii.normalize(visii.quat(*[random.uniform(-1, 1) for j in range(4)])),
+        position = rand_vec3(-2, 2))
+    velocity = [rand_vec3(-1, 1), visii.angleAxis(random.uniform(-1, 1), visii.normalize(rand_vec3(-1, 1))), rand_vec3(-.1, .1)]
+    t.set_linear_velocity(velocity[0])
+    t.set_angular_velocity(velocity[1])
+    t.set_scalar_velocity(velocity[2])
+    parent = random.randrange(i) if (i > 0 and random.random() < .8) else None
+    if parent is not None:
+        t.set_parent(transforms[parent])
+    transforms.append(t)
+    parents.append(parent)
+    velocities.append(velocity)
+
+# %%
+def assert_close(a, b, what):
+    for c in range(4):
+        for r in range(4):
+            assert abs(a[c][r] - b[c][r]) <= TOLERANCE * max(1., abs(b[c][r])), \
+                "{}: {} != {}".format(what, a, b)
+
+# Reference next frame matrices, composed with plain glm products
+def reference_next_local(i):
+    t = transforms[i]
+    linear, angular, scalar = velocities[i]
+    return visii.translate(visii.mat4(1.), t.get_position() + linear) * \
+        visii.mat4_cast(angular * t.get_rotation()) * \
+        visii.scale(visii.mat4(1.), t.get_scale() + scalar)
+
+def reference_next_world(i):
+    local = reference_next_local(i)
+    if parents[i] is None: return local
+    return reference_next_world(parents[i]) * local
+
+def check_all():
+    for i, t in enumerate(transforms):
+        local = reference_next_local(i)
+        assert_close(t.get_next_local_to_parent_matrix(), local, "next local to parent")
+        assert_close(t.get_next_parent_to_local_matrix(), visii.inverse(local), "next parent to local")
+        assert_close(t.get_next_local_to_world_matrix(), reference_next_world(i), "next local to world")
+
+# Both between an edit and the next update, and after the batched update 
+check_all()
+visii.render_to_png(width = 8, height = 8, samples_per_pixel = 1, image_path = "tmp_next_matrices.png")
+check_all()
+
+# Editing a parent's velocity moves its children's next matrices along with it
+velocities[0][0] = visii.vec3(10., 0., 0.)
+transforms[0].set_linear_velocity(velocities[0][0])
+check_all()
+visii.render_to_png(width = 8, height = 8, samples_per_pixel = 1, image_path = "tmp_next_matrices.png")
+check_all()
+
+print("All next frame matrices match their reference matrices")
+
+# %%
+os.remove("tmp_next_matrices.png")
+visii.cleanup()